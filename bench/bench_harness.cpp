@@ -0,0 +1,152 @@
+#include "bench_harness.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+
+// the two-sided 95% quantiles of the t distribution for 1..30 degrees of freedom.
+static const double T_QUANTILES[30] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+};
+
+static double t_quantile(int degrees)
+{
+    if (degrees <= 0) {
+        return 0.0;
+    }
+    return degrees <= 30 ? T_QUANTILES[degrees - 1] : 1.960;
+}
+
+// append the formatted text into the string.
+static void append(std::string* text, const char* format, ...)
+{
+    char buffer[512];
+    va_list args;
+    va_start(args, format);
+    SDL_vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    *text += buffer;
+}
+
+BenchHarness::BenchHarness(const BenchConfig& config) : mConfig(config)
+{
+    mConfig.warmup = SDL_max(mConfig.warmup, 0);
+    mConfig.repetitions = SDL_max(mConfig.repetitions, 1);
+}
+
+bool BenchHarness::enabled(const char* name) const
+{
+    if (mConfig.filter == NULL) {
+        return true;
+    }
+    auto length = SDL_min(SDL_strlen(name), SDL_strlen(mConfig.filter));
+    return SDL_strncmp(name, mConfig.filter, length) == 0;
+}
+
+void BenchHarness::run(const char* name, const char* unit, double ops, const Body& body)
+{
+    if (!enabled(name)) {
+        return;
+    }
+    for (auto i = 0; i < mConfig.warmup; i++) {
+        body();
+    }
+    std::vector<double> samples;
+    for (auto i = 0; i < mConfig.repetitions; i++) {
+        samples.push_back(body() * 1e9 / ops);
+    }
+
+    BenchResult result;
+    result.name = name;
+    result.unit = unit;
+    result.ops = ops;
+    auto count = double(samples.size());
+    auto sum = 0.0;
+    for (auto sample : samples) {
+        sum += sample;
+    }
+    result.meanNs = sum / count;
+    auto squares = 0.0;
+    for (auto sample : samples) {
+        squares += (sample - result.meanNs) * (sample - result.meanNs);
+    }
+    result.stddevNs = samples.size() > 1 ? std::sqrt(squares / (count - 1.0)) : 0.0;
+    result.ci95Ns = t_quantile(int(samples.size()) - 1) * result.stddevNs / std::sqrt(count);
+    std::sort(samples.begin(), samples.end());
+    auto middle = samples.size() / 2;
+    result.minNs = samples.front();
+    result.medianNs = samples.size() % 2 != 0 ? samples[middle] : (samples[middle - 1] + samples[middle]) / 2.0;
+    result.maxNs = samples.back();
+    mResults.push_back(result);
+
+    SDL_Log("%-28s %12.2f ns/%s +- %.2f (%.3g %s/s)\n",
+            name,
+            result.meanNs,
+            unit,
+            result.ci95Ns,
+            1e9 / result.meanNs,
+            unit);
+}
+
+bool BenchHarness::write_json(const char* path) const
+{
+    SDL_version version;
+    SDL_GetVersion(&version);
+    auto videoDriver = SDL_GetCurrentVideoDriver();
+
+    std::string json;
+    append(&json, "{\n");
+    append(&json, "  \"suite\": \"sdl2_sandbox_bench\",\n");
+    append(&json, "  \"sdl\": \"%d.%d.%d\",\n", version.major, version.minor, version.patch);
+    append(&json, "  \"platform\": \"%s\",\n", SDL_GetPlatform());
+    append(&json, "  \"video_driver\": \"%s\",\n", videoDriver != NULL ? videoDriver : "none");
+    append(&json, "  \"cpus\": %d,\n", SDL_GetCPUCount());
+    append(&json, "  \"warmup\": %d,\n", mConfig.warmup);
+    append(&json, "  \"repetitions\": %d,\n", mConfig.repetitions);
+    append(&json, "  \"results\": [");
+    for (size_t i = 0; i < mResults.size(); i++) {
+        const auto& result = mResults[i];
+        append(&json, "%s\n    {", i == 0 ? "" : ",");
+        append(&json, "\"name\": \"%s\", \"unit\": \"%s\", \"ops\": %.0f, ",
+               result.name.c_str(),
+               result.unit.c_str(),
+               result.ops);
+        append(&json, "\"mean_ns\": %.4f, \"stddev_ns\": %.4f, \"ci95_ns\": %.4f, ",
+               result.meanNs,
+               result.stddevNs,
+               result.ci95Ns);
+        append(&json, "\"min_ns\": %.4f, \"median_ns\": %.4f, \"max_ns\": %.4f, ",
+               result.minNs,
+               result.medianNs,
+               result.maxNs);
+        append(&json, "\"ops_per_s\": %.1f}", result.meanNs > 0.0 ? 1e9 / result.meanNs : 0.0);
+    }
+    append(&json, "\n  ]\n}\n");
+
+    auto file = path != NULL ? SDL_RWFromFile(path, "w") : SDL_RWFromFP(stdout, SDL_FALSE);
+    if (file == NULL) {
+        SDL_Log("Failed to open the benchmark JSON file: %s\n", SDL_GetError());
+        return false;
+    }
+    auto result = SDL_RWwrite(file, json.data(), 1, json.size()) == json.size();
+    if (!result) {
+        SDL_Log("Failed to write the benchmark JSON file: %s\n", SDL_GetError());
+    }
+    if (SDL_RWclose(file) != 0) {
+        SDL_Log("Failed to close the benchmark JSON file: %s\n", SDL_GetError());
+        result = false;
+    }
+    return result;
+}
+
+BenchConfig BenchHarness::default_config()
+{
+    BenchConfig config;
+    config.warmup = 2;
+    config.repetitions = 10;
+    config.filter = NULL;
+    return config;
+}
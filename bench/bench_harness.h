@@ -0,0 +1,68 @@
+// ============================================================================
+// BENCH HARNESS
+// ============================================================================
+// Runs the cases of the headless benchmark suite (bench_main.cpp) and writes
+// the results as JSON, so that the results of two builds can be compared.
+//
+// run()..........Run the body for the warmup repetitions, which are discarded,
+//                and then for the measured repetitions. The body returns the
+//                measured seconds of one repetition, which leaves the setup
+//                of the repetition out of the measurement.
+// write_json()...Write the results into a file or into stdout (NULL).
+//
+// Each result contains the mean, the standard deviation, the min, the median
+// and the max of the nanoseconds per operation, the throughput and the 95%
+// confidence interval of the mean from the Student's t distribution. A change
+// between two builds is significant when their intervals do not overlap.
+// ============================================================================
+#pragma once
+
+#include <SDL.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+struct BenchConfig {
+    int         warmup;      // the discarded repetitions of each case.
+    int         repetitions; // the measured repetitions of each case.
+    const char* filter;      // run only the cases with this prefix (or NULL).
+};
+
+struct BenchResult {
+    std::string name;
+    std::string unit;   // the name of the operation, e.g. "bytes".
+    double      ops;    // the operations of one repetition.
+    double      meanNs; // the following values are nanoseconds per operation.
+    double      stddevNs;
+    double      ci95Ns; // the half-width of the 95% confidence interval.
+    double      minNs;
+    double      medianNs;
+    double      maxNs;
+};
+
+class BenchHarness {
+public:
+    typedef std::function<double()> Body;
+
+    explicit BenchHarness(const BenchConfig& config);
+
+    // whether the case or the group of cases (e.g. "rwops") passes the filter.
+    // Used to skip the setup of the cases that are not run.
+    bool enabled(const char* name) const;
+    // run the case of ops operations (of the unit) per repetition.
+    void run(const char* name, const char* unit, double ops, const Body& body);
+    bool write_json(const char* path) const;
+
+    const BenchConfig&              config() const  { return mConfig; }
+    const std::vector<BenchResult>& results() const { return mResults; }
+
+    static BenchConfig default_config();
+
+private:
+    BenchHarness(const BenchHarness&);
+    BenchHarness& operator=(const BenchHarness&);
+
+    BenchConfig              mConfig;
+    std::vector<BenchResult> mResults;
+};
@@ -0,0 +1,367 @@
+// ============================================================================
+// SDL2 Sandbox Benchmarks
+// ============================================================================
+// A headless benchmark suite of the sandbox subsystems. The suite runs with
+// the dummy video driver (unless SDL_VIDEODRIVER is set) and a hidden window,
+// so it can be run on build machines without a display. The results are
+// written as JSON (see bench_harness.h) to catch regressions between builds.
+//
+// threads....Spawning an SDL thread per job versus submitting to ThreadPool.
+// counters...A single SDL_atomic_t versus a ShardedCounter on all CPUs.
+// rwops......SDL_RWops read throughput of memory, of a file and of a mapping.
+// rects......Looping over SDL_HasIntersection versus a RectBatch query.
+// events.....Pushing a flood of SDL_PushEvent events and draining them with
+//            SDL_PollEvent versus batches of SDL_PeepEvents.
+// timers.....The lateness of SDL_Delay and of an SDL_AddTimer callback.
+//
+// The command line options are the following.
+//
+// --warmup=N.......The discarded repetitions of each case (default: 2).
+// --reps=N.........The measured repetitions of each case (default: 10).
+// --filter=NAME....Run only the cases whose names start with NAME.
+// --out=FILE.......Write the JSON into the FILE instead of stdout.
+// ============================================================================
+#include <SDL.h>
+
+#include "bench_harness.h"
+#include "bench_workloads.h"
+#include "mapped_file.h"
+#include "subsystems.h"
+#include "thread_pool.h"
+
+#include <cstdio>
+#include <vector>
+
+// ============================================================================
+// THREADS
+// ============================================================================
+// A batch of empty jobs is run either on new threads, which are created and
+// joined for each job, or on a pool whose workers have already been started.
+// ============================================================================
+static const int THREAD_JOBS = 64;
+
+static int empty_thread_function(void* data)
+{
+    SDL_AtomicAdd(static_cast<SDL_atomic_t*>(data), 1);
+    return 0;
+}
+
+static void bench_threads(BenchHarness& harness)
+{
+    SDL_atomic_t done;
+    SDL_AtomicSet(&done, 0);
+    harness.run("threads.spawn", "job", THREAD_JOBS, [&done]() {
+        SDL_Thread* threads[THREAD_JOBS];
+        auto start = SDL_GetPerformanceCounter();
+        for (auto i = 0; i < THREAD_JOBS; i++) {
+            threads[i] = SDL_CreateThread(empty_thread_function, "bench-spawn", &done);
+        }
+        for (auto i = 0; i < THREAD_JOBS; i++) {
+            if (threads[i] != NULL) {
+                SDL_WaitThread(threads[i], NULL);
+            }
+        }
+        return seconds_since(start);
+    });
+    if (!harness.enabled("threads.pool")) {
+        return;
+    }
+    ThreadPool pool;
+    harness.run("threads.pool", "job", THREAD_JOBS, [&pool, &done]() {
+        WaitGroup group;
+        auto start = SDL_GetPerformanceCounter();
+        for (auto i = 0; i < THREAD_JOBS; i++) {
+            pool.submit([&done]() { SDL_AtomicAdd(&done, 1); }, &group);
+        }
+        pool.wait(group);
+        return seconds_since(start);
+    });
+}
+
+// ============================================================================
+// COUNTERS
+// ============================================================================
+// The counter workload (bench_workloads.h) with a thread per CPU.
+// ============================================================================
+static const int COUNTER_INCREMENTS = 200000;
+
+static void bench_counters(BenchHarness& harness)
+{
+    CounterWorkload workload(COUNTER_INCREMENTS);
+    auto numThreads = SDL_max(SDL_GetCPUCount(), 2);
+    auto increments = double(COUNTER_INCREMENTS) * numThreads;
+    harness.run("counters.atomic", "increment", increments, [&workload, numThreads]() {
+        return workload.run(numThreads, false);
+    });
+    harness.run("counters.sharded", "increment", increments, [&workload, numThreads]() {
+        return workload.run(numThreads, true);
+    });
+}
+
+// ============================================================================
+// RWOPS
+// ============================================================================
+// The same data is read in chunks through an SDL_RWops of memory, of a file
+// in the preferences path and of a mapping of the file (mapped_file.h). The
+// file is opened on each repetition, so the open is part of the measurement.
+// The file is in the page cache after the warmup, so the disk is not measured.
+// ============================================================================
+static const size_t RWOPS_SIZE = 16 * 1024 * 1024;
+static const size_t RWOPS_CHUNK = 64 * 1024;
+
+// read the whole stream and close it. Returns the seconds from the open.
+static double read_stream(SDL_RWops* rw, Uint64 start, std::vector<Uint8>* chunk)
+{
+    if (rw == NULL) {
+        SDL_Log("Failed to open the benchmark stream: %s\n", SDL_GetError());
+        return 0.0;
+    }
+    while (SDL_RWread(rw, &(*chunk)[0], 1, chunk->size()) > 0) {
+    }
+    SDL_RWclose(rw);
+    return seconds_since(start);
+}
+
+static void bench_rwops(BenchHarness& harness)
+{
+    if (!harness.enabled("rwops")) {
+        return;
+    }
+    std::vector<Uint8> data(RWOPS_SIZE);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = Uint8(i * 31 + (i >> 12));
+    }
+    std::vector<Uint8> chunk(RWOPS_CHUNK);
+    auto bytes = double(RWOPS_SIZE);
+    harness.run("rwops.mem", "byte", bytes, [&data, &chunk]() {
+        auto start = SDL_GetPerformanceCounter();
+        return read_stream(SDL_RWFromConstMem(&data[0], int(data.size())), start, &chunk);
+    });
+
+    char path[1024];
+    auto prefPath = SDL_GetPrefPath("organization_name", "application_name");
+    if (prefPath == NULL) {
+        SDL_Log("Unable to find the preferences path: %s\n", SDL_GetError());
+        return;
+    }
+    SDL_snprintf(path, sizeof(path), "%sbench.rwops", prefPath);
+    SDL_free(prefPath);
+    auto file = SDL_RWFromFile(path, "wb");
+    if (file == NULL || SDL_RWwrite(file, &data[0], 1, data.size()) != data.size()) {
+        SDL_Log("Unable to write the benchmark file %s: %s\n", path, SDL_GetError());
+        if (file != NULL) {
+            SDL_RWclose(file);
+        }
+        std::remove(path);
+        return;
+    }
+    SDL_RWclose(file);
+    harness.run("rwops.file", "byte", bytes, [&path, &chunk]() {
+        auto start = SDL_GetPerformanceCounter();
+        return read_stream(SDL_RWFromFile(path, "rb"), start, &chunk);
+    });
+    harness.run("rwops.mmap", "byte", bytes, [&path, &chunk]() {
+        auto start = SDL_GetPerformanceCounter();
+        return read_stream(rw_from_mapped_file(path), start, &chunk);
+    });
+    std::remove(path);
+}
+
+// ============================================================================
+// RECTS
+// ============================================================================
+// The query rects of the rect workload (bench_workloads.h) are tested for
+// intersections against all rects with SDL_HasIntersection and RectBatch.
+// ============================================================================
+static const int RECT_COUNT = 20000;
+static const int RECT_QUERIES = 50;
+
+static void bench_rects(BenchHarness& harness)
+{
+    if (!harness.enabled("rects")) {
+        return;
+    }
+    RectWorkload workload(RECT_COUNT, RECT_QUERIES);
+    auto tests = double(RECT_COUNT) * RECT_QUERIES;
+    auto loopHits = 0;
+    harness.run("rects.loop_intersect", "test", tests, [&workload, &loopHits]() {
+        return workload.loop_intersect(&loopHits);
+    });
+    auto batchHits = 0;
+    harness.run("rects.batch_intersect", "test", tests, [&workload, &batchHits]() {
+        return workload.batch_intersect(&batchHits);
+    });
+    if (harness.enabled("rects.loop_intersect") && harness.enabled("rects.batch_intersect") && loopHits != batchHits) {
+        SDL_Log("Rect batch hits (%d) do not match the SDL hits (%d)!\n", batchHits, loopHits);
+    }
+}
+
+// ============================================================================
+// EVENTS
+// ============================================================================
+// A flood of user events is pushed into the queue with SDL_PushEvent and then
+// drained either one by one with SDL_PollEvent, which also pumps the events of
+// the window on each call, or in batches with SDL_PeepEvents after a single
+// SDL_PumpEvents, as the main loop does. An operation is a pushed and drained
+// event. The flood stays below the SDL queue limit of 65535 events.
+// ============================================================================
+static const int EVENT_FLOOD = 16384;
+static const int EVENT_BATCH = 64;
+
+static double push_events(Uint32 type)
+{
+    SDL_Event event;
+    SDL_zero(event);
+    event.type = type;
+    auto start = SDL_GetPerformanceCounter();
+    for (auto i = 0; i < EVENT_FLOOD; i++) {
+        event.user.code = i;
+        if (SDL_PushEvent(&event) < 0) {
+            SDL_Log("Failed to push a benchmark event: %s\n", SDL_GetError());
+            break;
+        }
+    }
+    return seconds_since(start);
+}
+
+static void bench_events(BenchHarness& harness)
+{
+    if (!harness.enabled("events")) {
+        return;
+    }
+    auto type = SDL_RegisterEvents(1);
+    if (type == Uint32(-1)) {
+        SDL_Log("Unable to register the benchmark event: %s\n", SDL_GetError());
+        return;
+    }
+    SDL_PumpEvents();
+    SDL_FlushEvents(SDL_FIRSTEVENT, SDL_LASTEVENT);
+    harness.run("events.push_poll", "event", EVENT_FLOOD, [type]() {
+        auto seconds = push_events(type);
+        auto start = SDL_GetPerformanceCounter();
+        SDL_Event event;
+        while (SDL_PollEvent(&event)) {
+        }
+        return seconds + seconds_since(start);
+    });
+    harness.run("events.push_peep", "event", EVENT_FLOOD, [type]() {
+        auto seconds = push_events(type);
+        auto start = SDL_GetPerformanceCounter();
+        SDL_PumpEvents();
+        SDL_Event events[EVENT_BATCH];
+        while (SDL_PeepEvents(events, EVENT_BATCH, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT) > 0) {
+        }
+        return seconds + seconds_since(start);
+    });
+}
+
+// ============================================================================
+// TIMERS
+// ============================================================================
+// The lateness is the time past the requested deadline, measured with the
+// performance counter. The SDL_AddTimer callback runs on the SDL timer thread
+// and records the time it was called before it signals the waiting thread.
+// ============================================================================
+static const int TIMER_ROUNDS = 20;
+static const Uint32 TIMER_INTERVAL_MS = 2;
+
+struct TimerBench {
+    SDL_sem* fired;
+    Uint64   calledAt;
+};
+
+static Uint32 timer_callback(Uint32, void* data)
+{
+    auto bench = static_cast<TimerBench*>(data);
+    bench->calledAt = SDL_GetPerformanceCounter();
+    SDL_SemPost(bench->fired);
+    return 0;
+}
+
+static void bench_timers(BenchHarness& harness)
+{
+    auto frequency = double(SDL_GetPerformanceFrequency());
+    harness.run("timers.delay_1ms", "delay", TIMER_ROUNDS, [frequency]() {
+        auto lateness = 0.0;
+        for (auto i = 0; i < TIMER_ROUNDS; i++) {
+            auto start = SDL_GetPerformanceCounter();
+            SDL_Delay(1);
+            lateness += (SDL_GetPerformanceCounter() - start) / frequency - 0.001;
+        }
+        return lateness;
+    });
+    if (!harness.enabled("timers.add_timer")) {
+        return;
+    }
+    TimerBench bench;
+    bench.fired = SDL_CreateSemaphore(0);
+    harness.run("timers.add_timer_2ms", "timer", TIMER_ROUNDS, [&bench, frequency]() {
+        auto lateness = 0.0;
+        for (auto i = 0; i < TIMER_ROUNDS; i++) {
+            auto start = SDL_GetPerformanceCounter();
+            if (SDL_AddTimer(TIMER_INTERVAL_MS, timer_callback, &bench) == 0) {
+                SDL_Log("Failed to add a benchmark timer: %s\n", SDL_GetError());
+                break;
+            }
+            SDL_SemWait(bench.fired);
+            lateness += (bench.calledAt - start) / frequency - TIMER_INTERVAL_MS / 1000.0;
+        }
+        return lateness;
+    });
+    SDL_DestroySemaphore(bench.fired);
+}
+
+int main(int argc, char* argv[])
+{
+    auto config = BenchHarness::default_config();
+    const char* outPath = NULL;
+    for (auto i = 1; i < argc; i++) {
+        if (SDL_strncmp(argv[i], "--warmup=", 9) == 0) {
+            config.warmup = SDL_atoi(argv[i] + 9);
+        } else if (SDL_strncmp(argv[i], "--reps=", 7) == 0) {
+            config.repetitions = SDL_atoi(argv[i] + 7);
+        } else if (SDL_strncmp(argv[i], "--filter=", 9) == 0) {
+            config.filter = argv[i] + 9;
+        } else if (SDL_strncmp(argv[i], "--out=", 6) == 0) {
+            outPath = argv[i] + 6;
+        } else {
+            SDL_Log("Unknown option: %s\n", argv[i]);
+            return -1;
+        }
+    }
+
+    // the environment variable is not overwritten, so a real driver can be used.
+    SDL_setenv("SDL_VIDEODRIVER", "dummy", 0);
+    if (SDL_Init(0) != 0 || !Subsystems::instance().require(SDL_INIT_VIDEO | SDL_INIT_TIMER)) {
+        SDL_Log("Unable to initialize SDL: %s\n", SDL_GetError());
+        return -1;
+    }
+    auto window = SDL_CreateWindow("SDL2 Sandbox Benchmarks",
+                                   SDL_WINDOWPOS_UNDEFINED,
+                                   SDL_WINDOWPOS_UNDEFINED,
+                                   320,
+                                   240,
+                                   SDL_WINDOW_HIDDEN);
+    if (window == NULL) {
+        SDL_Log("Unable to create the hidden window: %s\n", SDL_GetError());
+    }
+
+    BenchHarness harness(config);
+    SDL_Log("Running the benchmarks with the %s video driver (%d warmup, %d repetitions).\n",
+            SDL_GetCurrentVideoDriver(),
+            harness.config().warmup,
+            harness.config().repetitions);
+    bench_threads(harness);
+    bench_counters(harness);
+    bench_rwops(harness);
+    bench_rects(harness);
+    bench_events(harness);
+    bench_timers(harness);
+    auto result = harness.write_json(outPath);
+
+    if (window != NULL) {
+        SDL_DestroyWindow(window);
+    }
+    SDL_Quit();
+    return result ? 0 : -1;
+}
@@ -0,0 +1,66 @@
+// ============================================================================
+// EXAMPLE PLUGIN
+// ============================================================================
+// A plugin module for the PluginHost (plugin_host.h) that counts the updates
+// and draws a pulsing rectangle with the renderer. Load it with the option
+// --plugin=FILE, change the colors or the speed below, rebuild the target
+// sandbox_example_plugin and the running sandbox swaps the new code in. The
+// counters are kept over the swap, as they live in the host-owned state.
+// ============================================================================
+#include "plugin_api.h"
+
+struct ExampleState {
+    Uint32 updates;
+    Uint32 loads;
+    double seconds;
+    double nextReport;
+};
+
+static const SandboxPluginInfo sInfo = {
+    SANDBOX_PLUGIN_API_VERSION,
+    "example",
+    sizeof(ExampleState),
+    1
+};
+
+SANDBOX_PLUGIN_EXPORT const SandboxPluginInfo* sandbox_plugin_info()
+{
+    return &sInfo;
+}
+
+SANDBOX_PLUGIN_EXPORT void sandbox_plugin_load(void* data, int reloaded)
+{
+    auto state = static_cast<ExampleState*>(data);
+    state->loads++;
+    SDL_Log("Example plugin %s (load %u, %u updates so far)\n",
+            reloaded ? "reloaded" : "loaded",
+            state->loads,
+            state->updates);
+}
+
+SANDBOX_PLUGIN_EXPORT void sandbox_plugin_unload(void* data)
+{
+    auto state = static_cast<ExampleState*>(data);
+    SDL_Log("Example plugin unloaded after %u updates\n", state->updates);
+}
+
+SANDBOX_PLUGIN_EXPORT void sandbox_plugin_update(void* data, double dt)
+{
+    auto state = static_cast<ExampleState*>(data);
+    state->updates++;
+    state->seconds += dt;
+    if (state->seconds >= state->nextReport) {
+        SDL_Log("Example plugin: %u updates in %.1f seconds\n", state->updates, state->seconds);
+        state->nextReport = state->seconds + 5.0;
+    }
+}
+
+SANDBOX_PLUGIN_EXPORT void sandbox_plugin_render(void* data, SDL_Renderer* renderer)
+{
+    auto state = static_cast<ExampleState*>(data);
+    auto pulse = 0.5 + 0.5 * SDL_sin(state->seconds * 4.0);
+    auto size = 16 + int(pulse * 48.0);
+    SDL_Rect rect = { 16, 16, size, size };
+    SDL_SetRenderDrawColor(renderer, 255, Uint8(pulse * 255.0), 64, 255);
+    SDL_RenderFillRect(renderer, &rect);
+}
@@ -0,0 +1,410 @@
+#include "allocator.h"
+#include "counters.h"
+
+// each pooled block starts with a header that keeps the payload 16 byte
+// aligned. Large blocks have no header, their sizes are kept in the shards.
+struct BlockHeader {
+    Uint32 magic;
+    Uint32 sizeClass;
+    Uint64 size;
+};
+
+static const Uint32 BLOCK_MAGIC = 0x414c4c43;
+
+static int size_class(size_t size)
+{
+    auto sizeClass = 0;
+    auto classSize = size_t(16);
+    while (classSize < size) {
+        classSize <<= 1;
+        sizeClass++;
+    }
+    return sizeClass;
+}
+
+static size_t class_size(int sizeClass)
+{
+    return size_t(16) << sizeClass;
+}
+
+static BlockHeader* header_of(void* memory)
+{
+    return static_cast<BlockHeader*>(memory) - 1;
+}
+
+Allocator& Allocator::instance()
+{
+    // never destroyed, because static destructors may still call SDL_free.
+    static Allocator* sAllocator = new Allocator();
+    return *sAllocator;
+}
+
+Allocator::Allocator()
+    : mInstalled(false),
+      mRegionLock(0),
+      mRegionUsed(0),
+      mStatsLock(0),
+      mPeakBytes(0),
+      mFrameStartAllocations(0),
+      mFrameStartBytes(0),
+      mFrameAllocations(0),
+      mFrameBytes(0),
+      mWorstFrameAllocations(0),
+      mArena(NULL),
+      mArenaUsed(0),
+      mArenaPeak(0)
+{
+    SDL_GetMemoryFunctions(&mSystemMalloc, &mSystemCalloc, &mSystemRealloc, &mSystemFree);
+    SDL_zeroa(mPools);
+    SDL_zeroa(mRegions);
+    SDL_AtomicSet(&mNumRegions, 0);
+    for (auto& shard : mLarge) {
+        shard.lock = 0;
+    }
+}
+
+bool Allocator::install()
+{
+    if (mInstalled) {
+        return true;
+    }
+    if (SDL_SetMemoryFunctions(pool_malloc, pool_calloc, pool_realloc, pool_free) != 0) {
+        SDL_Log("Unable to install the allocator: %s\n", SDL_GetError());
+        return false;
+    }
+    mInstalled = true;
+    return true;
+}
+
+// ============================================================================
+// SDL MEMORY FUNCTIONS
+// ============================================================================
+void* SDLCALL Allocator::pool_malloc(size_t size)
+{
+    return instance().allocate(size);
+}
+
+void* SDLCALL Allocator::pool_calloc(size_t count, size_t size)
+{
+    if (size != 0 && count > size_t(-1) / size) {
+        return NULL;
+    }
+    auto memory = instance().allocate(count * size);
+    if (memory != NULL) {
+        SDL_memset(memory, 0, count * size);
+    }
+    return memory;
+}
+
+void* SDLCALL Allocator::pool_realloc(void* memory, size_t size)
+{
+    auto& allocator = instance();
+    if (memory == NULL) {
+        return allocator.allocate(size);
+    }
+    if (!allocator.is_pooled(memory)) {
+        // large blocks are reallocated by the system, which may avoid a copy.
+        size_t oldSize = 0;
+        if (!allocator.take_large(memory, &oldSize)) {
+            return allocator.mSystemRealloc(memory, size);
+        }
+        auto result = allocator.mSystemRealloc(memory, size);
+        if (result == NULL) {
+            allocator.add_large(memory, oldSize);
+            return NULL;
+        }
+        allocator.add_large(result, size);
+        allocator.account(0, Sint64(size) - Sint64(oldSize));
+        return result;
+    }
+
+    // blocks of the pools can grow and shrink within their own size class.
+    auto header = header_of(memory);
+    SDL_assert(header->magic == BLOCK_MAGIC);
+    if (size <= class_size(header->sizeClass)) {
+        allocator.account(0, Sint64(size) - Sint64(header->size));
+        header->size = size;
+        return memory;
+    }
+    auto result = allocator.allocate(size);
+    if (result != NULL) {
+        SDL_memcpy(result, memory, SDL_min(size, size_t(header->size)));
+        allocator.release(memory);
+    }
+    return result;
+}
+
+void SDLCALL Allocator::pool_free(void* memory)
+{
+    if (memory != NULL) {
+        instance().release(memory);
+    }
+}
+
+// ============================================================================
+// POOLS
+// ============================================================================
+void* Allocator::allocate(size_t size)
+{
+    if (size <= MAX_POOLED_SIZE) {
+        auto sizeClass = size_class(size);
+        auto& pool = mPools[sizeClass];
+        SDL_AtomicLock(&pool.lock);
+        if (pool.freeList != NULL || refill(sizeClass)) {
+            auto block = pool.freeList;
+            pool.freeList = block->next;
+            SDL_AtomicUnlock(&pool.lock);
+            auto header = reinterpret_cast<BlockHeader*>(block);
+            header->magic = BLOCK_MAGIC;
+            header->sizeClass = Uint32(sizeClass);
+            header->size = size;
+            account(1, Sint64(size));
+            return header + 1;
+        }
+        // the regions are exhausted, so serve it from the system instead.
+        SDL_AtomicUnlock(&pool.lock);
+    }
+    auto memory = mSystemMalloc(size);
+    if (memory != NULL) {
+        add_large(memory, size);
+        account(1, Sint64(size));
+    }
+    return memory;
+}
+
+void Allocator::release(void* memory)
+{
+    if (!is_pooled(memory)) {
+        size_t size = 0;
+        if (take_large(memory, &size)) {
+            account(-1, -Sint64(size));
+        }
+        // a large block or memory that was allocated before installing.
+        mSystemFree(memory);
+        return;
+    }
+    auto header = header_of(memory);
+    SDL_assert(header->magic == BLOCK_MAGIC);
+    account(-1, -Sint64(header->size));
+    header->magic = 0;
+    auto& pool = mPools[header->sizeClass];
+    auto block = reinterpret_cast<FreeBlock*>(header);
+    SDL_AtomicLock(&pool.lock);
+    block->next = pool.freeList;
+    pool.freeList = block;
+    SDL_AtomicUnlock(&pool.lock);
+}
+
+// carve a new chunk of the newest region into blocks. Called with the pool
+// lock held. The regions are published with an atomic count, so is_pooled()
+// can read them without taking the region lock.
+bool Allocator::refill(int sizeClass)
+{
+    SDL_AtomicLock(&mRegionLock);
+    auto numRegions = SDL_AtomicGet(&mNumRegions);
+    if (numRegions == 0 || mRegionUsed == REGION_SIZE) {
+        auto memory = numRegions < MAX_REGIONS ? mSystemMalloc(REGION_SIZE) : NULL;
+        if (memory == NULL) {
+            SDL_AtomicUnlock(&mRegionLock);
+            return false;
+        }
+        mRegions[numRegions].begin = reinterpret_cast<uintptr_t>(memory);
+        mRegions[numRegions].end = mRegions[numRegions].begin + REGION_SIZE;
+        mRegionUsed = 0;
+        SDL_AtomicSet(&mNumRegions, ++numRegions);
+    }
+    auto chunk = reinterpret_cast<Uint8*>(mRegions[numRegions - 1].begin + mRegionUsed);
+    mRegionUsed += CHUNK_SIZE;
+    SDL_AtomicUnlock(&mRegionLock);
+
+    auto& pool = mPools[sizeClass];
+    auto blockSize = sizeof(BlockHeader) + class_size(sizeClass);
+    for (auto offset = size_t(0); offset + blockSize <= CHUNK_SIZE; offset += blockSize) {
+        auto block = reinterpret_cast<FreeBlock*>(chunk + offset);
+        block->next = pool.freeList;
+        pool.freeList = block;
+    }
+    return true;
+}
+
+bool Allocator::is_pooled(const void* memory) const
+{
+    auto address = reinterpret_cast<uintptr_t>(memory);
+    auto numRegions = SDL_AtomicGet(&mNumRegions);
+    for (auto i = 0; i < numRegions; i++) {
+        if (address >= mRegions[i].begin && address < mRegions[i].end) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int large_shard(const void* memory)
+{
+    auto address = reinterpret_cast<uintptr_t>(memory);
+    return int((address >> 4) ^ (address >> 12)) & (Allocator::LARGE_SHARDS - 1);
+}
+
+void Allocator::add_large(void* memory, size_t size)
+{
+    auto& shard = mLarge[large_shard(memory)];
+    SDL_AtomicLock(&shard.lock);
+    shard.blocks[memory] = size;
+    SDL_AtomicUnlock(&shard.lock);
+}
+
+// remove the large block and get its size. False if it's not a large block.
+bool Allocator::take_large(void* memory, size_t* size)
+{
+    auto& shard = mLarge[large_shard(memory)];
+    SDL_AtomicLock(&shard.lock);
+    auto block = shard.blocks.find(memory);
+    auto found = block != shard.blocks.end();
+    if (found) {
+        *size = block->second;
+        shard.blocks.erase(block);
+    }
+    SDL_AtomicUnlock(&shard.lock);
+    return found;
+}
+
+void Allocator::account(Sint64 allocations, Sint64 bytes)
+{
+    // the live values are the differences of the allocated and the freed.
+    if (allocations > 0) {
+        mAllocated.add(allocations);
+    } else if (allocations < 0) {
+        mFreed.add(-allocations);
+    }
+    if (bytes > 0) {
+        mAllocatedBytes.add(bytes);
+    } else if (bytes < 0) {
+        mFreedBytes.add(-bytes);
+    }
+}
+
+// ============================================================================
+// FRAME ARENA
+// ============================================================================
+// Allocations are bumped from the newest chunk. When a frame needs more than
+// the chunk has left, a new chunk is chained, and on the next reset all of
+// the chunks are replaced with a single chunk that fits the whole frame.
+// ============================================================================
+Allocator::ArenaChunk* Allocator::new_arena_chunk(size_t capacity)
+{
+    auto chunk = static_cast<ArenaChunk*>(mSystemMalloc(sizeof(ArenaChunk) + capacity));
+    if (chunk != NULL) {
+        chunk->next = NULL;
+        chunk->capacity = capacity;
+        chunk->used = 0;
+    }
+    return chunk;
+}
+
+void* Allocator::frame_alloc(size_t size, size_t alignment)
+{
+    SDL_assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+    for (auto attempt = 0; attempt < 2; attempt++) {
+        if (mArena != NULL) {
+            auto base = reinterpret_cast<uintptr_t>(mArena + 1);
+            auto start = (base + mArena->used + alignment - 1) & ~uintptr_t(alignment - 1);
+            auto end = start + size;
+            if (end <= base + mArena->capacity) {
+                mArenaUsed += size_t(end - base) - mArena->used;
+                mArena->used = size_t(end - base);
+                return reinterpret_cast<void*>(start);
+            }
+        }
+        auto chunk = new_arena_chunk(SDL_max(ARENA_SIZE, size + alignment));
+        if (chunk == NULL) {
+            return NULL;
+        }
+        chunk->next = mArena;
+        mArena = chunk;
+    }
+    return NULL;
+}
+
+void Allocator::end_frame()
+{
+    mArenaPeak = SDL_max(mArenaPeak, mArenaUsed);
+    if (mArena != NULL && mArena->next != NULL) {
+        size_t capacity = 0;
+        while (mArena != NULL) {
+            auto next = mArena->next;
+            capacity += mArena->capacity;
+            mSystemFree(mArena);
+            mArena = next;
+        }
+        mArena = new_arena_chunk(capacity);
+    } else if (mArena != NULL) {
+        mArena->used = 0;
+    }
+    mArenaUsed = 0;
+
+    auto allocated = mAllocated.value();
+    auto allocatedBytes = mAllocatedBytes.value();
+    auto bytes = allocatedBytes - mFreedBytes.value();
+    SDL_AtomicLock(&mStatsLock);
+    mPeakBytes = SDL_max(mPeakBytes, bytes);
+    mFrameAllocations = allocated - mFrameStartAllocations;
+    mFrameBytes = allocatedBytes - mFrameStartBytes;
+    mWorstFrameAllocations = SDL_max(mWorstFrameAllocations, mFrameAllocations);
+    mFrameStartAllocations = allocated;
+    mFrameStartBytes = allocatedBytes;
+    SDL_AtomicUnlock(&mStatsLock);
+}
+
+AllocatorStats Allocator::stats() const
+{
+    AllocatorStats stats;
+    stats.allocations = mAllocated.value() - mFreed.value();
+    stats.bytes = mAllocatedBytes.value() - mFreedBytes.value();
+    SDL_AtomicLock(&mStatsLock);
+    stats.peakBytes = SDL_max(mPeakBytes, stats.bytes);
+    stats.frameAllocations = mFrameAllocations;
+    stats.frameBytes = mFrameBytes;
+    stats.worstFrameAllocations = mWorstFrameAllocations;
+    SDL_AtomicUnlock(&mStatsLock);
+    stats.arenaCapacity = 0;
+    for (auto chunk = mArena; chunk != NULL; chunk = chunk->next) {
+        stats.arenaCapacity += Sint64(chunk->capacity);
+    }
+    stats.arenaPeakBytes = Sint64(mArenaPeak);
+    return stats;
+}
+
+// ============================================================================
+// GAUGES
+// ============================================================================
+static Sint64 live_allocations(void*)    { return Allocator::instance().stats().allocations; }
+static Sint64 live_bytes(void*)          { return Allocator::instance().stats().bytes; }
+static Sint64 peak_bytes(void*)          { return Allocator::instance().stats().peakBytes; }
+static Sint64 frame_allocations(void*)   { return Allocator::instance().stats().frameAllocations; }
+static Sint64 frame_bytes(void*)         { return Allocator::instance().stats().frameBytes; }
+static Sint64 worst_frame(void*)         { return Allocator::instance().stats().worstFrameAllocations; }
+static Sint64 arena_peak_bytes(void*)    { return Allocator::instance().stats().arenaPeakBytes; }
+
+void Allocator::add_gauges()
+{
+    auto& registry = CounterRegistry::instance();
+    registry.add_gauge("alloc live", live_allocations, NULL);
+    registry.add_gauge("alloc live bytes", live_bytes, NULL);
+    registry.add_gauge("alloc peak bytes", peak_bytes, NULL);
+    registry.add_gauge("alloc frame count", frame_allocations, NULL);
+    registry.add_gauge("alloc frame bytes", frame_bytes, NULL);
+    registry.add_gauge("alloc worst frame", worst_frame, NULL);
+    registry.add_gauge("arena peak bytes", arena_peak_bytes, NULL);
+}
+
+void Allocator::remove_gauges()
+{
+    auto& registry = CounterRegistry::instance();
+    registry.remove("alloc live");
+    registry.remove("alloc live bytes");
+    registry.remove("alloc peak bytes");
+    registry.remove("alloc frame count");
+    registry.remove("alloc frame bytes");
+    registry.remove("alloc worst frame");
+    registry.remove("arena peak bytes");
+}
@@ -0,0 +1,141 @@
+// ============================================================================
+// ALLOCATOR
+// ============================================================================
+// An allocator that replaces the memory functions of SDL (SDL_malloc etc.).
+//
+// Small allocations are served from size-class pools which keep the freed
+// blocks in free lists, so steady state allocation churn never reaches the
+// system allocator. Larger allocations are forwarded to the memory functions
+// that were in use before the allocator was installed.
+//
+// 16, 32, 64, 128, 256, 512...The size classes. Blocks are carved from 64 kB
+//                             chunks of 1 MB regions, which are never
+//                             returned to the system.
+// frame_alloc(size)...........A linear per-frame arena for transient frame
+//                             data. Resets on each end_frame (main loop
+//                             iteration) and can only be used by the main
+//                             thread. Grows to the frame high-water mark.
+//
+// The allocator should be installed before SDL allocates anything. Memory that
+// was allocated with the previous functions (e.g. by static constructors) is
+// recognized by its address, which is neither in the regions nor registered as
+// a large block, and it is forwarded to the previous functions.
+// ============================================================================
+#pragma once
+
+#include <SDL.h>
+#include "counters.h"
+
+#include <unordered_map>
+
+struct AllocatorStats {
+    Sint64 allocations;      // live allocations.
+    Sint64 bytes;            // live requested bytes.
+    Sint64 peakBytes;        // the highest amount of live bytes on a frame end.
+    Sint64 frameAllocations; // allocations within the last frame.
+    Sint64 frameBytes;       // bytes allocated within the last frame.
+    Sint64 worstFrameAllocations;
+    Sint64 arenaCapacity;    // bytes reserved for the frame arena.
+    Sint64 arenaPeakBytes;   // the highest amount of frame arena bytes used.
+};
+
+class Allocator {
+public:
+    static const int    NUM_CLASSES = 6;
+    static const size_t MAX_POOLED_SIZE = 512;
+    static const size_t CHUNK_SIZE = 64 * 1024;
+    static const size_t REGION_SIZE = 16 * CHUNK_SIZE;
+    static const int    MAX_REGIONS = 256;
+    static const int    LARGE_SHARDS = 16;
+    static const size_t ARENA_SIZE = 256 * 1024;
+
+    static Allocator& instance();
+
+    // replace the SDL memory functions. Call before any other SDL function.
+    bool install();
+    bool is_installed() const { return mInstalled; }
+
+    void* frame_alloc(size_t size, size_t alignment = 16);
+    void  end_frame();
+
+    AllocatorStats stats() const;
+    // register or remove the statistics as gauges of the CounterRegistry.
+    void add_gauges();
+    void remove_gauges();
+
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    struct Pool {
+        SDL_SpinLock lock;
+        FreeBlock*   freeList;
+    };
+
+    struct Region {
+        uintptr_t begin;
+        uintptr_t end;
+    };
+
+    // the live large blocks and their sizes, sharded by the address.
+    struct LargeShard {
+        SDL_SpinLock                      lock;
+        std::unordered_map<void*, size_t> blocks;
+    };
+
+    struct ArenaChunk {
+        ArenaChunk* next;
+        size_t      capacity;
+        size_t      used;
+    };
+
+    Allocator();
+    Allocator(const Allocator&);
+    Allocator& operator=(const Allocator&);
+
+    static void* SDLCALL pool_malloc(size_t size);
+    static void* SDLCALL pool_calloc(size_t count, size_t size);
+    static void* SDLCALL pool_realloc(void* memory, size_t size);
+    static void  SDLCALL pool_free(void* memory);
+
+    void* allocate(size_t size);
+    void  release(void* memory);
+    bool  refill(int sizeClass);
+    bool  is_pooled(const void* memory) const;
+    void  add_large(void* memory, size_t size);
+    bool  take_large(void* memory, size_t* size);
+    void  account(Sint64 allocations, Sint64 bytes);
+
+    ArenaChunk* new_arena_chunk(size_t capacity);
+
+    bool                 mInstalled;
+    SDL_malloc_func      mSystemMalloc;
+    SDL_calloc_func      mSystemCalloc;
+    SDL_realloc_func     mSystemRealloc;
+    SDL_free_func        mSystemFree;
+    Pool                 mPools[NUM_CLASSES];
+    SDL_SpinLock         mRegionLock;
+    mutable SDL_atomic_t mNumRegions;
+    size_t               mRegionUsed;
+    Region               mRegions[MAX_REGIONS];
+    LargeShard           mLarge[LARGE_SHARDS];
+
+    // the memory functions only touch the sharded counters, the lock guards
+    // the values that are aggregated from them on each end_frame.
+    ShardedCounter       mAllocated;
+    ShardedCounter       mAllocatedBytes;
+    ShardedCounter       mFreed;
+    ShardedCounter       mFreedBytes;
+    mutable SDL_SpinLock mStatsLock;
+    Sint64               mPeakBytes;
+    Sint64               mFrameStartAllocations;
+    Sint64               mFrameStartBytes;
+    Sint64               mFrameAllocations;
+    Sint64               mFrameBytes;
+    Sint64               mWorstFrameAllocations;
+
+    ArenaChunk*          mArena;
+    size_t               mArenaUsed;
+    size_t               mArenaPeak;
+};
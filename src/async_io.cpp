@@ -0,0 +1,333 @@
+#include "async_io.h"
+
+#include <algorithm>
+
+AsyncIo::AsyncIo(int numThreads)
+    : mEventType(SDL_RegisterEvents(1)),
+      mQuit(false),
+      mMutex(SDL_CreateMutex()),
+      mCond(SDL_CreateCond()),
+      mCacheMutex(SDL_CreateMutex()),
+      mCacheBytes(0),
+      mCacheClock(0)
+{
+    if (mEventType == Uint32(-1)) {
+        SDL_Log("Unable to register the async I/O event type: %s\n", SDL_GetError());
+    }
+    for (auto i = 0; i < SDL_max(1, numThreads); i++) {
+        char name[16];
+        SDL_snprintf(name, sizeof(name), "io-%d", i);
+        auto thread = SDL_CreateThread(thread_function, name, this);
+        if (thread == NULL) {
+            SDL_Log("Unable to create an I/O thread: %s\n", SDL_GetError());
+        } else {
+            mThreads.push_back(thread);
+        }
+    }
+}
+
+AsyncIo::~AsyncIo()
+{
+    SDL_LockMutex(mMutex);
+    mQuit = true;
+    SDL_CondBroadcast(mCond);
+    SDL_UnlockMutex(mMutex);
+    for (auto thread : mThreads) {
+        SDL_WaitThread(thread, NULL);
+    }
+    for (auto request : mPending) {
+        free_request(request);
+    }
+
+    // release the completions that were never dispatched.
+    SDL_Event events[16];
+    int count;
+    while ((count = SDL_PeepEvents(events, 16, SDL_GETEVENT, mEventType, mEventType)) > 0) {
+        for (auto i = 0; i < count; i++) {
+            free_request(static_cast<Request*>(events[i].user.data1));
+        }
+    }
+
+    for (auto& block : mCache) {
+        SDL_free(block.data);
+    }
+    SDL_DestroyMutex(mCacheMutex);
+    SDL_DestroyCond(mCond);
+    SDL_DestroyMutex(mMutex);
+}
+
+bool AsyncIo::read(const char* path, Sint64 offset, size_t length, Callback callback)
+{
+    auto request = new Request();
+    request->path = path;
+    request->offset = offset;
+    request->length = length;
+    request->callback = callback;
+    request->prefetch = false;
+    request->data = NULL;
+    request->bytesRead = 0;
+    return queue(request);
+}
+
+bool AsyncIo::prefetch(const char* path, Sint64 offset, size_t length)
+{
+    if (length > MAX_CACHE_BYTES) {
+        return false;
+    }
+    auto request = new Request();
+    request->path = path;
+    request->offset = offset;
+    request->length = length;
+    request->prefetch = true;
+    request->data = NULL;
+    request->bytesRead = 0;
+    return queue(request);
+}
+
+bool AsyncIo::handle_event(const SDL_Event& event)
+{
+    if (event.type != mEventType || event.user.data2 != this) {
+        return false;
+    }
+    auto request = static_cast<Request*>(event.user.data1);
+    if (request->callback) {
+        AsyncRead read;
+        read.path = request->path.c_str();
+        read.offset = request->offset;
+        read.data = request->data;
+        read.length = request->bytesRead;
+        read.ok = request->bytesRead == request->length;
+        request->callback(read);
+    }
+    free_request(request);
+    return true;
+}
+
+bool AsyncIo::queue(Request* request)
+{
+    if (request->offset < 0 || mThreads.empty()) {
+        free_request(request);
+        return false;
+    }
+    mRequests.increment();
+    SDL_LockMutex(mMutex);
+    mPending.push_back(request);
+    SDL_CondSignal(mCond);
+    SDL_UnlockMutex(mMutex);
+    return true;
+}
+
+int AsyncIo::thread_function(void* data)
+{
+    auto io = static_cast<AsyncIo*>(data);
+    std::vector<Request*> batch;
+    while (true) {
+        SDL_LockMutex(io->mMutex);
+        while (io->mPending.empty() && !io->mQuit) {
+            SDL_CondWait(io->mCond, io->mMutex);
+        }
+        if (io->mQuit) {
+            SDL_UnlockMutex(io->mMutex);
+            break;
+        }
+        batch.swap(io->mPending);
+        SDL_UnlockMutex(io->mMutex);
+
+        io->process(batch);
+        batch.clear();
+    }
+    return 0;
+}
+
+// ============================================================================
+// BATCHES
+// ============================================================================
+// Requests that are served from the cache are completed first. The rest are
+// sorted so that requests of the same file are next to each other in offset
+// order, and every file is opened only once for each batch. Requests whose
+// ranges overlap or are at most MAX_COALESCE_GAP apart become one span which
+// is read with a single seek and read.
+// ============================================================================
+void AsyncIo::process(std::vector<Request*>& batch)
+{
+    std::vector<Request*> misses;
+    for (auto request : batch) {
+        if (read_from_cache(request)) {
+            complete(request);
+        } else {
+            misses.push_back(request);
+        }
+    }
+    std::stable_sort(misses.begin(), misses.end(), [](const Request* a, const Request* b) {
+        auto order = a->path.compare(b->path);
+        return order != 0 ? order < 0 : a->offset < b->offset;
+    });
+
+    size_t first = 0;
+    while (first < misses.size()) {
+        auto last = first + 1;
+        while (last < misses.size() && misses[last]->path == misses[first]->path) {
+            last++;
+        }
+
+        auto file = SDL_RWFromFile(misses[first]->path.c_str(), "rb");
+        if (file == NULL) {
+            SDL_Log("Unable to open a file for async I/O: %s\n", SDL_GetError());
+            for (auto i = first; i < last; i++) {
+                complete(misses[i]);
+            }
+            first = last;
+            continue;
+        }
+
+        auto spanBegin = first;
+        auto spanEnd = misses[first]->offset + Sint64(misses[first]->length);
+        for (auto i = first + 1; i <= last; i++) {
+            if (i < last && misses[i]->offset <= spanEnd + MAX_COALESCE_GAP) {
+                spanEnd = SDL_max(spanEnd, misses[i]->offset + Sint64(misses[i]->length));
+                continue;
+            }
+            process_span(misses, spanBegin, i, file);
+            if (i < last) {
+                spanBegin = i;
+                spanEnd = misses[i]->offset + Sint64(misses[i]->length);
+            }
+        }
+        SDL_RWclose(file);
+        first = last;
+    }
+}
+
+void AsyncIo::process_span(std::vector<Request*>& batch, size_t begin, size_t end, SDL_RWops* file)
+{
+    auto offset = batch[begin]->offset;
+    Sint64 spanEnd = 0;
+    for (auto i = begin; i < end; i++) {
+        auto request = batch[i];
+        spanEnd = SDL_max(spanEnd, request->offset + Sint64(request->length));
+        request->data = request->length > 0 ? static_cast<Uint8*>(SDL_malloc(request->length)) : NULL;
+    }
+    auto length = size_t(spanEnd - offset);
+
+    // a single request is read directly into its own buffer.
+    auto single = end - begin == 1;
+    auto buffer = single ? batch[begin]->data : static_cast<Uint8*>(SDL_malloc(length));
+    size_t bytesRead = 0;
+    if (buffer != NULL && SDL_RWseek(file, offset, RW_SEEK_SET) == offset) {
+        bytesRead = SDL_RWread(file, buffer, 1, length);
+        mFileReads.increment();
+    }
+
+    for (auto i = begin; i < end; i++) {
+        auto request = batch[i];
+        auto start = size_t(request->offset - offset);
+        if (request->data != NULL && start < bytesRead) {
+            request->bytesRead = SDL_min(request->length, bytesRead - start);
+            if (!single) {
+                SDL_memcpy(request->data, buffer + start, request->bytesRead);
+            }
+        }
+        if (request->prefetch && request->length > 0 && request->bytesRead == request->length) {
+            add_to_cache(request->path, request->offset, request->data, request->bytesRead);
+        }
+        complete(request);
+    }
+    if (!single) {
+        SDL_free(buffer);
+    }
+}
+
+// ============================================================================
+// PREFETCH CACHE
+// ============================================================================
+// Prefetched blocks are kept until they are evicted by newer blocks in the
+// least recently used order. Requests must fit within a single block.
+// ============================================================================
+bool AsyncIo::read_from_cache(Request* request)
+{
+    if (request->prefetch) {
+        return false;
+    }
+    auto result = false;
+    SDL_LockMutex(mCacheMutex);
+    for (auto& block : mCache) {
+        if (block.path == request->path &&
+            request->offset >= block.offset &&
+            request->offset + Sint64(request->length) <= block.offset + Sint64(block.length)) {
+            request->data = request->length > 0 ? static_cast<Uint8*>(SDL_malloc(request->length)) : NULL;
+            if (request->data != NULL) {
+                SDL_memcpy(request->data, block.data + (request->offset - block.offset), request->length);
+            }
+            if (request->data != NULL || request->length == 0) {
+                request->bytesRead = request->length;
+                block.lastUse = ++mCacheClock;
+                result = true;
+            }
+            break;
+        }
+    }
+    SDL_UnlockMutex(mCacheMutex);
+    if (result) {
+        mCacheHits.increment();
+    }
+    return result;
+}
+
+void AsyncIo::add_to_cache(const std::string& path, Sint64 offset, const Uint8* data, size_t length)
+{
+    Block block;
+    block.path = path;
+    block.offset = offset;
+    block.length = length;
+    block.data = static_cast<Uint8*>(SDL_malloc(length));
+    if (block.data == NULL) {
+        return;
+    }
+    SDL_memcpy(block.data, data, length);
+
+    SDL_LockMutex(mCacheMutex);
+    while (!mCache.empty() && mCacheBytes + length > MAX_CACHE_BYTES) {
+        auto oldest = std::min_element(mCache.begin(), mCache.end(), [](const Block& a, const Block& b) {
+            return a.lastUse < b.lastUse;
+        });
+        mCacheBytes -= oldest->length;
+        SDL_free(oldest->data);
+        mCache.erase(oldest);
+    }
+    block.lastUse = ++mCacheClock;
+    mCache.push_back(block);
+    mCacheBytes += length;
+    SDL_UnlockMutex(mCacheMutex);
+}
+
+void AsyncIo::complete(Request* request)
+{
+    if (request->prefetch) {
+        free_request(request);
+        return;
+    }
+    SDL_Event event;
+    SDL_zero(event);
+    event.type = mEventType;
+    event.user.data1 = request;
+    event.user.data2 = this;
+
+    // the event queue can be temporarily full, so retry for a while.
+    for (auto attempt = 0; attempt < 100; attempt++) {
+        auto result = SDL_PushEvent(&event);
+        if (result > 0) {
+            return;
+        } else if (result == 0) {
+            break;
+        }
+        SDL_Delay(1);
+    }
+    SDL_Log("Unable to deliver an async I/O completion: %s\n", request->path.c_str());
+    free_request(request);
+}
+
+void AsyncIo::free_request(Request* request)
+{
+    SDL_free(request->data);
+    delete request;
+}
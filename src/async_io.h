@@ -0,0 +1,105 @@
+// ============================================================================
+// ASYNC I/O
+// ============================================================================
+// Asynchronous file reads which are serviced by dedicated I/O threads so the
+// frame loop never stalls on disk latency.
+//
+// read(path, offset, length, callback)...Queue a read request. Can be called
+//                                        from any thread.
+// prefetch(path, offset, length).........Queue a read whose data is kept in
+//                                        a block cache for later requests.
+// handle_event(event)....................Dispatch a completion on the main
+//                                        thread. Returns false for events
+//                                        that are not I/O completions.
+//
+// I/O threads take all pending requests as a single batch, sort them by the
+// file and the offset, and coalesce requests into one read when they refer
+// to the same or nearby ranges of a file. Completions are delivered through
+// the SDL event queue as events of a type from SDL_RegisterEvents, so the
+// callbacks are always called on the thread which pumps the events.
+// ============================================================================
+#pragma once
+
+#include <SDL.h>
+
+#include "counters.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+struct AsyncRead {
+    const char*  path;
+    Sint64       offset;
+    const Uint8* data;   // valid only during the callback.
+    size_t       length; // the amount of bytes that were read.
+    bool         ok;
+};
+
+class AsyncIo {
+public:
+    // coalesce requests of the same file if the gap between them is smaller.
+    static const Sint64 MAX_COALESCE_GAP = 64 * 1024;
+    // the maximum amount of bytes that are kept in the prefetch cache.
+    static const size_t MAX_CACHE_BYTES = 16 * 1024 * 1024;
+
+    typedef std::function<void(const AsyncRead& read)> Callback;
+
+    explicit AsyncIo(int numThreads = 1);
+    ~AsyncIo();
+
+    bool read(const char* path, Sint64 offset, size_t length, Callback callback);
+    bool prefetch(const char* path, Sint64 offset, size_t length);
+    bool handle_event(const SDL_Event& event);
+
+    Uint32                event_type() const { return mEventType; }
+    const ShardedCounter& requests() const   { return mRequests; }
+    const ShardedCounter& file_reads() const { return mFileReads; }
+    const ShardedCounter& cache_hits() const { return mCacheHits; }
+
+private:
+    struct Request {
+        std::string path;
+        Sint64      offset;
+        size_t      length;
+        Callback    callback;
+        bool        prefetch;
+        Uint8*      data;
+        size_t      bytesRead;
+    };
+
+    struct Block {
+        std::string path;
+        Sint64      offset;
+        size_t      length;
+        Uint8*      data;
+        Uint64      lastUse;
+    };
+
+    AsyncIo(const AsyncIo&);
+    AsyncIo& operator=(const AsyncIo&);
+
+    static int thread_function(void* data);
+
+    bool queue(Request* request);
+    void process(std::vector<Request*>& batch);
+    void process_span(std::vector<Request*>& batch, size_t begin, size_t end, SDL_RWops* file);
+    bool read_from_cache(Request* request);
+    void add_to_cache(const std::string& path, Sint64 offset, const Uint8* data, size_t length);
+    void complete(Request* request);
+    static void free_request(Request* request);
+
+    Uint32                    mEventType;
+    bool                      mQuit;
+    SDL_mutex*                mMutex;
+    SDL_cond*                 mCond;
+    std::vector<Request*>     mPending;
+    std::vector<SDL_Thread*>  mThreads;
+    SDL_mutex*                mCacheMutex;
+    std::vector<Block>        mCache;
+    size_t                    mCacheBytes;
+    Uint64                    mCacheClock;
+    ShardedCounter            mRequests;
+    ShardedCounter            mFileReads;
+    ShardedCounter            mCacheHits;
+};
@@ -0,0 +1,171 @@
+#include "async_log.h"
+
+static const size_t BUFFER_SIZE = 64 * 1024;
+
+static const char* PRIORITY_NAMES[SDL_NUM_LOG_PRIORITIES] = {
+    NULL, "VERBOSE", "DEBUG", "INFO", "WARN", "ERROR", "CRITICAL"
+};
+
+AsyncLog::AsyncLog(const char* path)
+    : mPreviousFunction(NULL),
+      mPreviousData(NULL),
+      mFile(NULL),
+      mQueue(QUEUE_CAPACITY),
+      mSemaphore(SDL_CreateSemaphore(0)),
+      mThread(NULL),
+      mStart(SDL_GetPerformanceCounter()),
+      mReportedLost(0)
+{
+    SDL_AtomicSet(&mWakePending, 0);
+    SDL_AtomicSet(&mQuit, 0);
+    for (auto& samples : mSamples) {
+        SDL_AtomicSet(&samples, 0);
+    }
+    mBuffer.reserve(BUFFER_SIZE);
+    if (path != NULL) {
+        mFile = SDL_RWFromFile(path, "wb");
+        if (mFile == NULL) {
+            SDL_Log("Unable to open the log file: %s\n", SDL_GetError());
+        }
+    }
+    mThread = SDL_CreateThread(thread_function, "log-writer", this);
+    if (mThread == NULL) {
+        SDL_Log("Unable to create the log writer thread: %s\n", SDL_GetError());
+        return;
+    }
+    SDL_LogGetOutputFunction(&mPreviousFunction, &mPreviousData);
+    SDL_LogSetOutputFunction(output_function, this);
+}
+
+AsyncLog::~AsyncLog()
+{
+    if (mThread != NULL) {
+        SDL_LogSetOutputFunction(mPreviousFunction, mPreviousData);
+        SDL_AtomicSet(&mQuit, 1);
+        SDL_SemPost(mSemaphore);
+        SDL_WaitThread(mThread, NULL);
+    }
+    if (mFile != NULL) {
+        SDL_RWclose(mFile);
+    }
+    SDL_DestroySemaphore(mSemaphore);
+}
+
+void AsyncLog::output_function(void* data, int category, SDL_LogPriority priority, const char* message)
+{
+    static_cast<AsyncLog*>(data)->output(category, priority, message);
+}
+
+void AsyncLog::output(int category, SDL_LogPriority priority, const char* message)
+{
+    static thread_local Record tRecord;
+
+    auto size = mQueue.size();
+    if (priority < SDL_LOG_PRIORITY_WARN) {
+        if (size >= QUEUE_CAPACITY / 4 * 3) {
+            mDropped.increment();
+            return;
+        }
+        if (size >= QUEUE_CAPACITY / 2) {
+            auto slot = SDL_max(0, SDL_min(category, int(SDL_LOG_CATEGORY_CUSTOM)));
+            if (SDL_AtomicIncRef(&mSamples[slot]) % SAMPLE_RATE != 0) {
+                mSampled.increment();
+                return;
+            }
+        }
+    }
+
+    tRecord.time = SDL_GetPerformanceCounter();
+    tRecord.thread = SDL_ThreadID();
+    tRecord.category = category;
+    tRecord.priority = priority;
+    SDL_strlcpy(tRecord.text, message, sizeof(tRecord.text));
+    if (!mQueue.push(tRecord)) {
+        mDropped.increment();
+        return;
+    }
+    mRecords.increment();
+
+    // wake the writer early for errors and when the queue starts to fill up.
+    if (priority >= SDL_LOG_PRIORITY_ERROR || size >= QUEUE_CAPACITY / 8) {
+        wake();
+    }
+}
+
+void AsyncLog::wake()
+{
+    if (SDL_AtomicCAS(&mWakePending, 0, 1)) {
+        SDL_SemPost(mSemaphore);
+    }
+}
+
+int AsyncLog::thread_function(void* data)
+{
+    auto log = static_cast<AsyncLog*>(data);
+    while (SDL_AtomicGet(&log->mQuit) == 0) {
+        SDL_SemWaitTimeout(log->mSemaphore, FLUSH_INTERVAL_MS);
+        SDL_AtomicSet(&log->mWakePending, 0);
+        log->drain();
+    }
+    log->drain();
+    return 0;
+}
+
+void AsyncLog::drain()
+{
+    Record record;
+    while (mQueue.pop(&record)) {
+        write_line(record);
+        if (mPreviousFunction != NULL) {
+            mPreviousFunction(mPreviousData, record.category, record.priority, record.text);
+        }
+    }
+
+    // make the gaps visible when records were lost since the last batch.
+    auto lost = mDropped.value() + mSampled.value();
+    if (lost != mReportedLost) {
+        record.time = SDL_GetPerformanceCounter();
+        record.thread = SDL_ThreadID();
+        record.category = SDL_LOG_CATEGORY_APPLICATION;
+        record.priority = SDL_LOG_PRIORITY_WARN;
+        SDL_snprintf(record.text, sizeof(record.text), "%d log records were dropped or sampled away",
+                     int(lost - mReportedLost));
+        mReportedLost = lost;
+        write_line(record);
+        if (mPreviousFunction != NULL) {
+            mPreviousFunction(mPreviousData, record.category, record.priority, record.text);
+        }
+    }
+    flush_buffer();
+}
+
+void AsyncLog::write_line(const Record& record)
+{
+    if (mFile == NULL) {
+        return;
+    }
+    char line[Record::TEXT_SIZE + 64];
+    auto seconds = double(record.time - mStart) / SDL_GetPerformanceFrequency();
+    auto length = SDL_snprintf(line, sizeof(line), "[%10.4f] [%lu] %s: %s",
+                               seconds,
+                               record.thread,
+                               PRIORITY_NAMES[record.priority],
+                               record.text);
+    length = SDL_min(length, int(sizeof(line)) - 1);
+    // the messages of the sandbox usually end with a newline, so avoid a blank line.
+    if (length == 0 || line[length - 1] != '\n') {
+        line[length++] = '\n';
+    }
+    if (mBuffer.size() + length > BUFFER_SIZE) {
+        flush_buffer();
+    }
+    mBuffer.insert(mBuffer.end(), line, line + length);
+}
+
+void AsyncLog::flush_buffer()
+{
+    if (mFile != NULL && !mBuffer.empty()) {
+        SDL_RWwrite(mFile, mBuffer.data(), 1, mBuffer.size());
+    }
+    mBuffer.clear();
+}
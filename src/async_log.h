@@ -0,0 +1,84 @@
+// ============================================================================
+// ASYNC LOG
+// ============================================================================
+// A logging backend that is installed with SDL_LogSetOutputFunction, so that
+// the SDL_Log calls no longer write to the console or a file on the calling
+// thread. A slow terminal or disk then blocks only the writer thread.
+//
+// 1. The message is copied into a record in a per-thread buffer.
+// 2. The record is pushed into a lock-free MpscQueue (never blocks).
+// 3. The "log-writer" thread drains the queue in batches, writes the batch
+//    with a single SDL_RWwrite into the log file (if any) and passes each
+//    record to the previous output function (i.e. the SDL console output).
+//
+// Under load the records below SDL_LOG_PRIORITY_WARN are first sampled (one
+// record of SAMPLE_RATE is kept per category) when the queue is half full,
+// and then dropped when the queue is three quarters full. The warnings and
+// the errors are dropped only when the queue is full. The writer logs the
+// amount of lost records so the gaps in the log are visible.
+//
+// Messages that are longer than Record::TEXT_SIZE bytes are truncated.
+// ============================================================================
+#pragma once
+
+#include <SDL.h>
+
+#include "counters.h"
+#include "lockfree_queue.h"
+
+#include <vector>
+
+class AsyncLog {
+public:
+    static const Uint32 QUEUE_CAPACITY = 2048;
+    static const int    SAMPLE_RATE = 8;
+    static const Uint32 FLUSH_INTERVAL_MS = 100;
+
+    // install the backend. The path of the log file can be NULL.
+    explicit AsyncLog(const char* path = NULL);
+    // restore the previous output function and write the queued records.
+    ~AsyncLog();
+
+    const ShardedCounter& records() const { return mRecords; }
+    const ShardedCounter& dropped() const { return mDropped; }
+    const ShardedCounter& sampled() const { return mSampled; }
+
+private:
+    struct Record {
+        static const int TEXT_SIZE = 232;
+
+        Uint64          time;
+        SDL_threadID    thread;
+        int             category;
+        SDL_LogPriority priority;
+        char            text[TEXT_SIZE];
+    };
+
+    AsyncLog(const AsyncLog&);
+    AsyncLog& operator=(const AsyncLog&);
+
+    static void output_function(void* data, int category, SDL_LogPriority priority, const char* message);
+    static int  thread_function(void* data);
+
+    void output(int category, SDL_LogPriority priority, const char* message);
+    void wake();
+    void drain();
+    void write_line(const Record& record);
+    void flush_buffer();
+
+    SDL_LogOutputFunction mPreviousFunction;
+    void*                 mPreviousData;
+    SDL_RWops*            mFile;
+    MpscQueue<Record>     mQueue;
+    SDL_sem*              mSemaphore;
+    SDL_atomic_t          mWakePending;
+    SDL_atomic_t          mQuit;
+    SDL_atomic_t          mSamples[SDL_LOG_CATEGORY_CUSTOM + 1];
+    SDL_Thread*           mThread;
+    Uint64                mStart;
+    Sint64                mReportedLost;
+    std::vector<char>     mBuffer;
+    ShardedCounter        mRecords;
+    ShardedCounter        mDropped;
+    ShardedCounter        mSampled;
+};
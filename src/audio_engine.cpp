@@ -0,0 +1,660 @@
+#include "audio_engine.h"
+#include "audio_stream.h"
+#include "cpu_features.h"
+#include "subsystems.h"
+
+#ifdef SANDBOX_X86
+#include <immintrin.h>
+#endif
+
+// ============================================================================
+// SCALAR
+// ============================================================================
+// The reference implementation which is used on every platform. The fraction
+// of the fixed point position is reduced to 24 bits, so that it converts into
+// a float without rounding. The vector variants compute exactly the same
+// operations in the same order and produce the same results.
+// ============================================================================
+static const float FRACTION_SCALE = 1.0f / 16777216.0f;
+
+static Uint64 resample_scalar(float* dst, const float* src, int count, Uint64 position, Uint64 step)
+{
+    for (auto i = 0; i < count; i++) {
+        auto index = Uint32(position >> 32);
+        auto fraction = float(Uint32(position) >> 8) * FRACTION_SCALE;
+        auto a = src[index];
+        auto b = src[index + 1];
+        dst[i] = a + (b - a) * fraction;
+        position += step;
+    }
+    return position;
+}
+
+static void mix_scalar(float* dst, const float* src, int count, float left, float right)
+{
+    for (auto i = 0; i < count; i++) {
+        dst[i * 2] += src[i] * left;
+        dst[i * 2 + 1] += src[i] * right;
+    }
+}
+
+static void accumulate_scalar(float* dst, const float* src, int count, float gain)
+{
+    for (auto i = 0; i < count; i++) {
+        dst[i] += src[i] * gain;
+    }
+}
+
+static void clamp_scalar(float* dst, int count, float gain)
+{
+    for (auto i = 0; i < count; i++) {
+        auto value = dst[i] * gain;
+        value = value > -1.0f ? value : -1.0f;
+        dst[i] = value < 1.0f ? value : 1.0f;
+    }
+}
+
+#ifdef SANDBOX_X86
+// ============================================================================
+// SSE2
+// ============================================================================
+// Four samples per iteration. The positions are kept as two pairs of 64-bit
+// lanes, from which the integer and the fraction halves are shuffled into
+// 32-bit lanes. SSE2 has no gather, so the source samples are loaded one by
+// one. The mono samples are duplicated into the interleaved left and right.
+// ============================================================================
+SANDBOX_TARGET("sse2")
+static Uint64 resample_sse2(float* dst, const float* src, int count, Uint64 position, Uint64 step)
+{
+    const auto scale = _mm_set1_ps(FRACTION_SCALE);
+    const auto increment = _mm_set1_epi64x(Sint64(step * 4));
+    auto p01 = _mm_set_epi64x(Sint64(position + step), Sint64(position));
+    auto p23 = _mm_set_epi64x(Sint64(position + step * 3), Sint64(position + step * 2));
+    auto i = 0;
+    for (; i + 4 <= count; i += 4) {
+        auto lo = _mm_castsi128_ps(p01);
+        auto hi = _mm_castsi128_ps(p23);
+        auto indices = _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+        auto fractions = _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+        auto fraction = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(fractions, 8)), scale);
+        Uint32 index[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(index), indices);
+        auto a = _mm_set_ps(src[index[3]], src[index[2]], src[index[1]], src[index[0]]);
+        auto b = _mm_set_ps(src[index[3] + 1], src[index[2] + 1], src[index[1] + 1], src[index[0] + 1]);
+        _mm_storeu_ps(dst + i, _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), fraction)));
+        p01 = _mm_add_epi64(p01, increment);
+        p23 = _mm_add_epi64(p23, increment);
+    }
+    return resample_scalar(dst + i, src, count - i, position + step * Uint64(i), step);
+}
+
+SANDBOX_TARGET("sse2")
+static void mix_sse2(float* dst, const float* src, int count, float left, float right)
+{
+    const auto gains = _mm_set_ps(right, left, right, left);
+    auto i = 0;
+    for (; i + 4 <= count; i += 4) {
+        auto s = _mm_loadu_ps(src + i);
+        auto out = dst + i * 2;
+        auto lo = _mm_mul_ps(_mm_unpacklo_ps(s, s), gains);
+        auto hi = _mm_mul_ps(_mm_unpackhi_ps(s, s), gains);
+        _mm_storeu_ps(out, _mm_add_ps(_mm_loadu_ps(out), lo));
+        _mm_storeu_ps(out + 4, _mm_add_ps(_mm_loadu_ps(out + 4), hi));
+    }
+    mix_scalar(dst + i * 2, src + i, count - i, left, right);
+}
+
+SANDBOX_TARGET("sse2")
+static void accumulate_sse2(float* dst, const float* src, int count, float gain)
+{
+    const auto scale = _mm_set1_ps(gain);
+    auto i = 0;
+    for (; i + 4 <= count; i += 4) {
+        auto value = _mm_mul_ps(_mm_loadu_ps(src + i), scale);
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), value));
+    }
+    accumulate_scalar(dst + i, src + i, count - i, gain);
+}
+
+SANDBOX_TARGET("sse2")
+static void clamp_sse2(float* dst, int count, float gain)
+{
+    const auto scale = _mm_set1_ps(gain);
+    const auto low = _mm_set1_ps(-1.0f);
+    const auto high = _mm_set1_ps(1.0f);
+    auto i = 0;
+    for (; i + 4 <= count; i += 4) {
+        auto value = _mm_mul_ps(_mm_loadu_ps(dst + i), scale);
+        _mm_storeu_ps(dst + i, _mm_min_ps(_mm_max_ps(value, low), high));
+    }
+    clamp_scalar(dst + i, count - i, gain);
+}
+
+// ============================================================================
+// AVX2
+// ============================================================================
+// Eight samples per iteration. The source samples are loaded with a gather
+// and the shuffled 32-bit halves are put back into order with a permute, as
+// the 256-bit shuffles only work within the 128-bit lanes.
+// ============================================================================
+SANDBOX_TARGET("avx2")
+static Uint64 resample_avx2(float* dst, const float* src, int count, Uint64 position, Uint64 step)
+{
+    const auto scale = _mm256_set1_ps(FRACTION_SCALE);
+    const auto increment = _mm256_set1_epi64x(Sint64(step * 8));
+    auto p0 = _mm256_set_epi64x(Sint64(position + step * 3), Sint64(position + step * 2),
+                                Sint64(position + step), Sint64(position));
+    auto p1 = _mm256_set_epi64x(Sint64(position + step * 7), Sint64(position + step * 6),
+                                Sint64(position + step * 5), Sint64(position + step * 4));
+    auto i = 0;
+    for (; i + 8 <= count; i += 8) {
+        auto lo = _mm256_castsi256_ps(p0);
+        auto hi = _mm256_castsi256_ps(p1);
+        auto indices = _mm256_castps_si256(_mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+        auto fractions = _mm256_castps_si256(_mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+        indices = _mm256_permute4x64_epi64(indices, _MM_SHUFFLE(3, 1, 2, 0));
+        fractions = _mm256_permute4x64_epi64(fractions, _MM_SHUFFLE(3, 1, 2, 0));
+        auto fraction = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(fractions, 8)), scale);
+        auto a = _mm256_i32gather_ps(src, indices, 4);
+        auto b = _mm256_i32gather_ps(src + 1, indices, 4);
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), fraction)));
+        p0 = _mm256_add_epi64(p0, increment);
+        p1 = _mm256_add_epi64(p1, increment);
+    }
+    return resample_scalar(dst + i, src, count - i, position + step * Uint64(i), step);
+}
+
+SANDBOX_TARGET("avx2")
+static void mix_avx2(float* dst, const float* src, int count, float left, float right)
+{
+    const auto gains = _mm256_set_ps(right, left, right, left, right, left, right, left);
+    auto i = 0;
+    for (; i + 8 <= count; i += 8) {
+        auto s = _mm256_loadu_ps(src + i);
+        auto out = dst + i * 2;
+        auto lo = _mm256_unpacklo_ps(s, s);
+        auto hi = _mm256_unpackhi_ps(s, s);
+        auto first = _mm256_mul_ps(_mm256_permute2f128_ps(lo, hi, 0x20), gains);
+        auto second = _mm256_mul_ps(_mm256_permute2f128_ps(lo, hi, 0x31), gains);
+        _mm256_storeu_ps(out, _mm256_add_ps(_mm256_loadu_ps(out), first));
+        _mm256_storeu_ps(out + 8, _mm256_add_ps(_mm256_loadu_ps(out + 8), second));
+    }
+    mix_scalar(dst + i * 2, src + i, count - i, left, right);
+}
+
+SANDBOX_TARGET("avx2")
+static void accumulate_avx2(float* dst, const float* src, int count, float gain)
+{
+    const auto scale = _mm256_set1_ps(gain);
+    auto i = 0;
+    for (; i + 8 <= count; i += 8) {
+        auto value = _mm256_mul_ps(_mm256_loadu_ps(src + i), scale);
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), value));
+    }
+    accumulate_scalar(dst + i, src + i, count - i, gain);
+}
+
+SANDBOX_TARGET("avx2")
+static void clamp_avx2(float* dst, int count, float gain)
+{
+    const auto scale = _mm256_set1_ps(gain);
+    const auto low = _mm256_set1_ps(-1.0f);
+    const auto high = _mm256_set1_ps(1.0f);
+    auto i = 0;
+    for (; i + 8 <= count; i += 8) {
+        auto value = _mm256_mul_ps(_mm256_loadu_ps(dst + i), scale);
+        _mm256_storeu_ps(dst + i, _mm256_min_ps(_mm256_max_ps(value, low), high));
+    }
+    clamp_scalar(dst + i, count - i, gain);
+}
+#endif
+
+// ============================================================================
+// DISPATCH
+// ============================================================================
+static const AudioKernels sKernels[AUDIO_ISA_COUNT] = {
+    { AUDIO_ISA_SCALAR, "scalar", resample_scalar, mix_scalar, accumulate_scalar, clamp_scalar },
+#ifdef SANDBOX_X86
+    { AUDIO_ISA_SSE2, "sse2", resample_sse2, mix_sse2, accumulate_sse2, clamp_sse2 },
+    { AUDIO_ISA_AVX2, "avx2", resample_avx2, mix_avx2, accumulate_avx2, clamp_avx2 },
+#endif
+};
+
+static bool is_supported(AudioIsa isa)
+{
+#ifdef SANDBOX_X86
+    const auto& cpu = cpu_features();
+    switch (isa) {
+        case AUDIO_ISA_SCALAR: return true;
+        case AUDIO_ISA_SSE2:   return cpu.sse2;
+        case AUDIO_ISA_AVX2:   return cpu.avx2;
+        default:               return false;
+    }
+#else
+    return isa == AUDIO_ISA_SCALAR;
+#endif
+}
+
+const AudioKernels* audio_kernels_for(AudioIsa isa)
+{
+    return is_supported(isa) ? &sKernels[isa] : NULL;
+}
+
+const AudioKernels& audio_kernels()
+{
+    static const AudioKernels* sSelected = []() {
+        auto isa = int(AUDIO_ISA_COUNT) - 1;
+        while (!is_supported(AudioIsa(isa))) {
+            isa--;
+        }
+        return &sKernels[isa];
+    }();
+    return *sSelected;
+}
+
+// ============================================================================
+// ENGINE
+// ============================================================================
+AudioConfig AudioEngine::default_config()
+{
+    AudioConfig config;
+    config.frequency = 48000;
+    config.samples = 256;
+    config.device = NULL;
+    return config;
+}
+
+AudioEngine::AudioEngine(const AudioConfig& config)
+    : mConfig(config),
+      mDevice(0),
+      mKernels(audio_kernels()),
+      mQueue(COMMAND_CAPACITY),
+      mNumSounds(0),
+      mNumVoices(0),
+      mMasterGain(1.0f),
+      mNumStreams(0),
+      mFrequency(SDL_GetPerformanceFrequency()),
+      mPreviousCallback(0)
+{
+    SDL_zero(mSpec);
+    SDL_AtomicSet(&mNextVoice, 0);
+    SDL_AtomicSet(&mActive, 0);
+    SDL_AtomicSet(&mCallbacks, 0);
+    SDL_AtomicSet(&mUnderruns, 0);
+    SDL_AtomicSet(&mCommands, 0);
+    SDL_AtomicSet(&mVoiceDrops, 0);
+}
+
+AudioEngine::~AudioEngine()
+{
+    if (mDevice != 0) {
+        SDL_CloseAudioDevice(mDevice);
+    }
+    for (auto i = 0; i < mNumSounds; i++) {
+        SDL_free(mSounds[i].samples);
+    }
+}
+
+bool AudioEngine::open()
+{
+    if (!Subsystems::instance().require(SDL_INIT_AUDIO)) {
+        return false;
+    }
+    SDL_AudioSpec desired;
+    SDL_zero(desired);
+    desired.freq = mConfig.frequency;
+    desired.format = AUDIO_F32SYS;
+    desired.channels = CHANNELS;
+    desired.samples = mConfig.samples;
+    desired.callback = callback;
+    desired.userdata = this;
+    mDevice = SDL_OpenAudioDevice(mConfig.device, 0, &desired, &mSpec,
+                                  SDL_AUDIO_ALLOW_FREQUENCY_CHANGE | SDL_AUDIO_ALLOW_SAMPLES_CHANGE);
+    if (mDevice == 0) {
+        SDL_Log("Unable to open the audio device: %s\n", SDL_GetError());
+        return false;
+    }
+    SDL_Log("Audio: %s at %d Hz with %u frames (%.2f ms) mixed with %s\n",
+            SDL_GetCurrentAudioDriver(),
+            mSpec.freq,
+            mSpec.samples,
+            buffer_ms(),
+            mKernels.name);
+    SDL_PauseAudioDevice(mDevice, 0);
+    return true;
+}
+
+double AudioEngine::buffer_ms() const
+{
+    return mSpec.freq > 0 ? mSpec.samples * 1000.0 / mSpec.freq : 0.0;
+}
+
+AudioEngine::SoundId AudioEngine::add_sound(const float* samples, int frames, int frequency)
+{
+    if (frames <= 0 || frequency <= 0) {
+        SDL_SetError("Invalid sound with %d frames at %d Hz", frames, frequency);
+        return -1;
+    }
+    if (mNumSounds >= MAX_SOUNDS) {
+        SDL_SetError("All %d sounds are in use", MAX_SOUNDS);
+        return -1;
+    }
+    auto data = static_cast<float*>(SDL_malloc(sizeof(float) * (size_t(frames) + 1)));
+    if (data == NULL) {
+        SDL_OutOfMemory();
+        return -1;
+    }
+    SDL_memcpy(data, samples, sizeof(float) * size_t(frames));
+    data[frames] = 0.0f;
+    auto& sound = mSounds[mNumSounds];
+    sound.samples = data;
+    sound.frames = frames;
+    sound.frequency = frequency;
+    return mNumSounds++;
+}
+
+AudioEngine::VoiceId AudioEngine::play(SoundId sound, float gain, float pan, float pitch, bool loop)
+{
+    if (sound < 0 || sound >= mNumSounds) {
+        return 0;
+    }
+    Command command;
+    command.type = COMMAND_PLAY;
+    command.voice = Uint32(SDL_AtomicAdd(&mNextVoice, 1)) + 1;
+    command.sound = &mSounds[sound];
+    command.track = NULL;
+    command.value = gain;
+    command.pan = pan;
+    command.pitch = pitch;
+    command.loop = loop;
+    return push(command) ? command.voice : 0;
+}
+
+bool AudioEngine::stop(VoiceId voice)
+{
+    return push_param(COMMAND_STOP, voice, 0.0f);
+}
+
+bool AudioEngine::stop_all()
+{
+    return push_param(COMMAND_STOP_ALL, 0, 0.0f);
+}
+
+bool AudioEngine::set_gain(VoiceId voice, float gain)
+{
+    return push_param(COMMAND_GAIN, voice, gain);
+}
+
+bool AudioEngine::set_pan(VoiceId voice, float pan)
+{
+    return push_param(COMMAND_PAN, voice, pan);
+}
+
+bool AudioEngine::set_pitch(VoiceId voice, float pitch)
+{
+    return push_param(COMMAND_PITCH, voice, pitch);
+}
+
+bool AudioEngine::set_master_gain(float gain)
+{
+    return push_param(COMMAND_MASTER_GAIN, 0, gain);
+}
+
+bool AudioEngine::play_stream(StreamingTrack* track, float gain)
+{
+    Command command;
+    SDL_zero(command);
+    command.type = COMMAND_PLAY_STREAM;
+    command.track = track;
+    command.value = gain;
+    return push(command);
+}
+
+bool AudioEngine::stop_stream(StreamingTrack* track)
+{
+    Command command;
+    SDL_zero(command);
+    command.type = COMMAND_STOP_STREAM;
+    command.track = track;
+    return push(command);
+}
+
+static Sint64 active_voice_count(void* data)
+{
+    return static_cast<AudioEngine*>(data)->active_voices();
+}
+
+static Sint64 callback_count(void* data)
+{
+    return static_cast<AudioEngine*>(data)->callbacks();
+}
+
+static Sint64 underrun_count(void* data)
+{
+    return static_cast<AudioEngine*>(data)->underruns();
+}
+
+static Sint64 command_count(void* data)
+{
+    return static_cast<AudioEngine*>(data)->commands();
+}
+
+static Sint64 dropped_count(void* data)
+{
+    return static_cast<AudioEngine*>(data)->dropped();
+}
+
+void AudioEngine::add_counters()
+{
+    auto& registry = CounterRegistry::instance();
+    registry.add_gauge("audio callbacks", callback_count, this);
+    registry.add_gauge("audio underruns", underrun_count, this);
+    registry.add_gauge("audio commands", command_count, this);
+    registry.add_gauge("audio dropped", dropped_count, this);
+    registry.add_gauge("audio voices", active_voice_count, this);
+}
+
+void AudioEngine::remove_counters()
+{
+    auto& registry = CounterRegistry::instance();
+    registry.remove("audio callbacks");
+    registry.remove("audio underruns");
+    registry.remove("audio commands");
+    registry.remove("audio dropped");
+    registry.remove("audio voices");
+}
+
+bool AudioEngine::push(const Command& command)
+{
+    if (!mQueue.push(command)) {
+        mDropped.increment();
+        return false;
+    }
+    return true;
+}
+
+bool AudioEngine::push_param(CommandType type, VoiceId voice, float value)
+{
+    Command command;
+    SDL_zero(command);
+    command.type = type;
+    command.voice = voice;
+    command.value = value;
+    return push(command);
+}
+
+// ============================================================================
+// AUDIO THREAD
+// ============================================================================
+// Everything below is only called from the audio callback. A voice that ends
+// or is stopped is replaced with the last voice, so the active voices are
+// always kept at the beginning of the array.
+// ============================================================================
+void SDLCALL AudioEngine::callback(void* data, Uint8* stream, int length)
+{
+    auto engine = static_cast<AudioEngine*>(data);
+    engine->mix(reinterpret_cast<float*>(stream), length / int(sizeof(float) * CHANNELS));
+}
+
+void AudioEngine::apply_commands()
+{
+    Command command;
+    while (mQueue.pop(&command)) {
+        SDL_AtomicAdd(&mCommands, 1);
+        auto voice = command.type == COMMAND_PLAY ? NULL : find_voice(command.voice);
+        switch (command.type) {
+            case COMMAND_PLAY:
+                if (mNumVoices >= MAX_VOICES) {
+                    SDL_AtomicAdd(&mVoiceDrops, 1);
+                    break;
+                }
+                voice = &mVoices[mNumVoices++];
+                voice->id = command.voice;
+                voice->sound = command.sound;
+                voice->position = 0;
+                voice->gain = command.value;
+                voice->pan = command.pan;
+                voice->pitch = command.pitch;
+                voice->loop = command.loop;
+                update_voice(voice);
+                break;
+            case COMMAND_STOP:
+                if (voice != NULL) {
+                    *voice = mVoices[--mNumVoices];
+                }
+                break;
+            case COMMAND_STOP_ALL:
+                mNumVoices = 0;
+                break;
+            case COMMAND_GAIN:
+            case COMMAND_PAN:
+            case COMMAND_PITCH:
+                if (voice != NULL) {
+                    if (command.type == COMMAND_GAIN) {
+                        voice->gain = command.value;
+                    } else if (command.type == COMMAND_PAN) {
+                        voice->pan = command.value;
+                    } else {
+                        voice->pitch = command.value;
+                    }
+                    update_voice(voice);
+                }
+                break;
+            case COMMAND_MASTER_GAIN:
+                mMasterGain = command.value;
+                break;
+            case COMMAND_PLAY_STREAM:
+                if (mNumStreams >= MAX_STREAMS) {
+                    SDL_AtomicAdd(&mVoiceDrops, 1);
+                    break;
+                }
+                mStreams[mNumStreams].track = command.track;
+                mStreams[mNumStreams].gain = command.value;
+                mNumStreams++;
+                break;
+            case COMMAND_STOP_STREAM:
+                for (auto i = 0; i < mNumStreams; i++) {
+                    if (mStreams[i].track == command.track) {
+                        mStreams[i] = mStreams[--mNumStreams];
+                        break;
+                    }
+                }
+                break;
+        }
+    }
+}
+
+AudioEngine::Voice* AudioEngine::find_voice(VoiceId id)
+{
+    for (auto i = 0; i < mNumVoices; i++) {
+        if (mVoices[i].id == id) {
+            return &mVoices[i];
+        }
+    }
+    return NULL;
+}
+
+void AudioEngine::update_voice(Voice* voice)
+{
+    const auto quarterPi = 0.78539816339744831;
+    auto pan = SDL_max(-1.0, SDL_min(double(voice->pan), 1.0));
+    auto angle = (pan + 1.0) * quarterPi;
+    voice->left = float(voice->gain * SDL_cos(angle));
+    voice->right = float(voice->gain * SDL_sin(angle));
+    auto ratio = double(voice->sound->frequency) * SDL_max(double(voice->pitch), 0.0) / mSpec.freq;
+    voice->step = SDL_max(Uint64(ratio * 4294967296.0), Uint64(1));
+}
+
+void AudioEngine::mix(float* stream, int frames)
+{
+    auto start = SDL_GetPerformanceCounter();
+    auto bufferTicks = mFrequency * Uint64(frames) / Uint64(SDL_max(mSpec.freq, 1));
+    if (mPreviousCallback != 0 && start - mPreviousCallback > bufferTicks * 3 / 2) {
+        SDL_AtomicAdd(&mUnderruns, 1);
+    }
+    mPreviousCallback = start;
+    SDL_AtomicAdd(&mCallbacks, 1);
+
+    apply_commands();
+    SDL_memset(stream, 0, sizeof(float) * CHANNELS * size_t(frames));
+    for (auto i = 0; i < mNumVoices;) {
+        if (mix_voice(&mVoices[i], stream, frames)) {
+            i++;
+        } else {
+            mVoices[i] = mVoices[--mNumVoices];
+        }
+    }
+    for (auto i = 0; i < mNumStreams;) {
+        if (mix_stream(&mStreams[i], stream, frames)) {
+            i++;
+        } else {
+            mStreams[i] = mStreams[--mNumStreams];
+        }
+    }
+    mKernels.clamp(stream, frames * CHANNELS, mMasterGain);
+    SDL_AtomicSet(&mActive, mNumVoices);
+
+    if (SDL_GetPerformanceCounter() - start > bufferTicks) {
+        SDL_AtomicAdd(&mUnderruns, 1);
+    }
+}
+
+bool AudioEngine::mix_voice(Voice* voice, float* stream, int frames)
+{
+    auto sound = voice->sound;
+    auto end = Uint64(sound->frames) << 32;
+    while (frames > 0) {
+        if (voice->position >= end) {
+            if (!voice->loop) {
+                return false;
+            }
+            voice->position %= end;
+        }
+        // the last interpolated position of the chunk must be before the end.
+        auto count = SDL_min(frames, MIX_CHUNK);
+        auto available = (end - voice->position + voice->step - 1) / voice->step;
+        if (Uint64(count) > available) {
+            count = int(available);
+        }
+        voice->position = mKernels.resample(mScratch, sound->samples, count, voice->position, voice->step);
+        mKernels.mix(stream, mScratch, count, voice->left, voice->right);
+        stream += count * CHANNELS;
+        frames -= count;
+    }
+    return true;
+}
+
+bool AudioEngine::mix_stream(StreamVoice* voice, float* stream, int frames)
+{
+    while (frames > 0) {
+        auto count = SDL_min(frames, MIX_CHUNK);
+        auto read = voice->track->read(mScratch, count);
+        mKernels.accumulate(stream, mScratch, read * CHANNELS, voice->gain);
+        if (read < count) {
+            return !voice->track->drained();
+        }
+        stream += count * CHANNELS;
+        frames -= count;
+    }
+    return true;
+}
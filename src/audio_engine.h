@@ -0,0 +1,210 @@
+// ============================================================================
+// AUDIO ENGINE
+// ============================================================================
+// A software mixer on top of the SDL audio callback. The device is opened with
+// SDL_OpenAudioDevice as 32-bit float stereo with a small buffer, so that the
+// latency from a play command to the speakers is about one or two buffers.
+//
+// The callback runs on the SDL audio thread, which must never wait for other
+// threads or the device underruns. Therefore the game threads do not touch
+// the voices directly, but push play, stop and parameter commands into an
+// MpscQueue, which the callback drains without locking at the start of each
+// buffer. Commands are applied at buffer boundaries. The statistics of the
+// callback are SDL_atomic_t values that only the callback writes, because the
+// slots of a ShardedCounter are also locked by the threads that read them.
+//
+// Each voice is mixed in chunks with three kernels.
+//
+// resample...Linear interpolation of a mono sound with the 32.32 fixed point
+//            step of the sound rate and the pitch to the device rate.
+// mix........Add the resampled mono span into the stereo buffer with the
+//            left and right gains of a constant power pan and the voice gain.
+// clamp......Apply the master gain and clamp the buffer into [-1, 1].
+//
+// Streaming tracks (audio_stream.h) are already converted into stereo at the
+// rate of the device and are added into the buffer with the accumulate kernel.
+//
+// The kernels have SSE2 and AVX2 variants which are selected once with the
+// SDL_HasSSE2 and SDL_HasAVX2 probes (cpu_features.h).
+//
+// An underrun is counted when the callback is called later than one and a
+// half buffers after the previous callback or when the mix itself takes
+// longer than the buffer lasts. Both are signs that the buffer is too small.
+// ============================================================================
+#pragma once
+
+#include <SDL.h>
+
+#include "counters.h"
+#include "lockfree_queue.h"
+
+class StreamingTrack;
+
+enum AudioIsa {
+    AUDIO_ISA_SCALAR,
+    AUDIO_ISA_SSE2,
+    AUDIO_ISA_AVX2,
+    AUDIO_ISA_COUNT
+};
+
+struct AudioKernels {
+    AudioIsa    isa;
+    const char* name;
+    // returns the position after the count samples. src[position + 1] must exist.
+    Uint64 (*resample)(float* dst, const float* src, int count, Uint64 position, Uint64 step);
+    void   (*mix)(float* dst, const float* src, int count, float left, float right);
+    void   (*accumulate)(float* dst, const float* src, int count, float gain);
+    void   (*clamp)(float* dst, int count, float gain);
+};
+
+// the kernels for the best instruction set supported by the CPU.
+const AudioKernels& audio_kernels();
+// the kernels of a specific instruction set or NULL if not supported.
+const AudioKernels* audio_kernels_for(AudioIsa isa);
+
+struct AudioConfig {
+    int         frequency; // the requested rate, the device may choose another.
+    Uint16      samples;   // the buffer size in sample frames (a power of two).
+    const char* device;    // the name of the device or NULL for the default.
+};
+
+class AudioEngine {
+public:
+    static const int    CHANNELS = 2;
+    static const int    MAX_VOICES = 64;
+    static const int    MAX_SOUNDS = 256;
+    static const int    MAX_STREAMS = 4;
+    static const int    MIX_CHUNK = 256;
+    static const Uint32 COMMAND_CAPACITY = 1024;
+
+    typedef int    SoundId;
+    typedef Uint32 VoiceId;
+
+    static AudioConfig default_config();
+
+    explicit AudioEngine(const AudioConfig& config = default_config());
+    // close the device and release the sounds.
+    ~AudioEngine();
+
+    // open and start the device. Returns false on failure (see SDL_GetError).
+    bool                 open();
+    bool                 is_open() const { return mDevice != 0; }
+    const SDL_AudioSpec& spec() const    { return mSpec; }
+    double               buffer_ms() const;
+
+    // copy a mono sound of the given rate. Returns -1 on failure. Sounds are
+    // only added from a single thread, before the id is given to other threads.
+    SoundId add_sound(const float* samples, int frames, int frequency);
+
+    // the commands can be pushed from any thread. play() returns 0 and the
+    // others return false when the command queue is full.
+    VoiceId play(SoundId sound, float gain = 1.0f, float pan = 0.0f, float pitch = 1.0f, bool loop = false);
+    bool    stop(VoiceId voice);
+    bool    stop_all();
+    bool    set_gain(VoiceId voice, float gain);
+    bool    set_pan(VoiceId voice, float pan);
+    bool    set_pitch(VoiceId voice, float pitch);
+    bool    set_master_gain(float gain);
+    // play a streaming track until it has been drained or stopped.
+    bool    play_stream(StreamingTrack* track, float gain = 1.0f);
+    bool    stop_stream(StreamingTrack* track);
+
+    int active_voices() const { return SDL_AtomicGet(&mActive); }
+    int callbacks() const     { return SDL_AtomicGet(&mCallbacks); }
+    int underruns() const     { return SDL_AtomicGet(&mUnderruns); }
+    int commands() const      { return SDL_AtomicGet(&mCommands); }
+    // the commands dropped by a full queue and the plays without a free slot.
+    Sint64 dropped() const    { return mDropped.value() + SDL_AtomicGet(&mVoiceDrops); }
+
+    void add_counters();
+    void remove_counters();
+
+private:
+    enum CommandType {
+        COMMAND_PLAY,
+        COMMAND_STOP,
+        COMMAND_STOP_ALL,
+        COMMAND_GAIN,
+        COMMAND_PAN,
+        COMMAND_PITCH,
+        COMMAND_MASTER_GAIN,
+        COMMAND_PLAY_STREAM,
+        COMMAND_STOP_STREAM
+    };
+
+    struct Sound {
+        float* samples; // frames + 1 samples, the last one is a silent guard.
+        int    frames;
+        int    frequency;
+    };
+
+    struct Command {
+        CommandType     type;
+        VoiceId         voice;
+        const Sound*    sound;
+        StreamingTrack* track;
+        float           value;
+        float           pan;
+        float           pitch;
+        bool            loop;
+    };
+
+    struct Voice {
+        VoiceId      id;
+        const Sound* sound;
+        Uint64       position;
+        Uint64       step;
+        float        gain;
+        float        pan;
+        float        pitch;
+        float        left;
+        float        right;
+        bool         loop;
+    };
+
+    struct StreamVoice {
+        StreamingTrack* track;
+        float           gain;
+    };
+
+    AudioEngine(const AudioEngine&);
+    AudioEngine& operator=(const AudioEngine&);
+
+    static void SDLCALL callback(void* data, Uint8* stream, int length);
+
+    bool   push(const Command& command);
+    bool   push_param(CommandType type, VoiceId voice, float value);
+    void   apply_commands();
+    Voice* find_voice(VoiceId id);
+    void   update_voice(Voice* voice);
+    void   mix(float* stream, int frames);
+    // returns false when the voice has reached the end of its sound.
+    bool   mix_voice(Voice* voice, float* stream, int frames);
+    bool   mix_stream(StreamVoice* voice, float* stream, int frames);
+
+    AudioConfig          mConfig;
+    SDL_AudioDeviceID    mDevice;
+    SDL_AudioSpec        mSpec;
+    const AudioKernels&  mKernels;
+    MpscQueue<Command>   mQueue;
+    Sound                mSounds[MAX_SOUNDS];
+    int                  mNumSounds;
+    SDL_atomic_t         mNextVoice;
+    // the following members are only used by the audio thread.
+    Voice                mVoices[MAX_VOICES];
+    int                  mNumVoices;
+    float                mMasterGain;
+    StreamVoice          mStreams[MAX_STREAMS];
+    int                  mNumStreams;
+    float                mScratch[MIX_CHUNK * CHANNELS];
+    Uint64               mFrequency;
+    Uint64               mPreviousCallback;
+    // written only by the audio thread.
+    mutable SDL_atomic_t mActive;
+    mutable SDL_atomic_t mCallbacks;
+    mutable SDL_atomic_t mUnderruns;
+    mutable SDL_atomic_t mCommands;
+    mutable SDL_atomic_t mVoiceDrops;
+    // written by the threads that push the commands.
+    ShardedCounter       mDropped;
+};
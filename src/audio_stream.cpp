@@ -0,0 +1,401 @@
+#include "audio_stream.h"
+#include "profiler.h"
+
+static Uint16 read_le16(const Uint8* data)
+{
+    return Uint16(data[0] | (data[1] << 8));
+}
+
+static Uint32 read_le32(const Uint8* data)
+{
+    return Uint32(data[0]) | (Uint32(data[1]) << 8) | (Uint32(data[2]) << 16) | (Uint32(data[3]) << 24);
+}
+
+// ============================================================================
+// IMA ADPCM
+// ============================================================================
+// Each block starts with a header of a 16-bit sample and a step index per
+// channel. The rest of the block holds 4-bit deltas, grouped by four bytes
+// (eight samples) per channel and the low nibble first. A truncated block at
+// the end of the file is decoded up to its last complete group.
+// ============================================================================
+static const int IMA_INDEX_TABLE[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static const int IMA_STEP_TABLE[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767
+};
+
+static int decode_ima_block(const Uint8* block, size_t length, int channels, Sint16* dst)
+{
+    auto header = size_t(4 * channels);
+    if (length < header) {
+        return 0;
+    }
+    int predictors[2];
+    int indices[2];
+    for (auto c = 0; c < channels; c++) {
+        predictors[c] = Sint16(read_le16(block + c * 4));
+        indices[c] = SDL_min(int(block[c * 4 + 2]), 88);
+        dst[c] = Sint16(predictors[c]);
+    }
+    auto groups = int((length - header) / header);
+    for (auto group = 0; group < groups; group++) {
+        for (auto c = 0; c < channels; c++) {
+            auto bytes = block + header + size_t(group * channels + c) * 4;
+            for (auto i = 0; i < 8; i++) {
+                auto nibble = (bytes[i / 2] >> ((i & 1) * 4)) & 0x0f;
+                auto step = IMA_STEP_TABLE[indices[c]];
+                auto diff = step >> 3;
+                if (nibble & 1) diff += step >> 2;
+                if (nibble & 2) diff += step >> 1;
+                if (nibble & 4) diff += step;
+                if (nibble & 8) diff = -diff;
+                predictors[c] = SDL_max(-32768, SDL_min(predictors[c] + diff, 32767));
+                indices[c] = SDL_max(0, SDL_min(indices[c] + IMA_INDEX_TABLE[nibble], 88));
+                dst[(1 + group * 8 + i) * channels + c] = Sint16(predictors[c]);
+            }
+        }
+    }
+    return 1 + groups * 8;
+}
+
+StreamingTrack::StreamingTrack(AsyncIo* io, ThreadPool* pool, const char* path, int rate, bool loop)
+    : mIo(io),
+      mPool(pool),
+      mPath(path),
+      mRate(rate),
+      mLoop(loop),
+      mEncoding(ENCODING_PCM),
+      mFormat(0),
+      mChannels(0),
+      mSourceRate(0),
+      mBlockAlign(0),
+      mBlockFrames(1),
+      mDataStart(0),
+      mDataEnd(0),
+      mOffset(0),
+      mChunkBytes(0),
+      mChunkLength(0),
+      mChunkOutput(0),
+      mEndOfData(false),
+      mStream(NULL),
+      mChunk(NULL),
+      mDecoded(NULL),
+      mRing(NULL)
+{
+    SDL_AtomicSet(&mState, STATE_CLOSED);
+    SDL_AtomicSet(&mBusy, 0);
+    SDL_AtomicSet(&mUnderruns, 0);
+    SDL_AtomicSet(&mWrite, 0);
+    SDL_AtomicSet(&mRead, 0);
+    SDL_AtomicSet(&mInputDone, 0);
+}
+
+StreamingTrack::~StreamingTrack()
+{
+    if (mStream != NULL) {
+        SDL_FreeAudioStream(mStream);
+    }
+    SDL_free(mChunk);
+    SDL_free(mDecoded);
+    SDL_free(mRing);
+}
+
+bool StreamingTrack::open()
+{
+    if (!SDL_AtomicCAS(&mState, STATE_CLOSED, STATE_LOADING)) {
+        return false;
+    }
+    SDL_AtomicSet(&mBusy, 1);
+    auto queued = mIo->read(mPath.c_str(), 0, HEADER_BYTES, [this](const AsyncRead& read) {
+        // a file shorter than the header is still fine.
+        if (read.length == 0) {
+            fail("unable to read the header");
+        } else if (!parse_header(read.data, read.length) || !allocate()) {
+            fail(SDL_GetError());
+        } else {
+            request();
+        }
+    });
+    if (!queued) {
+        fail("unable to queue a read");
+    }
+    return queued;
+}
+
+void StreamingTrack::update()
+{
+    if (SDL_AtomicGet(&mState) == STATE_STREAMING && SDL_AtomicCAS(&mBusy, 0, 1)) {
+        request();
+    }
+}
+
+bool StreamingTrack::failed() const
+{
+    return SDL_AtomicGet(&mState) == STATE_FAILED;
+}
+
+bool StreamingTrack::drained() const
+{
+    return SDL_AtomicGet(&mInputDone) != 0
+        && SDL_AtomicGet(&mWrite) == SDL_AtomicGet(&mRead);
+}
+
+size_t StreamingTrack::memory_bytes() const
+{
+    auto decoded = mEncoding == ENCODING_IMA_ADPCM
+        ? mChunkBytes / size_t(mBlockAlign) * size_t(mBlockFrames * mChannels) * sizeof(Sint16)
+        : 0;
+    return mChunkBytes + decoded + RING_FRAMES * 2 * sizeof(float);
+}
+
+// ============================================================================
+// AUDIO THREAD
+// ============================================================================
+// The ring positions are counted in frames and wrap around as 32-bit values.
+// The producer publishes the frames with a release barrier before it moves
+// the write position and the consumer releases the frames the same way.
+// ============================================================================
+int StreamingTrack::read(float* dst, int frames)
+{
+    auto read = Uint32(SDL_AtomicGet(&mRead));
+    auto write = Uint32(SDL_AtomicGet(&mWrite));
+    auto count = SDL_min(frames, int(write - read));
+    if (count > 0) {
+        SDL_MemoryBarrierAcquire();
+        auto index = int(read & (RING_FRAMES - 1));
+        auto first = SDL_min(count, RING_FRAMES - index);
+        SDL_memcpy(dst, mRing + index * 2, sizeof(float) * 2 * size_t(first));
+        SDL_memcpy(dst + first * 2, mRing, sizeof(float) * 2 * size_t(count - first));
+        SDL_MemoryBarrierRelease();
+        SDL_AtomicSet(&mRead, int(read + Uint32(count)));
+    }
+    if (count < frames
+        && SDL_AtomicGet(&mState) == STATE_STREAMING
+        && SDL_AtomicGet(&mInputDone) == 0) {
+        SDL_AtomicAdd(&mUnderruns, 1);
+    }
+    return count;
+}
+
+// ============================================================================
+// PIPELINE
+// ============================================================================
+// The functions below are only called by the thread that holds mBusy, which
+// passes from the main thread (read completions) to a pool worker (decoding)
+// and back, so the chunk buffers and the SDL_AudioStream are never shared.
+// ============================================================================
+bool StreamingTrack::parse_header(const Uint8* data, size_t length)
+{
+    if (length < 12 || SDL_memcmp(data, "RIFF", 4) != 0 || SDL_memcmp(data + 8, "WAVE", 4) != 0) {
+        SDL_SetError("not a RIFF WAVE file");
+        return false;
+    }
+    auto hasFormat = false;
+    size_t at = 12;
+    while (at + 8 <= length) {
+        auto id = data + at;
+        auto size = read_le32(data + at + 4);
+        auto body = data + at + 8;
+        if (SDL_memcmp(id, "fmt ", 4) == 0) {
+            if (size < 16 || at + 8 + 16 > length) {
+                SDL_SetError("truncated format chunk");
+                return false;
+            }
+            auto tag = read_le16(body);
+            auto bits = read_le16(body + 14);
+            mChannels = read_le16(body + 2);
+            mSourceRate = int(read_le32(body + 4));
+            mBlockAlign = read_le16(body + 12);
+            if (tag == 0xfffe && size >= 40 && at + 8 + 26 <= length) {
+                tag = read_le16(body + 24);
+            }
+            mEncoding = ENCODING_PCM;
+            if (tag == 1 && bits == 8) {
+                mFormat = AUDIO_U8;
+            } else if (tag == 1 && bits == 16) {
+                mFormat = AUDIO_S16LSB;
+            } else if (tag == 1 && bits == 32) {
+                mFormat = AUDIO_S32LSB;
+            } else if (tag == 3 && bits == 32) {
+                mFormat = AUDIO_F32LSB;
+            } else if (tag == 0x11 && bits == 4) {
+                mEncoding = ENCODING_IMA_ADPCM;
+                mFormat = AUDIO_S16SYS;
+            } else {
+                SDL_SetError("unsupported format %u with %u bits", tag, bits);
+                return false;
+            }
+            if (mChannels < 1 || mChannels > 2 || mSourceRate <= 0 || mBlockAlign <= 0
+                || (mEncoding == ENCODING_IMA_ADPCM && mBlockAlign <= 4 * mChannels)) {
+                SDL_SetError("invalid format of %d channels at %d Hz", mChannels, mSourceRate);
+                return false;
+            }
+            mBlockFrames = mEncoding == ENCODING_IMA_ADPCM
+                ? (mBlockAlign - 4 * mChannels) * 2 / mChannels + 1
+                : 1;
+            hasFormat = true;
+        } else if (SDL_memcmp(id, "data", 4) == 0) {
+            if (!hasFormat) {
+                SDL_SetError("data before the format chunk");
+                return false;
+            }
+            mDataStart = Sint64(at + 8);
+            mDataEnd = mDataStart + Sint64(size);
+            mOffset = mDataStart;
+            return true;
+        }
+        at += 8 + size + (size & 1);
+    }
+    SDL_SetError("no data within the first %d bytes", HEADER_BYTES);
+    return false;
+}
+
+bool StreamingTrack::allocate()
+{
+    // a chunk must fit into half of the ring after the conversion.
+    auto chunkFrames = int(SDL_min(Sint64(CHUNK_FRAMES), Sint64(RING_FRAMES / 2) * mSourceRate / mRate));
+    auto blocks = SDL_max(chunkFrames / mBlockFrames, 1);
+    auto sourceFrames = blocks * mBlockFrames;
+    mChunkBytes = size_t(blocks) * size_t(mBlockAlign);
+    mChunkOutput = int(Sint64(sourceFrames) * mRate / mSourceRate) + 64;
+    if (mChunkOutput > RING_FRAMES) {
+        SDL_SetError("blocks of %d frames do not fit into the ring", mBlockFrames);
+        return false;
+    }
+    mChunk = static_cast<Uint8*>(SDL_malloc(mChunkBytes));
+    mRing = static_cast<float*>(SDL_malloc(RING_FRAMES * 2 * sizeof(float)));
+    if (mEncoding == ENCODING_IMA_ADPCM) {
+        mDecoded = static_cast<Sint16*>(SDL_malloc(size_t(sourceFrames * mChannels) * sizeof(Sint16)));
+    }
+    if (mChunk == NULL || mRing == NULL || (mEncoding == ENCODING_IMA_ADPCM && mDecoded == NULL)) {
+        SDL_OutOfMemory();
+        return false;
+    }
+    mStream = SDL_NewAudioStream(mFormat, Uint8(mChannels), mSourceRate, AUDIO_F32SYS, 2, mRate);
+    if (mStream == NULL) {
+        return false;
+    }
+    SDL_Log("Streaming %s: %d Hz %d channels%s with %u KB of buffers\n",
+            mPath.c_str(),
+            mSourceRate,
+            mChannels,
+            mEncoding == ENCODING_IMA_ADPCM ? " IMA ADPCM" : "",
+            unsigned(memory_bytes() / 1024));
+    return true;
+}
+
+void StreamingTrack::fail(const char* reason)
+{
+    SDL_Log("Unable to stream %s: %s\n", mPath.c_str(), reason);
+    SDL_AtomicSet(&mState, STATE_FAILED);
+    SDL_AtomicSet(&mInputDone, 1);
+    SDL_AtomicSet(&mBusy, 0);
+}
+
+int StreamingTrack::ring_free() const
+{
+    auto used = Uint32(SDL_AtomicGet(&mWrite)) - Uint32(SDL_AtomicGet(&mRead));
+    return RING_FRAMES - int(used);
+}
+
+bool StreamingTrack::drain_stream()
+{
+    const auto frameBytes = int(sizeof(float) * 2);
+    for (;;) {
+        auto available = SDL_AudioStreamAvailable(mStream) / frameBytes;
+        if (available == 0) {
+            if (mEndOfData) {
+                SDL_AtomicSet(&mInputDone, 1);
+            }
+            return true;
+        }
+        auto free = ring_free();
+        if (free == 0) {
+            return false;
+        }
+        auto write = Uint32(SDL_AtomicGet(&mWrite));
+        auto index = int(write & (RING_FRAMES - 1));
+        auto frames = SDL_min(SDL_min(available, free), RING_FRAMES - index);
+        auto bytes = SDL_AudioStreamGet(mStream, mRing + index * 2, frames * frameBytes);
+        if (bytes <= 0) {
+            return bytes == 0;
+        }
+        SDL_MemoryBarrierRelease();
+        SDL_AtomicSet(&mWrite, int(write + Uint32(bytes / frameBytes)));
+    }
+}
+
+void StreamingTrack::request()
+{
+    if (!drain_stream() || mEndOfData || ring_free() < mChunkOutput) {
+        SDL_AtomicSet(&mBusy, 0);
+        return;
+    }
+    auto length = size_t(SDL_min(Sint64(mChunkBytes), mDataEnd - mOffset));
+    auto offset = mOffset;
+    auto queued = mIo->read(mPath.c_str(), offset, length, [this, offset](const AsyncRead& read) {
+        // a short read means that the file ends before the size of the data.
+        if (!read.ok) {
+            mDataEnd = offset + Sint64(read.length);
+        }
+        mChunkLength = read.length;
+        if (mEncoding == ENCODING_PCM) {
+            mChunkLength -= mChunkLength % size_t(mBlockAlign);
+        }
+        if (mChunkLength > 0) {
+            SDL_memcpy(mChunk, read.data, mChunkLength);
+        } else if (offset == mDataStart) {
+            fail("no sample data");
+            return;
+        }
+        mPool->submit([this]() {
+            decode();
+        });
+    });
+    if (!queued) {
+        fail("unable to queue a read");
+    }
+}
+
+void StreamingTrack::decode()
+{
+    PROFILE_SCOPE("audio decode");
+    mChunks.increment();
+    const void* data = mChunk;
+    auto bytes = mChunkLength;
+    if (mEncoding == ENCODING_IMA_ADPCM) {
+        auto frames = 0;
+        for (size_t at = 0; at < mChunkLength; at += size_t(mBlockAlign)) {
+            auto length = SDL_min(size_t(mBlockAlign), mChunkLength - at);
+            frames += decode_ima_block(mChunk + at, length, mChannels, mDecoded + frames * mChannels);
+        }
+        data = mDecoded;
+        bytes = size_t(frames * mChannels) * sizeof(Sint16);
+    }
+    if (bytes > 0 && SDL_AudioStreamPut(mStream, data, int(bytes)) != 0) {
+        fail(SDL_GetError());
+        return;
+    }
+
+    mOffset += Sint64(mChunkLength);
+    if (mChunkLength == 0 || mOffset >= mDataEnd) {
+        if (mLoop) {
+            mOffset = mDataStart;
+        } else {
+            mEndOfData = true;
+            SDL_AudioStreamFlush(mStream);
+        }
+    }
+    SDL_AtomicCAS(&mState, STATE_LOADING, STATE_STREAMING);
+    request();
+}
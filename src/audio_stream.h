@@ -0,0 +1,125 @@
+// ============================================================================
+// AUDIO STREAM
+// ============================================================================
+// A streaming track for long music and ambience files, which are decoded a
+// chunk at a time instead of being loaded into memory as a whole. The memory
+// of a track is bounded by its buffers, no matter how long the file is.
+//
+// 1. Read......The chunks of the file are read with AsyncIo. The header is
+//              read first to find the format and the sample data.
+// 2. Decode....The chunk is decoded on a ThreadPool worker and converted with
+//              an SDL_AudioStream into float stereo at the rate of the device.
+// 3. Ring......The converted frames are written into a single producer and
+//              single consumer ring buffer, which the audio callback drains
+//              without locking. The next chunk is read only when the ring has
+//              room for all of it, so the SDL_AudioStream never piles up data.
+//
+// Only a single chunk is read or decoded at a time. The step that finishes a
+// chunk requests the next one and update() restarts the reading after the
+// ring has been full, so it should be called on each frame.
+//
+// Supported files are RIFF WAVE with 8, 16 or 32-bit PCM, 32-bit float or IMA
+// ADPCM (a 4:1 compressed format) samples in one or two channels.
+//
+// A missing frame while the track is streaming is counted as an underrun. The
+// counters are included in the report of the profiler and the decoding time
+// is profiled as the "audio decode" section.
+//
+// The track is played by attaching it to an AudioEngine. It must be deleted
+// only after the AudioEngine, the ThreadPool and the AsyncIo have been deleted.
+// ============================================================================
+#pragma once
+
+#include <SDL.h>
+
+#include "async_io.h"
+#include "counters.h"
+#include "thread_pool.h"
+
+#include <string>
+
+class StreamingTrack {
+public:
+    // the source frames in a single chunk of the file.
+    static const int CHUNK_FRAMES = 4096;
+    // the stereo frames in the ring buffer (a power of two).
+    static const int RING_FRAMES = 16384;
+    // the amount of bytes that is read to find the format and the data.
+    static const int HEADER_BYTES = 4096;
+
+    StreamingTrack(AsyncIo* io, ThreadPool* pool, const char* path, int rate, bool loop);
+    ~StreamingTrack();
+
+    // [main] start reading the header. Returns false if the read failed to queue.
+    bool open();
+    // [any] continue reading when the ring has room for the next chunk.
+    void update();
+
+    bool   failed() const;
+    // true when all of the data has been decoded and played.
+    bool   drained() const;
+    size_t memory_bytes() const;
+
+    // [audio] read the stereo frames into the dst. Returns the frames read.
+    int read(float* dst, int frames);
+
+    // written only by the audio thread, so it is an atomic (see audio_engine.h).
+    int                   underruns() const { return SDL_AtomicGet(&mUnderruns); }
+    const ShardedCounter& chunks() const    { return mChunks; }
+
+private:
+    enum State {
+        STATE_CLOSED,
+        STATE_LOADING,
+        STATE_STREAMING,
+        STATE_FAILED
+    };
+
+    enum Encoding {
+        ENCODING_PCM,
+        ENCODING_IMA_ADPCM
+    };
+
+    StreamingTrack(const StreamingTrack&);
+    StreamingTrack& operator=(const StreamingTrack&);
+
+    bool parse_header(const Uint8* data, size_t length);
+    bool allocate();
+    void fail(const char* reason);
+    void request();
+    void decode();
+    // move the converted frames into the ring. Returns false when it is full.
+    bool drain_stream();
+    int  ring_free() const;
+
+    AsyncIo*             mIo;
+    ThreadPool*          mPool;
+    std::string          mPath;
+    int                  mRate;
+    bool                 mLoop;
+    mutable SDL_atomic_t mState;
+    // set while a chunk is being read or decoded or the stream is drained.
+    SDL_atomic_t         mBusy;
+    Encoding             mEncoding;
+    SDL_AudioFormat      mFormat;
+    int                  mChannels;
+    int                  mSourceRate;
+    int                  mBlockAlign;
+    int                  mBlockFrames;
+    Sint64               mDataStart;
+    Sint64               mDataEnd;
+    Sint64               mOffset;
+    size_t               mChunkBytes;
+    size_t               mChunkLength;
+    int                  mChunkOutput;
+    bool                 mEndOfData;
+    SDL_AudioStream*     mStream;
+    Uint8*               mChunk;
+    Sint16*              mDecoded;
+    float*               mRing;
+    mutable SDL_atomic_t mWrite;
+    mutable SDL_atomic_t mRead;
+    mutable SDL_atomic_t mInputDone;
+    mutable SDL_atomic_t mUnderruns;
+    ShardedCounter       mChunks;
+};
@@ -0,0 +1,138 @@
+#include "bench_workloads.h"
+
+double seconds_since(Uint64 start)
+{
+    return double(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+}
+
+// ============================================================================
+// COUNTERS
+// ============================================================================
+CounterWorkload::CounterWorkload(int iterations)
+    : mIterations(iterations),
+      mUseSharded(false)
+{
+    SDL_AtomicSet(&mReady, 0);
+    SDL_AtomicSet(&mGo, 0);
+    reset();
+}
+
+int CounterWorkload::thread_function(void* data)
+{
+    auto workload = static_cast<CounterWorkload*>(data);
+    SDL_AtomicAdd(&workload->mReady, 1);
+    while (SDL_AtomicGet(&workload->mGo) == 0) {
+    }
+    if (workload->mUseSharded) {
+        for (auto i = 0; i < workload->mIterations; i++) {
+            workload->mSharded.increment();
+        }
+    } else {
+        for (auto i = 0; i < workload->mIterations; i++) {
+            SDL_AtomicAdd(&workload->mAtomic, 1);
+        }
+    }
+    return 0;
+}
+
+double CounterWorkload::run(int numThreads, bool sharded)
+{
+    mUseSharded = sharded;
+    SDL_AtomicSet(&mReady, 0);
+    SDL_AtomicSet(&mGo, 0);
+    std::vector<SDL_Thread*> threads;
+    for (auto i = 0; i < numThreads; i++) {
+        auto thread = SDL_CreateThread(thread_function, "bench-counter", this);
+        if (thread != NULL) {
+            threads.push_back(thread);
+        }
+    }
+    while (SDL_AtomicGet(&mReady) < int(threads.size())) {
+        SDL_Delay(1);
+    }
+    auto start = SDL_GetPerformanceCounter();
+    SDL_AtomicSet(&mGo, 1);
+    for (auto thread : threads) {
+        SDL_WaitThread(thread, NULL);
+    }
+    return seconds_since(start);
+}
+
+Sint64 CounterWorkload::total(bool sharded) const
+{
+    return sharded ? mSharded.value() : Sint64(SDL_AtomicGet(&mAtomic));
+}
+
+void CounterWorkload::reset()
+{
+    SDL_AtomicSet(&mAtomic, 0);
+    mSharded.reset();
+}
+
+// ============================================================================
+// RECTS
+// ============================================================================
+// The rects are generated with a fixed seed, so each run tests the same rects.
+// ============================================================================
+RectWorkload::RectWorkload(int numRects, int numQueries)
+    : mRects(numRects),
+      mPoints(numRects),
+      mQueries(numQueries),
+      mHits(numRects)
+{
+    Uint32 seed = 0x12345678;
+    auto random = [&seed](int range) {
+        seed = seed * 1664525 + 1013904223;
+        return int((seed >> 8) % Uint32(range));
+    };
+    mBatch.reserve(numRects);
+    for (auto i = 0; i < numRects; i++) {
+        SDL_Rect rect = { random(4096), random(4096), random(128) + 1, random(128) + 1 };
+        if (i % 16 == 0) {
+            rect.w = 0;
+        }
+        mRects[i] = rect;
+        mBatch.add(rect);
+        mPoints[i].x = random(4096);
+        mPoints[i].y = random(4096);
+    }
+    // include empty and negative queries, which must not hit any rect.
+    for (auto i = 0; i < numQueries; i++) {
+        auto& query = mQueries[i];
+        query.x = random(4096);
+        query.y = random(4096);
+        query.w = random(256) + 1;
+        query.h = random(256) + 1;
+        if (i % 16 == 0) {
+            query.w = 0;
+        } else if (i % 16 == 8) {
+            query.h = -query.h;
+        }
+    }
+}
+
+double RectWorkload::loop_intersect(int* hits) const
+{
+    auto count = 0;
+    auto start = SDL_GetPerformanceCounter();
+    for (const auto& query : mQueries) {
+        for (const auto& rect : mRects) {
+            count += SDL_HasIntersection(&query, &rect) ? 1 : 0;
+        }
+    }
+    auto seconds = seconds_since(start);
+    *hits = count;
+    return seconds;
+}
+
+double RectWorkload::batch_intersect(int* hits)
+{
+    auto count = 0;
+    auto start = SDL_GetPerformanceCounter();
+    for (const auto& query : mQueries) {
+        count += mBatch.intersect(query, mHits.empty() ? NULL : &mHits[0]);
+    }
+    auto seconds = seconds_since(start);
+    *hits = count;
+    return seconds;
+}
@@ -0,0 +1,75 @@
+// ============================================================================
+// BENCH WORKLOADS
+// ============================================================================
+// The workloads that are measured both by the --bench=NAME benchmarks of the
+// sandbox (benchmarks.h) and by the headless benchmark suite (bench_main.cpp),
+// so that both of them measure exactly the same thing. The workloads return
+// the elapsed seconds, which leaves their setup out of the measurement.
+//
+// CounterWorkload...Each thread increments the same SDL_atomic_t or the same
+//                   ShardedCounter for a fixed amount of iterations. Threads
+//                   are released at the same time once all have started.
+// RectWorkload......Random rects (every 16th being empty), points and query
+//                   rects (every 8th being empty) on a 4096x4096 area. The
+//                   query rects are tested for intersections against all the
+//                   rects with SDL_HasIntersection and with a RectBatch.
+// ============================================================================
+#pragma once
+
+#include <SDL.h>
+#include "counters.h"
+#include "rect_batch.h"
+
+#include <vector>
+
+double seconds_since(Uint64 start);
+
+class CounterWorkload {
+public:
+    explicit CounterWorkload(int iterations);
+
+    // run the increments on the given amount of threads.
+    double run(int numThreads, bool sharded);
+    // the total of the counter since the last reset.
+    Sint64 total(bool sharded) const;
+    void   reset();
+
+    int iterations() const { return mIterations; }
+
+private:
+    CounterWorkload(const CounterWorkload&);
+    CounterWorkload& operator=(const CounterWorkload&);
+
+    static int thread_function(void* data);
+
+    mutable SDL_atomic_t mAtomic;
+    ShardedCounter       mSharded;
+    SDL_atomic_t         mReady;
+    SDL_atomic_t         mGo;
+    int                  mIterations;
+    bool                 mUseSharded;
+};
+
+class RectWorkload {
+public:
+    RectWorkload(int numRects, int numQueries);
+
+    // test each query rect against all rects. The hits are summed into hits.
+    double loop_intersect(int* hits) const;
+    double batch_intersect(int* hits);
+
+    const std::vector<SDL_Rect>&  rects() const   { return mRects; }
+    const std::vector<SDL_Point>& points() const  { return mPoints; }
+    const std::vector<SDL_Rect>&  queries() const { return mQueries; }
+    const RectBatch&              batch() const   { return mBatch; }
+
+private:
+    RectWorkload(const RectWorkload&);
+    RectWorkload& operator=(const RectWorkload&);
+
+    std::vector<SDL_Rect>  mRects;
+    std::vector<SDL_Point> mPoints;
+    std::vector<SDL_Rect>  mQueries;
+    std::vector<int>       mHits;
+    RectBatch              mBatch;
+};
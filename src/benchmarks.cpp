@@ -0,0 +1,333 @@
+#include "benchmarks.h"
+#include "bench_workloads.h"
+#include "pixel_convert.h"
+#include "pixel_kernels.h"
+#include "rect_batch.h"
+#include "spatial_index.h"
+
+#include <SDL.h>
+
+#include <vector>
+
+// ============================================================================
+// COUNTERS
+// ============================================================================
+// The counter workload (bench_workloads.h) on 1..N threads.
+// ============================================================================
+static void bench_counters()
+{
+    CounterWorkload workload(1000000);
+    auto maxThreads = SDL_max(2, SDL_GetCPUCount());
+    SDL_Log("Counter benchmark (%d increments per thread):\n", workload.iterations());
+    SDL_Log("\tthreads  atomic Mops/s  sharded Mops/s  speedup\n");
+    for (auto threads = 1; threads <= maxThreads; threads++) {
+        workload.reset();
+        auto atomicSeconds = workload.run(threads, false);
+        auto shardedSeconds = workload.run(threads, true);
+
+        auto total = double(workload.iterations()) * threads;
+        if (workload.total(false) != Sint64(total) || workload.total(true) != Sint64(total)) {
+            SDL_Log("\tCounter totals do not match the increments!\n");
+        }
+        SDL_Log("\t%7d  %13.1f  %14.1f  %6.2fx\n",
+                threads,
+                total / atomicSeconds / 1e6,
+                total / shardedSeconds / 1e6,
+                atomicSeconds / shardedSeconds);
+    }
+}
+
+// ============================================================================
+// PIXELS
+// ============================================================================
+// Each kernel processes a buffer that fits into the L2 cache for a fixed
+// amount of rounds. The results of the vector kernels are verified against
+// the results of the scalar kernels. The conversions of convert_pixels are
+// compared against SDL_ConvertPixels the same way.
+// ============================================================================
+static const int PIXEL_COUNT = 64 * 1024 + 3;
+static const int PIXEL_ROUNDS = 200;
+
+static const Uint32 CONVERT_PAIRS[][2] = {
+    { SDL_PIXELFORMAT_ARGB8888, SDL_PIXELFORMAT_ABGR8888 },
+    { SDL_PIXELFORMAT_BGRA8888, SDL_PIXELFORMAT_ARGB8888 },
+    { SDL_PIXELFORMAT_ARGB8888, SDL_PIXELFORMAT_RGB565 },
+    { SDL_PIXELFORMAT_RGB565, SDL_PIXELFORMAT_ARGB8888 },
+    { SDL_PIXELFORMAT_ARGB8888, SDL_PIXELFORMAT_RGB24 },
+    { SDL_PIXELFORMAT_RGB24, SDL_PIXELFORMAT_RGBA8888 }
+};
+
+static void fill_pattern(Uint32* pixels, int count)
+{
+    Uint32 seed = 0x12345678;
+    for (auto i = 0; i < count; i++) {
+        seed = seed * 1664525 + 1013904223;
+        pixels[i] = seed;
+    }
+}
+
+struct PixelResults {
+    double seconds[4];
+    Uint32 hash[4];
+};
+
+static Uint32 hash_pixels(const Uint32* pixels, int count)
+{
+    Uint32 hash = 2166136261u;
+    for (auto i = 0; i < count; i++) {
+        hash = (hash ^ pixels[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static PixelResults run_pixel_kernels(const PixelKernels& kernels, Uint32* dst, const Uint32* src)
+{
+    PixelResults results;
+    auto frequency = double(SDL_GetPerformanceFrequency());
+    for (auto kernel = 0; kernel < 4; kernel++) {
+        fill_pattern(dst, PIXEL_COUNT);
+        auto start = SDL_GetPerformanceCounter();
+        for (auto round = 0; round < PIXEL_ROUNDS; round++) {
+            switch (kernel) {
+                case 0: kernels.fill(dst, PIXEL_COUNT, 0x80402010); break;
+                case 1: kernels.copy(dst, src, PIXEL_COUNT); break;
+                case 2: kernels.blend(dst, src, PIXEL_COUNT); break;
+                case 3: kernels.swizzle(dst, src, PIXEL_COUNT); break;
+            }
+        }
+        results.seconds[kernel] = (SDL_GetPerformanceCounter() - start) / frequency;
+        results.hash[kernel] = hash_pixels(dst, PIXEL_COUNT);
+    }
+    return results;
+}
+
+static void bench_pixels()
+{
+    std::vector<Uint32> src(PIXEL_COUNT);
+    std::vector<Uint32> dst(PIXEL_COUNT);
+    fill_pattern(&src[0], PIXEL_COUNT);
+
+    SDL_Log("Pixel kernel benchmark (%d pixels, %d rounds, Mpx/s):\n", PIXEL_COUNT, PIXEL_ROUNDS);
+    SDL_Log("\tisa         fill      copy     blend   swizzle\n");
+    auto megapixels = double(PIXEL_COUNT) * PIXEL_ROUNDS / 1e6;
+    PixelResults reference;
+    for (auto isa = 0; isa < PIXEL_ISA_COUNT; isa++) {
+        auto kernels = pixel_kernels_for(PixelIsa(isa));
+        if (kernels == NULL) {
+            continue;
+        }
+        auto results = run_pixel_kernels(*kernels, &dst[0], &src[0]);
+        if (isa == PIXEL_ISA_SCALAR) {
+            reference = results;
+        }
+        SDL_Log("\t%-6s  %8.0f  %8.0f  %8.0f  %8.0f\n",
+                kernels->name,
+                megapixels / results.seconds[0],
+                megapixels / results.seconds[1],
+                megapixels / results.seconds[2],
+                megapixels / results.seconds[3]);
+        if (SDL_memcmp(results.hash, reference.hash, sizeof(reference.hash)) != 0) {
+            SDL_Log("\tResults of %s kernels do not match the scalar kernels!\n", kernels->name);
+        }
+    }
+    SDL_Log("\tSelected: %s\n", pixel_kernels().name);
+
+    // a single row of pixels, so the pitch does not matter.
+    std::vector<Uint32> sdlDst(PIXEL_COUNT);
+    SDL_Log("\tconversion                   convert  SDL_ConvertPixels\n");
+    for (const auto& pair : CONVERT_PAIRS) {
+        auto from = pair[0];
+        auto to = pair[1];
+        auto srcPitch = PIXEL_COUNT * SDL_BYTESPERPIXEL(from);
+        auto dstPitch = PIXEL_COUNT * SDL_BYTESPERPIXEL(to);
+        auto start = SDL_GetPerformanceCounter();
+        for (auto round = 0; round < PIXEL_ROUNDS; round++) {
+            convert_pixels(PIXEL_COUNT, 1, from, &src[0], srcPitch, to, &dst[0], dstPitch);
+        }
+        auto convertSeconds = seconds_since(start);
+        start = SDL_GetPerformanceCounter();
+        for (auto round = 0; round < PIXEL_ROUNDS; round++) {
+            SDL_ConvertPixels(PIXEL_COUNT, 1, from, &src[0], srcPitch, to, &sdlDst[0], dstPitch);
+        }
+        auto sdlSeconds = seconds_since(start);
+        char name[64];
+        SDL_snprintf(name, sizeof(name), "%s -> %s",
+                     SDL_GetPixelFormatName(from) + 16,
+                     SDL_GetPixelFormatName(to) + 16);
+        SDL_Log("\t%-24s  %9.0f  %17.0f%s\n",
+                name,
+                megapixels / convertSeconds,
+                megapixels / sdlSeconds,
+                SDL_memcmp(&dst[0], &sdlDst[0], dstPitch) == 0 ? "" : "  MISMATCH");
+    }
+}
+
+// ============================================================================
+// RECTS
+// ============================================================================
+// The rects, the points and the queries of the rect workload (see
+// bench_workloads.h). Each test is run with both the SDL functions in a loop
+// and with the batch API, and the results of both are compared to each other.
+// ============================================================================
+static const int RECT_COUNT = 20000;
+static const int RECT_QUERIES = 200;
+
+static void log_rect_result(const char* test, double loopSeconds, double batchSeconds, bool match)
+{
+    SDL_Log("\t%-12s  %9.2f  %9.2f  %6.2fx%s\n",
+            test,
+            loopSeconds * 1000.0,
+            batchSeconds * 1000.0,
+            loopSeconds / batchSeconds,
+            match ? "" : "  MISMATCH");
+}
+
+static void bench_rects()
+{
+    RectWorkload workload(RECT_COUNT, RECT_QUERIES);
+    const auto& rects = workload.rects();
+    const auto& points = workload.points();
+    const auto& batch = workload.batch();
+    std::vector<int> hits(RECT_COUNT);
+
+    SDL_Log("Rect benchmark (%d rects, %d queries, %s kernels):\n", RECT_COUNT, RECT_QUERIES, rect_kernels_name());
+    SDL_Log("\ttest          loop (ms)  batch (ms)  speedup\n");
+
+    // intersection tests of each query rect against all rects.
+    auto loopHits = 0;
+    auto batchHits = 0;
+    auto loopSeconds = workload.loop_intersect(&loopHits);
+    auto batchSeconds = workload.batch_intersect(&batchHits);
+    log_rect_result("intersect", loopSeconds, batchSeconds, loopHits == batchHits);
+
+    // point-in-rect tests of each query point against all rects.
+    loopHits = 0;
+    auto start = SDL_GetPerformanceCounter();
+    for (auto i = 0; i < RECT_QUERIES; i++) {
+        for (const auto& rect : rects) {
+            loopHits += SDL_PointInRect(&points[i], &rect) ? 1 : 0;
+        }
+    }
+    loopSeconds = seconds_since(start);
+    batchHits = 0;
+    start = SDL_GetPerformanceCounter();
+    for (auto i = 0; i < RECT_QUERIES; i++) {
+        batchHits += batch.contains_point(points[i], &hits[0]);
+    }
+    log_rect_result("point in", loopSeconds, seconds_since(start), loopHits == batchHits);
+
+    // union of all rects.
+    SDL_Rect loopUnion = { 0, 0, 0, 0 };
+    start = SDL_GetPerformanceCounter();
+    for (auto round = 0; round < RECT_QUERIES; round++) {
+        loopUnion = rects[0];
+        for (const auto& rect : rects) {
+            SDL_UnionRect(&loopUnion, &rect, &loopUnion);
+        }
+    }
+    loopSeconds = seconds_since(start);
+    SDL_Rect batchUnion = { 0, 0, 0, 0 };
+    start = SDL_GetPerformanceCounter();
+    for (auto round = 0; round < RECT_QUERIES; round++) {
+        batch.bounds(&batchUnion);
+    }
+    log_rect_result("union", loopSeconds, seconds_since(start), SDL_RectEquals(&loopUnion, &batchUnion) == SDL_TRUE);
+
+    // bounding box of all points within a clip rect.
+    SDL_Rect clip = { 512, 512, 2048, 2048 };
+    SDL_Rect loopEnclosed = { 0, 0, 0, 0 };
+    start = SDL_GetPerformanceCounter();
+    for (auto round = 0; round < RECT_QUERIES; round++) {
+        SDL_EnclosePoints(&points[0], RECT_COUNT, &clip, &loopEnclosed);
+    }
+    loopSeconds = seconds_since(start);
+    SDL_Rect batchEnclosed = { 0, 0, 0, 0 };
+    start = SDL_GetPerformanceCounter();
+    for (auto round = 0; round < RECT_QUERIES; round++) {
+        enclose_points(&points[0], RECT_COUNT, &clip, &batchEnclosed);
+    }
+    log_rect_result("enclose", loopSeconds, seconds_since(start), SDL_RectEquals(&loopEnclosed, &batchEnclosed) == SDL_TRUE);
+}
+
+// ============================================================================
+// SPATIAL
+// ============================================================================
+// A broadphase over random small rects. The brute force version tests every
+// pair with SDL_HasIntersection. The grid is also measured when every rect
+// is moved once (an incremental update per rect) before the pair query.
+// ============================================================================
+static const int SPATIAL_COUNT = 10000;
+
+static void bench_spatial()
+{
+    Uint32 seed = 0x12345678;
+    auto random = [&seed](int range) {
+        seed = seed * 1664525 + 1013904223;
+        return int((seed >> 8) % Uint32(range));
+    };
+    std::vector<SDL_Rect> rects(SPATIAL_COUNT);
+    for (auto& rect : rects) {
+        rect.x = random(4096);
+        rect.y = random(4096);
+        rect.w = random(64) + 1;
+        rect.h = random(64) + 1;
+    }
+
+    SDL_Log("Spatial benchmark (%d rects, overlap pairs):\n", SPATIAL_COUNT);
+    SDL_Log("\tmethod    pairs      time (ms)\n");
+
+    size_t brutePairs = 0;
+    auto start = SDL_GetPerformanceCounter();
+    for (auto i = 0; i < SPATIAL_COUNT; i++) {
+        for (auto j = i + 1; j < SPATIAL_COUNT; j++) {
+            brutePairs += SDL_HasIntersection(&rects[i], &rects[j]) ? 1 : 0;
+        }
+    }
+    SDL_Log("\tbrute     %-9d  %9.2f\n", int(brutePairs), seconds_since(start) * 1000.0);
+
+    std::vector<OverlapPair> pairs;
+    SpatialGrid grid(64);
+    start = SDL_GetPerformanceCounter();
+    for (const auto& rect : rects) {
+        grid.insert(rect);
+    }
+    grid.overlap_pairs(&pairs);
+    SDL_Log("\tgrid      %-9d  %9.2f%s\n", int(pairs.size()), seconds_since(start) * 1000.0,
+            pairs.size() == brutePairs ? "" : "  MISMATCH");
+
+    pairs.clear();
+    start = SDL_GetPerformanceCounter();
+    for (auto id = 0; id < SPATIAL_COUNT; id++) {
+        auto rect = rects[id];
+        rect.x += random(16) - 8;
+        rect.y += random(16) - 8;
+        grid.update(id, rect);
+    }
+    grid.overlap_pairs(&pairs);
+    SDL_Log("\tgrid+move %-9d  %9.2f\n", int(pairs.size()), seconds_since(start) * 1000.0);
+
+    pairs.clear();
+    RectBvh bvh;
+    start = SDL_GetPerformanceCounter();
+    bvh.build(&rects[0], SPATIAL_COUNT);
+    bvh.overlap_pairs(&pairs);
+    SDL_Log("\tbvh       %-9d  %9.2f%s\n", int(pairs.size()), seconds_since(start) * 1000.0,
+            pairs.size() == brutePairs ? "" : "  MISMATCH");
+}
+
+bool run_benchmark(const char* name)
+{
+    if (SDL_strcmp(name, "counters") == 0) {
+        bench_counters();
+    } else if (SDL_strcmp(name, "pixels") == 0) {
+        bench_pixels();
+    } else if (SDL_strcmp(name, "rects") == 0) {
+        bench_rects();
+    } else if (SDL_strcmp(name, "spatial") == 0) {
+        bench_spatial();
+    } else {
+        SDL_Log("Unknown benchmark: %s\n", name);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,16 @@
+// ============================================================================
+// BENCHMARKS
+// ============================================================================
+// Micro-benchmarks that can be run with the --bench=NAME command line option
+// instead of the interactive sandbox. Results are written with SDL_Log.
+//
+// counters...A single SDL_atomic_t versus a ShardedCounter on 1..N threads.
+// pixels.....The pixel kernels of each supported instruction set and the
+//            specialized pixel conversions versus SDL_ConvertPixels.
+// rects......Batched rect geometry versus looping over the SDL rect functions.
+// spatial....Overlap pairs with SDL_HasIntersection versus a grid and a BVH.
+// ============================================================================
+#pragma once
+
+// run the named benchmark. Returns false if there is no such benchmark.
+bool run_benchmark(const char* name);
@@ -0,0 +1,42 @@
+#include "cache_line.h"
+
+size_t cache_line_size()
+{
+    static const size_t sLineSize = []() {
+        // SDL reports a guess (or zero) on platforms where it can't detect it.
+        size_t size = SDL_GetCPUCacheLineSize();
+        size_t line = sizeof(void*) * 2;
+        while (line < size) {
+            line <<= 1;
+        }
+        return SDL_max(line, size_t(64));
+    }();
+    return sLineSize;
+}
+
+size_t cache_line_round(size_t size)
+{
+    auto line = cache_line_size();
+    return (size + line - 1) & ~(line - 1);
+}
+
+void* cache_aligned_alloc(size_t size)
+{
+    // the original pointer is stored just before the aligned block.
+    auto line = cache_line_size();
+    auto raw = static_cast<Uint8*>(SDL_malloc(size + line + sizeof(void*)));
+    if (raw == NULL) {
+        return NULL;
+    }
+    auto address = reinterpret_cast<uintptr_t>(raw + sizeof(void*));
+    auto aligned = reinterpret_cast<Uint8*>((address + line - 1) & ~uintptr_t(line - 1));
+    reinterpret_cast<void**>(aligned)[-1] = raw;
+    return aligned;
+}
+
+void cache_aligned_free(void* ptr)
+{
+    if (ptr != NULL) {
+        SDL_free(reinterpret_cast<void**>(ptr)[-1]);
+    }
+}
@@ -0,0 +1,20 @@
+// ============================================================================
+// CACHE LINE
+// ============================================================================
+// Helpers to keep data that is written by different threads on separate CPU
+// cache lines. The line size is queried from SDL_GetCPUCacheLineSize() at
+// runtime, so the padding matches the CPU the application is running on.
+//
+// cache_line_size()........The L1 cache line size (a power of two).
+// cache_line_round()........Round a size up to the next multiple of a line.
+// cache_aligned_alloc()....Allocate memory that starts at a line boundary.
+// cache_aligned_free().....Release memory from cache_aligned_alloc().
+// ============================================================================
+#pragma once
+
+#include <SDL.h>
+
+size_t cache_line_size();
+size_t cache_line_round(size_t size);
+void*  cache_aligned_alloc(size_t size);
+void   cache_aligned_free(void* ptr);
@@ -0,0 +1,224 @@
+#include "controllers.h"
+#include "cpu_features.h"
+#include "subsystems.h"
+
+#ifdef SANDBOX_X86
+#include <immintrin.h>
+#endif
+
+// ============================================================================
+// EDGE DETECTION
+// ============================================================================
+// Compute the pressed and released bits of all controllers from the previous
+// and current button bitsets. The count is always a multiple of eight.
+// ============================================================================
+static void detect_edges_scalar(const Uint32* previous, const Uint32* current,
+                                Uint32* pressed, Uint32* released, int count)
+{
+    for (auto i = 0; i < count; i++) {
+        auto changed = previous[i] ^ current[i];
+        pressed[i] = changed & current[i];
+        released[i] = changed & previous[i];
+    }
+}
+
+#ifdef SANDBOX_X86
+SANDBOX_TARGET("sse2")
+static void detect_edges_sse2(const Uint32* previous, const Uint32* current,
+                              Uint32* pressed, Uint32* released, int count)
+{
+    for (auto i = 0; i < count; i += 4) {
+        auto before = _mm_loadu_si128(reinterpret_cast<const __m128i*>(previous + i));
+        auto now = _mm_loadu_si128(reinterpret_cast<const __m128i*>(current + i));
+        auto changed = _mm_xor_si128(before, now);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pressed + i), _mm_and_si128(changed, now));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(released + i), _mm_and_si128(changed, before));
+    }
+}
+
+SANDBOX_TARGET("avx2")
+static void detect_edges_avx2(const Uint32* previous, const Uint32* current,
+                              Uint32* pressed, Uint32* released, int count)
+{
+    for (auto i = 0; i < count; i += 8) {
+        auto before = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(previous + i));
+        auto now = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(current + i));
+        auto changed = _mm256_xor_si256(before, now);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pressed + i), _mm256_and_si256(changed, now));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(released + i), _mm256_and_si256(changed, before));
+    }
+}
+#endif
+
+typedef void (*DetectEdges)(const Uint32*, const Uint32*, Uint32*, Uint32*, int);
+
+static DetectEdges select_detect_edges()
+{
+#ifdef SANDBOX_X86
+    const auto& cpu = cpu_features();
+    if (cpu.avx2) {
+        return detect_edges_avx2;
+    }
+    if (cpu.sse2) {
+        return detect_edges_sse2;
+    }
+#endif
+    return detect_edges_scalar;
+}
+
+// ============================================================================
+// CONTROLLER SET
+// ============================================================================
+static const Uint32 POLLED_EVENTS[] = {
+    SDL_JOYAXISMOTION,
+    SDL_JOYBALLMOTION,
+    SDL_JOYHATMOTION,
+    SDL_JOYBUTTONDOWN,
+    SDL_JOYBUTTONUP,
+    SDL_CONTROLLERAXISMOTION,
+    SDL_CONTROLLERBUTTONDOWN,
+    SDL_CONTROLLERBUTTONUP
+};
+
+ControllerSet::ControllerSet()
+    : mInitialized(false),
+      mCount(0)
+{
+    for (auto i = 0; i < MAX_CONTROLLERS; i++) {
+        mControllers[i] = NULL;
+        mPrevious[i] = 0;
+        clear(i);
+    }
+    if (!Subsystems::instance().require(SDL_INIT_GAMECONTROLLER)) {
+        return;
+    }
+    mInitialized = true;
+    for (auto type : POLLED_EVENTS) {
+        SDL_EventState(type, SDL_IGNORE);
+    }
+    for (auto i = 0; i < SDL_NumJoysticks(); i++) {
+        if (SDL_IsGameController(i)) {
+            open(i);
+        }
+    }
+}
+
+ControllerSet::~ControllerSet()
+{
+    while (mCount > 0) {
+        close(mCount - 1);
+    }
+    if (mInitialized) {
+        for (auto type : POLLED_EVENTS) {
+            SDL_EventState(type, SDL_ENABLE);
+        }
+    }
+}
+
+bool ControllerSet::handle_event(const SDL_Event& event)
+{
+    if (event.type == SDL_CONTROLLERDEVICEADDED) {
+        open(event.cdevice.which);
+        return true;
+    }
+    if (event.type == SDL_CONTROLLERDEVICEREMOVED) {
+        auto index = find(event.cdevice.which);
+        if (index >= 0) {
+            close(index);
+        }
+        return true;
+    }
+    return false;
+}
+
+int ControllerSet::find(SDL_JoystickID id) const
+{
+    for (auto i = 0; i < mCount; i++) {
+        if (mIds[i] == id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void ControllerSet::update()
+{
+    static const auto sDetectEdges = select_detect_edges();
+    if (!mInitialized) {
+        return;
+    }
+    SDL_GameControllerUpdate();
+    for (auto axis = 0; axis < SDL_CONTROLLER_AXIS_MAX; axis++) {
+        auto values = mAxes[axis];
+        for (auto i = 0; i < mCount; i++) {
+            values[i] = SDL_GameControllerGetAxis(mControllers[i], SDL_GameControllerAxis(axis));
+        }
+    }
+    for (auto i = 0; i < mCount; i++) {
+        mPrevious[i] = mButtons[i];
+        Uint32 bits = 0;
+        for (auto button = 0; button < SDL_CONTROLLER_BUTTON_MAX; button++) {
+            if (SDL_GameControllerGetButton(mControllers[i], SDL_GameControllerButton(button))) {
+                bits |= 1u << button;
+            }
+        }
+        mButtons[i] = bits;
+    }
+    sDetectEdges(mPrevious, mButtons, mPressed, mReleased, MAX_CONTROLLERS);
+}
+
+bool ControllerSet::open(int deviceIndex)
+{
+    auto controller = SDL_GameControllerOpen(deviceIndex);
+    if (controller == NULL) {
+        SDL_Log("Unable to open controller %d: %s\n", deviceIndex, SDL_GetError());
+        return false;
+    }
+    // the controllers found at the initialization also get the added event,
+    // and opening an open controller only adds a reference to it.
+    auto id = SDL_JoystickInstanceID(SDL_GameControllerGetJoystick(controller));
+    if (find(id) >= 0) {
+        SDL_GameControllerClose(controller);
+        return true;
+    }
+    if (mCount >= MAX_CONTROLLERS) {
+        SDL_GameControllerClose(controller);
+        SDL_Log("Unable to open a controller: all %d slots are in use.\n", MAX_CONTROLLERS);
+        return false;
+    }
+    auto index = mCount++;
+    mControllers[index] = controller;
+    mIds[index] = id;
+    clear(index);
+    mPrevious[index] = 0;
+    SDL_Log("Opened controller %d: %s\n", mIds[index], SDL_GameControllerName(controller));
+    return true;
+}
+
+void ControllerSet::close(int index)
+{
+    SDL_GameControllerClose(mControllers[index]);
+    auto last = --mCount;
+    mControllers[index] = mControllers[last];
+    mIds[index] = mIds[last];
+    for (auto axis = 0; axis < SDL_CONTROLLER_AXIS_MAX; axis++) {
+        mAxes[axis][index] = mAxes[axis][last];
+    }
+    mButtons[index] = mButtons[last];
+    mPrevious[index] = mPrevious[last];
+    mPressed[index] = mPressed[last];
+    mReleased[index] = mReleased[last];
+    mControllers[last] = NULL;
+    mPrevious[last] = 0;
+    clear(last);
+}
+
+void ControllerSet::clear(int index)
+{
+    for (auto axis = 0; axis < SDL_CONTROLLER_AXIS_MAX; axis++) {
+        mAxes[axis][index] = 0;
+    }
+    mButtons[index] = 0;
+    mPressed[index] = 0;
+    mReleased[index] = 0;
+}
@@ -0,0 +1,74 @@
+// ============================================================================
+// CONTROLLERS
+// ============================================================================
+// Polls all open game controllers once per tick instead of handling an event
+// for every axis and button change. With many controllers the axis motion
+// events alone flood the event queue, so the per-axis, per-button, hat and
+// ball events of both the joystick and the game controller API are turned
+// off with SDL_EventState. Only the device added and removed events remain.
+//
+// update() calls SDL_GameControllerUpdate once and reads the state of every
+// controller into contiguous structure-of-arrays buffers.
+//
+// axes(axis)....The values of a single axis for all controllers.
+// buttons().....A bitset of the pressed buttons for each controller.
+// pressed().....The buttons that went down during the latest update.
+// released()....The buttons that went up during the latest update.
+//
+// The edges are detected as (previous ^ current) & current (or & previous)
+// of all the bitsets at once, with SSE2 or AVX2 when supported.
+//
+// Controllers are kept densely at the beginning of the arrays. A removed
+// controller is replaced with the last one, so an index is not stable over
+// hotplugging, but the instance id is.
+// ============================================================================
+#pragma once
+
+#include <SDL.h>
+
+class ControllerSet {
+public:
+    // a multiple of eight, so that the vector edge detection has no tail.
+    static const int MAX_CONTROLLERS = 16;
+
+    // initialize the game controller subsystem (subsystems.h) and open the controllers.
+    ControllerSet();
+    ~ControllerSet();
+
+    // open or close the controllers on the device added and removed events.
+    bool handle_event(const SDL_Event& event);
+    void update();
+
+    int            count() const                { return mCount; }
+    SDL_JoystickID instance_id(int index) const { return mIds[index]; }
+    SDL_Joystick*  joystick(int index) const    { return SDL_GameControllerGetJoystick(mControllers[index]); }
+    int            find(SDL_JoystickID id) const;
+
+    const Sint16* axes(SDL_GameControllerAxis axis) const { return mAxes[axis]; }
+    const Uint32* buttons() const                         { return mButtons; }
+    const Uint32* pressed() const                         { return mPressed; }
+    const Uint32* released() const                        { return mReleased; }
+
+    Sint16 axis(int index, SDL_GameControllerAxis axis) const { return mAxes[axis][index]; }
+    bool   is_down(int index, SDL_GameControllerButton button) const {
+        return (mButtons[index] >> button) & 1;
+    }
+
+private:
+    ControllerSet(const ControllerSet&);
+    ControllerSet& operator=(const ControllerSet&);
+
+    bool open(int deviceIndex);
+    void close(int index);
+    void clear(int index);
+
+    bool                mInitialized;
+    int                 mCount;
+    SDL_GameController* mControllers[MAX_CONTROLLERS];
+    SDL_JoystickID      mIds[MAX_CONTROLLERS];
+    Sint16              mAxes[SDL_CONTROLLER_AXIS_MAX][MAX_CONTROLLERS];
+    Uint32              mButtons[MAX_CONTROLLERS];
+    Uint32              mPrevious[MAX_CONTROLLERS];
+    Uint32              mPressed[MAX_CONTROLLERS];
+    Uint32              mReleased[MAX_CONTROLLERS];
+};
@@ -0,0 +1,138 @@
+#include "counters.h"
+#include "cache_line.h"
+
+#include <new>
+
+// the slot index of the calling thread, assigned on the first increment.
+static SDL_atomic_t sNextSlot;
+static thread_local int tSlot = -1;
+
+static int thread_slot()
+{
+    if (tSlot < 0) {
+        tSlot = SDL_AtomicAdd(&sNextSlot, 1) & 0x7fffffff;
+    }
+    return tSlot;
+}
+
+ShardedCounter::ShardedCounter()
+    : mSlots(NULL),
+      mStride(cache_line_round(sizeof(Slot))),
+      mNumSlots(4)
+{
+    while (mNumSlots < SDL_GetCPUCount() * 2 && mNumSlots < 64) {
+        mNumSlots <<= 1;
+    }
+    mSlots = static_cast<Uint8*>(cache_aligned_alloc(mStride * mNumSlots));
+    SDL_assert_release(mSlots != NULL);
+    for (auto i = 0; i < mNumSlots; i++) {
+        new (slot(i)) Slot();
+    }
+    reset();
+}
+
+ShardedCounter::~ShardedCounter()
+{
+    cache_aligned_free(mSlots);
+}
+
+void ShardedCounter::add(Sint64 amount)
+{
+    auto own = slot(thread_slot() & (mNumSlots - 1));
+    SDL_AtomicLock(&own->lock);
+    own->value += amount;
+    SDL_AtomicUnlock(&own->lock);
+}
+
+Sint64 ShardedCounter::value() const
+{
+    Sint64 total = 0;
+    for (auto i = 0; i < mNumSlots; i++) {
+        auto s = slot(i);
+        SDL_AtomicLock(&s->lock);
+        total += s->value;
+        SDL_AtomicUnlock(&s->lock);
+    }
+    return total;
+}
+
+void ShardedCounter::reset()
+{
+    for (auto i = 0; i < mNumSlots; i++) {
+        auto s = slot(i);
+        SDL_AtomicLock(&s->lock);
+        s->value = 0;
+        SDL_AtomicUnlock(&s->lock);
+    }
+}
+
+CounterRegistry& CounterRegistry::instance()
+{
+    static CounterRegistry sRegistry;
+    return sRegistry;
+}
+
+CounterRegistry::CounterRegistry() : mNumEntries(0), mLock(0)
+{
+    SDL_zeroa(mEntries);
+}
+
+bool CounterRegistry::add_counter(const char* name, const ShardedCounter* counter)
+{
+    Entry entry;
+    entry.name = name;
+    entry.counter = counter;
+    entry.gauge = NULL;
+    entry.data = NULL;
+    return add(entry);
+}
+
+bool CounterRegistry::add_gauge(const char* name, Gauge gauge, void* data)
+{
+    Entry entry;
+    entry.name = name;
+    entry.counter = NULL;
+    entry.gauge = gauge;
+    entry.data = data;
+    return add(entry);
+}
+
+void CounterRegistry::remove(const char* name)
+{
+    SDL_AtomicLock(&mLock);
+    for (auto i = 0; i < mNumEntries; i++) {
+        if (SDL_strcmp(mEntries[i].name, name) == 0) {
+            mEntries[i] = mEntries[--mNumEntries];
+            break;
+        }
+    }
+    SDL_AtomicUnlock(&mLock);
+}
+
+void CounterRegistry::log_report() const
+{
+    SDL_AtomicLock(&mLock);
+    SDL_Log("Counters:\n");
+    for (auto i = 0; i < mNumEntries; i++) {
+        const auto& entry = mEntries[i];
+        auto value = entry.counter != NULL
+            ? entry.counter->value()
+            : entry.gauge(entry.data);
+        SDL_Log("\t%-24s %" SDL_PRIs64 "\n", entry.name, value);
+    }
+    SDL_AtomicUnlock(&mLock);
+}
+
+bool CounterRegistry::add(const Entry& entry)
+{
+    SDL_AtomicLock(&mLock);
+    auto result = mNumEntries < MAX_ENTRIES;
+    if (result) {
+        mEntries[mNumEntries++] = entry;
+    }
+    SDL_AtomicUnlock(&mLock);
+    if (!result) {
+        SDL_Log("Counter registry is full, ignoring: %s\n", entry.name);
+    }
+    return result;
+}
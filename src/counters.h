@@ -0,0 +1,84 @@
+// ============================================================================
+// COUNTERS
+// ============================================================================
+// Statistics counters that scale to many concurrently incrementing threads.
+//
+// A single SDL_atomic_t that is incremented by every thread makes its cache
+// line to ping-pong between the CPU cores. A ShardedCounter instead has one
+// slot per thread, where each slot is padded to the SDL_GetCPUCacheLineSize
+// so that the threads do not share cache lines. Slots are summed lazily only
+// when the value is read, which makes reads slower than increments.
+//
+// Threads get their slots in the order they first touch any counter. When
+// there are more threads than slots, threads share slots which is still
+// correct but no longer contention free.
+//
+// The CounterRegistry holds named counters and gauges so that the profiler
+// is able to include them in its report.
+// ============================================================================
+#pragma once
+
+#include <SDL.h>
+
+class ShardedCounter {
+public:
+    ShardedCounter();
+    ~ShardedCounter();
+
+    void   add(Sint64 amount);
+    void   increment() { add(1); }
+    Sint64 value() const;
+    void   reset();
+
+private:
+    struct Slot {
+        SDL_SpinLock lock;
+        Sint64       value;
+    };
+
+    ShardedCounter(const ShardedCounter&);
+    ShardedCounter& operator=(const ShardedCounter&);
+
+    Slot* slot(int index) const {
+        return reinterpret_cast<Slot*>(mSlots + mStride * size_t(index));
+    }
+
+    Uint8* mSlots;
+    size_t mStride;
+    int    mNumSlots;
+};
+
+class CounterRegistry {
+public:
+    static const int MAX_ENTRIES = 64;
+
+    // a gauge is a function that is called to get the value when it's read.
+    typedef Sint64 (*Gauge)(void* data);
+
+    static CounterRegistry& instance();
+
+    // register a counter or a gauge. The name must remain valid until removed.
+    bool add_counter(const char* name, const ShardedCounter* counter);
+    bool add_gauge(const char* name, Gauge gauge, void* data);
+    void remove(const char* name);
+
+    void log_report() const;
+
+private:
+    struct Entry {
+        const char*           name;
+        const ShardedCounter* counter;
+        Gauge                 gauge;
+        void*                 data;
+    };
+
+    CounterRegistry();
+    CounterRegistry(const CounterRegistry&);
+    CounterRegistry& operator=(const CounterRegistry&);
+
+    bool add(const Entry& entry);
+
+    int                  mNumEntries;
+    mutable SDL_SpinLock mLock;
+    Entry                mEntries[MAX_ENTRIES];
+};
@@ -0,0 +1,44 @@
+// ============================================================================
+// CPU FEATURES
+// ============================================================================
+// The CPU feature probes (SDL_HasSSE2, SDL_HasSSE41, SDL_HasAVX, SDL_HasAVX2)
+// are resolved once and cached so that the dispatching subsystems are able to
+// select their vector kernel variants without calling SDL on each query.
+//
+// SANDBOX_X86..............Defined when compiling for a x86 or x64 target.
+// SANDBOX_TARGET(isa)......Compile a single function for the given isa (like
+//                          "sse4.1" or "avx2") without changing the target
+//                          of the whole translation unit. Such functions can
+//                          only be called after checking the CPU features.
+// ============================================================================
+#pragma once
+
+#include <SDL.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SANDBOX_X86 1
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SANDBOX_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SANDBOX_TARGET(isa)
+#endif
+
+struct CpuFeatures {
+    bool sse2;
+    bool sse41;
+    bool avx;
+    bool avx2;
+};
+
+inline const CpuFeatures& cpu_features()
+{
+    static const CpuFeatures sFeatures = {
+        SDL_HasSSE2() == SDL_TRUE,
+        SDL_HasSSE41() == SDL_TRUE,
+        SDL_HasAVX() == SDL_TRUE,
+        SDL_HasAVX2() == SDL_TRUE
+    };
+    return sFeatures;
+}
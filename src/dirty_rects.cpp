@@ -0,0 +1,173 @@
+#include "dirty_rects.h"
+
+static Sint64 area_of(const SDL_Rect& rect)
+{
+    return Sint64(rect.w) * rect.h;
+}
+
+// ============================================================================
+// DIRTY REGION
+// ============================================================================
+DirtyRegion::DirtyRegion() : mNumRects(0)
+{
+    SDL_zero(mBounds);
+    SDL_zeroa(mRects);
+}
+
+void DirtyRegion::set_bounds(int width, int height)
+{
+    mBounds.x = 0;
+    mBounds.y = 0;
+    mBounds.w = width;
+    mBounds.h = height;
+    clear();
+}
+
+void DirtyRegion::add(const SDL_Rect& rect)
+{
+    SDL_Rect clipped;
+    if (SDL_RectEmpty(&mBounds)) {
+        clipped = rect;
+    } else if (!SDL_IntersectRect(&rect, &mBounds, &clipped)) {
+        return;
+    }
+    if (SDL_RectEmpty(&clipped)) {
+        return;
+    }
+
+    // skip rects which are already covered by a damaged rect.
+    for (auto i = 0; i < mNumRects; i++) {
+        SDL_Rect common;
+        if (SDL_IntersectRect(&mRects[i], &clipped, &common) && SDL_RectEquals(&common, &clipped)) {
+            return;
+        }
+    }
+    mRects[mNumRects++] = clipped;
+    merge(mNumRects - 1);
+    if (mNumRects > MAX_RECTS) {
+        merge_cheapest_pair();
+    }
+}
+
+// merge the rect with all rects it overlaps, repeating with the grown rect.
+void DirtyRegion::merge(int index)
+{
+    auto merged = true;
+    while (merged) {
+        merged = false;
+        for (auto i = 0; i < mNumRects; i++) {
+            if (i != index && SDL_HasIntersection(&mRects[i], &mRects[index])) {
+                SDL_UnionRect(&mRects[i], &mRects[index], &mRects[index]);
+                mRects[i] = mRects[--mNumRects];
+                if (index == mNumRects) {
+                    index = i;
+                }
+                merged = true;
+                break;
+            }
+        }
+    }
+}
+
+void DirtyRegion::merge_cheapest_pair()
+{
+    auto bestA = 0;
+    auto bestB = 1;
+    auto bestCost = SDL_MAX_SINT64;
+    for (auto a = 0; a < mNumRects; a++) {
+        for (auto b = a + 1; b < mNumRects; b++) {
+            SDL_Rect merged;
+            SDL_UnionRect(&mRects[a], &mRects[b], &merged);
+            auto cost = area_of(merged) - area_of(mRects[a]) - area_of(mRects[b]);
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestA = a;
+                bestB = b;
+            }
+        }
+    }
+    SDL_UnionRect(&mRects[bestA], &mRects[bestB], &mRects[bestA]);
+    mRects[bestB] = mRects[--mNumRects];
+    merge(bestA);
+}
+
+Sint64 DirtyRegion::area() const
+{
+    Sint64 total = 0;
+    for (auto i = 0; i < mNumRects; i++) {
+        total += area_of(mRects[i]);
+    }
+    return total;
+}
+
+// ============================================================================
+// WINDOW PRESENTER
+// ============================================================================
+WindowPresenter::WindowPresenter(SDL_Window* window, double fullUpdateThreshold)
+    : mWindow(window),
+      mSurface(NULL),
+      mThreshold(fullUpdateThreshold),
+      mFullUpdate(true),
+      mSurfaceChanged(true)
+{
+    acquire_surface();
+}
+
+void WindowPresenter::acquire_surface()
+{
+    mSurface = SDL_GetWindowSurface(mWindow);
+    if (mSurface == NULL) {
+        SDL_Log("Unable to get the window surface: %s\n", SDL_GetError());
+        mDirty.set_bounds(0, 0);
+    } else {
+        mDirty.set_bounds(mSurface->w, mSurface->h);
+    }
+    mFullUpdate = true;
+    mSurfaceChanged = true;
+}
+
+void WindowPresenter::invalidate_all()
+{
+    mFullUpdate = true;
+}
+
+void WindowPresenter::handle_event(const SDL_Event& event)
+{
+    if (event.type != SDL_WINDOWEVENT || event.window.windowID != SDL_GetWindowID(mWindow)) {
+        return;
+    }
+    switch (event.window.event) {
+        case SDL_WINDOWEVENT_SIZE_CHANGED:
+            acquire_surface();
+            break;
+        case SDL_WINDOWEVENT_EXPOSED:
+            invalidate_all();
+            break;
+    }
+}
+
+int WindowPresenter::present()
+{
+    if (mSurface == NULL) {
+        return SDL_SetError("The window has no surface to present");
+    }
+    if (mDirty.num_rects() == 0 && !mFullUpdate) {
+        return 0;
+    }
+    auto surfaceArea = Sint64(mSurface->w) * mSurface->h;
+    auto dirtyArea = mDirty.area();
+    int result;
+    if (mFullUpdate || dirtyArea > surfaceArea * mThreshold) {
+        result = SDL_UpdateWindowSurface(mWindow);
+        mPresentedPixels.add(surfaceArea);
+        mFullUpdates.increment();
+    } else {
+        result = SDL_UpdateWindowSurfaceRects(mWindow, mDirty.rects(), mDirty.num_rects());
+        mPresentedPixels.add(dirtyArea);
+        mPartialUpdates.increment();
+    }
+    mDirty.clear();
+    mFullUpdate = false;
+    mSurfaceChanged = false;
+    return result;
+}
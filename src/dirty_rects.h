@@ -0,0 +1,85 @@
+// ============================================================================
+// DIRTY RECTS
+// ============================================================================
+// Damage tracking for the window surface so only the changed areas are sent
+// to the screen with SDL_UpdateWindowSurfaceRects.
+//
+// DirtyRegion......A set of damaged rects. Overlapping rects are merged with
+//                  SDL_UnionRect. When there are more than MAX_RECTS rects,
+//                  the pair whose union adds the least extra area is merged.
+// WindowPresenter..Draws into the window surface and presents the damaged
+//                  region. When the damage covers more than the threshold
+//                  of the surface, the whole surface is updated instead as
+//                  SDL_UpdateWindowSurface is cheaper than many rects.
+//
+// The window surface is invalidated by SDL when the window is resized, so
+// the presenter must also receive the window events of its window. The new
+// surface has undefined contents, and surface_changed() tells that it must be
+// redrawn fully before the next present.
+// ============================================================================
+#pragma once
+
+#include <SDL.h>
+
+#include "counters.h"
+
+class DirtyRegion {
+public:
+    static const int MAX_RECTS = 32;
+
+    DirtyRegion();
+
+    // add a damaged rect, which is clipped to the bounds (if set).
+    void add(const SDL_Rect& rect);
+    void clear() { mNumRects = 0; }
+    void set_bounds(int width, int height);
+
+    const SDL_Rect* rects() const     { return mRects; }
+    int             num_rects() const { return mNumRects; }
+    Sint64          area() const;
+
+private:
+    void merge(int index);
+    void merge_cheapest_pair();
+
+    SDL_Rect mBounds;
+    SDL_Rect mRects[MAX_RECTS + 1];
+    int      mNumRects;
+};
+
+class WindowPresenter {
+public:
+    explicit WindowPresenter(SDL_Window* window, double fullUpdateThreshold = 0.5);
+
+    // the surface to draw into or NULL when the window has no surface.
+    SDL_Surface* surface() { return mSurface; }
+    // whether the surface was (re)acquired after the last present.
+    bool surface_changed() const { return mSurfaceChanged; }
+
+    void invalidate(const SDL_Rect& rect) { mDirty.add(rect); }
+    void invalidate_all();
+    void handle_event(const SDL_Event& event);
+
+    // present the damaged region. Returns -1 on failure (see SDL_GetError).
+    int present();
+
+    const ShardedCounter& presented_pixels() const { return mPresentedPixels; }
+    const ShardedCounter& partial_updates() const  { return mPartialUpdates; }
+    const ShardedCounter& full_updates() const     { return mFullUpdates; }
+
+private:
+    WindowPresenter(const WindowPresenter&);
+    WindowPresenter& operator=(const WindowPresenter&);
+
+    void acquire_surface();
+
+    SDL_Window*    mWindow;
+    SDL_Surface*   mSurface;
+    double         mThreshold;
+    bool           mFullUpdate;
+    bool           mSurfaceChanged;
+    DirtyRegion    mDirty;
+    ShardedCounter mPresentedPixels;
+    ShardedCounter mPartialUpdates;
+    ShardedCounter mFullUpdates;
+};
@@ -0,0 +1,263 @@
+#include "display_cache.h"
+
+#include <algorithm>
+
+static const Uint32 CACHE_MAGIC = 0x43505344; // "DSPC"
+static const Uint32 CACHE_VERSION = 1;
+static const Uint32 MAX_CACHED_MODES = 65536;
+
+// FNV-1a hash, which is used to build the topology signature.
+static void hash_bytes(Uint64* hash, const void* data, size_t size)
+{
+    auto bytes = static_cast<const Uint8*>(data);
+    for (size_t i = 0; i < size; i++) {
+        *hash ^= bytes[i];
+        *hash *= 0x100000001b3ull;
+    }
+}
+
+static void hash_string(Uint64* hash, const char* string)
+{
+    if (string != NULL) {
+        hash_bytes(hash, string, SDL_strlen(string) + 1);
+    }
+}
+
+DisplayCache::DisplayCache(const char* fileName)
+    : mStale(true),
+      mLoaded(false),
+      mSignature(0)
+{
+    mPath[0] = '\0';
+    auto prefPath = SDL_GetPrefPath("organization_name", "application_name");
+    if (prefPath != NULL) {
+        SDL_snprintf(mPath, sizeof(mPath), "%s%s", prefPath, fileName);
+        SDL_free(prefPath);
+    }
+    mFirst.assign(1, 0);
+}
+
+Uint64 DisplayCache::topology_signature() const
+{
+    Uint64 hash = 0xcbf29ce484222325ull;
+    hash_string(&hash, SDL_GetCurrentVideoDriver());
+    auto numDisplays = SDL_GetNumVideoDisplays();
+    hash_bytes(&hash, &numDisplays, sizeof(numDisplays));
+    for (auto i = 0; i < numDisplays; i++) {
+        hash_string(&hash, SDL_GetDisplayName(i));
+        SDL_Rect bounds;
+        if (SDL_GetDisplayBounds(i, &bounds) == 0) {
+            hash_bytes(&hash, &bounds, sizeof(bounds));
+        }
+        SDL_DisplayMode desktop;
+        if (SDL_GetDesktopDisplayMode(i, &desktop) == 0) {
+            hash_bytes(&hash, &desktop.format, sizeof(desktop.format));
+            hash_bytes(&hash, &desktop.w, sizeof(desktop.w));
+            hash_bytes(&hash, &desktop.h, sizeof(desktop.h));
+            hash_bytes(&hash, &desktop.refresh_rate, sizeof(desktop.refresh_rate));
+        }
+    }
+    return hash;
+}
+
+void DisplayCache::refresh()
+{
+    if (!mStale) {
+        return;
+    }
+    mStale = false;
+    auto signature = topology_signature();
+    if (signature == mSignature) {
+        return;
+    }
+    mSignature = signature;
+    mLoaded = load(signature);
+    if (!mLoaded) {
+        enumerate();
+        save();
+    }
+}
+
+void DisplayCache::handle_event(const SDL_Event& event)
+{
+    switch (event.type) {
+#if SDL_VERSION_ATLEAST(2, 0, 9)
+        case SDL_DISPLAYEVENT:
+            invalidate();
+            break;
+#endif
+        case SDL_WINDOWEVENT:
+            // moving is frequent, but only the cheap signature is re-validated.
+            if (event.window.event == SDL_WINDOWEVENT_MOVED) {
+                invalidate();
+            }
+            break;
+    }
+}
+
+void DisplayCache::enumerate()
+{
+    mFirst.assign(1, 0);
+    mModes.clear();
+    auto numDisplays = SDL_GetNumVideoDisplays();
+    for (auto i = 0; i < numDisplays; i++) {
+        auto numModes = SDL_GetNumDisplayModes(i);
+        for (auto j = 0; j < numModes; j++) {
+            SDL_DisplayMode displayMode;
+            if (SDL_GetDisplayMode(i, j, &displayMode) != 0) {
+                continue;
+            }
+            Mode mode;
+            mode.format = displayMode.format;
+            mode.width = Uint16(displayMode.w);
+            mode.height = Uint16(displayMode.h);
+            mode.refreshRate = Uint16(displayMode.refresh_rate);
+            mode.bpp = Uint16(SDL_BITSPERPIXEL(displayMode.format));
+            mModes.push_back(mode);
+        }
+        std::sort(mModes.begin() + mFirst.back(), mModes.end(), [](const Mode& a, const Mode& b) {
+            if (a.width != b.width) {
+                return a.width < b.width;
+            }
+            if (a.height != b.height) {
+                return a.height < b.height;
+            }
+            if (a.refreshRate != b.refreshRate) {
+                return a.refreshRate < b.refreshRate;
+            }
+            return a.bpp < b.bpp;
+        });
+        mFirst.push_back(int(mModes.size()));
+    }
+}
+
+bool DisplayCache::load(Uint64 signature)
+{
+    if (mPath[0] == '\0') {
+        return false;
+    }
+    auto file = SDL_RWFromFile(mPath, "rb");
+    if (file == NULL) {
+        return false;
+    }
+    auto result = SDL_ReadLE32(file) == CACHE_MAGIC
+               && SDL_ReadLE32(file) == CACHE_VERSION
+               && SDL_ReadLE64(file) == signature;
+    std::vector<int> first(1, 0);
+    if (result) {
+        auto numDisplays = SDL_ReadLE32(file);
+        for (Uint32 i = 0; i < numDisplays && result; i++) {
+            auto total = Uint32(first.back()) + SDL_ReadLE32(file);
+            result = total <= MAX_CACHED_MODES;
+            first.push_back(int(total));
+        }
+    }
+    std::vector<Mode> modes;
+    if (result) {
+        modes.resize(first.back());
+        for (auto& mode : modes) {
+            mode.format = SDL_ReadLE32(file);
+            mode.width = SDL_ReadLE16(file);
+            mode.height = SDL_ReadLE16(file);
+            mode.refreshRate = SDL_ReadLE16(file);
+            mode.bpp = SDL_ReadLE16(file);
+        }
+        // the reads return zeros at the end of the file, so check the size.
+        result = SDL_RWtell(file) == SDL_RWsize(file);
+    }
+    SDL_RWclose(file);
+    if (result) {
+        mFirst.swap(first);
+        mModes.swap(modes);
+    }
+    return result;
+}
+
+void DisplayCache::save() const
+{
+    if (mPath[0] == '\0') {
+        return;
+    }
+    auto file = SDL_RWFromFile(mPath, "wb");
+    if (file == NULL) {
+        SDL_Log("Failed to write the display cache: %s\n", SDL_GetError());
+        return;
+    }
+    SDL_WriteLE32(file, CACHE_MAGIC);
+    SDL_WriteLE32(file, CACHE_VERSION);
+    SDL_WriteLE64(file, mSignature);
+    SDL_WriteLE32(file, Uint32(mFirst.size() - 1));
+    for (size_t i = 1; i < mFirst.size(); i++) {
+        SDL_WriteLE32(file, Uint32(mFirst[i] - mFirst[i - 1]));
+    }
+    for (const auto& mode : mModes) {
+        SDL_WriteLE32(file, mode.format);
+        SDL_WriteLE16(file, mode.width);
+        SDL_WriteLE16(file, mode.height);
+        SDL_WriteLE16(file, mode.refreshRate);
+        SDL_WriteLE16(file, mode.bpp);
+    }
+    SDL_RWclose(file);
+}
+
+int DisplayCache::num_displays()
+{
+    refresh();
+    return int(mFirst.size()) - 1;
+}
+
+int DisplayCache::num_modes(int display)
+{
+    if (display < 0 || display >= num_displays()) {
+        return 0;
+    }
+    return mFirst[display + 1] - mFirst[display];
+}
+
+bool DisplayCache::mode(int display, int index, SDL_DisplayMode* result)
+{
+    if (index < 0 || index >= num_modes(display)) {
+        return false;
+    }
+    const auto& mode = mModes[mFirst[display] + index];
+    result->format = mode.format;
+    result->w = mode.width;
+    result->h = mode.height;
+    result->refresh_rate = mode.refreshRate;
+    result->driverdata = NULL;
+    return true;
+}
+
+bool DisplayCache::best_mode(int display, int width, int height, int refreshRate, SDL_DisplayMode* result)
+{
+    if (num_modes(display) == 0) {
+        return false;
+    }
+    const Mode* best = NULL;
+    auto bestArea = SDL_MAX_SINT64;
+    auto bestDelta = SDL_MAX_SINT32;
+    for (auto i = mFirst[display]; i < mFirst[display + 1]; i++) {
+        const auto& mode = mModes[i];
+        if (mode.width < width || mode.height < height) {
+            continue;
+        }
+        auto area = Sint64(mode.width) * mode.height;
+        auto delta = refreshRate > 0 ? SDL_abs(mode.refreshRate - refreshRate) : -mode.refreshRate;
+        if (area < bestArea
+            || (area == bestArea && delta < bestDelta)
+            || (area == bestArea && delta == bestDelta && mode.bpp >= best->bpp)) {
+            best = &mode;
+            bestArea = area;
+            bestDelta = delta;
+        }
+    }
+    if (best == NULL) {
+        return false;
+    }
+    result->format = best->format;
+    result->w = best->width;
+    result->h = best->height;
+    result->refresh_rate = best->refreshRate;
+    result->driverdata = NULL;
+    return true;
+}
@@ -0,0 +1,71 @@
+// ============================================================================
+// DISPLAY CACHE
+// ============================================================================
+// A cached table of the display modes of all displays, so the modes do not
+// have to be enumerated with SDL_GetNumDisplayModes and SDL_GetDisplayMode
+// on every launch and best mode lookups do not call into the video driver.
+//
+// The table is stored into the preferences path (SDL_GetPrefPath) together
+// with a signature of the display topology, which is built from the cheap
+// queries (the video driver, the display names, the display bounds and the
+// desktop modes). When the signature of the cache file matches the current
+// signature, the modes are read from the file instead of the driver.
+//
+// refresh()........Validate the table and re-enumerate it when it is stale.
+// invalidate().....Re-validate the table on the next refresh or lookup.
+// handle_event()...Invalidate on SDL_DISPLAYEVENT and SDL_WINDOWEVENT_MOVED.
+// best_mode()......The smallest mode that is at least the requested size,
+//                  with the closest refresh rate and then the highest bpp.
+//
+// The modes are sorted by display, resolution, refresh rate and bpp. Note
+// that the cached modes have no driver data (the driverdata is NULL), which
+// is fine for SDL_SetWindowDisplayMode as it looks up the driver mode.
+// ============================================================================
+#pragma once
+
+#include <SDL.h>
+
+#include <vector>
+
+class DisplayCache {
+public:
+    explicit DisplayCache(const char* fileName = "displays.bin");
+
+    void refresh();
+    void invalidate() { mStale = true; }
+    void handle_event(const SDL_Event& event);
+
+    // whether the last refresh used the table from the cache file.
+    bool loaded_from_file() const { return mLoaded; }
+
+    int  num_displays();
+    int  num_modes(int display);
+    bool mode(int display, int index, SDL_DisplayMode* result);
+
+    // a zero refresh rate selects the highest refresh rate of the size.
+    bool best_mode(int display, int width, int height, int refreshRate, SDL_DisplayMode* result);
+
+private:
+    struct Mode {
+        Uint32 format;
+        Uint16 width;
+        Uint16 height;
+        Uint16 refreshRate;
+        Uint16 bpp;
+    };
+
+    DisplayCache(const DisplayCache&);
+    DisplayCache& operator=(const DisplayCache&);
+
+    Uint64 topology_signature() const;
+    void   enumerate();
+    bool   load(Uint64 signature);
+    void   save() const;
+
+    char              mPath[1024];
+    bool              mStale;
+    bool              mLoaded;
+    Uint64            mSignature;
+    std::vector<int>  mFirst;
+    std::vector<Mode> mModes;
+};
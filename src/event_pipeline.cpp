@@ -0,0 +1,176 @@
+#include "event_pipeline.h"
+
+EventPipeline::EventPipeline()
+    : mPreviousFilter(NULL),
+      mPreviousData(NULL),
+      mLock(0)
+{
+    for (auto& pending : mPending) {
+        pending.used = false;
+    }
+    for (auto& table : mTables) {
+        table = NULL;
+    }
+    if (!SDL_GetEventFilter(&mPreviousFilter, &mPreviousData)) {
+        mPreviousFilter = NULL;
+        mPreviousData = NULL;
+    }
+    SDL_SetEventFilter(filter, this);
+}
+
+EventPipeline::~EventPipeline()
+{
+    SDL_SetEventFilter(mPreviousFilter, mPreviousData);
+    for (auto table : mTables) {
+        delete[] table;
+    }
+}
+
+void EventPipeline::on(Uint32 type, const Handler& handler)
+{
+    if (type > SDL_LASTEVENT) {
+        return;
+    }
+    auto& table = mTables[type >> 8];
+    if (table == NULL) {
+        table = new Handlers[256];
+    }
+    table[type & 0xff].push_back(handler);
+}
+
+void EventPipeline::dispatch(const SDL_Event& event)
+{
+    // a queued coalesced event is replaced with the latest pending value.
+    auto current = &event;
+    SDL_Event latest;
+    Key key;
+    if (coalesce_key(event, &key)) {
+        SDL_AtomicLock(&mLock);
+        auto pending = find_pending(key);
+        // the events are copied as a whole into and out of the queue.
+        if (pending != NULL && SDL_memcmp(&pending->queued, &event, sizeof(event)) == 0) {
+            latest = pending->event;
+            pending->used = false;
+            current = &latest;
+        }
+        SDL_AtomicUnlock(&mLock);
+    }
+
+    mDispatched.increment();
+    auto table = event.type <= SDL_LASTEVENT ? mTables[event.type >> 8] : NULL;
+    if (table == NULL) {
+        return;
+    }
+    for (const auto& handler : table[event.type & 0xff]) {
+        handler(*current);
+    }
+}
+
+int SDLCALL EventPipeline::filter(void* data, SDL_Event* event)
+{
+    auto pipeline = static_cast<EventPipeline*>(data);
+    if (pipeline->mPreviousFilter != NULL
+        && pipeline->mPreviousFilter(pipeline->mPreviousData, event) == 0) {
+        return 0;
+    }
+    return pipeline->coalesce(*event) ? 1 : 0;
+}
+
+bool EventPipeline::coalesce_key(const SDL_Event& event, Key* key)
+{
+    key->type = event.type;
+    key->detail = 0;
+    switch (event.type) {
+        case SDL_MOUSEMOTION:
+            key->source = event.motion.which;
+            return true;
+        case SDL_JOYAXISMOTION:
+            key->source = Uint32(event.jaxis.which);
+            key->detail = event.jaxis.axis;
+            return true;
+        case SDL_CONTROLLERAXISMOTION:
+            key->source = Uint32(event.caxis.which);
+            key->detail = event.caxis.axis;
+            return true;
+        case SDL_WINDOWEVENT:
+            if (event.window.event == SDL_WINDOWEVENT_MOVED
+                || event.window.event == SDL_WINDOWEVENT_RESIZED
+                || event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
+                key->source = event.window.windowID;
+                key->detail = event.window.event;
+                return true;
+            }
+            return false;
+        default:
+            return false;
+    }
+}
+
+EventPipeline::Pending* EventPipeline::find_pending(const Key& key)
+{
+    for (auto& pending : mPending) {
+        if (pending.used
+            && pending.key.type == key.type
+            && pending.key.source == key.source
+            && pending.key.detail == key.detail) {
+            return &pending;
+        }
+    }
+    return NULL;
+}
+
+bool EventPipeline::coalesce(const SDL_Event& event)
+{
+    Key key;
+    if (!coalesce_key(event, &key)) {
+        return true;
+    }
+    auto queue = true;
+    SDL_AtomicLock(&mLock);
+    auto pending = find_pending(key);
+    if (pending != NULL && event.common.timestamp - pending->event.common.timestamp <= STALE_MS) {
+        if (event.type == SDL_MOUSEMOTION) {
+            auto xrel = pending->event.motion.xrel + event.motion.xrel;
+            auto yrel = pending->event.motion.yrel + event.motion.yrel;
+            pending->event = event;
+            pending->event.motion.xrel = xrel;
+            pending->event.motion.yrel = yrel;
+        } else {
+            pending->event = event;
+        }
+        queue = false;
+    } else {
+        // the first event of a burst is queued and becomes the pending event.
+        // The motion merged into a stale burst is carried into the new burst,
+        // as its queued event is now dispatched with its own value.
+        auto xrel = 0;
+        auto yrel = 0;
+        if (pending != NULL && event.type == SDL_MOUSEMOTION) {
+            xrel = pending->event.motion.xrel - pending->queued.motion.xrel;
+            yrel = pending->event.motion.yrel - pending->queued.motion.yrel;
+        }
+        if (pending == NULL) {
+            for (auto& candidate : mPending) {
+                if (!candidate.used) {
+                    pending = &candidate;
+                    break;
+                }
+            }
+        }
+        if (pending != NULL) {
+            pending->used = true;
+            pending->key = key;
+            pending->queued = event;
+            pending->event = event;
+            if (event.type == SDL_MOUSEMOTION) {
+                pending->event.motion.xrel += xrel;
+                pending->event.motion.yrel += yrel;
+            }
+        }
+    }
+    SDL_AtomicUnlock(&mLock);
+    if (!queue) {
+        mCoalesced.increment();
+    }
+    return queue;
+}
@@ -0,0 +1,92 @@
+// ============================================================================
+// EVENT PIPELINE
+// ============================================================================
+// Routes the SDL events to handlers with a dispatch table and coalesces the
+// bursty events before they accumulate into the SDL event queue.
+//
+// 1. Filter.....An SDL_SetEventFilter callback, which is called when an event
+//               is pushed into the queue. The first motion event of a source
+//               is queued normally and kept as pending. The following events
+//               of the same source only update the pending event and are not
+//               queued at all, until the queued event has been dispatched.
+// 2. Dispatch...A two-level table indexed by the high and low byte of the
+//               event type holds the handlers of each event type. A queued
+//               coalesced event is replaced with its latest pending value.
+//
+// The coalesced events are the mouse motion (per mouse, with the relative
+// motion accumulated), the joystick and game controller axis motion (per
+// axis) and the window moves and size changes (per window). A coalesced event
+// is dispatched at the position of the first event of the burst.
+//
+// A pending event keeps a copy of the event that was queued for its burst and
+// only that event is replaced at the dispatch. When the queued event has not
+// been dispatched within STALE_MS, the next event starts a new burst with the
+// relative motion that was merged into the old burst, so neither the delta of
+// the old burst is lost nor the delta of the new burst applied twice.
+//
+// The MainLoop drains the queue in batches with SDL_PeepEvents and passes
+// each event to dispatch().
+// ============================================================================
+#pragma once
+
+#include <SDL.h>
+
+#include "counters.h"
+
+#include <functional>
+#include <vector>
+
+class EventPipeline {
+public:
+    typedef std::function<void(const SDL_Event&)> Handler;
+
+    static const int MAX_PENDING = 32;
+    // a pending event older than this is assumed to have left the queue.
+    static const Uint32 STALE_MS = 250;
+
+    // install the event filter (the previous filter is still called first).
+    EventPipeline();
+    // restore the previous event filter.
+    ~EventPipeline();
+
+    // add a handler for the event type. Handlers are called in order.
+    void on(Uint32 type, const Handler& handler);
+    void dispatch(const SDL_Event& event);
+
+    const ShardedCounter& dispatched() const { return mDispatched; }
+    const ShardedCounter& coalesced() const  { return mCoalesced; }
+
+private:
+    struct Key {
+        Uint32 type;
+        Uint32 source;
+        Uint32 detail;
+    };
+
+    struct Pending {
+        bool      used;
+        Key       key;
+        SDL_Event queued; // the event that was queued for the burst.
+        SDL_Event event;  // the latest (merged) value of the burst.
+    };
+
+    typedef std::vector<Handler> Handlers;
+
+    EventPipeline(const EventPipeline&);
+    EventPipeline& operator=(const EventPipeline&);
+
+    static int SDLCALL filter(void* data, SDL_Event* event);
+    static bool        coalesce_key(const SDL_Event& event, Key* key);
+
+    // returns false when the event was merged into a pending event.
+    bool     coalesce(const SDL_Event& event);
+    Pending* find_pending(const Key& key);
+
+    SDL_EventFilter mPreviousFilter;
+    void*           mPreviousData;
+    SDL_SpinLock    mLock;
+    Pending         mPending[MAX_PENDING];
+    Handlers*       mTables[256];
+    ShardedCounter  mDispatched;
+    ShardedCounter  mCoalesced;
+};
@@ -0,0 +1,100 @@
+#include "frame_pacer.h"
+
+#include <cmath>
+
+static const int CALIBRATION_SLEEPS = 8;
+
+FramePacer::FramePacer()
+    : mFrequency(SDL_GetPerformanceFrequency()),
+      mOvershoot(mFrequency / 500),
+      mCalibrated(false),
+      mFrames(0),
+      mMissed(0),
+      mSum(0.0),
+      mSumSquares(0.0),
+      mMax(0.0)
+{
+}
+
+// ============================================================================
+// The overshoot is the worst extra time of a few SDL_Delay(1) calls and a
+// small safety margin, so the sleeps rarely end after the frame deadline.
+// ============================================================================
+void FramePacer::calibrate()
+{
+    auto oneMillisecond = mFrequency / 1000;
+    Uint64 worst = 0;
+    for (auto i = 0; i < CALIBRATION_SLEEPS; i++) {
+        auto start = SDL_GetPerformanceCounter();
+        SDL_Delay(1);
+        worst = SDL_max(worst, SDL_GetPerformanceCounter() - start);
+    }
+    mOvershoot = (worst > oneMillisecond ? worst - oneMillisecond : 0) + mFrequency / 5000;
+    mCalibrated = true;
+}
+
+int FramePacer::sleep_millis(Uint64 deadline) const
+{
+    auto now = SDL_GetPerformanceCounter();
+    if (now + mOvershoot >= deadline) {
+        return 0;
+    }
+    return int((deadline - now - mOvershoot) * 1000 / mFrequency);
+}
+
+void FramePacer::spin_until(Uint64 deadline) const
+{
+    while (SDL_GetPerformanceCounter() < deadline) {
+        // spin, the remaining time is shorter than the sleep granularity.
+    }
+}
+
+void FramePacer::wait_until(Uint64 deadline) const
+{
+    auto millis = sleep_millis(deadline);
+    if (millis > 0) {
+        SDL_Delay(Uint32(millis));
+    }
+    spin_until(deadline);
+}
+
+void FramePacer::record(Uint64 wakeTime, Uint64 deadline, Uint64 frameTicks)
+{
+    auto error = double(Sint64(wakeTime - deadline)) * 1000.0 / mFrequency;
+    mSum += SDL_fabs(error);
+    mSumSquares += error * error;
+    mMax = SDL_max(mMax, SDL_fabs(error));
+    if (wakeTime > deadline + frameTicks / 2) {
+        mMissed++;
+    }
+    mFrames++;
+}
+
+PacerStats FramePacer::take_stats()
+{
+    PacerStats stats;
+    stats.frames = mFrames;
+    stats.missed = mMissed;
+    stats.averageJitter = mFrames > 0 ? mSum / mFrames : 0.0;
+    stats.maxJitter = mMax;
+    stats.deviation = mFrames > 0 ? std::sqrt(mSumSquares / mFrames) : 0.0;
+    mFrames = 0;
+    mMissed = 0;
+    mSum = 0.0;
+    mSumSquares = 0.0;
+    mMax = 0.0;
+    return stats;
+}
+
+int FramePacer::display_rate(SDL_Window* window, int fallback)
+{
+    if (window == NULL) {
+        return fallback;
+    }
+    auto display = SDL_GetWindowDisplayIndex(window);
+    SDL_DisplayMode mode;
+    if (display < 0 || SDL_GetCurrentDisplayMode(display, &mode) != 0 || mode.refresh_rate <= 0) {
+        return fallback;
+    }
+    return mode.refresh_rate;
+}
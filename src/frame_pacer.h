@@ -0,0 +1,59 @@
+// ============================================================================
+// FRAME PACER
+// ============================================================================
+// Precise waits for the frame deadlines. SDL_Delay and SDL_WaitEventTimeout
+// sleep at least the given milliseconds, but the OS may wake the thread up
+// much later (even 15 ms on some systems), which makes the frames miss their
+// deadlines. The pacer sleeps only for the part of the wait which is safe to
+// sleep and spins on SDL_GetPerformanceCounter for the rest.
+//
+// calibrate()........Measure how much SDL_Delay(1) overshoots on this system.
+// sleep_millis().....The milliseconds that can be slept before the deadline.
+// spin_until().......Busy wait on the performance counter until the deadline.
+// wait_until().......Sleep and then spin until the deadline.
+// record()...........Record the wake up time of a frame against its deadline.
+// take_stats().......The jitter statistics since the previous call.
+//
+// display_rate() returns the refresh rate of the display of a window, which
+// can be used as the target frame rate.
+// ============================================================================
+#pragma once
+
+#include <SDL.h>
+
+struct PacerStats {
+    Uint32 frames;
+    Uint32 missed;        // frames that woke up later than half a frame.
+    double averageJitter; // the average absolute wake up error in ms.
+    double maxJitter;     // the largest absolute wake up error in ms.
+    double deviation;     // the root mean square of the wake up error in ms.
+};
+
+class FramePacer {
+public:
+    FramePacer();
+
+    void   calibrate();
+    bool   calibrated() const { return mCalibrated; }
+    double sleep_overshoot_ms() const { return mOvershoot * 1000.0 / mFrequency; }
+
+    int  sleep_millis(Uint64 deadline) const;
+    void spin_until(Uint64 deadline) const;
+    void wait_until(Uint64 deadline) const;
+
+    void       record(Uint64 wakeTime, Uint64 deadline, Uint64 frameTicks);
+    PacerStats take_stats();
+
+    // the refresh rate of the display of the window or the fallback when unknown.
+    static int display_rate(SDL_Window* window, int fallback = 60);
+
+private:
+    Uint64 mFrequency;
+    Uint64 mOvershoot;
+    bool   mCalibrated;
+    Uint32 mFrames;
+    Uint32 mMissed;
+    double mSum;
+    double mSumSquares;
+    double mMax;
+};
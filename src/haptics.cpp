@@ -0,0 +1,364 @@
+#include "haptics.h"
+#include "profiler.h"
+#include "subsystems.h"
+
+// the period of the sine fallback of the rumble in milliseconds.
+static const Uint16 RUMBLE_PERIOD_MS = 40;
+
+// FNV-1a hash of the effect parameters.
+static Uint64 hash_effect(const SDL_HapticEffect& effect)
+{
+    auto bytes = reinterpret_cast<const Uint8*>(&effect);
+    auto hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < sizeof(effect); i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+HapticManager::HapticManager()
+    : mQuit(false),
+      mFlushed(false),
+      mPending(false),
+      mMutex(SDL_CreateMutex()),
+      mCond(SDL_CreateCond()),
+      mThread(NULL)
+{
+    if (!Subsystems::instance().require(SDL_INIT_HAPTIC)) {
+        return;
+    }
+    mThread = SDL_CreateThread(thread_function, "haptics", this);
+    if (mThread == NULL) {
+        SDL_Log("Unable to create the haptics thread: %s\n", SDL_GetError());
+    }
+}
+
+HapticManager::~HapticManager()
+{
+    if (mThread != NULL) {
+        SDL_LockMutex(mMutex);
+        mQuit = true;
+        SDL_CondSignal(mCond);
+        SDL_UnlockMutex(mMutex);
+        SDL_WaitThread(mThread, NULL);
+    }
+    for (auto device : mDevices) {
+        close(device);
+    }
+    for (auto device : mDetached) {
+        close(device);
+    }
+    SDL_DestroyCond(mCond);
+    SDL_DestroyMutex(mMutex);
+}
+
+bool HapticManager::attach(SDL_JoystickID id, SDL_Joystick* joystick)
+{
+    if (mThread == NULL || joystick == NULL || SDL_JoystickIsHaptic(joystick) <= 0) {
+        return false;
+    }
+    if (is_attached(id)) {
+        return true;
+    }
+    auto haptic = SDL_HapticOpenFromJoystick(joystick);
+    if (haptic == NULL) {
+        SDL_Log("Unable to open the haptic device of controller %d: %s\n", id, SDL_GetError());
+        return false;
+    }
+    auto numSlots = SDL_min(SDL_HapticNumEffects(haptic), MAX_EFFECTS);
+    if (numSlots <= 0) {
+        SDL_Log("The haptic device of controller %d has no effect slots.\n", id);
+        SDL_HapticClose(haptic);
+        return false;
+    }
+    auto device = new Device();
+    device->id = id;
+    device->haptic = haptic;
+    for (auto i = 0; i < MAX_CHANNELS; i++) {
+        device->pending[i].type = REQUEST_NONE;
+        device->channels[i] = -1;
+    }
+    for (auto i = 0; i < MAX_EFFECTS; i++) {
+        device->slots[i].effect = -1;
+    }
+    device->numSlots = numSlots;
+    device->features = SDL_HapticQuery(haptic);
+    device->clock = 0;
+    SDL_LockMutex(mMutex);
+    mDevices.push_back(device);
+    SDL_UnlockMutex(mMutex);
+    SDL_Log("Opened the haptic device of controller %d with %d effect slots.\n", id, numSlots);
+    return true;
+}
+
+void HapticManager::detach(SDL_JoystickID id)
+{
+    SDL_LockMutex(mMutex);
+    for (size_t i = 0; i < mDevices.size(); i++) {
+        if (mDevices[i]->id == id) {
+            mDetached.push_back(mDevices[i]);
+            mDevices.erase(mDevices.begin() + i);
+            mFlushed = true;
+            SDL_CondSignal(mCond);
+            break;
+        }
+    }
+    SDL_UnlockMutex(mMutex);
+}
+
+bool HapticManager::is_attached(SDL_JoystickID id) const
+{
+    SDL_LockMutex(mMutex);
+    auto result = find_device(id) != NULL;
+    SDL_UnlockMutex(mMutex);
+    return result;
+}
+
+bool HapticManager::play(SDL_JoystickID id, int channel, const SDL_HapticEffect& effect, Uint32 iterations)
+{
+    Request request;
+    request.type = REQUEST_PLAY;
+    request.effect = effect;
+    request.iterations = iterations;
+    return post(id, channel, request);
+}
+
+bool HapticManager::rumble(SDL_JoystickID id, int channel, float strength, Uint32 lengthMs)
+{
+    Request request;
+    SDL_zero(request);
+    request.type = REQUEST_RUMBLE;
+    request.effect.type = SDL_HAPTIC_LEFTRIGHT;
+    request.effect.leftright.length = lengthMs;
+    request.effect.leftright.large_magnitude = Uint16(SDL_max(0.0f, SDL_min(strength, 1.0f)) * 0xffff);
+    request.effect.leftright.small_magnitude = request.effect.leftright.large_magnitude;
+    request.iterations = 1;
+    return post(id, channel, request);
+}
+
+bool HapticManager::stop(SDL_JoystickID id, int channel)
+{
+    Request request;
+    SDL_zero(request);
+    request.type = REQUEST_STOP;
+    return post(id, channel, request);
+}
+
+void HapticManager::flush()
+{
+    SDL_LockMutex(mMutex);
+    if (mPending) {
+        mPending = false;
+        mFlushed = true;
+        SDL_CondSignal(mCond);
+    }
+    SDL_UnlockMutex(mMutex);
+}
+
+void HapticManager::add_counters()
+{
+    auto& registry = CounterRegistry::instance();
+    registry.add_counter("haptic requests", &mRequests);
+    registry.add_counter("haptic coalesced", &mCoalesced);
+    registry.add_counter("haptic uploads", &mUploads);
+    registry.add_counter("haptic updates", &mUpdates);
+    registry.add_counter("haptic cache hits", &mHits);
+}
+
+void HapticManager::remove_counters()
+{
+    auto& registry = CounterRegistry::instance();
+    registry.remove("haptic requests");
+    registry.remove("haptic coalesced");
+    registry.remove("haptic uploads");
+    registry.remove("haptic updates");
+    registry.remove("haptic cache hits");
+}
+
+int HapticManager::thread_function(void* data)
+{
+    auto manager = static_cast<HapticManager*>(data);
+    std::vector<Work> batch;
+    std::vector<Device*> detached;
+    SDL_LockMutex(manager->mMutex);
+    while (true) {
+        while (!manager->mQuit && !manager->mFlushed) {
+            SDL_CondWait(manager->mCond, manager->mMutex);
+        }
+        if (manager->mQuit) {
+            break;
+        }
+        manager->mFlushed = false;
+        for (auto device : manager->mDevices) {
+            for (auto channel = 0; channel < MAX_CHANNELS; channel++) {
+                auto& pending = device->pending[channel];
+                if (pending.type != REQUEST_NONE) {
+                    Work work = { device, channel, pending };
+                    batch.push_back(work);
+                    pending.type = REQUEST_NONE;
+                }
+            }
+        }
+        detached.swap(manager->mDetached);
+        SDL_UnlockMutex(manager->mMutex);
+
+        // the detached devices are closed only after their last requests, so
+        // the devices of the batch are still open.
+        for (auto& work : batch) {
+            manager->execute(work.device, work.channel, work.request);
+        }
+        batch.clear();
+        for (auto device : detached) {
+            manager->close(device);
+        }
+        detached.clear();
+        SDL_LockMutex(manager->mMutex);
+    }
+    SDL_UnlockMutex(manager->mMutex);
+    return 0;
+}
+
+HapticManager::Device* HapticManager::find_device(SDL_JoystickID id) const
+{
+    for (auto device : mDevices) {
+        if (device->id == id) {
+            return device;
+        }
+    }
+    return NULL;
+}
+
+bool HapticManager::post(SDL_JoystickID id, int channel, const Request& request)
+{
+    if (channel < 0 || channel >= MAX_CHANNELS) {
+        return false;
+    }
+    SDL_LockMutex(mMutex);
+    auto device = find_device(id);
+    if (device == NULL) {
+        SDL_UnlockMutex(mMutex);
+        return false;
+    }
+    auto& pending = device->pending[channel];
+    if (pending.type != REQUEST_NONE) {
+        mCoalesced.increment();
+    }
+    pending = request;
+    mPending = true;
+    SDL_UnlockMutex(mMutex);
+    mRequests.increment();
+    return true;
+}
+
+void HapticManager::execute(Device* device, int channel, const Request& request)
+{
+    auto& current = device->channels[channel];
+    if (request.type == REQUEST_STOP) {
+        if (current >= 0) {
+            SDL_HapticStopEffect(device->haptic, device->slots[current].effect);
+            current = -1;
+        }
+        return;
+    }
+
+    auto effect = request.effect;
+    if (request.type == REQUEST_RUMBLE && (device->features & SDL_HAPTIC_LEFTRIGHT) == 0) {
+        if ((device->features & SDL_HAPTIC_SINE) == 0) {
+            return;
+        }
+        SDL_zero(effect);
+        effect.type = SDL_HAPTIC_SINE;
+        effect.periodic.direction.type = SDL_HAPTIC_CARTESIAN;
+        effect.periodic.direction.dir[0] = 1;
+        effect.periodic.period = RUMBLE_PERIOD_MS;
+        effect.periodic.magnitude = Sint16(request.effect.leftright.large_magnitude / 2);
+        effect.periodic.length = request.effect.leftright.length;
+    } else if ((device->features & effect.type) == 0) {
+        return;
+    }
+
+    auto slot = upload(device, effect);
+    if (slot < 0) {
+        return;
+    }
+    if (current >= 0 && current != slot) {
+        SDL_HapticStopEffect(device->haptic, device->slots[current].effect);
+    }
+    current = slot;
+    if (SDL_HapticRunEffect(device->haptic, device->slots[slot].effect, request.iterations) != 0) {
+        SDL_Log("Unable to run a haptic effect on controller %d: %s\n", device->id, SDL_GetError());
+    }
+}
+
+int HapticManager::upload(Device* device, const SDL_HapticEffect& effect)
+{
+    auto hash = hash_effect(effect);
+    device->clock++;
+    for (auto i = 0; i < device->numSlots; i++) {
+        auto& slot = device->slots[i];
+        if (slot.effect >= 0 && slot.hash == hash
+            && SDL_memcmp(&slot.params, &effect, sizeof(effect)) == 0) {
+            slot.lastUsed = device->clock;
+            mHits.increment();
+            return i;
+        }
+    }
+
+    // replace an empty slot or the least recently used one.
+    auto index = 0;
+    for (auto i = 0; i < device->numSlots; i++) {
+        auto& slot = device->slots[i];
+        if (slot.effect < 0) {
+            index = i;
+            break;
+        }
+        if (slot.lastUsed < device->slots[index].lastUsed) {
+            index = i;
+        }
+    }
+    for (auto& channel : device->channels) {
+        if (channel == index) {
+            channel = -1;
+        }
+    }
+
+    PROFILE_SCOPE("haptic upload");
+    auto& slot = device->slots[index];
+    auto params = effect;
+    if (slot.effect >= 0 && slot.params.type == effect.type) {
+        if (SDL_HapticUpdateEffect(device->haptic, slot.effect, &params) == 0) {
+            slot.hash = hash;
+            slot.lastUsed = device->clock;
+            slot.params = effect;
+            mUpdates.increment();
+            return index;
+        }
+    }
+    if (slot.effect >= 0) {
+        SDL_HapticDestroyEffect(device->haptic, slot.effect);
+        slot.effect = -1;
+    }
+    auto id = SDL_HapticNewEffect(device->haptic, &params);
+    if (id < 0) {
+        SDL_Log("Unable to upload a haptic effect to controller %d: %s\n", device->id, SDL_GetError());
+        return -1;
+    }
+    slot.effect = id;
+    slot.hash = hash;
+    slot.lastUsed = device->clock;
+    slot.params = effect;
+    mUploads.increment();
+    return index;
+}
+
+void HapticManager::close(Device* device)
+{
+    for (auto i = 0; i < device->numSlots; i++) {
+        if (device->slots[i].effect >= 0) {
+            SDL_HapticDestroyEffect(device->haptic, device->slots[i].effect);
+        }
+    }
+    SDL_HapticClose(device->haptic);
+    delete device;
+}
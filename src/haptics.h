@@ -0,0 +1,134 @@
+// ============================================================================
+// HAPTICS
+// ============================================================================
+// A force feedback scheduler for the haptic devices of the game controllers.
+// Uploading an effect with SDL_HapticNewEffect or SDL_HapticUpdateEffect is a
+// blocking driver call that can take milliseconds on some platforms, so the
+// game threads never touch the devices. They only post requests, and all of
+// the device I/O is done by the "haptics" thread.
+//
+// Requests are keyed by the device and a channel (e.g. the engine rumble and
+// the hit feedback of a game). A newer request of a same channel replaces the
+// older one until flush() is called, which is done once per frame, so a value
+// that is changed on every update is uploaded at most once per frame. Requests
+// that arrive while the thread is still busy are coalesced the same way.
+//
+// The uploaded effects are cached into the effect slots of the device by the
+// FNV-1a hash of their parameters. An effect that is already in a slot is only
+// run again. Otherwise the least recently used slot is replaced, and a slot
+// with an effect of the same type is updated in place instead of destroying it
+// and creating a new one. The effects should be cleared with SDL_zero before
+// the parameters are set, so that the padding bytes hash equally.
+//
+// The devices are opened with SDL_HapticOpenFromJoystick by attach(), which is
+// done once for each connected controller. All other calls are asynchronous.
+// ============================================================================
+#pragma once
+
+#include <SDL.h>
+
+#include "counters.h"
+
+#include <vector>
+
+class HapticManager {
+public:
+    static const int MAX_CHANNELS = 4;
+    static const int MAX_EFFECTS = 16;
+
+    // initialize the haptic subsystem (subsystems.h) and start the thread.
+    HapticManager();
+    // stop the thread and close the devices.
+    ~HapticManager();
+
+    // [main] open the haptic device of the joystick. Returns false if the
+    // joystick has no force feedback. Attaching a same id again does nothing.
+    bool attach(SDL_JoystickID id, SDL_Joystick* joystick);
+    // [main] close the device of the joystick on the "haptics" thread.
+    void detach(SDL_JoystickID id);
+    bool is_attached(SDL_JoystickID id) const;
+
+    // [any] request the effect to be run on the channel of the device. Returns
+    // false if the device is not attached.
+    bool play(SDL_JoystickID id, int channel, const SDL_HapticEffect& effect, Uint32 iterations = 1);
+    // [any] a left-right rumble with a sine fallback for the older devices.
+    bool rumble(SDL_JoystickID id, int channel, float strength, Uint32 lengthMs);
+    // [any] stop the effect of the channel.
+    bool stop(SDL_JoystickID id, int channel);
+    // [main] hand the requests of the frame to the "haptics" thread.
+    void flush();
+
+    const ShardedCounter& requests() const  { return mRequests; }
+    const ShardedCounter& coalesced() const { return mCoalesced; }
+    const ShardedCounter& uploads() const   { return mUploads; }
+    const ShardedCounter& updates() const   { return mUpdates; }
+    const ShardedCounter& hits() const      { return mHits; }
+
+    void add_counters();
+    void remove_counters();
+
+private:
+    enum RequestType {
+        REQUEST_NONE,
+        REQUEST_PLAY,
+        REQUEST_RUMBLE,
+        REQUEST_STOP
+    };
+
+    struct Request {
+        RequestType      type;
+        SDL_HapticEffect effect;
+        Uint32           iterations;
+    };
+
+    struct Slot {
+        int              effect;   // the effect id or -1 when the slot is empty.
+        Uint64           hash;
+        Uint32           lastUsed;
+        SDL_HapticEffect params;
+    };
+
+    // the pending requests are guarded by the mutex and the rest of the device
+    // is only used by the "haptics" thread.
+    struct Device {
+        SDL_JoystickID id;
+        SDL_Haptic*    haptic;
+        Request        pending[MAX_CHANNELS];
+        int            channels[MAX_CHANNELS]; // the slot run by each channel.
+        Slot           slots[MAX_EFFECTS];
+        int            numSlots;
+        unsigned int   features;
+        Uint32         clock;
+    };
+
+    struct Work {
+        Device* device;
+        int     channel;
+        Request request;
+    };
+
+    HapticManager(const HapticManager&);
+    HapticManager& operator=(const HapticManager&);
+
+    static int thread_function(void* data);
+
+    Device* find_device(SDL_JoystickID id) const;
+    bool    post(SDL_JoystickID id, int channel, const Request& request);
+    void    execute(Device* device, int channel, const Request& request);
+    int     upload(Device* device, const SDL_HapticEffect& effect);
+    void    close(Device* device);
+
+    bool                 mQuit;
+    bool                 mFlushed;
+    bool                 mPending;
+    SDL_mutex*           mMutex;
+    SDL_cond*            mCond;
+    SDL_Thread*          mThread;
+    std::vector<Device*> mDevices;
+    std::vector<Device*> mDetached;
+    ShardedCounter       mRequests;
+    ShardedCounter       mCoalesced;
+    ShardedCounter       mUploads;
+    ShardedCounter       mUpdates;
+    ShardedCounter       mHits;
+};
@@ -0,0 +1,164 @@
+#include "input_sampler.h"
+
+InputSampler::InputSampler(int rate)
+    : mRate(SDL_max(rate, 1)),
+      mFrequency(SDL_GetPerformanceFrequency()),
+      mBack(0),
+      mFront(1),
+      mPresented(0),
+      mLatencySum(0),
+      mLatencyMax(0),
+      mLatencyCount(0)
+{
+    for (auto& controller : mControllers) {
+        controller = NULL;
+    }
+    SDL_zero(mPublished);
+    read_state(&mPublished);
+    mPublished.time = SDL_GetPerformanceCounter();
+    for (auto& buffer : mBuffers) {
+        buffer = mPublished;
+    }
+    SDL_AtomicSet(&mMiddle, 2);
+}
+
+bool InputSampler::add_controller(SDL_GameController* controller)
+{
+    for (auto& slot : mControllers) {
+        if (slot == NULL) {
+            slot = controller;
+            return true;
+        }
+    }
+    SDL_Log("Unable to sample controller: all %d slots are in use.\n", InputSnapshot::MAX_CONTROLLERS);
+    return false;
+}
+
+void InputSampler::remove_controller(SDL_GameController* controller)
+{
+    for (auto& slot : mControllers) {
+        if (slot == controller) {
+            slot = NULL;
+        }
+    }
+}
+
+// ============================================================================
+// The sampler writes into the back buffer and swaps it with the middle buffer
+// and the reader swaps the middle buffer with its front buffer. The DIRTY bit
+// tells the reader that the middle buffer holds a newer snapshot. The swaps
+// are atomic exchanges, so neither side ever waits for the other.
+// ============================================================================
+bool InputSampler::sample()
+{
+    mSamples.increment();
+    auto& next = mBuffers[mBack];
+    read_state(&next);
+    if (same_state(next, mPublished)) {
+        return false;
+    }
+    next.time = SDL_GetPerformanceCounter();
+    next.sequence = mPublished.sequence + 1;
+    mPublished = next;
+
+    SDL_MemoryBarrierRelease();
+    mBack = SDL_AtomicSet(&mMiddle, mBack | DIRTY) & ~DIRTY;
+    return true;
+}
+
+const InputSnapshot& InputSampler::latest()
+{
+    if (SDL_AtomicGet(&mMiddle) & DIRTY) {
+        mFront = SDL_AtomicSet(&mMiddle, mFront) & ~DIRTY;
+        SDL_MemoryBarrierAcquire();
+    }
+    return mBuffers[mFront];
+}
+
+void InputSampler::presented(const InputSnapshot& snapshot)
+{
+    // each input is measured only with the first frame that presents it.
+    if (snapshot.sequence == 0 || snapshot.sequence == mPresented) {
+        return;
+    }
+    mPresented = snapshot.sequence;
+    auto latency = SDL_GetPerformanceCounter() - snapshot.time;
+    mLatencySum += latency;
+    mLatencyMax = SDL_max(mLatencyMax, latency);
+    mLatencyCount++;
+}
+
+Sint64 InputSampler::average_latency_us() const
+{
+    if (mLatencyCount == 0) {
+        return 0;
+    }
+    return Sint64(mLatencySum * 1000000.0 / mFrequency / mLatencyCount);
+}
+
+Sint64 InputSampler::max_latency_us() const
+{
+    return Sint64(mLatencyMax * 1000000.0 / mFrequency);
+}
+
+static Sint64 average_latency(void* data)
+{
+    return static_cast<InputSampler*>(data)->average_latency_us();
+}
+
+static Sint64 max_latency(void* data)
+{
+    return static_cast<InputSampler*>(data)->max_latency_us();
+}
+
+void InputSampler::add_counters()
+{
+    auto& registry = CounterRegistry::instance();
+    registry.add_counter("input samples", &mSamples);
+    registry.add_gauge("input latency avg us", average_latency, this);
+    registry.add_gauge("input latency max us", max_latency, this);
+}
+
+void InputSampler::remove_counters()
+{
+    auto& registry = CounterRegistry::instance();
+    registry.remove("input samples");
+    registry.remove("input latency avg us");
+    registry.remove("input latency max us");
+}
+
+void InputSampler::read_state(InputSnapshot* snapshot) const
+{
+    auto numKeys = 0;
+    auto keys = SDL_GetKeyboardState(&numKeys);
+    numKeys = SDL_min(numKeys, int(SDL_NUM_SCANCODES));
+    SDL_memcpy(snapshot->keys, keys, size_t(numKeys));
+
+    snapshot->mouseButtons = SDL_GetMouseState(&snapshot->mouseX, &snapshot->mouseY);
+
+    for (auto i = 0; i < InputSnapshot::MAX_CONTROLLERS; i++) {
+        auto controller = mControllers[i];
+        auto attached = controller != NULL && SDL_GameControllerGetAttached(controller);
+        for (auto axis = 0; axis < SDL_CONTROLLER_AXIS_MAX; axis++) {
+            snapshot->axes[i][axis] = attached
+                ? SDL_GameControllerGetAxis(controller, SDL_GameControllerAxis(axis))
+                : 0;
+        }
+        snapshot->buttons[i] = 0;
+        for (auto button = 0; attached && button < SDL_CONTROLLER_BUTTON_MAX; button++) {
+            if (SDL_GameControllerGetButton(controller, SDL_GameControllerButton(button))) {
+                snapshot->buttons[i] |= 1u << button;
+            }
+        }
+    }
+}
+
+bool InputSampler::same_state(const InputSnapshot& a, const InputSnapshot& b)
+{
+    return a.mouseX == b.mouseX
+        && a.mouseY == b.mouseY
+        && a.mouseButtons == b.mouseButtons
+        && SDL_memcmp(a.buttons, b.buttons, sizeof(a.buttons)) == 0
+        && SDL_memcmp(a.axes, b.axes, sizeof(a.axes)) == 0
+        && SDL_memcmp(a.keys, b.keys, sizeof(a.keys)) == 0;
+}
@@ -0,0 +1,91 @@
+// ============================================================================
+// INPUT SAMPLER
+// ============================================================================
+// Samples the keyboard, mouse and game controller state at a high fixed rate
+// and publishes the state as timestamped snapshots, so that the simulation
+// reads the latest input without waiting for the next frame to handle the
+// events.
+//
+// SDL requires the events to be pumped on the thread that created the window,
+// so the sampling is done on the main thread. The MainLoop calls sample()
+// before each update and also while it waits for the next frame deadline, in
+// slices of the sampling period, instead of sleeping through the whole wait.
+//
+// sample()......[main] Read the state after the events have been pumped and
+//               publish a snapshot if the state has changed. The snapshot is
+//               stamped with the performance counter of the sample, so the
+//               input happened at most one sampling period earlier.
+// latest()......[reader] The latest published snapshot. A triple buffer is
+//               used, so the reader is never blocked by the sampler and gets
+//               a consistent snapshot. There can be only one reader thread.
+// presented()...[main] The latency probe. Records the time from the input of
+//               the snapshot to the present of the frame that used it, which
+//               is the input-to-photon latency without the display scanout.
+// ============================================================================
+#pragma once
+
+#include <SDL.h>
+
+#include "counters.h"
+
+struct InputSnapshot {
+    static const int MAX_CONTROLLERS = 4;
+
+    Uint64 time;       // performance counter of the sample that saw the change.
+    Uint32 sequence;   // increments by one for each published snapshot.
+    Uint8  keys[SDL_NUM_SCANCODES];
+    int    mouseX;
+    int    mouseY;
+    Uint32 mouseButtons;
+    Sint16 axes[MAX_CONTROLLERS][SDL_CONTROLLER_AXIS_MAX];
+    Uint32 buttons[MAX_CONTROLLERS];
+};
+
+class InputSampler {
+public:
+    explicit InputSampler(int rate = 1000);
+
+    // the controllers whose state is included into the snapshots.
+    bool add_controller(SDL_GameController* controller);
+    void remove_controller(SDL_GameController* controller);
+
+    int    rate() const      { return mRate; }
+    Uint32 period_ms() const { return Uint32(SDL_max(1000 / mRate, 1)); }
+
+    // returns true when a new snapshot was published.
+    bool                 sample();
+    const InputSnapshot& latest();
+    void                 presented(const InputSnapshot& snapshot);
+
+    const ShardedCounter& samples() const { return mSamples; }
+    // the measured input-to-present latency in microseconds.
+    Sint64 average_latency_us() const;
+    Sint64 max_latency_us() const;
+
+    void add_counters();
+    void remove_counters();
+
+private:
+    // set in the middle index when it holds a snapshot not yet seen by the reader.
+    static const int DIRTY = 4;
+
+    InputSampler(const InputSampler&);
+    InputSampler& operator=(const InputSampler&);
+
+    void        read_state(InputSnapshot* snapshot) const;
+    static bool same_state(const InputSnapshot& a, const InputSnapshot& b);
+
+    int                 mRate;
+    Uint64              mFrequency;
+    SDL_GameController* mControllers[InputSnapshot::MAX_CONTROLLERS];
+    InputSnapshot       mBuffers[3];
+    InputSnapshot       mPublished;
+    int                 mBack;
+    int                 mFront;
+    SDL_atomic_t        mMiddle;
+    Uint32              mPresented;
+    Uint64              mLatencySum;
+    Uint64              mLatencyMax;
+    Uint32              mLatencyCount;
+    ShardedCounter      mSamples;
+};
@@ -0,0 +1,184 @@
+// ============================================================================
+// LOCK-FREE QUEUES
+// ============================================================================
+// Bounded ring buffer queues for passing messages between threads without
+// locking a mutex for each message. Both queues are built on SDL_atomic_t and
+// the SDL memory barriers and have a fixed power-of-two capacity.
+//
+// SpscQueue...A single producer and a single consumer. Both push and pop are
+//             wait-free and cost a single atomic store each.
+// MpscQueue...Multiple producers and a single consumer. Producers claim a
+//             cell with SDL_AtomicCAS and each cell carries a sequence number
+//             that tells whether it can be written or read.
+//
+// The producer and consumer indices are placed on separate cache lines with
+// a padding sized from SDL_GetCPUCacheLineSize(), so that the producer and
+// the consumer threads do not invalidate each others cache lines.
+//
+// Both queues return false instead of blocking when they are full or empty.
+// Values must be copy assignable and are copied in and out of the queue.
+// ============================================================================
+#pragma once
+
+#include <SDL.h>
+
+#include <new>
+
+#include "cache_line.h"
+
+// ============================================================================
+// A memory block that contains two atomic indices on separate cache lines
+// followed by the cells of the queue.
+// ============================================================================
+template <typename Cell>
+class QueueStorage {
+public:
+    explicit QueueStorage(Uint32 capacity) {
+        SDL_assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+        auto line = cache_line_size();
+        mBlock = static_cast<Uint8*>(cache_aligned_alloc(line * 2 + sizeof(Cell) * capacity));
+        SDL_assert_release(mBlock != NULL);
+        mHead = new (mBlock) SDL_atomic_t();
+        mTail = new (mBlock + line) SDL_atomic_t();
+        mCells = reinterpret_cast<Cell*>(mBlock + line * 2);
+        SDL_AtomicSet(mHead, 0);
+        SDL_AtomicSet(mTail, 0);
+        for (Uint32 i = 0; i < capacity; i++) {
+            new (&mCells[i]) Cell();
+        }
+        mCapacity = capacity;
+    }
+
+    ~QueueStorage() {
+        for (Uint32 i = 0; i < mCapacity; i++) {
+            mCells[i].~Cell();
+        }
+        cache_aligned_free(mBlock);
+    }
+
+    Uint32        mCapacity;
+    Uint8*        mBlock;
+    SDL_atomic_t* mHead;   // written by the consumer.
+    SDL_atomic_t* mTail;   // written by the producer(s).
+    Cell*         mCells;
+
+private:
+    QueueStorage(const QueueStorage&);
+    QueueStorage& operator=(const QueueStorage&);
+};
+
+// ============================================================================
+// A single-producer single-consumer queue.
+// ============================================================================
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(Uint32 capacity) : mStorage(capacity) {}
+
+    // [producer] copy the value into the queue. Returns false when full.
+    bool push(const T& value) {
+        auto tail = Uint32(SDL_AtomicGet(mStorage.mTail));
+        auto head = Uint32(SDL_AtomicGet(mStorage.mHead));
+        if (tail - head >= mStorage.mCapacity) {
+            return false;
+        }
+        mStorage.mCells[tail & (mStorage.mCapacity - 1)] = value;
+        SDL_MemoryBarrierRelease();
+        SDL_AtomicSet(mStorage.mTail, int(tail + 1));
+        return true;
+    }
+
+    // [consumer] move the oldest value out of the queue. Returns false when empty.
+    bool pop(T* value) {
+        auto head = Uint32(SDL_AtomicGet(mStorage.mHead));
+        auto tail = Uint32(SDL_AtomicGet(mStorage.mTail));
+        if (head == tail) {
+            return false;
+        }
+        SDL_MemoryBarrierAcquire();
+        *value = mStorage.mCells[head & (mStorage.mCapacity - 1)];
+        SDL_MemoryBarrierRelease();
+        SDL_AtomicSet(mStorage.mHead, int(head + 1));
+        return true;
+    }
+
+    // an approximation of the amount of queued values.
+    Uint32 size() const {
+        return Uint32(SDL_AtomicGet(mStorage.mTail)) - Uint32(SDL_AtomicGet(mStorage.mHead));
+    }
+
+    Uint32 capacity() const { return mStorage.mCapacity; }
+
+private:
+    mutable QueueStorage<T> mStorage;
+};
+
+// ============================================================================
+// A multi-producer single-consumer queue.
+// ============================================================================
+template <typename T>
+class MpscQueue {
+public:
+    explicit MpscQueue(Uint32 capacity) : mStorage(capacity) {
+        // a cell is writable when its sequence equals the claimed position.
+        for (Uint32 i = 0; i < capacity; i++) {
+            SDL_AtomicSet(&mStorage.mCells[i].sequence, int(i));
+        }
+    }
+
+    // [producers] copy the value into the queue. Returns false when full.
+    bool push(const T& value) {
+        auto position = Uint32(SDL_AtomicGet(mStorage.mTail));
+        Cell* cell;
+        for (;;) {
+            cell = &mStorage.mCells[position & (mStorage.mCapacity - 1)];
+            auto sequence = Uint32(SDL_AtomicGet(&cell->sequence));
+            auto difference = int(sequence - position);
+            if (difference == 0) {
+                if (SDL_AtomicCAS(mStorage.mTail, int(position), int(position + 1))) {
+                    break;
+                }
+                position = Uint32(SDL_AtomicGet(mStorage.mTail));
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = Uint32(SDL_AtomicGet(mStorage.mTail));
+            }
+        }
+        cell->value = value;
+        SDL_MemoryBarrierRelease();
+        SDL_AtomicSet(&cell->sequence, int(position + 1));
+        return true;
+    }
+
+    // [consumer] move the oldest value out of the queue. Returns false when empty.
+    bool pop(T* value) {
+        auto position = Uint32(SDL_AtomicGet(mStorage.mHead));
+        auto cell = &mStorage.mCells[position & (mStorage.mCapacity - 1)];
+        auto sequence = Uint32(SDL_AtomicGet(&cell->sequence));
+        if (int(sequence - (position + 1)) < 0) {
+            return false;
+        }
+        SDL_MemoryBarrierAcquire();
+        *value = cell->value;
+        SDL_MemoryBarrierRelease();
+        SDL_AtomicSet(&cell->sequence, int(position + mStorage.mCapacity));
+        SDL_AtomicSet(mStorage.mHead, int(position + 1));
+        return true;
+    }
+
+    // an approximation of the amount of queued values.
+    Uint32 size() const {
+        return Uint32(SDL_AtomicGet(mStorage.mTail)) - Uint32(SDL_AtomicGet(mStorage.mHead));
+    }
+
+    Uint32 capacity() const { return mStorage.mCapacity; }
+
+private:
+    struct Cell {
+        SDL_atomic_t sequence;
+        T            value;
+    };
+
+    mutable QueueStorage<Cell> mStorage;
+};
@@ -21,24 +21,136 @@
 // ============================================================================
 #include <SDL.h>
 
-static SDL_atomic_t sAtomicInt;
+#include "allocator.h"
+#include "async_io.h"
+#include "audio_engine.h"
+#include "audio_stream.h"
+#include "async_log.h"
+#include "benchmarks.h"
+#include "controllers.h"
+#include "counters.h"
+#include "dirty_rects.h"
+#include "event_pipeline.h"
+#include "display_cache.h"
+#include "frame_pacer.h"
+#include "haptics.h"
+#include "input_sampler.h"
+#include "lockfree_queue.h"
+#include "main_loop.h"
+#include "mapped_file.h"
+#include "pixel_kernels.h"
+#include "plugin_host.h"
+#include "power_governor.h"
+#include "profiler.h"
+#include "rect_batch.h"
+#include "render_profile.h"
+#include "spatial_index.h"
+#include "sprite_batch.h"
+#include "startup.h"
+#include "subsystems.h"
+#include "texture_atlas.h"
+#include "thread_pool.h"
+#include "timer_wheel.h"
+
+#include <vector>
+
+// a result message that is sent from a worker thread to the main thread.
+struct ThreadResult {
+    SDL_threadID thread;
+    Uint32       ticks;
+};
+
+static ShardedCounter*          sThreadJobs = NULL;
+static ThreadPool*              sThreadPool = NULL;
+static MpscQueue<ThreadResult>* sThreadResults = NULL;
+static AsyncIo*                 sAsyncIo = NULL;
+static AsyncLog*                sLog = NULL;
+static AudioEngine*             sAudio = NULL;
+static StreamingTrack*          sMusic = NULL;
+static TimerWheel*              sTimers = NULL;
+static EventPipeline*           sEvents = NULL;
+static InputSampler*            sInput = NULL;
+static ControllerSet*           sControllers = NULL;
+static HapticManager*           sHaptics = NULL;
+static PluginHost*              sPlugins = NULL;
+static PowerGovernor*           sPower = NULL;
+static WindowPresenter*         sPresenter = NULL;
+static DisplayCache*            sDisplays = NULL;
+static SDL_Renderer*            sRenderer = NULL;
+static SDL_Texture*             sScaledTarget = NULL;
+static float                    sRenderScale = 1.0f;
+static TextureAtlas*            sAtlas = NULL;
+static SpriteBatch*             sSprites = NULL;
+static std::vector<AtlasRegion> sSpriteRegions;
 
 // ============================================================================
 // TIMERS
 // ============================================================================
-// An example SDL timer callback function.
+// An example timer callback function.
+//
+// SDL_AddTimer calls a callback of the form Uint32(Uint32 interval, void*)
+// on the SDL timer thread, where the return value is the next interval (or
+// 0 to cancel the timer).
 //
-// This function is as a callback function that is called by the SDL framework
-// timer functionality on periodic intervals after being registered with the
-// SDL_AddTimer function.
+// The sandbox schedules its timers into a TimerWheel (timer_wheel.h), which
+// has sub-millisecond deadlines and runs the callbacks on a chosen executor.
+// A periodic timer is given its interval when it is scheduled.
+// ============================================================================
+static void timer_callback()
+{
+    SDL_Log("\tThe timer wheel called the timer callback function!");
+}
+
+// ============================================================================
+// AUDIO
+// ============================================================================
+// SDL audio is callback based, the callback is called on the SDL audio thread
+// whenever the device needs more samples. The sandbox mixes the voices in the
+// callback with an AudioEngine (audio_engine.h), which takes its commands from
+// any thread through a lock-free queue.
 //
-// Function return value specifies when SDL should call the function for the
-// next time. If the function returns 0, then the timer is being cancelled.
+// The test plays a short chord and then a click every second from the timer
+// thread, alternating between the left and the right speaker.
 // ============================================================================
-static Uint32 timer_callback(Uint32 interval, void* param)
+static std::vector<float> create_tone(double frequency, double seconds, int rate)
+{
+    const auto pi = 3.14159265358979324;
+    auto frames = int(seconds * rate);
+    auto fade = SDL_max(frames / 10, 1);
+    std::vector<float> samples(size_t(SDL_max(frames, 1)));
+    for (auto i = 0; i < frames; i++) {
+        auto envelope = SDL_min(SDL_min(i, frames - i), fade) / double(fade);
+        samples[i] = float(envelope * SDL_sin(2.0 * pi * frequency * i / rate));
+    }
+    return samples;
+}
+
+static void test_audio()
 {
-    SDL_Log("\tSDL called the timer callback function!");
-    return interval;
+    PROFILE_SCOPE("audio");
+    const auto rate = 44100;
+    SDL_Log("Testing SDL audio features:\n");
+    SDL_Log("\tDevice buffer of %u frames lasts %.2f ms.\n", sAudio->spec().samples, sAudio->buffer_ms());
+
+    const double chord[] = {261.63, 329.63, 392.00};
+    for (auto i = 0; i < int(SDL_arraysize(chord)); i++) {
+        auto tone = create_tone(chord[i], 0.5, rate);
+        auto sound = sAudio->add_sound(tone.data(), int(tone.size()), rate);
+        if (sound < 0 || sAudio->play(sound, 0.25f, (i - 1) * 0.5f) == 0) {
+            SDL_Log("\tUnable to play a tone: %s\n", SDL_GetError());
+        }
+    }
+
+    static AudioEngine::SoundId sClick;
+    auto click = create_tone(1000.0, 0.03, rate);
+    sClick = sAudio->add_sound(click.data(), int(click.size()), rate);
+    if (sClick >= 0) {
+        sTimers->schedule(1000.0, []() {
+            static auto sPan = 1.0f;
+            sPan = -sPan;
+            sAudio->play(sClick, 0.3f, sPan);
+        }, TimerWheel::EXECUTOR_TIMER, 1000.0);
+    }
 }
 
 // ============================================================================
@@ -50,95 +162,46 @@ static Uint32 timer_callback(Uint32 interval, void* param)
 // will be called when they are used along the SDL_CreateThread function.
 //
 // Function return value will be passed to issuer via the SDL_WaitThread.
+//
+// The sandbox runs the function as a job of the thread pool (thread_pool.h).
+// The result is sent to the main thread through a lock-free queue, because
+// only the main thread is allowed to render or to handle the window events.
+//
+// Finished jobs are counted with a sharded counter (counters.h) instead of a
+// single SDL_atomic_t, so the workers do not contend on the same cache line.
 // ============================================================================
 static int thread_function(void* data)
 {
     SDL_Delay(*static_cast<int*>(data));
     SDL_Log("\tSDL called a thread function on thread %d!", SDL_ThreadID());
 
-    SDL_AtomicAdd(&sAtomicInt, 1);
+    sThreadJobs->increment();
+
+    ThreadResult result;
+    result.thread = SDL_ThreadID();
+    result.ticks = SDL_GetTicks();
+    if (!sThreadResults->push(result)) {
+        SDL_Log("\tThread result queue is full, dropping a result.\n");
+    }
     return 0;
 }
 
-int main(int argc, char* argv[])
+// ============================================================================
+// SYSTEM INFORMATION
+// ============================================================================
+// SDL is capable to detect various things about the client system.
+//
+// 1. Platform name (Windows, Mac OS X, Linux, iOS or Android).
+// 1. Absolute application path (guaranteed to end with path separator).
+// 2. Preference path for user data (guaranteed to end with path separator).
+// 3. Number of logical CPU cores.
+// 4. CPU L1 cache line size.
+// 5. Amount of RAM.
+// 6. Support for different kinds of CPU features.
+// ============================================================================
+static void test_system_information()
 {
-    // ========================================================================
-    // SDL allows configuration variables to be used as configuration hints.
-    // They may or may not be supported or applicable on any given platform.
-    // However, they can be used as hints to note how the SDL should behave.
-    //
-    // The full list of hints: https://wiki.libsdl.org/CategoryHints
-    //
-    // Hints can be either provided with normal or priorited way. Prioritized
-    // hints will force the hint to be handled in a desired importance level.
-    //
-    // Note that hint state changes can also be listened with callbacks.
-    // ========================================================================
-    auto hintResult = SDL_SetHint(SDL_HINT_RENDER_DRIVER, "opengl");
-    SDL_Log("[%d] SDL uses OpenGL\n", hintResult);
-
-    // ========================================================================
-    // SDL provides an easy 3-function interface to indicate errors.
-    // Errors are also automatically added by the SDL if SDL functions fail.
-    // ========================================================================
-    SDL_Log("SDL error management testing:\n");
-    SDL_Log("\tInitially: %s\n", SDL_GetError());
-    SDL_SetError("Custom error message!");
-    SDL_Log("\tAfter set: %s\n", SDL_GetError());
-    SDL_ClearError();
-    SDL_Log("\t  Cleared: %s\n", SDL_GetError());
-
-    // ========================================================================
-    // Initialize the SDL along with desired subsystems.
-    // SDL_INIT_TIMER............Include SDL timer support.
-    // SDL_INIT_AUDIO............Include SDL audio (???) support.
-    // SDL_INIT_VIDEO............Include SDL video/graphics support.
-    // SDL_INIT_JOYSTICK.........Include SDL joystick support.
-    // SDL_INIT_HAPTIC...........Include SDL haptic (force feedback) support.
-    // SDL_INIT_GAMECONTROLLER...Include SDL game controller support.
-    // SDL_INIT_EVENTS...........Include SDL event system.
-    // SDL_INIT_EVERYTHING.......Include all SDL subsystems.
-    // 
-    // Some subsystems also automatically imply other subsystems.
-    // SDL_INIT_GAMECONTROLLER...Implies SDL_INIT_JOYSTICK.
-    // SDL_INIT_VIDEO............Implies SDL_INIT_EVENTS.
-    // SDL_INIT_JOYSTICK.........Implies SDL_INIT_EVENTS.
-    //
-    // Definitions can be OR'd together (i.e. SDL_INIT_TIMER | SDL_INIT_AUDIO)
-    // ========================================================================
-    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER) != 0) {
-        SDL_Log("Failed to initialize SDL: %s\n", SDL_GetError());
-        return -1;
-    }
-
-    // ========================================================================
-    // SDL offers a way to check which SDL subsystems has been initialized.
-    // Uses the same macros than what are used with SDL_Init (see above).
-    // 
-    // Definitions can be OR'd together (i.e. SDL_INIT_TIMER | SDL_INIT_AUDIO)
-    // ========================================================================
-    SDL_Log("Initialized SDL subsystems:\n");
-    SDL_Log("[%d] Timer\n", SDL_WasInit(SDL_INIT_TIMER) != 0);
-    SDL_Log("[%d] Audio\n", SDL_WasInit(SDL_INIT_AUDIO) != 0);
-    SDL_Log("[%d] Video\n", SDL_WasInit(SDL_INIT_VIDEO) != 0);
-    SDL_Log("[%d] Joystick\n", SDL_WasInit(SDL_INIT_JOYSTICK) != 0);
-    SDL_Log("[%d] Haptic\n", SDL_WasInit(SDL_INIT_HAPTIC) != 0);
-    SDL_Log("[%d] Game controller\n", SDL_WasInit(SDL_INIT_GAMECONTROLLER) != 0);
-    SDL_Log("[%d] Events\n", SDL_WasInit(SDL_INIT_EVENTS) != 0);
-
-    // ========================================================================
-    // SYSTEM INFORMATION
-    // ========================================================================
-    // SDL is capable to detect various things about the client system.
-    //
-    // 1. Platform name (Windows, Mac OS X, Linux, iOS or Android).
-    // 1. Absolute application path (guaranteed to end with path separator).
-    // 2. Preference path for user data (guaranteed to end with path separator).
-    // 3. Number of logical CPU cores.
-    // 4. CPU L1 cache line size.
-    // 5. Amount of RAM.
-    // 6. Support for different kinds of CPU features.
-    // ========================================================================
+    PROFILE_SCOPE("system information");
     SDL_Log("SDL system information testing:\n");
     auto* basePath = SDL_GetBasePath();
     auto* prefPath = SDL_GetPrefPath("organization_name", "application_name");
@@ -160,31 +223,36 @@ int main(int argc, char* argv[])
     SDL_Log("\t[%d] SSE3\n", SDL_HasSSE3());
     SDL_Log("\t[%d] SSE41\n", SDL_HasSSE41());
     SDL_Log("\t[%d] SSE42\n", SDL_HasSSE42());
+    SDL_Log("\tPixel kernels: %s\n", pixel_kernels().name);
     SDL_free(basePath);
     SDL_free(prefPath);
+}
 
-    // ========================================================================
-    // ASSERTIONS
-    // ========================================================================
-    // SDL contains three (+ disabled) different levels of assertions.
-    // 
-    // SDL_assert_release....A release level assertion.
-    // SDL_assert............A debug level assertion.
-    // SDL_assert_paranoid...A trace level assertion.
-    //
-    // Assertion level is defined by redefining the SDL_ASSERT_LEVEL value.
-    //
-    // 0...Disables all assertions.
-    // 1...Enables SDL_assert_release (default for release).
-    // 2...Enables SDL_assert and SDL_assert_release (default for debug).
-    // 3...Enables SDL_assert_paranoid, SDL_assert and SDL_assert_release.
-    // 
-    // Assertions are being tracked by the SDL. While assertions can be ignored
-    // by continuing the program execution, we are able to get assertion report
-    // from the framework. This report can be used to describe all failures.
-    //
-    // Note that SDL also allows setting a custom assertion handler if desired.
-    // ========================================================================
+// ============================================================================
+// ASSERTIONS
+// ============================================================================
+// SDL contains three (+ disabled) different levels of assertions.
+// 
+// SDL_assert_release....A release level assertion.
+// SDL_assert............A debug level assertion.
+// SDL_assert_paranoid...A trace level assertion.
+//
+// Assertion level is defined by redefining the SDL_ASSERT_LEVEL value.
+//
+// 0...Disables all assertions.
+// 1...Enables SDL_assert_release (default for release).
+// 2...Enables SDL_assert and SDL_assert_release (default for debug).
+// 3...Enables SDL_assert_paranoid, SDL_assert and SDL_assert_release.
+// 
+// Assertions are being tracked by the SDL. While assertions can be ignored
+// by continuing the program execution, we are able to get assertion report
+// from the framework. This report can be used to describe all failures.
+//
+// Note that SDL also allows setting a custom assertion handler if desired.
+// ============================================================================
+static void test_assertions()
+{
+    PROFILE_SCOPE("assertions");
     SDL_assert_release(true == true);
     SDL_assert(true == true);
     SDL_assert_paranoid(true == true);
@@ -199,17 +267,22 @@ int main(int argc, char* argv[])
                 item->always_ignore ? "yes" : "no");
         item = item->next;
     }
+}
 
-    // ========================================================================
-    // TIMERS
-    // ========================================================================
-    // SDL contains a support the following timer features.
-    //
-    // Timer.................Add/remove timer called on a specified interval.
-    // Delay.................Make the current thread to wait for some time.
-    // Performance Counter...A high resolution timer value and frequency.
-    // Ticks.................The number of millis since SDL init.
-    // ========================================================================
+// ============================================================================
+// TIMERS
+// ============================================================================
+// SDL contains a support the following timer features.
+//
+// Timer.................Add/remove timer called on a specified interval.
+//                         (The sandbox uses a TimerWheel instead, see above.)
+// Delay.................Make the current thread to wait for some time.
+// Performance Counter...A high resolution timer value and frequency.
+// Ticks.................The number of millis since SDL init.
+// ============================================================================
+static void test_timers()
+{
+    PROFILE_SCOPE("timers");
     SDL_Log("Testing SDL timer features:\n");
     SDL_Log("\tPerformance counter frequency: %u\n", SDL_GetPerformanceFrequency());
     SDL_Log("\tPerforming a small SDL one second delay and using timers.\n");
@@ -217,86 +290,142 @@ int main(int argc, char* argv[])
     SDL_Delay(1000);
     SDL_Log("\t%04u --- %u\n", SDL_GetTicks(), SDL_GetPerformanceCounter());
 
-    SDL_Log("\tChecking how the SDL periodic timer works.\n");
+    SDL_Log("\tChecking how the periodic timer works.\n");
     SDL_Log("\tCreating a timer with 500 millisecond interval.\n");
-    auto timerId = SDL_AddTimer(500, timer_callback, nullptr);
+    auto timerId = sTimers->schedule(500.0, timer_callback, TimerWheel::EXECUTOR_TIMER, 500.0);
     if (timerId == 0) {
-        SDL_Log("\tUnable to create SDL timer: %s\n", SDL_GetError());
+        SDL_Log("\tUnable to create a timer.\n");
+    }
+
+    // schedule many short timeouts and measure how late they are called.
+    static SDL_atomic_t sFired;
+    static SDL_atomic_t sLateMicros;
+    static SDL_atomic_t sMaxLateMicros;
+    SDL_AtomicSet(&sFired, 0);
+    SDL_AtomicSet(&sLateMicros, 0);
+    SDL_AtomicSet(&sMaxLateMicros, 0);
+    const auto numTimeouts = 2000;
+    for (auto i = 0; i < numTimeouts; i++) {
+        auto delayMs = 0.5 + (i % 200) * 0.25;
+        auto deadline = SDL_GetPerformanceCounter() + Uint64(delayMs * SDL_GetPerformanceFrequency() / 1000.0);
+        sTimers->schedule(delayMs, [deadline]() {
+            auto now = SDL_GetPerformanceCounter();
+            auto late = now > deadline ? int((now - deadline) * 1000000 / SDL_GetPerformanceFrequency()) : 0;
+            SDL_AtomicAdd(&sLateMicros, late);
+            auto previous = SDL_AtomicGet(&sMaxLateMicros);
+            while (late > previous && !SDL_AtomicCAS(&sMaxLateMicros, previous, late)) {
+                previous = SDL_AtomicGet(&sMaxLateMicros);
+            }
+            SDL_AtomicIncRef(&sFired);
+        });
     }
     SDL_Delay(1010);
-    if (SDL_RemoveTimer(timerId) == SDL_FALSE) {
-        SDL_Log("\tSDL was unable to find a timer with id: %d\n", timerId);
+    auto fired = SDL_AtomicGet(&sFired);
+    SDL_Log("\t%d of %d timeouts fired, lateness avg %d us max %d us.\n",
+            fired,
+            numTimeouts,
+            fired > 0 ? SDL_AtomicGet(&sLateMicros) / fired : 0,
+            SDL_AtomicGet(&sMaxLateMicros));
+    if (!sTimers->cancel(timerId)) {
+        SDL_Log("\tUnable to find the periodic timer.\n");
     }
     SDL_Log("\tRemoved the timer.\n");
+}
 
-    // ========================================================================
-    // THREADS
-    // ========================================================================
-    // SDL contains the following inbuilt support for multithreading.
-    //
-    // 1. Threads
-    // 2. Synchronization primitives
-    // 3. Atomic operations
-    //
-    // Thread management contains the following functionality.
-    // 
-    // 1. Thread creation.
-    // 2. Thread waiting.
-    // 3. Thread detaching.
-    // 4. Thread-local storage.
-    // 5. Thread priorities (LOW, NORMAL[default] and HIGH).
-    // 
-    // Synchronization primitives contain the following structures.
-    //
-    // 1. Condition variables
-    // 2. Mutexes
-    // 3. Semaphores
-    //
-    // Atomic operations support the following 
-    // 
-    // !!! IMPORTANT NOTE !!!
-    // Note that window creation, rendering or event receiving cannot be done
-    // in any other thread than within the main thread of the application.
-    // ========================================================================
+// ============================================================================
+// THREADS
+// ============================================================================
+// SDL contains the following inbuilt support for multithreading.
+//
+// 1. Threads
+// 2. Synchronization primitives
+// 3. Atomic operations
+//
+// Thread management contains the following functionality.
+// 
+// 1. Thread creation.
+// 2. Thread waiting.
+// 3. Thread detaching.
+// 4. Thread-local storage.
+// 5. Thread priorities (LOW, NORMAL[default] and HIGH).
+// 
+// Synchronization primitives contain the following structures.
+//
+// 1. Condition variables
+// 2. Mutexes
+// 3. Semaphores
+//
+// Atomic operations support the following 
+// 
+// !!! IMPORTANT NOTE !!!
+// Note that window creation, rendering or event receiving cannot be done
+// in any other thread than within the main thread of the application.
+//
+// Creating a thread per job is expensive for many short jobs. The sandbox
+// uses a persistent thread pool (sized from SDL_GetCPUCount) which offers
+// the following functionality on top of the SDL threading primitives.
+//
+// submit().........Run a job on a pool worker (tracked with a WaitGroup).
+// parallel_for()...Split a range of items into jobs and wait them all.
+// wait()...........Wait for a WaitGroup while helping to run pending jobs.
+// ============================================================================
+static void test_threads()
+{
+    PROFILE_SCOPE("threads");
     SDL_Log("Testing SDL threading features:\n");
+    SDL_Log("\tThread pool has %d workers.\n", sThreadPool->num_workers());
     auto threadDelay = 2000;
-    auto thread1 = SDL_CreateThread(thread_function, "foo-1", &threadDelay);
-    auto thread2 = SDL_CreateThread(thread_function, "foo-2", &threadDelay);
-    auto thread3 = SDL_CreateThread(thread_function, "foo-3", &threadDelay);
+    WaitGroup group;
+    for (auto i = 0; i < 3; i++) {
+        sThreadPool->submit([&threadDelay]() {
+            thread_function(&threadDelay);
+        }, &group);
+    }
+    sThreadPool->wait(group);
+    SDL_Log("\tAll pool jobs have processed their work.\n");
+    SDL_Log("\tThread job counter is now %d.\n", int(sThreadJobs->value()));
 
-    auto threadReturn = 0;
-    SDL_DetachThread(thread1);
-    SDL_WaitThread(thread2, &threadReturn);
-    SDL_WaitThread(thread3, &threadReturn);
-    SDL_Log("\tAll threads have processed their work.\n");
-    SDL_Log("\tAtomic integer is now to %d.\n", SDL_AtomicGet(&sAtomicInt));
+    SDL_atomic_t sum;
+    SDL_AtomicSet(&sum, 0);
+    sThreadPool->parallel_for(0, 1000, 0, [&sum](int begin, int end) {
+        auto local = 0;
+        for (auto i = begin; i < end; i++) {
+            local += i;
+        }
+        SDL_AtomicAdd(&sum, local);
+    });
+    SDL_Log("\tParallel sum of [0, 1000) is %d.\n", SDL_AtomicGet(&sum));
+}
 
-    // ========================================================================
-    // DATA I/O ABSTRACTION
-    // ========================================================================
-    // SDL has a support for data reading and writing from various sources.
-    //
-    // 1. Reading from a read-only memory buffer (const void*).
-    // 2. Reading and writing with a FILE pointer (not available in Windows!).
-    // 3. Reading and writing from a file based on a provided filename.
-    // 4. Reading and writing with a memory buffer (void*).
-    //
-    // All reading and writing does actually use a SDL_RWops structure. It can
-    // be used to perform different kinds of basic file operations including.
-    //
-    // 1. Allocate
-    // 2. Free
-    // 3. Allocate from source (inc. Allocate).
-    // 4. Close (inc. Free).
-    // 5. Read
-    // 6. Seek
-    // 7. Get stream size.
-    // 8. Get current stream pointer location.
-    // 9. Write
-    // 
-    // SDL also contains support for reading and writing individual 1,2,4 and 8
-    // bytes with a byte-order conversion, which ensures byte order correctness.
-    // ========================================================================
+// ============================================================================
+// DATA I/O ABSTRACTION
+// ============================================================================
+// SDL has a support for data reading and writing from various sources.
+//
+// 1. Reading from a read-only memory buffer (const void*).
+// 2. Reading and writing with a FILE pointer (not available in Windows!).
+// 3. Reading and writing from a file based on a provided filename.
+// 4. Reading and writing with a memory buffer (void*).
+//
+// All reading and writing does actually use a SDL_RWops structure. It can
+// be used to perform different kinds of basic file operations including.
+//
+// 1. Allocate
+// 2. Free
+// 3. Allocate from source (inc. Allocate).
+// 4. Close (inc. Free).
+// 5. Read
+// 6. Seek
+// 7. Get stream size.
+// 8. Get current stream pointer location.
+// 9. Write
+// 
+// SDL also contains support for reading and writing individual 1,2,4 and 8
+// bytes with a byte-order conversion, which ensures byte order correctness.
+// ============================================================================
+static void test_data_io()
+{
+    PROFILE_SCOPE("data i/o");
     SDL_Log("Testing SDL data I/O abstraction features:\n");
     char buffer[] = "foo";
     SDL_Log("\tbuffer content before write: %s\n", buffer);
@@ -320,15 +449,61 @@ int main(int argc, char* argv[])
     }
     SDL_Log("\tbuffer content after write: %s\n");
 
-    // ========================================================================
-    // GRAPHICS CARD MANAGEMENT
-    // ========================================================================
-    // SDL is capable to query some very basic information about video drivers.
-    // 
-    // 1. The number of available drivers.
-    // 2. A name for each available driver.
-    // 3. The name of the currently used video driver. 
-    // ========================================================================
+    // write a file into the preferences folder and read it through a mapping.
+    auto prefPath = SDL_GetPrefPath("organization_name", "application_name");
+    if (prefPath == NULL) {
+        SDL_Log("\tFailed to get the preferences path: %s\n", SDL_GetError());
+        return;
+    }
+    char path[1024];
+    SDL_snprintf(path, sizeof(path), "%smapped.bin", prefPath);
+    SDL_free(prefPath);
+    auto file = SDL_RWFromFile(path, "wb");
+    if (file == NULL) {
+        SDL_Log("\tFailed to create the file to map: %s\n", SDL_GetError());
+        return;
+    }
+    for (Uint32 i = 0; i < 1024; i++) {
+        SDL_WriteLE32(file, i);
+    }
+    SDL_RWclose(file);
+
+    auto mapped = rw_from_mapped_file(path);
+    if (mapped == NULL) {
+        SDL_Log("\tFailed to map the file: %s\n", SDL_GetError());
+        return;
+    }
+    Sint64 size = 0;
+    auto bytes = rw_mapped_data(mapped, &size);
+    SDL_RWseek(mapped, -4, RW_SEEK_END);
+    auto last = SDL_ReadLE32(mapped);
+    SDL_Log("\tmapped file: %" SDL_PRIs64 " bytes, first byte: %d, last value: %u\n",
+            size, bytes[0], last);
+    SDL_RWclose(mapped);
+
+    // queue reads which are coalesced and completed later on the main thread.
+    sAsyncIo->prefetch(path, 2048, 2048);
+    for (auto offset = 0; offset < 4096; offset += 1024) {
+        sAsyncIo->read(path, offset, 16, [](const AsyncRead& read) {
+            SDL_Log("\tasync read at %" SDL_PRIs64 ": %d bytes, first value: %u\n",
+                    read.offset, int(read.length),
+                    read.ok ? SDL_SwapLE32(*reinterpret_cast<const Uint32*>(read.data)) : 0);
+        });
+    }
+}
+
+// ============================================================================
+// GRAPHICS CARD MANAGEMENT
+// ============================================================================
+// SDL is capable to query some very basic information about video drivers.
+// 
+// 1. The number of available drivers.
+// 2. A name for each available driver.
+// 3. The name of the currently used video driver. 
+// ============================================================================
+static void test_graphics_cards()
+{
+    PROFILE_SCOPE("graphics cards");
     auto numVideoDrivers = SDL_GetNumVideoDrivers();
     
     SDL_Log("Testing SDL graphics card features:\n");
@@ -337,22 +512,37 @@ int main(int argc, char* argv[])
         SDL_Log("\t\t[%d] driver: %s\n", i, SDL_GetVideoDriver(i));
     }
     SDL_Log("\tCurrent video driver: %s\n", SDL_GetCurrentVideoDriver());
+}
 
-    // ========================================================================
-    // DISPLAY MANAGEMENT
-    // ========================================================================
-    // SDL is capable to query some abstract information about the displays.
-    //
-    // 1. The number of available displays.
-    // 2. The name for each available display.
-    // 3. Diagonal, horizontal and vertical dots-per-inch (DPI).
-    // 4. The currently active display mode.
-    // 5. The currently active OS desktop display mode.
-    // 6. Enumeration of all display modes for a display.
-    // 7. System and usable boundaries for each display.
-    // 8. Finding a closest matching display mode for a provided mode.
-    // ========================================================================
+// ============================================================================
+// DISPLAY MANAGEMENT
+// ============================================================================
+// SDL is capable to query some abstract information about the displays.
+//
+// 1. The number of available displays.
+// 2. The name for each available display.
+// 3. Diagonal, horizontal and vertical dots-per-inch (DPI).
+// 4. The currently active display mode.
+// 5. The currently active OS desktop display mode.
+// 6. Enumeration of all display modes for a display.
+// 7. System and usable boundaries for each display.
+// 8. Finding a closest matching display mode for a provided mode.
+//
+// The display modes are read through a DisplayCache, which keeps the modes
+// in the preferences path and re-enumerates them only when the displays have
+// changed. The best mode lookups are then done without the video driver.
+// ============================================================================
+static void test_displays()
+{
+    PROFILE_SCOPE("display enumeration");
     auto numVideoDisplays = SDL_GetNumVideoDisplays();
+    auto refreshStart = SDL_GetPerformanceCounter();
+    sDisplays = new DisplayCache();
+    sDisplays->refresh();
+    SDL_Log("\tDisplay modes %s in %.2f ms\n",
+            sDisplays->loaded_from_file() ? "loaded from the cache" : "enumerated",
+            (SDL_GetPerformanceCounter() - refreshStart) * 1000.0 /
+            SDL_GetPerformanceFrequency());
 
     SDL_Log("Testing SDL display features:\n");
     SDL_Log("\tNumber of displays: %d\n", numVideoDisplays);
@@ -400,90 +590,89 @@ int main(int argc, char* argv[])
                 rect.w, rect.h);
         }
 
-        auto numDisplayModes = SDL_GetNumDisplayModes(i);
-        SDL_Log("\t\tNumber of display modes: %d\n", numDisplayModes);
-        if (numDisplayModes >= 1) {
-            for (auto j = 0; j < numDisplayModes; j++) {
-                SDL_GetDisplayMode(i, j, &mode);
-                SDL_Log("\t\t\t%d bpp %dx%d %dhz",
-                    SDL_BITSPERPIXEL(mode.format),
-                    mode.w,
-                    mode.h,
-                    mode.refresh_rate);
-            }
+        SDL_Log("\t\tNumber of display modes: %d\n", sDisplays->num_modes(i));
+        if (sDisplays->best_mode(i, 800, 600, 60, &mode)) {
+            SDL_Log("\t\tBest mode for 800x600 60hz: %d bpp %dx%d %dhz",
+                SDL_BITSPERPIXEL(mode.format),
+                mode.w,
+                mode.h,
+                mode.refresh_rate);
         }
-
     }
+}
 
-    // ========================================================================
-    // WINDOW MANAGEMENT
-    // ========================================================================
-    // SDL uses an own abstraction layout on top of the traditional OS window
-    // handles. The framework provides three functions to create new windows.
-    // 
-    // SDL_CreateWindow..............Builds a SDL window.
-    // SDL_CreateWindowAndRenderer...Builds a SDL window and default renderer.
-    // SDL_CreateWindowFrom..........Builds a SDL window from a native window.
-    //
-    // SDL allows the usage of window construction flags when building a window
-    // from scratch (not from native window). Here is a list of those flags.
-    //
-    // SDL_WINDOW_FULLSCREEN...........Fullscreen window.
-    // SDL_WINDOW_FULLSCREEN_DESKTOP...Fullscreen window with desktop resolution.
-    // SDL_WINDOW_OPENGL...............OpenGL context supported window.
-    // SDL_WINDOW_HIDDEN...............Window which is not visible.
-    // SDL_WINDOW_BORDERLESS...........Window without decorations.
-    // SDL_WINDOW_RESIZABLE............Window that can be resized.
-    // SDL_WINDOW_MINIMIZED............Window that is minimized.
-    // SDL_WINDOW_MAXIMIZED............Window that is maximized.
-    // SDL_WINDOW_INPUT_GRABBED........Window that has grabbed input focus.
-    // SDL_WINDOW_ALLOW_HIGHDPI........Window with high-DPI mode (if supported)
-    //
-    // There are also some additional window flags that can be used when doing
-    // a query for the current state of the SDL window. See the following list.
-    //
-    // SDL_WINDOW_SHOWN...........Window is visible.
-    // SDL_WINDOW_INPUT_FOCUS.....Window has focus.
-    // SDL_WINDOW_MOUSE_FOCUS.....Window has mouse focus.
-    // SDL_WINDOW_FOREIGN.........Window is not created by SDL.
-    // SDL_WINDOW_MOUSE_CAPTURE...Window has mouse captured.
-    // SDL_WINDOW_ALWAYS_ON_TOP...[X11] Window is always top on others.
-    // SDL_WINDOW_SKIP_TASKBAR....[X11] Window is not in taskbar.
-    // SDL_WINDOW_UTILITY.........[X11] Window is an utility window.
-    // SDL_WINDOW_TOOLTIP.........[X11] Window is a tooltip.
-    // SDL_WINDOW_POPUP_MENU......[X11] Window is a popup menu.
-    //
-    // In addition to previously mentioned window flags, SDL provides a way to
-    // define and query some following special management for each SDL window.
-    //
-    // * Visibility
-    // * Borders
-    // * Window owner display brightness (gamma).
-    // * An arbitary named pointer with window.
-    // * A fullscreen window display mode.
-    // * A window fullscreen mode (real / desktop / none).
-    // * The gamma ramp for the window owner display.
-    // * Grap input to target window.
-    // * Callbacks to define window special properties.
-    // * Window icon from a SDL_Surface.
-    // * Input focus state of a window.
-    // * The maximum size of the window.
-    // * The minimum size for the window.
-    // * The parent window for a window to act modal.
-    // * The opacity of the window (directFB, X11, Cocoa, Windows).
-    // * The position for the window.
-    // * Whether a user is able to resize the window.
-    // * The size of the window client area.
-    // * The title of the window.
-    // * Set window on top of other windows.
-    // * Get the numeric ID of the window (for logging purposes).
-    // * Get the index of the parent display of the window.
-    // * An ability to update fully/partially the window surface on the screen.
-    // 
-    // SDL also contains a way to toggle the screensaver state for the duration
-    // of the application execution and also provides a way to show small info
-    // message boxes that can contain informative messages for the users.
-    // ========================================================================
+// ============================================================================
+// WINDOW MANAGEMENT
+// ============================================================================
+// SDL uses an own abstraction layout on top of the traditional OS window
+// handles. The framework provides three functions to create new windows.
+// 
+// SDL_CreateWindow..............Builds a SDL window.
+// SDL_CreateWindowAndRenderer...Builds a SDL window and default renderer.
+// SDL_CreateWindowFrom..........Builds a SDL window from a native window.
+//
+// SDL allows the usage of window construction flags when building a window
+// from scratch (not from native window). Here is a list of those flags.
+//
+// SDL_WINDOW_FULLSCREEN...........Fullscreen window.
+// SDL_WINDOW_FULLSCREEN_DESKTOP...Fullscreen window with desktop resolution.
+// SDL_WINDOW_OPENGL...............OpenGL context supported window.
+// SDL_WINDOW_HIDDEN...............Window which is not visible.
+// SDL_WINDOW_BORDERLESS...........Window without decorations.
+// SDL_WINDOW_RESIZABLE............Window that can be resized.
+// SDL_WINDOW_MINIMIZED............Window that is minimized.
+// SDL_WINDOW_MAXIMIZED............Window that is maximized.
+// SDL_WINDOW_INPUT_GRABBED........Window that has grabbed input focus.
+// SDL_WINDOW_ALLOW_HIGHDPI........Window with high-DPI mode (if supported)
+//
+// There are also some additional window flags that can be used when doing
+// a query for the current state of the SDL window. See the following list.
+//
+// SDL_WINDOW_SHOWN...........Window is visible.
+// SDL_WINDOW_INPUT_FOCUS.....Window has focus.
+// SDL_WINDOW_MOUSE_FOCUS.....Window has mouse focus.
+// SDL_WINDOW_FOREIGN.........Window is not created by SDL.
+// SDL_WINDOW_MOUSE_CAPTURE...Window has mouse captured.
+// SDL_WINDOW_ALWAYS_ON_TOP...[X11] Window is always top on others.
+// SDL_WINDOW_SKIP_TASKBAR....[X11] Window is not in taskbar.
+// SDL_WINDOW_UTILITY.........[X11] Window is an utility window.
+// SDL_WINDOW_TOOLTIP.........[X11] Window is a tooltip.
+// SDL_WINDOW_POPUP_MENU......[X11] Window is a popup menu.
+//
+// In addition to previously mentioned window flags, SDL provides a way to
+// define and query some following special management for each SDL window.
+//
+// * Visibility
+// * Borders
+// * Window owner display brightness (gamma).
+// * An arbitary named pointer with window.
+// * A fullscreen window display mode.
+// * A window fullscreen mode (real / desktop / none).
+// * The gamma ramp for the window owner display.
+// * Grap input to target window.
+// * Callbacks to define window special properties.
+// * Window icon from a SDL_Surface.
+// * Input focus state of a window.
+// * The maximum size of the window.
+// * The minimum size for the window.
+// * The parent window for a window to act modal.
+// * The opacity of the window (directFB, X11, Cocoa, Windows).
+// * The position for the window.
+// * Whether a user is able to resize the window.
+// * The size of the window client area.
+// * The title of the window.
+// * Set window on top of other windows.
+// * Get the numeric ID of the window (for logging purposes).
+// * Get the index of the parent display of the window.
+// * An ability to update fully/partially the window surface on the screen.
+// 
+// SDL also contains a way to toggle the screensaver state for the duration
+// of the application execution and also provides a way to show small info
+// message boxes that can contain informative messages for the users.
+// ============================================================================
+static SDL_Window* create_window()
+{
+    PROFILE_SCOPE("window creation");
     SDL_Log("Testing SDL window management features:\n");
     
     // construct a new SDL window with the name, position, size and flags.
@@ -500,27 +689,222 @@ int main(int argc, char* argv[])
 
     // enable to show a super simple message box to user.
     // SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "Foo!", "Bar!", window);
+    return window;
+}
 
-    // ========================================================================
-    // RECTANGLES AND POINTS
-    // ========================================================================
-    // SDL contains a support for two kinds of geometric primitives.
-    //
-    // 1. SDL_Point......A two-dimensional point used also to define a size.
-    // 2. SDL_Rect.......A two-dimensional definition of a rectangle.
-    //
-    // SDL has a in-built support for some minor functions that can be used to 
-    // perform some basic tasks. See the following list of functions.
-    //
-    // 1. Calculate the minimumal rectangle that encloses the set of points.
-    // 2. Check whether two rectangles intersect.
-    // 3. Calculate the intersection rectangle between two intersecting rects.
-    // 4. Calculate the intersection point between a line and a rectangle.
-    // 5. Check whether the given point resides inside a rectangle.
-    // 6. Check whether the given rectangle has not area.
-    // 7. Equality of two rectangles.
-    // 8. Union of two rectangles.
-    // ========================================================================
+// ============================================================================
+// The window surface is drawn as a mostly static screen where only a small
+// indicator moves. The WindowPresenter sends only the damaged areas of the
+// surface to the screen with SDL_UpdateWindowSurfaceRects.
+// ============================================================================
+static void animate_window(WindowPresenter* presenter)
+{
+    static SDL_Rect sIndicator = {0, 0, 0, 0};
+    auto surface = presenter->surface();
+    if (surface == NULL) {
+        return;
+    }
+    auto background = SDL_MapRGB(surface->format, 32, 32, 48);
+    auto foreground = SDL_MapRGB(surface->format, 224, 160, 32);
+    // a new surface (e.g. after a resize) has undefined contents.
+    if (SDL_RectEmpty(&sIndicator) || presenter->surface_changed()) {
+        SDL_FillRect(surface, NULL, background);
+        presenter->invalidate_all();
+    } else {
+        SDL_FillRect(surface, &sIndicator, background);
+        presenter->invalidate(sIndicator);
+    }
+    auto range = SDL_max(surface->w - 32, 1);
+    sIndicator.x = int(SDL_GetTicks() / 10 % Uint32(range));
+    sIndicator.y = surface->h / 2 - 16;
+    sIndicator.w = 32;
+    sIndicator.h = 32;
+    SDL_FillRect(surface, &sIndicator, foreground);
+    presenter->invalidate(sIndicator);
+}
+
+// ============================================================================
+// With --present=renderer the window is drawn with an SDL_Renderer instead.
+// The sprite images are packed into the pages of a texture atlas and drawn
+// through a sprite batch, which sorts the draws to minimize texture binds.
+// ============================================================================
+static bool create_sprites(SDL_Window* window)
+{
+    sRenderer = SDL_CreateRenderer(window, -1, 0);
+    if (sRenderer == NULL) {
+        SDL_Log("Failed to create a renderer: %s\n", SDL_GetError());
+        return false;
+    }
+    sAtlas = new TextureAtlas(sRenderer, 256);
+    for (auto i = 0; i < 64; i++) {
+        auto size = 8 + (i * 7) % 40;
+        auto surface = SDL_CreateRGBSurfaceWithFormat(0, size, size, 32, SDL_PIXELFORMAT_ARGB8888);
+        if (surface == NULL) {
+            SDL_Log("Failed to create a sprite surface: %s\n", SDL_GetError());
+            continue;
+        }
+        auto color = SDL_MapRGB(surface->format, Uint8(i * 37), Uint8(i * 91), Uint8(255 - i * 13));
+        SDL_FillRect(surface, NULL, color);
+        AtlasRegion region;
+        if (sAtlas->add(surface, &region)) {
+            sSpriteRegions.push_back(region);
+        } else {
+            SDL_Log("Failed to add a sprite into the atlas: %s\n", SDL_GetError());
+        }
+        SDL_FreeSurface(surface);
+    }
+    for (auto i = 0; i < sAtlas->num_pages(); i++) {
+        SDL_Log("\tAtlas page %d occupancy: %.1f%%\n", i, sAtlas->occupancy(i) * 100.0);
+    }
+    sSprites = new SpriteBatch(sRenderer);
+    sSprites->add_counters();
+    return true;
+}
+
+// the target for drawing below the output resolution or NULL for the output.
+static SDL_Texture* scaled_target(int width, int height)
+{
+    SDL_RendererInfo info;
+    if (sRenderScale >= 1.0f || SDL_GetRendererInfo(sRenderer, &info) != 0
+        || (info.flags & SDL_RENDERER_TARGETTEXTURE) == 0) {
+        return NULL;
+    }
+    auto targetWidth = SDL_max(int(width * sRenderScale), 1);
+    auto targetHeight = SDL_max(int(height * sRenderScale), 1);
+    int currentWidth = 0;
+    int currentHeight = 0;
+    if (sScaledTarget != NULL) {
+        SDL_QueryTexture(sScaledTarget, NULL, NULL, &currentWidth, &currentHeight);
+    }
+    if (currentWidth != targetWidth || currentHeight != targetHeight) {
+        if (sScaledTarget != NULL) {
+            SDL_DestroyTexture(sScaledTarget);
+        }
+        sScaledTarget = SDL_CreateTexture(sRenderer,
+                                          SDL_PIXELFORMAT_ARGB8888,
+                                          SDL_TEXTUREACCESS_TARGET,
+                                          targetWidth,
+                                          targetHeight);
+        if (sScaledTarget == NULL) {
+            SDL_Log("Failed to create the scaled render target: %s\n", SDL_GetError());
+        }
+    }
+    return sScaledTarget;
+}
+
+static void animate_sprites()
+{
+    int width = 0;
+    int height = 0;
+    SDL_GetRendererOutputSize(sRenderer, &width, &height);
+    auto ticks = SDL_GetTicks();
+
+    // the frame is drawn with window coordinates and scaled into the target.
+    auto target = scaled_target(width, height);
+    if (target != NULL) {
+        SDL_SetRenderTarget(sRenderer, target);
+        SDL_RenderSetScale(sRenderer, sRenderScale, sRenderScale);
+    }
+    SDL_SetRenderDrawColor(sRenderer, 32, 32, 48, 255);
+    SDL_RenderClear(sRenderer);
+    sSprites->begin();
+    for (auto i = 0; i < 1024 && !sSpriteRegions.empty(); i++) {
+        const auto& region = sSpriteRegions[i % sSpriteRegions.size()];
+        auto rangeX = Uint32(SDL_max(width - region.rect.w, 1));
+        auto rangeY = Uint32(SDL_max(height - region.rect.h, 1));
+        SDL_Rect dst = {
+            int((Uint32(i) * 7919u + ticks / 8) % rangeX),
+            int((Uint32(i) * 104729u + ticks / 16) % rangeY),
+            region.rect.w,
+            region.rect.h
+        };
+        sSprites->draw(region, dst, i % 4);
+    }
+    sSprites->end();
+    if (sPlugins != NULL) {
+        sPlugins->render(sRenderer);
+    }
+    if (target != NULL) {
+        // the output target restores its own scale of 1.0.
+        SDL_SetRenderTarget(sRenderer, NULL);
+        SDL_RenderCopy(sRenderer, target, NULL, NULL);
+    }
+}
+
+static void apply_power_settings(MainLoop& loop)
+{
+    const auto& settings = sPower->settings();
+    loop.set_update_rate(settings.updateRate);
+    sThreadPool->set_active_workers(settings.workers);
+    sRenderScale = settings.renderScale;
+}
+
+// ============================================================================
+// The game controllers and their haptic devices are opened after the first
+// frame has been shown, as enumerating the devices can take a long time. With
+// --prewarm the subsystems are initialized on the prewarm thread and the main
+// thread opens the controllers only after it has finished (subsystems.h). By
+// default they are initialized on the main thread, as SDL documents it.
+// ============================================================================
+static const Uint32 CONTROLLER_SUBSYSTEMS = SDL_INIT_GAMECONTROLLER | SDL_INIT_HAPTIC;
+
+static void attach_haptics()
+{
+    for (auto i = 0; i < sControllers->count(); i++) {
+        sHaptics->attach(sControllers->instance_id(i), sControllers->joystick(i));
+    }
+}
+
+static void update_controllers()
+{
+    if (sControllers == NULL) {
+        if (Subsystems::instance().prewarming()) {
+            return;
+        }
+        sControllers = new ControllerSet();
+        sHaptics = new HapticManager();
+        sHaptics->add_counters();
+        attach_haptics();
+    }
+    sControllers->update();
+    for (auto i = 0; i < sControllers->count(); i++) {
+        if (sControllers->pressed()[i] != 0) {
+            SDL_Log("Controller %d pressed buttons 0x%04x\n",
+                    sControllers->instance_id(i),
+                    sControllers->pressed()[i]);
+            sHaptics->rumble(sControllers->instance_id(i), 0, 0.5f, 100);
+        }
+    }
+    sHaptics->flush();
+}
+
+// ============================================================================
+// RECTANGLES AND POINTS
+// ============================================================================
+// SDL contains a support for two kinds of geometric primitives.
+//
+// 1. SDL_Point......A two-dimensional point used also to define a size.
+// 2. SDL_Rect.......A two-dimensional definition of a rectangle.
+//
+// SDL has a in-built support for some minor functions that can be used to 
+// perform some basic tasks. See the following list of functions.
+//
+// 1. Calculate the minimumal rectangle that encloses the set of points.
+// 2. Check whether two rectangles intersect.
+// 3. Calculate the intersection rectangle between two intersecting rects.
+// 4. Calculate the intersection point between a line and a rectangle.
+// 5. Check whether the given point resides inside a rectangle.
+// 6. Check whether the given rectangle has not area.
+// 7. Equality of two rectangles.
+// 8. Union of two rectangles.
+//
+// The RectBatch runs the same tests over whole arrays of rectangles at once.
+// The SpatialGrid (dynamic) and RectBvh (static) answer the queries without
+// testing every pair of rectangles.
+// ============================================================================
+static void test_rects()
+{
+    PROFILE_SCOPE("rectangles and points");
     SDL_Log("Testing SDL rect features:\n");
     SDL_Rect rect1 = {100, 200, 300, 400};
     SDL_Rect rect2 = {200, 100, 300, 400};
@@ -530,6 +914,340 @@ int main(int argc, char* argv[])
     SDL_UnionRect(&rect1, &rect2, &rect3);
     SDL_Log("\t\tunion: x=%d y=%d w=%d h=%d\n", rect3.x, rect3.y, rect3.w, rect3.h);
 
+    RectBatch batch;
+    batch.add(rect1);
+    batch.add(rect2);
+    batch.add(rect3);
+    SDL_Rect query = {150, 150, 10, 10};
+    SDL_Point point = {450, 250};
+    int hits[3];
+    SDL_Rect bounds;
+    batch.bounds(&bounds);
+    SDL_Log("\tbatch (%s kernels):\n", rect_kernels_name());
+    SDL_Log("\t\trects intersecting the query: %d\n", batch.intersect(query, hits));
+    SDL_Log("\t\trects containing the point: %d\n", batch.contains_point(point, hits));
+    SDL_Log("\t\tbounds: x=%d y=%d w=%d h=%d\n", bounds.x, bounds.y, bounds.w, bounds.h);
+
+    SpatialGrid grid(128);
+    grid.insert(rect1);
+    auto moving = grid.insert(rect2);
+    std::vector<OverlapPair> pairs;
+    grid.overlap_pairs(&pairs);
+    SDL_Log("\tgrid: %d overlapping pairs\n", int(pairs.size()));
+    SDL_Rect moved = {1000, 1000, 300, 400};
+    grid.update(moving, moved);
+    pairs.clear();
+    grid.overlap_pairs(&pairs);
+    SDL_Log("\tgrid after a move: %d overlapping pairs\n", int(pairs.size()));
+    SDL_Rect level[] = {rect1, rect2, rect3, moved};
+    RectBvh bvh;
+    bvh.build(level, SDL_arraysize(level));
+    std::vector<int> found;
+    bvh.query_point(point, &found);
+    SDL_Log("\tbvh: %d rects contain the point\n", int(found.size()));
+}
+
+static Sint64 stream_underruns(void* data)
+{
+    return static_cast<StreamingTrack*>(data)->underruns();
+}
+
+int main(int argc, char* argv[])
+{
+    auto mainStart = SDL_GetPerformanceCounter();
+
+    // ========================================================================
+    // Parse the command line arguments.
+    // --loop=blocking...Sleep in SDL_WaitEventTimeout until events arrive.
+    // --loop=fixed......Update on a fixed timestep with a frame budget.
+    // --rate=HZ.........The fixed timestep rate (default: the display rate).
+    // --profile=FILE....Write the profiler report as CSV into the FILE.
+    // --bench=NAME......Run the named benchmark instead of the sandbox.
+    // --alloc=system....Keep the default SDL memory functions (see ALLOCATOR).
+    // --log=FILE........Also write the log into the FILE (see LOGGING).
+    // --audio[=FRAMES]..Open the audio device with a buffer of FRAMES.
+    // --music=FILE......Stream a WAV file as looping music (with --audio).
+    // --plugin=FILE.....Load a plugin module and reload it when it changes.
+    // --power=POLICY....performance, balanced (default) or battery (see POWER).
+    // --prewarm.........Initialize the controllers on a background thread.
+    // --reprobe.........Benchmark the render drivers again (with the renderer).
+    // --present=renderer..Draw sprites with an SDL_Renderer instead of the
+    //                     window surface (the two cannot be mixed).
+    // ========================================================================
+    auto loopConfig = MainLoop::default_config();
+    const char* profilePath = NULL;
+    const char* benchmark = NULL;
+    const char* logPath = NULL;
+    const char* musicPath = NULL;
+    std::vector<const char*> pluginPaths;
+    auto poolAllocator = true;
+    auto useRenderer = false;
+    auto rateGiven = false;
+    auto useAudio = false;
+    auto prewarm = false;
+    auto reprobe = false;
+    auto audioConfig = AudioEngine::default_config();
+    auto powerPolicy = POWER_POLICY_BALANCED;
+    for (auto i = 1; i < argc; i++) {
+        if (SDL_strncmp(argv[i], "--loop=", 7) == 0) {
+            if (!MainLoop::parse_mode(argv[i] + 7, &loopConfig.mode)) {
+                SDL_Log("Unknown loop mode: %s\n", argv[i] + 7);
+                return -1;
+            }
+        } else if (SDL_strncmp(argv[i], "--rate=", 7) == 0) {
+            loopConfig.updateRate = SDL_max(SDL_atoi(argv[i] + 7), 1);
+            rateGiven = true;
+        } else if (SDL_strncmp(argv[i], "--profile=", 10) == 0) {
+            profilePath = argv[i] + 10;
+        } else if (SDL_strncmp(argv[i], "--log=", 6) == 0) {
+            logPath = argv[i] + 6;
+        } else if (SDL_strncmp(argv[i], "--music=", 8) == 0) {
+            musicPath = argv[i] + 8;
+        } else if (SDL_strncmp(argv[i], "--plugin=", 9) == 0) {
+            pluginPaths.push_back(argv[i] + 9);
+        } else if (SDL_strncmp(argv[i], "--power=", 8) == 0) {
+            if (!PowerGovernor::parse_policy(argv[i] + 8, &powerPolicy)) {
+                SDL_Log("Unknown power policy: %s\n", argv[i] + 8);
+                return -1;
+            }
+        } else if (SDL_strncmp(argv[i], "--bench=", 8) == 0) {
+            benchmark = argv[i] + 8;
+        } else if (SDL_strcmp(argv[i], "--alloc=system") == 0) {
+            poolAllocator = false;
+        } else if (SDL_strcmp(argv[i], "--present=renderer") == 0) {
+            useRenderer = true;
+        } else if (SDL_strcmp(argv[i], "--prewarm") == 0) {
+            prewarm = true;
+        } else if (SDL_strcmp(argv[i], "--reprobe") == 0) {
+            reprobe = true;
+        } else if (SDL_strncmp(argv[i], "--audio", 7) == 0) {
+            if (argv[i][7] != '\0' && argv[i][7] != '=') {
+                SDL_Log("Unknown option: %s\n", argv[i]);
+                return -1;
+            }
+            useAudio = true;
+            if (argv[i][7] == '=') {
+                audioConfig.samples = Uint16(SDL_max(SDL_min(SDL_atoi(argv[i] + 8), 8192), 16));
+            }
+        }
+    }
+
+    // ========================================================================
+    // ALLOCATOR
+    // ========================================================================
+    // SDL allows its memory functions (SDL_malloc, SDL_calloc, SDL_realloc
+    // and SDL_free) to be replaced with SDL_SetMemoryFunctions. Replacing is
+    // done before SDL allocates anything, and the allocator forwards memory
+    // of the old functions (e.g. from static constructors) back to them.
+    //
+    // The sandbox uses size-class pools for small allocations and reports the
+    // allocation statistics (including the per-frame churn) as gauges.
+    // ========================================================================
+    if (poolAllocator && Allocator::instance().install()) {
+        Allocator::instance().add_gauges();
+    }
+
+    // ========================================================================
+    // LOGGING
+    // ========================================================================
+    // SDL_Log writes the message on the calling thread by default. The output
+    // function can be replaced with SDL_LogSetOutputFunction, which is used
+    // here to move the writing into a background thread, so that a slow
+    // terminal or disk does not stall the frame loop.
+    // ========================================================================
+    sLog = new AsyncLog(logPath);
+    CounterRegistry::instance().add_counter("log records", &sLog->records());
+    CounterRegistry::instance().add_counter("log dropped", &sLog->dropped());
+    CounterRegistry::instance().add_counter("log sampled", &sLog->sampled());
+
+    // ========================================================================
+    // SDL provides an easy 3-function interface to indicate errors.
+    // Errors are also automatically added by the SDL if SDL functions fail.
+    // ========================================================================
+    SDL_Log("SDL error management testing:\n");
+    SDL_Log("\tInitially: %s\n", SDL_GetError());
+    SDL_SetError("Custom error message!");
+    SDL_Log("\tAfter set: %s\n", SDL_GetError());
+    SDL_ClearError();
+    SDL_Log("\t  Cleared: %s\n", SDL_GetError());
+
+    // ========================================================================
+    // Initialize the SDL along with desired subsystems.
+    // SDL_INIT_TIMER............Include SDL timer support.
+    // SDL_INIT_AUDIO............Include SDL audio (???) support.
+    // SDL_INIT_VIDEO............Include SDL video/graphics support.
+    // SDL_INIT_JOYSTICK.........Include SDL joystick support.
+    // SDL_INIT_HAPTIC...........Include SDL haptic (force feedback) support.
+    // SDL_INIT_GAMECONTROLLER...Include SDL game controller support.
+    // SDL_INIT_EVENTS...........Include SDL event system.
+    // SDL_INIT_EVERYTHING.......Include all SDL subsystems.
+    // 
+    // Some subsystems also automatically imply other subsystems.
+    // SDL_INIT_GAMECONTROLLER...Implies SDL_INIT_JOYSTICK.
+    // SDL_INIT_VIDEO............Implies SDL_INIT_EVENTS.
+    // SDL_INIT_JOYSTICK.........Implies SDL_INIT_EVENTS.
+    //
+    // Definitions can be OR'd together (i.e. SDL_INIT_TIMER | SDL_INIT_AUDIO)
+    //
+    // Only the video is initialized at the start. The other subsystems are
+    // initialized on their first use, which also measures how long each one
+    // takes (subsystems.h). The timers of the sandbox use the timer wheel, so
+    // the SDL timer subsystem is not needed at all.
+    // ========================================================================
+    if (SDL_Init(0) != 0 || !Subsystems::instance().require(SDL_INIT_VIDEO)) {
+        SDL_Log("Failed to initialize SDL: %s\n", SDL_GetError());
+        delete sLog;
+        return -1;
+    }
+
+    if (benchmark != NULL) {
+        auto result = run_benchmark(benchmark) ? 0 : -1;
+        CounterRegistry::instance().remove("log records");
+        CounterRegistry::instance().remove("log dropped");
+        CounterRegistry::instance().remove("log sampled");
+        delete sLog;
+        sLog = NULL;
+        SDL_Quit();
+        return result;
+    }
+
+    // ========================================================================
+    // SDL allows configuration variables to be used as configuration hints.
+    // They may or may not be supported or applicable on any given platform.
+    // However, they can be used as hints to note how the SDL should behave.
+    //
+    // The full list of hints: https://wiki.libsdl.org/CategoryHints
+    //
+    // Hints can be either provided with normal or priorited way. Prioritized
+    // hints will force the hint to be handled in a desired importance level.
+    //
+    // Note that hint state changes can also be listened with callbacks.
+    //
+    // The render driver hints are not hard-coded but measured: the first run
+    // with --present=renderer benchmarks the render drivers in a hidden window
+    // and stores the fastest one with its hints into a profile, which is then
+    // applied on the later runs (render_profile.h). --reprobe measures again.
+    // ========================================================================
+    if (useRenderer) {
+        RenderProfile renderProfile;
+        if (renderProfile.select(reprobe)) {
+            renderProfile.apply();
+        }
+    }
+    auto renderDriver = SDL_GetHint(SDL_HINT_RENDER_DRIVER);
+    SDL_Log("SDL render driver hint: %s\n", renderDriver != NULL ? renderDriver : "(default)");
+
+    // ========================================================================
+    // AUDIO
+    // ========================================================================
+    // The audio subsystem is only opened with the --audio option, as the
+    // device keeps the audio thread busy for as long as it is open. A small
+    // buffer has a low latency but underruns more easily, so the buffer size
+    // can be tuned with --audio=FRAMES while watching the underrun counter.
+    //
+    // The --music=FILE is streamed in chunks through the async I/O and decoded
+    // on the thread pool (audio_stream.h), so it starts after those exist.
+    // ========================================================================
+    if (useAudio) {
+        sAudio = new AudioEngine(audioConfig);
+        if (sAudio->open()) {
+            sAudio->add_counters();
+        } else {
+            delete sAudio;
+            sAudio = NULL;
+        }
+    }
+
+    // ========================================================================
+    // SDL offers a way to check which SDL subsystems has been initialized.
+    // Uses the same macros than what are used with SDL_Init (see above).
+    // 
+    // Definitions can be OR'd together (i.e. SDL_INIT_TIMER | SDL_INIT_AUDIO)
+    //
+    // The report uses SDL_WasInit(SDL_INIT_AUDIO) etc. for each subsystem.
+    // ========================================================================
+    SDL_Log("Initialized SDL subsystems:\n");
+    Subsystems::instance().log_report();
+
+    // ========================================================================
+    // STARTUP
+    // ========================================================================
+    // The demo sections are run as a graph of startup tasks. Independent tasks
+    // are run at the same time on the worker threads, so the slow timer and
+    // thread tests do not delay the window creation on the main thread.
+    //
+    // Display enumeration is run on the main thread after the window has been
+    // created, as it queries the windowing system for the display modes.
+    // ========================================================================
+    sThreadJobs = new ShardedCounter();
+    CounterRegistry::instance().add_counter("thread jobs", sThreadJobs);
+    sThreadPool = new ThreadPool(SDL_GetCPUCount());
+    sThreadResults = new MpscQueue<ThreadResult>(64);
+    sAsyncIo = new AsyncIo();
+    CounterRegistry::instance().add_counter("io requests", &sAsyncIo->requests());
+    CounterRegistry::instance().add_counter("io file reads", &sAsyncIo->file_reads());
+    CounterRegistry::instance().add_counter("io cache hits", &sAsyncIo->cache_hits());
+    sTimers = new TimerWheel(sThreadPool);
+    CounterRegistry::instance().add_counter("timers scheduled", &sTimers->scheduled());
+    CounterRegistry::instance().add_counter("timers expired", &sTimers->expired());
+
+    if (sAudio != NULL && musicPath != NULL) {
+        sMusic = new StreamingTrack(sAsyncIo, sThreadPool, musicPath, sAudio->spec().freq, true);
+        CounterRegistry::instance().add_gauge("stream underruns", stream_underruns, sMusic);
+        CounterRegistry::instance().add_counter("stream chunks", &sMusic->chunks());
+        if (sMusic->open()) {
+            sAudio->play_stream(sMusic, 0.5f);
+        }
+    }
+
+    // ========================================================================
+    // SHARED OBJECTS
+    // ========================================================================
+    // SDL loads shared objects (.so, .dll or .dylib) with SDL_LoadObject and
+    // finds their functions with SDL_LoadFunction. The --plugin=FILE modules
+    // are reloaded between the frames when their files change (see the file
+    // plugin_host.h), e.g. after the sandbox_example_plugin has been rebuilt.
+    // ========================================================================
+    if (!pluginPaths.empty()) {
+        sPlugins = new PluginHost();
+        sPlugins->add_counters();
+        for (auto path : pluginPaths) {
+            sPlugins->load(path);
+        }
+    }
+
+    SDL_Window* window = NULL;
+    StartupScheduler startup;
+    auto windowTask = startup.add("window creation", [&window, mainStart, useRenderer]() {
+        window = create_window();
+        SDL_Log("Time to first window: %.2f ms\n",
+                (SDL_GetPerformanceCounter() - mainStart) * 1000.0 /
+                SDL_GetPerformanceFrequency());
+        if (window != NULL && useRenderer) {
+            create_sprites(window);
+        } else if (window != NULL) {
+            sPresenter = new WindowPresenter(window);
+            CounterRegistry::instance().add_counter("present pixels", &sPresenter->presented_pixels());
+            CounterRegistry::instance().add_counter("present partial", &sPresenter->partial_updates());
+            CounterRegistry::instance().add_counter("present full", &sPresenter->full_updates());
+        }
+    }, {}, StartupScheduler::AFFINITY_MAIN);
+    auto graphicsTask = startup.add("graphics cards", test_graphics_cards);
+    startup.add("display enumeration", test_displays,
+                {windowTask, graphicsTask},
+                StartupScheduler::AFFINITY_MAIN);
+    startup.add("system information", test_system_information);
+    startup.add("assertions", test_assertions);
+    startup.add("data i/o", test_data_io);
+    startup.add("rectangles and points", test_rects);
+    startup.add("timers", test_timers);
+    startup.add("threads", test_threads);
+    if (sAudio != NULL) {
+        startup.add("audio", test_audio);
+    }
+    startup.start(*sThreadPool);
+    startup.run_main_task();
+
     // ========================================================================
     // EVENTS
     // ========================================================================
@@ -549,21 +1267,235 @@ int main(int argc, char* argv[])
     // Note that SDL can be set to ignore (i.e. disable) unwanted event types.
     //
     // Events can be also filtered/handled from the queue with custom filters.
+    // The sandbox uses a filter to coalesce the bursts of motion events and a
+    // dispatch table to route the events to the handlers (event_pipeline.h).
+    //
+    // The main loop sleeps between the events instead of spinning on polling.
+    // Mode can be selected with the --loop=blocking|fixed command line option.
+    // The fixed timestep follows the refresh rate of the display of the window
+    // unless the rate is given with the --rate=HZ command line option.
+    //
+    // The input state is sampled at 1000 Hz while the loop waits for the next
+    // frame, and the update reads the latest snapshot (input_sampler.h).
+    //
+    // The game controllers are polled once per update into arrays instead of
+    // handling their axis and button events (controllers.h). The rumble of a
+    // controller is done on the haptics thread (haptics.h). The controllers
+    // are opened after the first frame (see update_controllers).
     // ========================================================================
     SDL_EventState(SDL_MOUSEBUTTONDOWN, SDL_IGNORE);
     SDL_EventState(SDL_MOUSEBUTTONUP, SDL_IGNORE);
 
-    auto running = true;
-    while (running) {
-        SDL_Event event;
-        while (SDL_PollEvent(&event)) {
-            switch (event.type) {
-                case SDL_QUIT:
-                    running = false;
-                    break;
+    if (!rateGiven) {
+        loopConfig.updateRate = FramePacer::display_rate(window, loopConfig.updateRate);
+    }
+
+    // the handlers are routed by the event type through the event pipeline.
+    MainLoop loop(loopConfig);
+    sEvents = new EventPipeline();
+    CounterRegistry::instance().add_counter("events dispatched", &sEvents->dispatched());
+    CounterRegistry::instance().add_counter("events coalesced", &sEvents->coalesced());
+    sEvents->on(sAsyncIo->event_type(), [](const SDL_Event& event) {
+        sAsyncIo->handle_event(event);
+    });
+    sEvents->on(sTimers->event_type(), [](const SDL_Event& event) {
+        sTimers->handle_event(event);
+    });
+    sEvents->on(SDL_WINDOWEVENT, [](const SDL_Event& event) {
+        if (sPresenter != NULL) {
+            sPresenter->handle_event(event);
+        }
+        if (sDisplays != NULL) {
+            sDisplays->handle_event(event);
+        }
+    });
+#if SDL_VERSION_ATLEAST(2, 0, 9)
+    sEvents->on(SDL_DISPLAYEVENT, [](const SDL_Event& event) {
+        if (sDisplays != NULL) {
+            sDisplays->handle_event(event);
+        }
+    });
+#endif
+    sEvents->on(SDL_CONTROLLERDEVICEADDED, [](const SDL_Event& event) {
+        if (sControllers != NULL) {
+            sControllers->handle_event(event);
+            attach_haptics();
+        }
+    });
+    sEvents->on(SDL_CONTROLLERDEVICEREMOVED, [](const SDL_Event& event) {
+        if (sControllers != NULL) {
+            sHaptics->detach(event.cdevice.which);
+            sControllers->handle_event(event);
+        }
+    });
+    sEvents->on(SDL_QUIT, [&loop](const SDL_Event&) {
+        loop.stop();
+    });
+    loop.set_event_handler([](const SDL_Event& event) {
+        sEvents->dispatch(event);
+    });
+    sInput = new InputSampler(1000);
+    sInput->add_counters();
+    loop.set_input_sampler(sInput);
+
+    // ========================================================================
+    // POWER
+    // ========================================================================
+    // SDL_GetPowerInfo tells whether the device runs on battery and how much
+    // of the battery is left. The governor samples it once per second along
+    // with the frame times and selects the quality level of the power policy
+    // (power_governor.h). The level sets the frame-rate cap of the fixed-step
+    // loop, the active workers of the thread pool and the render resolution.
+    // ========================================================================
+    sPower = new PowerGovernor(powerPolicy, loopConfig.updateRate, sThreadPool->num_workers());
+    sPower->add_counters();
+    apply_power_settings(loop);
+
+    auto startupReported = false;
+    loop.set_update_handler([&loop, &startup, &startupReported, prewarm](double dt) {
+        PROFILE_SCOPE(PowerGovernor::WORK_SECTION);
+        ThreadResult result;
+        while (sThreadResults->pop(&result)) {
+            SDL_Log("\tMain thread received a result from thread %lu at %u ms.\n",
+                    result.thread,
+                    result.ticks);
+        }
+        if (startupReported) {
+            update_controllers();
+        }
+        if (sMusic != NULL) {
+            sMusic->update();
+        }
+        if (sPlugins != NULL) {
+            sPlugins->poll();
+            sPlugins->update(dt);
+        }
+        if (sPower->update()) {
+            apply_power_settings(loop);
+        }
+        if (!startupReported) {
+            startup.run_main_task();
+            if (startup.finished()) {
+                startup.log_timeline();
+                startupReported = true;
+                if (prewarm) {
+                    Subsystems::instance().prewarm(CONTROLLER_SUBSYSTEMS);
+                }
             }
         }
-        // ...
+    });
+    // the window is drawn and presented once per frame, after its updates.
+    // The drawing is measured for the power governor, the presents are not.
+    loop.set_render_handler([]() {
+        const auto& input = sInput->latest();
+        {
+            PROFILE_SCOPE(PowerGovernor::WORK_SECTION);
+            if (sPresenter != NULL) {
+                animate_window(sPresenter);
+            }
+            if (sSprites != NULL) {
+                animate_sprites();
+            }
+        }
+        if (sPresenter != NULL && sPresenter->surface() != NULL) {
+            sPresenter->present();
+            sInput->presented(input);
+        }
+        if (sSprites != NULL) {
+            SDL_RenderPresent(sRenderer);
+            sInput->presented(input);
+        }
+    });
+    loop.run();
+    startup.wait();
+    Subsystems::instance().wait();
+    CounterRegistry::instance().remove("events dispatched");
+    CounterRegistry::instance().remove("events coalesced");
+    delete sEvents;
+    sEvents = NULL;
+    sInput->remove_counters();
+    delete sInput;
+    sInput = NULL;
+    sPower->remove_counters();
+    delete sPower;
+    sPower = NULL;
+    if (sPlugins != NULL) {
+        sPlugins->remove_counters();
+        delete sPlugins;
+        sPlugins = NULL;
+    }
+    if (sControllers != NULL) {
+        sHaptics->remove_counters();
+        delete sHaptics;
+        sHaptics = NULL;
+        delete sControllers;
+        sControllers = NULL;
+    }
+    CounterRegistry::instance().remove("timers scheduled");
+    CounterRegistry::instance().remove("timers expired");
+    delete sTimers;
+    sTimers = NULL;
+    delete sThreadPool;
+    sThreadPool = NULL;
+    delete sThreadResults;
+    sThreadResults = NULL;
+
+    Profiler::instance().log_report();
+    Subsystems::instance().log_report();
+    if (profilePath != NULL) {
+        Profiler::instance().write_csv(profilePath);
+    }
+    CounterRegistry::instance().remove("thread jobs");
+    delete sThreadJobs;
+    sThreadJobs = NULL;
+    CounterRegistry::instance().remove("io requests");
+    CounterRegistry::instance().remove("io file reads");
+    CounterRegistry::instance().remove("io cache hits");
+    delete sAsyncIo;
+    sAsyncIo = NULL;
+    if (sAudio != NULL) {
+        sAudio->remove_counters();
+        delete sAudio;
+        sAudio = NULL;
+    }
+    if (sMusic != NULL) {
+        CounterRegistry::instance().remove("stream underruns");
+        CounterRegistry::instance().remove("stream chunks");
+        delete sMusic;
+        sMusic = NULL;
+    }
+    if (sPresenter != NULL) {
+        CounterRegistry::instance().remove("present pixels");
+        CounterRegistry::instance().remove("present partial");
+        CounterRegistry::instance().remove("present full");
+        delete sPresenter;
+        sPresenter = NULL;
+    }
+    delete sDisplays;
+    sDisplays = NULL;
+    if (sSprites != NULL) {
+        sSprites->remove_counters();
+        delete sSprites;
+        sSprites = NULL;
+    }
+    delete sAtlas;
+    sAtlas = NULL;
+    sSpriteRegions.clear();
+    if (sScaledTarget != NULL) {
+        SDL_DestroyTexture(sScaledTarget);
+        sScaledTarget = NULL;
+    }
+    if (sRenderer != NULL) {
+        SDL_DestroyRenderer(sRenderer);
+        sRenderer = NULL;
+    }
+    CounterRegistry::instance().remove("log records");
+    CounterRegistry::instance().remove("log dropped");
+    CounterRegistry::instance().remove("log sampled");
+    delete sLog;
+    sLog = NULL;
+    if (Allocator::instance().is_installed()) {
+        Allocator::instance().remove_gauges();
     }
 
     // ========================================================================
@@ -0,0 +1,241 @@
+#include "main_loop.h"
+#include "allocator.h"
+#include "profiler.h"
+
+MainLoop::MainLoop(const LoopConfig& config)
+    : mConfig(config),
+      mSampler(NULL),
+      mRunning(false),
+      mFrequency(SDL_GetPerformanceFrequency()),
+      mPeriodStart(0)
+{
+    SDL_zero(mPeriod);
+    SDL_zero(mStats);
+    SDL_zero(mPacerStats);
+}
+
+void MainLoop::set_event_handler(const EventHandler& handler)
+{
+    mEventHandler = handler;
+}
+
+void MainLoop::set_update_handler(const UpdateHandler& handler)
+{
+    mUpdateHandler = handler;
+}
+
+void MainLoop::set_render_handler(const RenderHandler& handler)
+{
+    mRenderHandler = handler;
+}
+
+void MainLoop::set_input_sampler(InputSampler* sampler)
+{
+    mSampler = sampler;
+}
+
+void MainLoop::run()
+{
+    mRunning = true;
+    mPeriodStart = SDL_GetPerformanceCounter();
+    switch (mConfig.mode) {
+        case LOOP_MODE_BLOCKING:
+            run_blocking();
+            break;
+        case LOOP_MODE_FIXED_TIMESTEP:
+            run_fixed_timestep();
+            break;
+    }
+}
+
+void MainLoop::stop()
+{
+    mRunning = false;
+}
+
+void MainLoop::set_update_rate(int rate)
+{
+    mConfig.updateRate = SDL_max(rate, 1);
+}
+
+bool MainLoop::parse_mode(const char* text, LoopMode* mode)
+{
+    if (SDL_strcmp(text, "blocking") == 0) {
+        *mode = LOOP_MODE_BLOCKING;
+    } else if (SDL_strcmp(text, "fixed") == 0) {
+        *mode = LOOP_MODE_FIXED_TIMESTEP;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+LoopConfig MainLoop::default_config()
+{
+    LoopConfig config;
+    config.mode = LOOP_MODE_BLOCKING;
+    config.waitTimeout = 100;
+    config.updateRate = 60;
+    config.maxStepsPerFrame = 5;
+    return config;
+}
+
+// ============================================================================
+// Blocking mode sleeps within SDL_WaitEventTimeout until something happens.
+// The timeout makes sure that the update handler is still called a few times
+// per second even when the window does not receive any events at all.
+// ============================================================================
+void MainLoop::run_blocking()
+{
+    auto previous = SDL_GetPerformanceCounter();
+    while (mRunning) {
+        SDL_Event event;
+        auto waitStart = SDL_GetPerformanceCounter();
+        auto received = SDL_WaitEventTimeout(&event, mConfig.waitTimeout);
+        auto waitEnd = SDL_GetPerformanceCounter();
+
+        if (received && mEventHandler) {
+            PROFILE_SCOPE("event pump");
+            mEventHandler(event);
+        }
+        drain_events();
+        if (mUpdateHandler) {
+            PROFILE_SCOPE("update");
+            mUpdateHandler(double(waitEnd - previous) / mFrequency);
+        }
+        if (mRenderHandler) {
+            PROFILE_SCOPE("render");
+            mRenderHandler();
+        }
+        previous = waitEnd;
+
+        account(waitEnd - waitStart, SDL_GetPerformanceCounter() - waitEnd);
+    }
+}
+
+// ============================================================================
+// Fixed-timestep mode calls the update with a constant step. When a frame is
+// late, the loop catches up with at most maxStepsPerFrame steps and drops the
+// rest of the backlog instead of falling further behind. The remaining frame
+// budget is spent sleeping within SDL_WaitEventTimeout so that events are
+// still handled as soon as they arrive. The sleep ends early by the measured
+// sleep overshoot and the pacer spins until the exact deadline.
+// ============================================================================
+void MainLoop::run_fixed_timestep()
+{
+    if (!mPacer.calibrated()) {
+        mPacer.calibrate();
+        SDL_Log("Frame pacing: %d Hz with a %.2f ms sleep overshoot\n",
+                mConfig.updateRate,
+                mPacer.sleep_overshoot_ms());
+    }
+    auto rate = SDL_max(mConfig.updateRate, 1);
+    auto stepTicks = mFrequency / Uint64(rate);
+    auto stepSeconds = double(stepTicks) / mFrequency;
+    auto nextStep = SDL_GetPerformanceCounter();
+    while (mRunning) {
+        if (rate != mConfig.updateRate) {
+            rate = mConfig.updateRate;
+            stepTicks = mFrequency / Uint64(rate);
+            stepSeconds = double(stepTicks) / mFrequency;
+        }
+        auto busyStart = SDL_GetPerformanceCounter();
+        drain_events();
+
+        auto steps = 0;
+        auto now = SDL_GetPerformanceCounter();
+        while (now >= nextStep && steps < mConfig.maxStepsPerFrame) {
+            if (mUpdateHandler) {
+                PROFILE_SCOPE("update");
+                mUpdateHandler(stepSeconds);
+            }
+            nextStep += stepTicks;
+            steps++;
+            now = SDL_GetPerformanceCounter();
+        }
+        if (now >= nextStep) {
+            nextStep = now + stepTicks;
+        }
+        // a frame without updates has nothing new to draw.
+        if (steps > 0 && mRenderHandler) {
+            PROFILE_SCOPE("render");
+            mRenderHandler();
+        }
+
+        auto waitStart = SDL_GetPerformanceCounter();
+        int waitMillis;
+        while (mRunning && (waitMillis = mPacer.sleep_millis(nextStep)) > 0) {
+            if (mSampler != NULL) {
+                waitMillis = SDL_min(waitMillis, int(mSampler->period_ms()));
+            }
+            SDL_Event event;
+            if (SDL_WaitEventTimeout(&event, waitMillis) && mEventHandler) {
+                PROFILE_SCOPE("event pump");
+                mEventHandler(event);
+            }
+            if (mSampler != NULL) {
+                mSampler->sample();
+            }
+        }
+        mPacer.spin_until(nextStep);
+        auto waitEnd = SDL_GetPerformanceCounter();
+        mPacer.record(waitEnd, nextStep, stepTicks);
+
+        account(waitEnd - waitStart, waitStart - busyStart);
+    }
+}
+
+// ============================================================================
+// The queue is drained in batches with SDL_PeepEvents, which takes the lock
+// of the event queue once per batch instead of once per event.
+// ============================================================================
+void MainLoop::drain_events()
+{
+    PROFILE_SCOPE("event pump");
+    SDL_PumpEvents();
+    SDL_Event events[EVENT_BATCH];
+    int count;
+    while ((count = SDL_PeepEvents(events, EVENT_BATCH, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT)) > 0) {
+        for (auto i = 0; i < count && mEventHandler; i++) {
+            mEventHandler(events[i]);
+        }
+    }
+    if (mSampler != NULL) {
+        mSampler->sample();
+    }
+}
+
+void MainLoop::account(Uint64 idleTicks, Uint64 busyTicks)
+{
+    Profiler::instance().end_frame();
+    Allocator::instance().end_frame();
+
+    mPeriod.idleTicks += idleTicks;
+    mPeriod.busyTicks += busyTicks;
+    mPeriod.frames++;
+
+    auto now = SDL_GetPerformanceCounter();
+    if (now - mPeriodStart >= mFrequency) {
+        mStats = mPeriod;
+        SDL_zero(mPeriod);
+        mPeriodStart = now;
+
+        auto idleMillis = mStats.idleTicks * 1000.0 / mFrequency;
+        auto busyMillis = mStats.busyTicks * 1000.0 / mFrequency;
+        auto total = SDL_max(idleMillis + busyMillis, 1.0);
+        SDL_Log("Main loop: idle %.1f ms busy %.1f ms (%.1f%% busy) %u frames\n",
+                idleMillis,
+                busyMillis,
+                100.0 * busyMillis / total,
+                mStats.frames);
+        if (mConfig.mode == LOOP_MODE_FIXED_TIMESTEP) {
+            mPacerStats = mPacer.take_stats();
+            SDL_Log("Frame pacing: jitter avg %.3f ms max %.3f ms rms %.3f ms, %u of %u frames missed\n",
+                    mPacerStats.averageJitter,
+                    mPacerStats.maxJitter,
+                    mPacerStats.deviation,
+                    mPacerStats.missed,
+                    mPacerStats.frames);
+        }
+    }
+}
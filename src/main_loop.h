@@ -0,0 +1,113 @@
+// ============================================================================
+// MAIN LOOP
+// ============================================================================
+// A main loop that never spins idle on SDL_PollEvent. It is available in two
+// different modes which can be chosen based on the application workload.
+//
+// LOOP_MODE_BLOCKING..........Sleep inside SDL_WaitEventTimeout until either
+//                             an event arrives or the wait timeout expires.
+//                             Suitable for idle windows without animation.
+// LOOP_MODE_FIXED_TIMESTEP....Run the update on a fixed simulation rate and
+//                             sleep away the rest of the frame budget while
+//                             still being woken up by the incoming events.
+//                             A FramePacer spins the last part of the wait,
+//                             which the OS sleep would overshoot.
+//
+// The render handler is called once per frame after the update handler(s),
+// so a fixed-timestep frame that catches up with several update steps still
+// draws and presents only once.
+//
+// An InputSampler can be attached to the loop. The state is sampled after the
+// events of each frame and the fixed-timestep sleep is split into slices of
+// the sampling period, so the input is sampled during the wait as well.
+//
+// The loop measures how much of the time was spent sleeping (idle) and how
+// much was spent handling events and updates (busy) and reports the split
+// (and the frame pacing jitter in fixed-timestep mode) once per second via
+// SDL_Log.
+// ============================================================================
+#pragma once
+
+#include <SDL.h>
+
+#include "frame_pacer.h"
+#include "input_sampler.h"
+
+#include <functional>
+
+enum LoopMode {
+    LOOP_MODE_BLOCKING,
+    LOOP_MODE_FIXED_TIMESTEP
+};
+
+struct LoopConfig {
+    LoopMode mode;
+    int waitTimeout;      // [blocking] the maximum sleep in milliseconds.
+    int updateRate;       // [fixed-timestep] updates per second.
+    int maxStepsPerFrame; // [fixed-timestep] the catch-up budget per frame.
+};
+
+struct LoopStats {
+    Uint64 idleTicks;  // performance counter ticks spent sleeping.
+    Uint64 busyTicks;  // performance counter ticks spent working.
+    Uint32 frames;     // loop iterations within the measurement period.
+};
+
+class MainLoop {
+public:
+    // the amount of events that are taken from the queue at once.
+    static const int EVENT_BATCH = 64;
+
+    typedef std::function<void(const SDL_Event&)> EventHandler;
+    typedef std::function<void(double)>           UpdateHandler;
+    typedef std::function<void()>                 RenderHandler;
+
+    explicit MainLoop(const LoopConfig& config);
+
+    // the handler for each received event.
+    void set_event_handler(const EventHandler& handler);
+    // the handler for each update with the elapsed time in seconds.
+    void set_update_handler(const UpdateHandler& handler);
+    // the handler that draws and presents the frame after its updates.
+    void set_render_handler(const RenderHandler& handler);
+    // the sampler of the input state (or NULL to not sample the input).
+    void set_input_sampler(InputSampler* sampler);
+
+    // run the loop until stop() gets called.
+    void run();
+    void stop();
+
+    // [fixed-timestep] change the update rate, e.g. from the update handler.
+    // The new step is taken into use from the next frame on.
+    void set_update_rate(int rate);
+    const LoopConfig& config() const { return mConfig; }
+
+    // the idle/busy split of the latest complete one second period.
+    const LoopStats& stats() const { return mStats; }
+    // the jitter of the frame deadlines of the latest complete period.
+    const PacerStats& pacer_stats() const { return mPacerStats; }
+
+    // parse the loop mode from a text (i.e. "blocking" or "fixed").
+    static bool parse_mode(const char* text, LoopMode* mode);
+    static LoopConfig default_config();
+
+private:
+    void run_blocking();
+    void run_fixed_timestep();
+    // drain all pending events without blocking.
+    void drain_events();
+    void account(Uint64 idleTicks, Uint64 busyTicks);
+
+    LoopConfig    mConfig;
+    EventHandler  mEventHandler;
+    UpdateHandler mUpdateHandler;
+    RenderHandler mRenderHandler;
+    InputSampler* mSampler;
+    bool          mRunning;
+    Uint64        mFrequency;
+    Uint64        mPeriodStart;
+    LoopStats     mPeriod;
+    LoopStats     mStats;
+    FramePacer    mPacer;
+    PacerStats    mPacerStats;
+};
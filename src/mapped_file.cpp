@@ -0,0 +1,226 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+    : mOpen(false),
+      mData(NULL),
+      mSize(0)
+#ifdef _WIN32
+      , mFile(INVALID_HANDLE_VALUE),
+      mMapping(NULL)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+#ifdef _WIN32
+bool MappedFile::open(const char* path)
+{
+    close();
+    auto widePath = SDL_iconv_utf8_ucs2(path);
+    if (widePath == NULL) {
+        SDL_SetError("Failed to convert path: %s", path);
+        return false;
+    }
+    auto file = CreateFileW(reinterpret_cast<LPCWSTR>(widePath), GENERIC_READ, FILE_SHARE_READ,
+                            NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    SDL_free(widePath);
+    if (file == INVALID_HANDLE_VALUE) {
+        SDL_SetError("Failed to open file: %s", path);
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        SDL_SetError("Failed to get file size: %s", path);
+        return false;
+    }
+    mFile = file;
+    mSize = size.QuadPart;
+    if (mSize > 0) {
+        mMapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        mData = mMapping == NULL ? NULL : static_cast<Uint8*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+        if (mData == NULL) {
+            close();
+            SDL_SetError("Failed to map file: %s", path);
+            return false;
+        }
+    }
+    mOpen = true;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (mData != NULL) {
+        UnmapViewOfFile(mData);
+    }
+    if (mMapping != NULL) {
+        CloseHandle(mMapping);
+    }
+    if (mFile != INVALID_HANDLE_VALUE) {
+        CloseHandle(mFile);
+    }
+    mOpen = false;
+    mData = NULL;
+    mSize = 0;
+    mFile = INVALID_HANDLE_VALUE;
+    mMapping = NULL;
+}
+#else
+bool MappedFile::open(const char* path)
+{
+    close();
+    auto fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        SDL_SetError("Failed to open file: %s", path);
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        ::close(fd);
+        SDL_SetError("Failed to get file size: %s", path);
+        return false;
+    }
+    mSize = Sint64(info.st_size);
+    if (mSize > 0) {
+        auto data = mmap(NULL, size_t(mSize), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            ::close(fd);
+            mSize = 0;
+            SDL_SetError("Failed to map file: %s", path);
+            return false;
+        }
+        // assets are usually parsed from the beginning to the end.
+        madvise(data, size_t(mSize), MADV_SEQUENTIAL);
+        mData = static_cast<Uint8*>(data);
+    }
+    // the mapping keeps its own reference to the file.
+    ::close(fd);
+    mOpen = true;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (mData != NULL) {
+        munmap(mData, size_t(mSize));
+    }
+    mOpen = false;
+    mData = NULL;
+    mSize = 0;
+}
+#endif
+
+// ============================================================================
+// SDL_RWops
+// ============================================================================
+// The context keeps the mapping and the current offset in hidden.unknown.
+// ============================================================================
+struct MappedStream {
+    MappedFile file;
+    Sint64     offset;
+};
+
+static MappedStream* mapped_stream(SDL_RWops* rw)
+{
+    return static_cast<MappedStream*>(rw->hidden.unknown.data1);
+}
+
+static Sint64 SDLCALL mapped_size(SDL_RWops* rw)
+{
+    return mapped_stream(rw)->file.size();
+}
+
+static Sint64 SDLCALL mapped_seek(SDL_RWops* rw, Sint64 offset, int whence)
+{
+    auto stream = mapped_stream(rw);
+    Sint64 position;
+    switch (whence) {
+        case RW_SEEK_SET: position = offset; break;
+        case RW_SEEK_CUR: position = stream->offset + offset; break;
+        case RW_SEEK_END: position = stream->file.size() + offset; break;
+        default:          return SDL_SetError("Unknown value for 'whence'");
+    }
+    if (position < 0) {
+        return SDL_SetError("Seek before the start of a mapped file");
+    }
+    // seeking past the end is allowed (reads will return zero) like in stdio.
+    stream->offset = position;
+    return position;
+}
+
+static size_t SDLCALL mapped_read(SDL_RWops* rw, void* ptr, size_t size, size_t maxnum)
+{
+    auto stream = mapped_stream(rw);
+    auto remaining = stream->file.size() - stream->offset;
+    if (size == 0 || remaining <= 0) {
+        return 0;
+    }
+    auto num = SDL_min(maxnum, size_t(remaining) / size);
+    SDL_memcpy(ptr, stream->file.data() + stream->offset, num * size);
+    stream->offset += Sint64(num * size);
+    return num;
+}
+
+static size_t SDLCALL mapped_write(SDL_RWops*, const void*, size_t, size_t)
+{
+    SDL_SetError("Mapped files are read-only");
+    return 0;
+}
+
+static int SDLCALL mapped_close(SDL_RWops* rw)
+{
+    delete mapped_stream(rw);
+    SDL_FreeRW(rw);
+    return 0;
+}
+
+SDL_RWops* rw_from_mapped_file(const char* path)
+{
+    auto stream = new MappedStream();
+    stream->offset = 0;
+    if (!stream->file.open(path)) {
+        delete stream;
+        return NULL;
+    }
+    auto rw = SDL_AllocRW();
+    if (rw == NULL) {
+        delete stream;
+        return NULL;
+    }
+    rw->size = mapped_size;
+    rw->seek = mapped_seek;
+    rw->read = mapped_read;
+    rw->write = mapped_write;
+    rw->close = mapped_close;
+    rw->type = SANDBOX_RWOPS_MAPPED;
+    rw->hidden.unknown.data1 = stream;
+    return rw;
+}
+
+const Uint8* rw_mapped_data(SDL_RWops* rw, Sint64* size)
+{
+    if (rw == NULL || rw->type != SANDBOX_RWOPS_MAPPED) {
+        SDL_SetError("Not a mapped file stream");
+        return NULL;
+    }
+    auto stream = mapped_stream(rw);
+    if (size != NULL) {
+        *size = stream->file.size();
+    }
+    return stream->file.data();
+}
@@ -0,0 +1,54 @@
+// ============================================================================
+// MAPPED FILE
+// ============================================================================
+// Read-only memory mapped files (mmap on POSIX and MapViewOfFile on Windows).
+//
+// Reading a large asset with SDL_RWFromFile copies each byte first into the
+// stdio buffer and then into the buffer of the caller, with a read syscall
+// per buffer refill. A mapping lets the OS page the file in on demand and
+// shares the pages with the page cache, so the file is not copied at all.
+//
+// MappedFile.....................Owns a mapping and hands out a direct pointer.
+// rw_from_mapped_file(path)......A SDL_RWops whose read/seek/size callbacks
+//                                work directly on a mapping of the file.
+// rw_mapped_data(rw, size).......The direct pointer of a mapped SDL_RWops for
+//                                consumers that are able to parse in place.
+//
+// The pointer remains valid until the MappedFile is closed or destroyed or
+// until the SDL_RWops is closed with SDL_RWclose.
+// ============================================================================
+#pragma once
+
+#include <SDL.h>
+
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    // map the whole file. Returns false and sets the SDL error on failure.
+    bool open(const char* path);
+    void close();
+
+    bool         is_open() const { return mOpen; }
+    const Uint8* data() const    { return mData; }
+    Sint64       size() const    { return mSize; }
+
+private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    bool   mOpen;
+    Uint8* mData;
+    Sint64 mSize;
+#ifdef _WIN32
+    void*  mFile;
+    void*  mMapping;
+#endif
+};
+
+// the SDL_RWops type of the mapped file streams.
+#define SANDBOX_RWOPS_MAPPED 0x4d4d4150U
+
+SDL_RWops*   rw_from_mapped_file(const char* path);
+const Uint8* rw_mapped_data(SDL_RWops* rw, Sint64* size);
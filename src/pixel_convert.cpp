@@ -0,0 +1,206 @@
+#include "pixel_convert.h"
+#include "pixel_kernels.h"
+
+// ============================================================================
+// FORMATS
+// ============================================================================
+// A packed format is a single 16- or 32-bit value with a shift and a bit count
+// per channel and a byte format is an array of bytes, one per channel. Both
+// load the channels expanded into 8 bits and store them from 8 bits.
+// ============================================================================
+static inline Uint32 expand(Uint32 value, int bits)
+{
+    // bit replication as in the expansion tables of SDL.
+    return bits >= 8 ? value : (value << (8 - bits)) | (value >> (2 * bits - 8));
+}
+
+template <typename T, int RShift, int RBits, int GShift, int GBits, int BShift, int BBits, int AShift, int ABits>
+struct PackedFormat {
+    typedef T Unit;
+    static const int UNITS = 1;
+
+    static inline void load(const T* pixel, Uint32* r, Uint32* g, Uint32* b, Uint32* a)
+    {
+        Uint32 value = *pixel;
+        *r = expand((value >> RShift) & ((1u << RBits) - 1), RBits);
+        *g = expand((value >> GShift) & ((1u << GBits) - 1), GBits);
+        *b = expand((value >> BShift) & ((1u << BBits) - 1), BBits);
+        *a = ABits > 0 ? expand((value >> AShift) & ((1u << ABits) - 1), ABits) : 255;
+    }
+
+    static inline void store(T* pixel, Uint32 r, Uint32 g, Uint32 b, Uint32 a)
+    {
+        Uint32 value = ((r >> (8 - RBits)) << RShift)
+                     | ((g >> (8 - GBits)) << GShift)
+                     | ((b >> (8 - BBits)) << BShift);
+        if (ABits > 0) {
+            value |= (a >> (8 - ABits)) << AShift;
+        }
+        *pixel = T(value);
+    }
+};
+
+template <int R, int G, int B>
+struct ByteFormat {
+    typedef Uint8 Unit;
+    static const int UNITS = 3;
+
+    static inline void load(const Uint8* pixel, Uint32* r, Uint32* g, Uint32* b, Uint32* a)
+    {
+        *r = pixel[R];
+        *g = pixel[G];
+        *b = pixel[B];
+        *a = 255;
+    }
+
+    static inline void store(Uint8* pixel, Uint32 r, Uint32 g, Uint32 b, Uint32)
+    {
+        pixel[R] = Uint8(r);
+        pixel[G] = Uint8(g);
+        pixel[B] = Uint8(b);
+    }
+};
+
+template <Uint32 Format>
+struct FormatOf;
+
+#define SANDBOX_PIXEL_FORMAT(format, ...) \
+    template <> struct FormatOf<format> { typedef __VA_ARGS__ Type; }
+
+SANDBOX_PIXEL_FORMAT(SDL_PIXELFORMAT_ARGB8888, PackedFormat<Uint32, 16, 8, 8, 8, 0, 8, 24, 8>);
+SANDBOX_PIXEL_FORMAT(SDL_PIXELFORMAT_ABGR8888, PackedFormat<Uint32, 0, 8, 8, 8, 16, 8, 24, 8>);
+SANDBOX_PIXEL_FORMAT(SDL_PIXELFORMAT_RGBA8888, PackedFormat<Uint32, 24, 8, 16, 8, 8, 8, 0, 8>);
+SANDBOX_PIXEL_FORMAT(SDL_PIXELFORMAT_BGRA8888, PackedFormat<Uint32, 8, 8, 16, 8, 24, 8, 0, 8>);
+SANDBOX_PIXEL_FORMAT(SDL_PIXELFORMAT_RGB888, PackedFormat<Uint32, 16, 8, 8, 8, 0, 8, 0, 0>);
+SANDBOX_PIXEL_FORMAT(SDL_PIXELFORMAT_BGR888, PackedFormat<Uint32, 0, 8, 8, 8, 16, 8, 0, 0>);
+SANDBOX_PIXEL_FORMAT(SDL_PIXELFORMAT_RGB565, PackedFormat<Uint16, 11, 5, 5, 6, 0, 5, 0, 0>);
+SANDBOX_PIXEL_FORMAT(SDL_PIXELFORMAT_RGB555, PackedFormat<Uint16, 10, 5, 5, 5, 0, 5, 0, 0>);
+SANDBOX_PIXEL_FORMAT(SDL_PIXELFORMAT_RGB24, ByteFormat<0, 1, 2>);
+SANDBOX_PIXEL_FORMAT(SDL_PIXELFORMAT_BGR24, ByteFormat<2, 1, 0>);
+
+#undef SANDBOX_PIXEL_FORMAT
+
+// ============================================================================
+// CONVERTER TABLE
+// ============================================================================
+// The table is generated from the list of the formats by expanding the list
+// twice, once for the source and once for the destination, which instantiates
+// the converter for every pair of the formats at compile time.
+// ============================================================================
+template <class From, class To>
+static void convert_row(void* dst, const void* src, int count)
+{
+    auto in = static_cast<const typename From::Unit*>(src);
+    auto out = static_cast<typename To::Unit*>(dst);
+    for (auto i = 0; i < count; i++) {
+        Uint32 r, g, b, a;
+        From::load(in + i * From::UNITS, &r, &g, &b, &a);
+        To::store(out + i * To::UNITS, r, g, b, a);
+    }
+}
+
+struct ConverterEntry {
+    Uint32         from;
+    Uint32         to;
+    PixelConverter converter;
+};
+
+template <Uint32 From, Uint32... To>
+static ConverterEntry* add_converters(ConverterEntry* entry)
+{
+    const ConverterEntry entries[] = {
+        { From, To, convert_row<typename FormatOf<From>::Type, typename FormatOf<To>::Type> }...
+    };
+    for (const auto& converter : entries) {
+        *entry++ = converter;
+    }
+    return entry;
+}
+
+template <Uint32... Formats>
+struct ConverterTable {
+    static const int SIZE = sizeof...(Formats) * sizeof...(Formats);
+
+    ConverterTable()
+    {
+        auto entry = entries;
+        int expansion[] = { (entry = add_converters<Formats, Formats...>(entry), 0)... };
+        (void)expansion;
+    }
+
+    PixelConverter find(Uint32 from, Uint32 to) const
+    {
+        for (const auto& entry : entries) {
+            if (entry.from == from && entry.to == to) {
+                return entry.converter;
+            }
+        }
+        return NULL;
+    }
+
+    ConverterEntry entries[SIZE];
+};
+
+typedef ConverterTable<SDL_PIXELFORMAT_ARGB8888,
+                       SDL_PIXELFORMAT_ABGR8888,
+                       SDL_PIXELFORMAT_RGBA8888,
+                       SDL_PIXELFORMAT_BGRA8888,
+                       SDL_PIXELFORMAT_RGB888,
+                       SDL_PIXELFORMAT_BGR888,
+                       SDL_PIXELFORMAT_RGB565,
+                       SDL_PIXELFORMAT_RGB555,
+                       SDL_PIXELFORMAT_RGB24,
+                       SDL_PIXELFORMAT_BGR24> Converters;
+
+PixelConverter pixel_converter(Uint32 from, Uint32 to)
+{
+    static const Converters sConverters;
+    return sConverters.find(from, to);
+}
+
+// ============================================================================
+// CONVERSION
+// ============================================================================
+static bool is_swizzle(Uint32 from, Uint32 to)
+{
+    return (from == SDL_PIXELFORMAT_ARGB8888 && to == SDL_PIXELFORMAT_ABGR8888)
+        || (from == SDL_PIXELFORMAT_ABGR8888 && to == SDL_PIXELFORMAT_ARGB8888)
+        || (from == SDL_PIXELFORMAT_RGB888 && to == SDL_PIXELFORMAT_BGR888)
+        || (from == SDL_PIXELFORMAT_BGR888 && to == SDL_PIXELFORMAT_RGB888);
+}
+
+int convert_pixels(int width, int height,
+                   Uint32 from, const void* src, int srcPitch,
+                   Uint32 to, void* dst, int dstPitch)
+{
+    if (src == NULL || dst == NULL) {
+        return SDL_SetError("Pixel conversion requires source and destination pixels");
+    }
+    auto in = static_cast<const Uint8*>(src);
+    auto out = static_cast<Uint8*>(dst);
+    const auto& kernels = pixel_kernels();
+    if (from == to && SDL_BYTESPERPIXEL(from) == 4 && !SDL_ISPIXELFORMAT_FOURCC(from)) {
+        for (auto y = 0; y < height; y++) {
+            kernels.copy(reinterpret_cast<Uint32*>(out + y * dstPitch),
+                         reinterpret_cast<const Uint32*>(in + y * srcPitch),
+                         width);
+        }
+        return 0;
+    }
+    if (is_swizzle(from, to)) {
+        for (auto y = 0; y < height; y++) {
+            kernels.swizzle(reinterpret_cast<Uint32*>(out + y * dstPitch),
+                            reinterpret_cast<const Uint32*>(in + y * srcPitch),
+                            width);
+        }
+        return 0;
+    }
+    auto converter = pixel_converter(from, to);
+    if (converter == NULL) {
+        return SDL_ConvertPixels(width, height, from, src, srcPitch, to, dst, dstPitch);
+    }
+    for (auto y = 0; y < height; y++) {
+        converter(out + y * dstPitch, in + y * srcPitch, width);
+    }
+    return 0;
+}
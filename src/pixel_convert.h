@@ -0,0 +1,38 @@
+// ============================================================================
+// PIXEL CONVERSION
+// ============================================================================
+// Converts pixels between the SDL_PIXELFORMAT_* formats that the displays and
+// the capture paths commonly use. SDL_ConvertPixels (and SDL_ConvertSurface)
+// decode the formats from their masks at runtime, while the converters here
+// are template functions that are specialized for each (source, destination)
+// pair, so the shifts and the masks are constants the compiler can fold and
+// vectorize.
+//
+// pixel_converter()...The specialized row converter of a pair or NULL.
+// convert_pixels()....Convert a rect of pixels like SDL_ConvertPixels.
+//
+// The formats which have the specialized converters in both directions.
+//
+// ARGB8888, ABGR8888, RGBA8888, BGRA8888...32-bit with alpha.
+// RGB888, BGR888...........................32-bit with an unused byte.
+// RGB565, RGB555...........................16-bit without alpha.
+// RGB24, BGR24.............................24-bit byte arrays.
+//
+// convert_pixels() uses the SIMD kernels (pixel_kernels.h) of the CPU for the
+// copies and the swizzles of the red and blue channels, the specialized table
+// for the other pairs of the formats above and SDL_ConvertPixels for the rest.
+// The channels are expanded like SDL does it (bit replication) and a missing
+// alpha is read as opaque, so the color and the alpha channels match the
+// results of SDL_ConvertPixels.
+// ============================================================================
+#pragma once
+
+#include <SDL.h>
+
+typedef void (*PixelConverter)(void* dst, const void* src, int count);
+
+PixelConverter pixel_converter(Uint32 from, Uint32 to);
+// returns 0 on success or -1 on failure (see SDL_GetError).
+int convert_pixels(int width, int height,
+                   Uint32 from, const void* src, int srcPitch,
+                   Uint32 to, void* dst, int dstPitch);
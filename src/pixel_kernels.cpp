@@ -0,0 +1,430 @@
+#include "pixel_kernels.h"
+#include "cpu_features.h"
+#include "pixel_convert.h"
+
+#ifdef SANDBOX_X86
+#include <immintrin.h>
+#endif
+
+// ============================================================================
+// SCALAR
+// ============================================================================
+// The reference implementation which is used on every platform. Blending is
+// done as (s * a + d * (255 - a) + 128) / 255 per channel with an exact
+// division by 255 computed as (t + (t >> 8)) >> 8. Source alpha is treated
+// as 255 so that the resulting alpha is a + da * (255 - a) / 255.
+// ============================================================================
+static void fill_scalar(Uint32* dst, int count, Uint32 color)
+{
+    for (auto i = 0; i < count; i++) {
+        dst[i] = color;
+    }
+}
+
+static void copy_scalar(Uint32* dst, const Uint32* src, int count)
+{
+    SDL_memcpy(dst, src, sizeof(Uint32) * count);
+}
+
+static inline Uint32 blend_pixel(Uint32 d, Uint32 s)
+{
+    auto a = s >> 24;
+    auto ia = 255 - a;
+    s |= 0xff000000;
+    Uint32 result = 0;
+    for (auto shift = 0; shift < 32; shift += 8) {
+        auto t = ((s >> shift) & 0xff) * a + ((d >> shift) & 0xff) * ia + 128;
+        result |= (((t + (t >> 8)) >> 8) & 0xff) << shift;
+    }
+    return result;
+}
+
+static void blend_scalar(Uint32* dst, const Uint32* src, int count)
+{
+    for (auto i = 0; i < count; i++) {
+        dst[i] = blend_pixel(dst[i], src[i]);
+    }
+}
+
+static inline Uint32 swizzle_pixel(Uint32 p)
+{
+    return (p & 0xff00ff00) | ((p >> 16) & 0xff) | ((p & 0xff) << 16);
+}
+
+static void swizzle_scalar(Uint32* dst, const Uint32* src, int count)
+{
+    for (auto i = 0; i < count; i++) {
+        dst[i] = swizzle_pixel(src[i]);
+    }
+}
+
+#ifdef SANDBOX_X86
+// ============================================================================
+// SSE2
+// ============================================================================
+// Four pixels per iteration. Pixels are expanded to 16-bit lanes where the
+// blend products fit without overflowing (255 * 255 + 255 * 0 + 128 + 254).
+// ============================================================================
+SANDBOX_TARGET("sse2")
+static void fill_sse2(Uint32* dst, int count, Uint32 color)
+{
+    auto value = _mm_set1_epi32(int(color));
+    auto i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), value);
+    }
+    fill_scalar(dst + i, count - i, color);
+}
+
+SANDBOX_TARGET("sse2")
+static void copy_sse2(Uint32* dst, const Uint32* src, int count)
+{
+    auto i = 0;
+    for (; i + 4 <= count; i += 4) {
+        auto value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), value);
+    }
+    copy_scalar(dst + i, src + i, count - i);
+}
+
+// blend two pixels that have been expanded into 16-bit lanes.
+SANDBOX_TARGET("sse2")
+static inline __m128i blend_lanes_sse2(__m128i s, __m128i d, __m128i a)
+{
+    const auto alphaLanes = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+    const auto max = _mm_set1_epi16(255);
+    const auto bias = _mm_set1_epi16(128);
+    auto ia = _mm_sub_epi16(max, a);
+    s = _mm_or_si128(s, alphaLanes);
+    auto t = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(s, a), _mm_mullo_epi16(d, ia)), bias);
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+SANDBOX_TARGET("sse2")
+static void blend_sse2(Uint32* dst, const Uint32* src, int count)
+{
+    const auto zero = _mm_setzero_si128();
+    auto i = 0;
+    for (; i + 4 <= count; i += 4) {
+        auto s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        auto d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        auto slo = _mm_unpacklo_epi8(s, zero);
+        auto shi = _mm_unpackhi_epi8(s, zero);
+        auto alo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(slo, 0xff), 0xff);
+        auto ahi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(shi, 0xff), 0xff);
+        auto lo = blend_lanes_sse2(slo, _mm_unpacklo_epi8(d, zero), alo);
+        auto hi = blend_lanes_sse2(shi, _mm_unpackhi_epi8(d, zero), ahi);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+    }
+    blend_scalar(dst + i, src + i, count - i);
+}
+
+SANDBOX_TARGET("sse2")
+static void swizzle_sse2(Uint32* dst, const Uint32* src, int count)
+{
+    const auto keep = _mm_set1_epi32(int(0xff00ff00));
+    const auto low = _mm_set1_epi32(0xff);
+    auto i = 0;
+    for (; i + 4 <= count; i += 4) {
+        auto p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        auto r = _mm_and_si128(_mm_srli_epi32(p, 16), low);
+        auto b = _mm_slli_epi32(_mm_and_si128(p, low), 16);
+        auto result = _mm_or_si128(_mm_and_si128(p, keep), _mm_or_si128(r, b));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), result);
+    }
+    swizzle_scalar(dst + i, src + i, count - i);
+}
+
+// ============================================================================
+// SSE4.1
+// ============================================================================
+// Uses byte shuffles (SSSE3, implied by SSE4.1) to broadcast the alpha and
+// to swizzle channels, and zero extension instructions to expand pixels.
+// ============================================================================
+SANDBOX_TARGET("sse4.1")
+static void blend_sse41(Uint32* dst, const Uint32* src, int count)
+{
+    const auto alphaLo = _mm_setr_epi8(3, -1, 3, -1, 3, -1, 3, -1, 7, -1, 7, -1, 7, -1, 7, -1);
+    const auto alphaHi = _mm_setr_epi8(11, -1, 11, -1, 11, -1, 11, -1, 15, -1, 15, -1, 15, -1, 15, -1);
+    const auto alphaLanes = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+    const auto max = _mm_set1_epi16(255);
+    const auto bias = _mm_set1_epi16(128);
+    auto i = 0;
+    for (; i + 4 <= count; i += 4) {
+        auto s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        auto d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        __m128i halves[2];
+        for (auto half = 0; half < 2; half++) {
+            auto shifted = half == 0 ? s : _mm_srli_si128(s, 8);
+            auto s16 = _mm_or_si128(_mm_cvtepu8_epi16(shifted), alphaLanes);
+            auto d16 = _mm_cvtepu8_epi16(half == 0 ? d : _mm_srli_si128(d, 8));
+            auto a = _mm_shuffle_epi8(s, half == 0 ? alphaLo : alphaHi);
+            auto ia = _mm_sub_epi16(max, a);
+            auto t = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(s16, a), _mm_mullo_epi16(d16, ia)), bias);
+            halves[half] = _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(halves[0], halves[1]));
+    }
+    blend_scalar(dst + i, src + i, count - i);
+}
+
+SANDBOX_TARGET("sse4.1")
+static void swizzle_sse41(Uint32* dst, const Uint32* src, int count)
+{
+    const auto mask = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    auto i = 0;
+    for (; i + 4 <= count; i += 4) {
+        auto p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_shuffle_epi8(p, mask));
+    }
+    swizzle_scalar(dst + i, src + i, count - i);
+}
+
+// ============================================================================
+// AVX2
+// ============================================================================
+// Eight pixels per iteration. The 256-bit pack instruction works within the
+// 128-bit lanes, so the packed quadwords are permuted back in order.
+// ============================================================================
+SANDBOX_TARGET("avx2")
+static void fill_avx2(Uint32* dst, int count, Uint32 color)
+{
+    auto value = _mm256_set1_epi32(int(color));
+    auto i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), value);
+    }
+    fill_scalar(dst + i, count - i, color);
+}
+
+SANDBOX_TARGET("avx2")
+static void copy_avx2(Uint32* dst, const Uint32* src, int count)
+{
+    auto i = 0;
+    for (; i + 8 <= count; i += 8) {
+        auto value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), value);
+    }
+    copy_scalar(dst + i, src + i, count - i);
+}
+
+SANDBOX_TARGET("avx2")
+static void blend_avx2(Uint32* dst, const Uint32* src, int count)
+{
+    const auto alphaMask = _mm256_setr_epi8(
+        6, -1, 6, -1, 6, -1, 6, -1, 14, -1, 14, -1, 14, -1, 14, -1,
+        6, -1, 6, -1, 6, -1, 6, -1, 14, -1, 14, -1, 14, -1, 14, -1);
+    const auto alphaLanes = _mm256_set_epi16(255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0);
+    const auto max = _mm256_set1_epi16(255);
+    const auto bias = _mm256_set1_epi16(128);
+    auto i = 0;
+    for (; i + 8 <= count; i += 8) {
+        auto s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        auto d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+        __m256i halves[2];
+        for (auto half = 0; half < 2; half++) {
+            auto s16 = _mm256_cvtepu8_epi16(half == 0 ? _mm256_castsi256_si128(s) : _mm256_extracti128_si256(s, 1));
+            auto d16 = _mm256_cvtepu8_epi16(half == 0 ? _mm256_castsi256_si128(d) : _mm256_extracti128_si256(d, 1));
+            auto a = _mm256_shuffle_epi8(s16, alphaMask);
+            auto ia = _mm256_sub_epi16(max, a);
+            s16 = _mm256_or_si256(s16, alphaLanes);
+            auto t = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(s16, a), _mm256_mullo_epi16(d16, ia)), bias);
+            halves[half] = _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+        }
+        auto packed = _mm256_packus_epi16(halves[0], halves[1]);
+        packed = _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), packed);
+    }
+    blend_scalar(dst + i, src + i, count - i);
+}
+
+SANDBOX_TARGET("avx2")
+static void swizzle_avx2(Uint32* dst, const Uint32* src, int count)
+{
+    const auto mask = _mm256_setr_epi8(
+        2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+        2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    auto i = 0;
+    for (; i + 8 <= count; i += 8) {
+        auto p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_shuffle_epi8(p, mask));
+    }
+    swizzle_scalar(dst + i, src + i, count - i);
+}
+#endif
+
+// ============================================================================
+// DISPATCH
+// ============================================================================
+static const PixelKernels sKernels[PIXEL_ISA_COUNT] = {
+    { PIXEL_ISA_SCALAR, "scalar", fill_scalar, copy_scalar, blend_scalar, swizzle_scalar },
+#ifdef SANDBOX_X86
+    { PIXEL_ISA_SSE2, "sse2", fill_sse2, copy_sse2, blend_sse2, swizzle_sse2 },
+    { PIXEL_ISA_SSE41, "sse4.1", fill_sse2, copy_sse2, blend_sse41, swizzle_sse41 },
+    { PIXEL_ISA_AVX2, "avx2", fill_avx2, copy_avx2, blend_avx2, swizzle_avx2 },
+#endif
+};
+
+static bool is_supported(PixelIsa isa)
+{
+#ifdef SANDBOX_X86
+    const auto& cpu = cpu_features();
+    switch (isa) {
+        case PIXEL_ISA_SCALAR: return true;
+        case PIXEL_ISA_SSE2:   return cpu.sse2;
+        case PIXEL_ISA_SSE41:  return cpu.sse41;
+        case PIXEL_ISA_AVX2:   return cpu.avx2;
+        default:               return false;
+    }
+#else
+    return isa == PIXEL_ISA_SCALAR;
+#endif
+}
+
+const PixelKernels* pixel_kernels_for(PixelIsa isa)
+{
+    return is_supported(isa) ? &sKernels[isa] : NULL;
+}
+
+const PixelKernels& pixel_kernels()
+{
+    static const PixelKernels* sSelected = []() {
+        auto isa = int(PIXEL_ISA_COUNT) - 1;
+        while (!is_supported(PixelIsa(isa))) {
+            isa--;
+        }
+        return &sKernels[isa];
+    }();
+    return *sSelected;
+}
+
+// ============================================================================
+// SURFACE OPERATIONS
+// ============================================================================
+static bool is_32bit(SDL_Surface* surface)
+{
+    return surface != NULL && surface->format->BytesPerPixel == 4;
+}
+
+static Uint32* row(SDL_Surface* surface, int x, int y)
+{
+    auto bytes = static_cast<Uint8*>(surface->pixels) + y * surface->pitch;
+    return reinterpret_cast<Uint32*>(bytes) + x;
+}
+
+// clip the source rect and the destination position against both surfaces.
+static bool clip_blit(SDL_Surface* src, const SDL_Rect* srcRect,
+                      SDL_Surface* dst, int x, int y,
+                      SDL_Rect* srcClip, SDL_Rect* dstClip)
+{
+    SDL_Rect srcBounds = { 0, 0, src->w, src->h };
+    SDL_Rect dstBounds = { 0, 0, dst->w, dst->h };
+    SDL_Rect wanted = srcRect != NULL ? *srcRect : srcBounds;
+    if (!SDL_IntersectRect(&wanted, &srcBounds, srcClip)) {
+        return false;
+    }
+    SDL_Rect target = { x + srcClip->x - wanted.x, y + srcClip->y - wanted.y, srcClip->w, srcClip->h };
+    if (!SDL_IntersectRect(&target, &dstBounds, dstClip)) {
+        return false;
+    }
+    srcClip->x += dstClip->x - target.x;
+    srcClip->y += dstClip->y - target.y;
+    srcClip->w = dstClip->w;
+    srcClip->h = dstClip->h;
+    return true;
+}
+
+typedef void (*SpanFunction)(Uint32* dst, const Uint32* src, int count);
+
+static int surface_span_blit(SDL_Surface* src, const SDL_Rect* srcRect,
+                             SDL_Surface* dst, int x, int y,
+                             SpanFunction function)
+{
+    if (!is_32bit(src) || !is_32bit(dst)) {
+        return SDL_SetError("Pixel kernels require 32-bit surfaces");
+    }
+    if (src == dst) {
+        return SDL_SetError("Pixel kernels require separate surfaces");
+    }
+    SDL_Rect s, d;
+    if (!clip_blit(src, srcRect, dst, x, y, &s, &d)) {
+        return 0;
+    }
+    if (SDL_LockSurface(src) != 0) {
+        return -1;
+    }
+    if (SDL_LockSurface(dst) != 0) {
+        SDL_UnlockSurface(src);
+        return -1;
+    }
+    for (auto i = 0; i < d.h; i++) {
+        function(row(dst, d.x, d.y + i), row(src, s.x, s.y + i), d.w);
+    }
+    SDL_UnlockSurface(dst);
+    SDL_UnlockSurface(src);
+    return 0;
+}
+
+int surface_fill(SDL_Surface* dst, const SDL_Rect* rect, Uint32 color)
+{
+    if (!is_32bit(dst)) {
+        return SDL_SetError("Pixel kernels require 32-bit surfaces");
+    }
+    SDL_Rect bounds = { 0, 0, dst->w, dst->h };
+    SDL_Rect area;
+    if (!SDL_IntersectRect(rect != NULL ? rect : &bounds, &bounds, &area)) {
+        return 0;
+    }
+    if (SDL_LockSurface(dst) != 0) {
+        return -1;
+    }
+    const auto& kernels = pixel_kernels();
+    for (auto i = 0; i < area.h; i++) {
+        kernels.fill(row(dst, area.x, area.y + i), area.w, color);
+    }
+    SDL_UnlockSurface(dst);
+    return 0;
+}
+
+int surface_copy(SDL_Surface* src, const SDL_Rect* srcRect, SDL_Surface* dst, int x, int y)
+{
+    if (is_32bit(src) && is_32bit(dst) && src->format->format != dst->format->format) {
+        return SDL_SetError("Pixel copy requires surfaces of the same format");
+    }
+    return surface_span_blit(src, srcRect, dst, x, y, pixel_kernels().copy);
+}
+
+int surface_blend(SDL_Surface* src, const SDL_Rect* srcRect, SDL_Surface* dst, int x, int y)
+{
+    if (is_32bit(src) && is_32bit(dst)) {
+        auto format = src->format->format;
+        if (format != dst->format->format ||
+            (format != SDL_PIXELFORMAT_ARGB8888 && format != SDL_PIXELFORMAT_ABGR8888)) {
+            return SDL_SetError("Pixel blend requires ARGB8888 or ABGR8888 surfaces");
+        }
+    }
+    return surface_span_blit(src, srcRect, dst, x, y, pixel_kernels().blend);
+}
+
+int surface_convert(SDL_Surface* src, SDL_Surface* dst)
+{
+    if (src == NULL || dst == NULL || src->w != dst->w || src->h != dst->h) {
+        return SDL_SetError("Pixel conversion requires surfaces of the same size");
+    }
+    if (src == dst) {
+        return SDL_SetError("Pixel kernels require separate surfaces");
+    }
+    if (SDL_LockSurface(src) != 0) {
+        return -1;
+    }
+    if (SDL_LockSurface(dst) != 0) {
+        SDL_UnlockSurface(src);
+        return -1;
+    }
+    auto result = convert_pixels(src->w, src->h,
+                                 src->format->format, src->pixels, src->pitch,
+                                 dst->format->format, dst->pixels, dst->pitch);
+    SDL_UnlockSurface(dst);
+    SDL_UnlockSurface(src);
+    return result;
+}
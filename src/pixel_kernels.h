@@ -0,0 +1,53 @@
+// ============================================================================
+// PIXEL KERNELS
+// ============================================================================
+// Software pixel kernels for 32-bit SDL_Surface buffers with variants for the
+// vector instruction sets that SDL is able to detect at runtime.
+//
+// fill......Fill a span of pixels with a single color.
+// copy......Copy a span of pixels (blit without blending).
+// blend.....Alpha blend a span of non-premultiplied pixels over another
+//           span (source over). Alpha must be in the highest byte.
+// swizzle...Swap the highest and lowest color channel of each pixel which
+//           converts between ARGB8888 <-> ABGR8888 and RGB888 <-> BGR888.
+//
+// The dispatch table is resolved once on the first use based on the probes
+// SDL_HasAVX2, SDL_HasSSE41 and SDL_HasSSE2 and all variants produce exactly
+// the same results. Vector variants are only compiled for x86 targets.
+// ============================================================================
+#pragma once
+
+#include <SDL.h>
+
+enum PixelIsa {
+    PIXEL_ISA_SCALAR,
+    PIXEL_ISA_SSE2,
+    PIXEL_ISA_SSE41,
+    PIXEL_ISA_AVX2,
+    PIXEL_ISA_COUNT
+};
+
+struct PixelKernels {
+    PixelIsa    isa;
+    const char* name;
+    void (*fill)(Uint32* dst, int count, Uint32 color);
+    void (*copy)(Uint32* dst, const Uint32* src, int count);
+    void (*blend)(Uint32* dst, const Uint32* src, int count);
+    void (*swizzle)(Uint32* dst, const Uint32* src, int count);
+};
+
+// the kernels for the best instruction set supported by the CPU.
+const PixelKernels& pixel_kernels();
+// the kernels of a specific instruction set or NULL if not supported.
+const PixelKernels* pixel_kernels_for(PixelIsa isa);
+
+// ============================================================================
+// Surface operations which use the dispatched kernels row by row. All of the
+// functions return 0 on success or -1 on failure (see SDL_GetError).
+// ============================================================================
+int surface_fill(SDL_Surface* dst, const SDL_Rect* rect, Uint32 color);
+int surface_copy(SDL_Surface* src, const SDL_Rect* srcRect, SDL_Surface* dst, int x, int y);
+int surface_blend(SDL_Surface* src, const SDL_Rect* srcRect, SDL_Surface* dst, int x, int y);
+// convert between two surfaces of the same size with convert_pixels, which
+// uses the kernels or the specialized converters (see pixel_convert.h).
+int surface_convert(SDL_Surface* src, SDL_Surface* dst);
@@ -0,0 +1,44 @@
+// ============================================================================
+// PLUGIN API
+// ============================================================================
+// The interface between the PluginHost (plugin_host.h) and the plugin modules.
+// A plugin is a shared object that exports the following C functions.
+//
+// sandbox_plugin_info......Required. The API version, the name and the size
+//                          and the version of the state of the plugin.
+// sandbox_plugin_load......Required. Called after each load with the state.
+//                          The reloaded flag is zero when the state is new
+//                          (zero filled) and one when it is kept over a swap.
+// sandbox_plugin_unload....Optional. Called before the module is unloaded.
+// sandbox_plugin_update....Optional. Called on each update of the main loop.
+// sandbox_plugin_render....Optional. Called when the renderer draws a frame.
+//
+// The state is owned by the host, so a plugin must keep all of its data that
+// should survive a reload in the state block and not in static variables. A
+// plugin that changes the layout of its state must bump the state version,
+// which gives it a new zero filled state instead of the old one.
+// ============================================================================
+#pragma once
+
+#include <SDL.h>
+
+#define SANDBOX_PLUGIN_API_VERSION 1
+
+#ifdef _WIN32
+#define SANDBOX_PLUGIN_EXPORT extern "C" __declspec(dllexport)
+#else
+#define SANDBOX_PLUGIN_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+struct SandboxPluginInfo {
+    Uint32      apiVersion;   // SANDBOX_PLUGIN_API_VERSION
+    const char* name;
+    Uint32      stateSize;    // the bytes of the state block, at most 64 KiB.
+    Uint32      stateVersion; // a change discards the old state on reload.
+};
+
+typedef const SandboxPluginInfo* (*SandboxPluginInfoFunction)();
+typedef void (*SandboxPluginLoadFunction)(void* state, int reloaded);
+typedef void (*SandboxPluginUnloadFunction)(void* state);
+typedef void (*SandboxPluginUpdateFunction)(void* state, double dt);
+typedef void (*SandboxPluginRenderFunction)(void* state, SDL_Renderer* renderer);
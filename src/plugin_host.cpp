@@ -0,0 +1,268 @@
+#include "plugin_host.h"
+#include "cache_line.h"
+
+#include <cstdio>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+static const size_t COPY_BUFFER_SIZE = 64 * 1024;
+
+static Sint64 last_swap(void* data)
+{
+    return static_cast<PluginHost*>(data)->last_swap_us();
+}
+
+// copy the file with SDL_RWops. Returns false on failure (see SDL_GetError).
+static bool copy_file(const char* from, const char* to)
+{
+    auto source = SDL_RWFromFile(from, "rb");
+    if (source == NULL) {
+        return false;
+    }
+    auto target = SDL_RWFromFile(to, "wb");
+    if (target == NULL) {
+        SDL_RWclose(source);
+        return false;
+    }
+    std::string buffer(COPY_BUFFER_SIZE, '\0');
+    auto result = true;
+    size_t length = 0;
+    while (result && (length = SDL_RWread(source, &buffer[0], 1, buffer.size())) > 0) {
+        result = SDL_RWwrite(target, buffer.data(), 1, length) == length;
+    }
+    SDL_RWclose(source);
+    if (SDL_RWclose(target) != 0) {
+        result = false;
+    }
+    return result;
+}
+
+PluginHost::PluginHost()
+    : mArena(static_cast<Uint8*>(cache_aligned_alloc(MAX_PLUGINS * MAX_STATE_SIZE))),
+      mNumPlugins(0),
+      mNextPoll(0),
+      mLastSwapUs(0)
+{
+    if (mArena != NULL) {
+        SDL_memset(mArena, 0, MAX_PLUGINS * MAX_STATE_SIZE);
+    }
+    auto prefPath = SDL_GetPrefPath("organization_name", "application_name");
+    if (prefPath != NULL) {
+        mCopyDir = prefPath;
+        SDL_free(prefPath);
+    }
+}
+
+PluginHost::~PluginHost()
+{
+    for (auto i = 0; i < mNumPlugins; i++) {
+        auto& plugin = mPlugins[i];
+        if (plugin.module.unload != NULL) {
+            plugin.module.unload(plugin.state);
+        }
+        close_module(&plugin.module);
+    }
+    cache_aligned_free(mArena);
+}
+
+bool PluginHost::load(const char* path)
+{
+    if (mArena == NULL || mNumPlugins >= MAX_PLUGINS) {
+        SDL_Log("Unable to load the plugin %s: all %d slots are in use.\n", path, MAX_PLUGINS);
+        return false;
+    }
+    auto& plugin = mPlugins[mNumPlugins];
+    plugin.path = path;
+    plugin.loadedTime = modification_time(path);
+    plugin.pendingTime = plugin.loadedTime;
+    plugin.generation = 0;
+    plugin.state = mArena + size_t(mNumPlugins) * MAX_STATE_SIZE;
+    if (!open_module(&plugin, &plugin.module)) {
+        return false;
+    }
+    mNumPlugins++;
+    plugin.module.load(plugin.state, 0);
+    SDL_Log("Loaded the plugin %s from %s\n", plugin.module.info->name, path);
+    return true;
+}
+
+void PluginHost::poll()
+{
+    auto now = SDL_GetTicks();
+    if (!SDL_TICKS_PASSED(now, mNextPoll)) {
+        return;
+    }
+    mNextPoll = now + POLL_INTERVAL_MS;
+    for (auto i = 0; i < mNumPlugins; i++) {
+        auto& plugin = mPlugins[i];
+        auto time = modification_time(plugin.path.c_str());
+        auto stable = time == plugin.pendingTime;
+        plugin.pendingTime = time;
+        if (time < 0 || time == plugin.loadedTime || !stable) {
+            continue;
+        }
+        // a failed reload is retried only after the file changes again.
+        plugin.loadedTime = time;
+        reload(&plugin);
+    }
+}
+
+void PluginHost::update(double dt)
+{
+    for (auto i = 0; i < mNumPlugins; i++) {
+        auto& plugin = mPlugins[i];
+        if (plugin.module.update != NULL) {
+            plugin.module.update(plugin.state, dt);
+        }
+    }
+}
+
+void PluginHost::render(SDL_Renderer* renderer)
+{
+    for (auto i = 0; i < mNumPlugins; i++) {
+        auto& plugin = mPlugins[i];
+        if (plugin.module.render != NULL) {
+            plugin.module.render(plugin.state, renderer);
+        }
+    }
+}
+
+void PluginHost::add_counters()
+{
+    auto& registry = CounterRegistry::instance();
+    registry.add_counter("plugin reloads", &mReloads);
+    registry.add_counter("plugin failures", &mFailures);
+    registry.add_gauge("plugin swap us", last_swap, this);
+}
+
+void PluginHost::remove_counters()
+{
+    auto& registry = CounterRegistry::instance();
+    registry.remove("plugin reloads");
+    registry.remove("plugin failures");
+    registry.remove("plugin swap us");
+}
+
+Sint64 PluginHost::modification_time(const char* path)
+{
+#ifdef _WIN32
+    struct _stat info;
+    if (_stat(path, &info) != 0) {
+        return -1;
+    }
+    return Sint64(info.st_mtime) * 1000000000;
+#else
+    struct stat info;
+    if (stat(path, &info) != 0) {
+        return -1;
+    }
+#if defined(__APPLE__)
+    return Sint64(info.st_mtimespec.tv_sec) * 1000000000 + info.st_mtimespec.tv_nsec;
+#elif defined(__linux__)
+    return Sint64(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+#else
+    return Sint64(info.st_mtime) * 1000000000;
+#endif
+#endif
+}
+
+bool PluginHost::open_module(Plugin* plugin, Module* module)
+{
+    // load a copy with the generation in its name, e.g. plugin0-3.so.
+    auto extension = plugin->path.find_last_of('.');
+    auto separator = plugin->path.find_last_of("/\\");
+    if (extension == std::string::npos || (separator != std::string::npos && extension < separator)) {
+        extension = plugin->path.size();
+    }
+    char name[64];
+    SDL_snprintf(name, sizeof(name), "plugin%d-%u", int(plugin - mPlugins), plugin->generation);
+
+    module->object = NULL;
+    module->copyPath = mCopyDir + name + plugin->path.substr(extension);
+    module->info = NULL;
+    if (!copy_file(plugin->path.c_str(), module->copyPath.c_str())) {
+        SDL_Log("Unable to copy the plugin %s: %s\n", plugin->path.c_str(), SDL_GetError());
+        std::remove(module->copyPath.c_str());
+        return false;
+    }
+    module->object = SDL_LoadObject(module->copyPath.c_str());
+    if (module->object == NULL) {
+        SDL_Log("Unable to load the plugin %s: %s\n", plugin->path.c_str(), SDL_GetError());
+        close_module(module);
+        return false;
+    }
+    auto info = reinterpret_cast<SandboxPluginInfoFunction>(SDL_LoadFunction(module->object, "sandbox_plugin_info"));
+    module->load = reinterpret_cast<SandboxPluginLoadFunction>(SDL_LoadFunction(module->object, "sandbox_plugin_load"));
+    module->unload = reinterpret_cast<SandboxPluginUnloadFunction>(SDL_LoadFunction(module->object, "sandbox_plugin_unload"));
+    module->update = reinterpret_cast<SandboxPluginUpdateFunction>(SDL_LoadFunction(module->object, "sandbox_plugin_update"));
+    module->render = reinterpret_cast<SandboxPluginRenderFunction>(SDL_LoadFunction(module->object, "sandbox_plugin_render"));
+    // the optional functions are allowed to be missing.
+    SDL_ClearError();
+    module->info = info != NULL ? info() : NULL;
+    if (module->info == NULL || module->load == NULL) {
+        SDL_Log("The plugin %s does not export the plugin functions.\n", plugin->path.c_str());
+        close_module(module);
+        return false;
+    }
+    if (module->info->apiVersion != SANDBOX_PLUGIN_API_VERSION || module->info->stateSize > MAX_STATE_SIZE) {
+        SDL_Log("The plugin %s has API version %u and %u bytes of state (supported: %u and %u).\n",
+                plugin->path.c_str(),
+                module->info->apiVersion,
+                module->info->stateSize,
+                Uint32(SANDBOX_PLUGIN_API_VERSION),
+                MAX_STATE_SIZE);
+        close_module(module);
+        return false;
+    }
+    return true;
+}
+
+void PluginHost::close_module(Module* module)
+{
+    if (module->object != NULL) {
+        SDL_UnloadObject(module->object);
+        module->object = NULL;
+    }
+    module->info = NULL;
+    if (!module->copyPath.empty()) {
+        std::remove(module->copyPath.c_str());
+        module->copyPath.clear();
+    }
+}
+
+bool PluginHost::reload(Plugin* plugin)
+{
+    plugin->generation++;
+    Module module;
+    if (!open_module(plugin, &module)) {
+        mFailures.increment();
+        return false;
+    }
+    auto keepState = module.info->stateSize == plugin->module.info->stateSize
+                  && module.info->stateVersion == plugin->module.info->stateVersion;
+
+    // the old copy is deleted after the swap, as it is not needed for it.
+    auto oldCopyPath = plugin->module.copyPath;
+    plugin->module.copyPath.clear();
+    auto start = SDL_GetPerformanceCounter();
+    if (plugin->module.unload != NULL) {
+        plugin->module.unload(plugin->state);
+    }
+    close_module(&plugin->module);
+    if (!keepState) {
+        SDL_memset(plugin->state, 0, MAX_STATE_SIZE);
+    }
+    plugin->module = module;
+    plugin->module.load(plugin->state, keepState ? 1 : 0);
+    auto ticks = SDL_GetPerformanceCounter() - start;
+    std::remove(oldCopyPath.c_str());
+
+    mLastSwapUs = Sint64(ticks * 1000000 / SDL_GetPerformanceFrequency());
+    mReloads.increment();
+    SDL_Log("Reloaded the plugin %s (generation %u) in %lld us%s.\n",
+            plugin->module.info->name,
+            plugin->generation,
+            (long long)mLastSwapUs,
+            keepState ? "" : " with a new state");
+    return true;
+}
@@ -0,0 +1,98 @@
+// ============================================================================
+// PLUGIN HOST
+// ============================================================================
+// Loads plugin modules with SDL_LoadObject and SDL_LoadFunction and reloads
+// them when their files change, so that the code of a plugin can be rebuilt
+// and swapped into the running sandbox without relinking and restarting it.
+//
+// poll()......[main] Check the modification times of the plugin files. The
+//             check is done between the frames in the update of the loop.
+//             A changed file is reloaded only after its time has remained
+//             the same over two checks, so a file that is still being linked
+//             is not loaded half written.
+// update()....[main] Call the update function of every plugin.
+// render()....[main] Call the render function of every plugin.
+//
+// A reload is done in two steps. The slow step copies the module into a new
+// file with a generation number and loads the copy, while the old module is
+// still running. The copy keeps the loader from reusing the old module with
+// the same path and the linker from writing into a loaded file. The swap step
+// then only unloads the old module and calls the load of the new one, which
+// takes microseconds. If the new module fails to load, the old one is kept.
+//
+// The states of the plugins are slots of a single arena that is owned by the
+// host, so a state survives the swap unless its size or version changes (see
+// plugin_api.h). The reloads and the time of the latest swap are counted.
+// ============================================================================
+#pragma once
+
+#include <SDL.h>
+
+#include "counters.h"
+#include "plugin_api.h"
+
+#include <string>
+
+class PluginHost {
+public:
+    static const int    MAX_PLUGINS = 8;
+    static const Uint32 MAX_STATE_SIZE = 64 * 1024;
+    static const Uint32 POLL_INTERVAL_MS = 250;
+
+    PluginHost();
+    // unload the plugins and delete the copies of the modules.
+    ~PluginHost();
+
+    // load the plugin module from the path. Returns false on failure.
+    bool load(const char* path);
+    void poll();
+    void update(double dt);
+    void render(SDL_Renderer* renderer);
+
+    int num_plugins() const { return mNumPlugins; }
+
+    const ShardedCounter& reloads() const      { return mReloads; }
+    const ShardedCounter& failures() const     { return mFailures; }
+    Sint64                last_swap_us() const { return mLastSwapUs; }
+
+    void add_counters();
+    void remove_counters();
+
+private:
+    struct Module {
+        void*                       object;
+        std::string                 copyPath;
+        const SandboxPluginInfo*    info;
+        SandboxPluginLoadFunction   load;
+        SandboxPluginUnloadFunction unload;
+        SandboxPluginUpdateFunction update;
+        SandboxPluginRenderFunction render;
+    };
+
+    struct Plugin {
+        std::string path;
+        Module      module;
+        Sint64      loadedTime;  // the modification time of the loaded file.
+        Sint64      pendingTime; // the time seen on the previous check.
+        Uint32      generation;
+        void*       state;
+    };
+
+    PluginHost(const PluginHost&);
+    PluginHost& operator=(const PluginHost&);
+
+    static Sint64 modification_time(const char* path);
+
+    bool open_module(Plugin* plugin, Module* module);
+    void close_module(Module* module);
+    bool reload(Plugin* plugin);
+
+    Uint8*         mArena;
+    Plugin         mPlugins[MAX_PLUGINS];
+    int            mNumPlugins;
+    Uint32         mNextPoll;
+    std::string    mCopyDir;
+    Sint64         mLastSwapUs;
+    ShardedCounter mReloads;
+    ShardedCounter mFailures;
+};
@@ -0,0 +1,210 @@
+#include "power_governor.h"
+#include "profiler.h"
+
+static Sint64 quality(void* data)
+{
+    return static_cast<PowerGovernor*>(data)->level();
+}
+
+static Sint64 battery(void* data)
+{
+    return static_cast<PowerGovernor*>(data)->battery_percent();
+}
+
+const char* const PowerGovernor::WORK_SECTION = "frame work";
+
+PowerGovernor::PowerGovernor(PowerPolicy policy, int fullRate, int fullWorkers)
+    : mPolicy(policy),
+      mFullRate(SDL_max(fullRate, 1)),
+      mFullWorkers(SDL_max(fullWorkers, 1)),
+      mSection(Profiler::instance().section(WORK_SECTION)),
+      mLevel(QUALITY_HIGH),
+      mPowerState(SDL_POWERSTATE_UNKNOWN),
+      mBatteryPercent(-1),
+      mLowBattery(false),
+      mDownSamples(0),
+      mUpSamples(0),
+      mNextSample(SDL_GetTicks() + SAMPLE_INTERVAL_MS),
+      mLastChange(SDL_GetTicks())
+{
+    sample_power();
+    mLevel = policy_level();
+    mSettings = settings_of(mLevel);
+    SDL_Log("Power policy %s selected the %s quality (%d Hz, %d workers, %d%% resolution).\n",
+            policy_name(mPolicy),
+            level_name(mLevel),
+            mSettings.updateRate,
+            mSettings.workers,
+            int(mSettings.renderScale * 100.0f));
+}
+
+bool PowerGovernor::update()
+{
+    auto now = SDL_GetTicks();
+    if (!SDL_TICKS_PASSED(now, mNextSample)) {
+        return false;
+    }
+    mNextSample = now + SAMPLE_INTERVAL_MS;
+    sample_power();
+
+    // the policy level is limited by the frame times of the current level.
+    auto target = policy_level();
+    Profiler::Summary summary;
+    if (Profiler::instance().summary(mSection, &summary) && summary.samples > 0) {
+        if (frame_load(summary.p99, mLevel) >= THROTTLE_PERCENT) {
+            target = QualityLevel(SDL_max(int(QUALITY_LOW), SDL_min(int(target), mLevel - 1)));
+        } else if (target > mLevel && frame_load(summary.p99, QualityLevel(mLevel + 1)) > HEADROOM_PERCENT) {
+            target = mLevel;
+        }
+    }
+    // the quality is raised one level at a time.
+    if (target > mLevel) {
+        target = QualityLevel(mLevel + 1);
+    }
+
+    if (target < mLevel) {
+        mDownSamples++;
+        mUpSamples = 0;
+    } else if (target > mLevel) {
+        mUpSamples++;
+        mDownSamples = 0;
+    } else {
+        mDownSamples = 0;
+        mUpSamples = 0;
+    }
+    if ((mDownSamples >= DOWN_SAMPLES || mUpSamples >= UP_SAMPLES)
+        && SDL_TICKS_PASSED(now, mLastChange + HOLD_MS)) {
+        change_level(target, now);
+        return true;
+    }
+    return false;
+}
+
+void PowerGovernor::add_counters()
+{
+    auto& registry = CounterRegistry::instance();
+    registry.add_counter("power changes", &mChanges);
+    registry.add_gauge("power quality", quality, this);
+    registry.add_gauge("power battery pct", battery, this);
+}
+
+void PowerGovernor::remove_counters()
+{
+    auto& registry = CounterRegistry::instance();
+    registry.remove("power changes");
+    registry.remove("power quality");
+    registry.remove("power battery pct");
+}
+
+bool PowerGovernor::parse_policy(const char* text, PowerPolicy* policy)
+{
+    if (SDL_strcmp(text, "performance") == 0) {
+        *policy = POWER_POLICY_PERFORMANCE;
+    } else if (SDL_strcmp(text, "balanced") == 0) {
+        *policy = POWER_POLICY_BALANCED;
+    } else if (SDL_strcmp(text, "battery") == 0) {
+        *policy = POWER_POLICY_BATTERY_SAVER;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* PowerGovernor::policy_name(PowerPolicy policy)
+{
+    switch (policy) {
+        case POWER_POLICY_PERFORMANCE:
+            return "performance";
+        case POWER_POLICY_BALANCED:
+            return "balanced";
+        case POWER_POLICY_BATTERY_SAVER:
+            return "battery saver";
+    }
+    return "unknown";
+}
+
+const char* PowerGovernor::level_name(QualityLevel level)
+{
+    switch (level) {
+        case QUALITY_LOW:
+            return "low";
+        case QUALITY_MEDIUM:
+            return "medium";
+        case QUALITY_HIGH:
+            return "high";
+    }
+    return "unknown";
+}
+
+void PowerGovernor::sample_power()
+{
+    auto seconds = -1;
+    auto percent = -1;
+    mPowerState = SDL_GetPowerInfo(&seconds, &percent);
+    mBatteryPercent = percent;
+    if (mPowerState != SDL_POWERSTATE_ON_BATTERY) {
+        mLowBattery = false;
+    } else if (percent >= 0 && percent <= LOW_BATTERY_PERCENT) {
+        mLowBattery = true;
+    } else if (percent >= RESTORE_BATTERY_PERCENT) {
+        mLowBattery = false;
+    }
+}
+
+QualityLevel PowerGovernor::policy_level() const
+{
+    auto onBattery = mPowerState == SDL_POWERSTATE_ON_BATTERY;
+    switch (mPolicy) {
+        case POWER_POLICY_PERFORMANCE:
+            return mLowBattery ? QUALITY_MEDIUM : QUALITY_HIGH;
+        case POWER_POLICY_BALANCED:
+            return mLowBattery ? QUALITY_LOW : (onBattery ? QUALITY_MEDIUM : QUALITY_HIGH);
+        case POWER_POLICY_BATTERY_SAVER:
+            return onBattery ? QUALITY_LOW : QUALITY_MEDIUM;
+    }
+    return QUALITY_HIGH;
+}
+
+PowerSettings PowerGovernor::settings_of(QualityLevel level) const
+{
+    PowerSettings settings;
+    switch (level) {
+        case QUALITY_LOW:
+            settings.updateRate = SDL_min(mFullRate, 30);
+            settings.workers = SDL_max(mFullWorkers / 4, 1);
+            settings.renderScale = 0.5f;
+            break;
+        case QUALITY_MEDIUM:
+            settings.updateRate = SDL_min(mFullRate, 60);
+            settings.workers = SDL_max(mFullWorkers / 2, 1);
+            settings.renderScale = 0.75f;
+            break;
+        default:
+            settings.updateRate = mFullRate;
+            settings.workers = mFullWorkers;
+            settings.renderScale = 1.0f;
+            break;
+    }
+    return settings;
+}
+
+int PowerGovernor::frame_load(Uint64 p99Ticks, QualityLevel level) const
+{
+    auto budgetTicks = SDL_GetPerformanceFrequency() / Uint64(settings_of(level).updateRate);
+    return int(SDL_min(p99Ticks * 100 / SDL_max(budgetTicks, Uint64(1)), Uint64(1000)));
+}
+
+void PowerGovernor::change_level(QualityLevel level, Uint32 now)
+{
+    SDL_Log("Power governor: %s -> %s quality (%s, battery %d%%).\n",
+            level_name(mLevel),
+            level_name(level),
+            mPowerState == SDL_POWERSTATE_ON_BATTERY ? "on battery" : "on AC",
+            mBatteryPercent);
+    mLevel = level;
+    mSettings = settings_of(level);
+    mLastChange = now;
+    mDownSamples = 0;
+    mUpSamples = 0;
+    mChanges.increment();
+}
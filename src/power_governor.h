@@ -0,0 +1,124 @@
+// ============================================================================
+// POWER GOVERNOR
+// ============================================================================
+// Adapts the quality of the sandbox to the power state of the device, so that
+// a laptop or a handheld on battery does not run the full workload until it
+// throttles. The power state is sampled with SDL_GetPowerInfo once per sample
+// interval along with the frame times of the WORK_SECTION of the profiler. The
+// application adds the CPU time of its updates and of its drawing into that
+// section, but not the present, which blocks until the vblank with vsync and
+// would make every frame look like it used the whole frame budget.
+//
+// update()...[main] Sample when the interval has passed and select the level.
+//            Returns true when the level has changed, i.e. when the settings
+//            should be applied to the loop, the thread pool and the renderer.
+//
+// The quality levels have the following settings.
+//
+// QUALITY_LOW......At most 30 Hz, a quarter of the workers and 50% resolution.
+// QUALITY_MEDIUM...At most 60 Hz, half of the workers and 75% resolution.
+// QUALITY_HIGH.....The full rate, all of the workers and the full resolution.
+//
+// The policy selects the level for the power state of the device.
+//
+// POWER_POLICY_PERFORMANCE.....High, or medium when the battery is low.
+// POWER_POLICY_BALANCED........High on AC, medium on battery and low when the
+//                              battery is low.
+// POWER_POLICY_BATTERY_SAVER...Medium on AC and low on battery.
+//
+// SDL has no thermal information, but a throttled CPU or GPU shows up as long
+// frames. When the p99 frame time exceeds THROTTLE_PERCENT of the frame budget
+// the level is lowered below the policy level, and it is raised again when the
+// p99 would fit within HEADROOM_PERCENT of the budget of the higher level.
+//
+// The transitions use hysteresis so the quality does not oscillate. The low
+// battery state is entered at LOW_BATTERY_PERCENT and left only at the higher
+// RESTORE_BATTERY_PERCENT. A lower level is taken after DOWN_SAMPLES samples
+// in a row and a higher after UP_SAMPLES, and no change is made within HOLD_MS
+// of the previous change.
+// ============================================================================
+#pragma once
+
+#include <SDL.h>
+
+#include "counters.h"
+
+enum PowerPolicy {
+    POWER_POLICY_PERFORMANCE,
+    POWER_POLICY_BALANCED,
+    POWER_POLICY_BATTERY_SAVER
+};
+
+enum QualityLevel {
+    QUALITY_LOW,
+    QUALITY_MEDIUM,
+    QUALITY_HIGH
+};
+
+struct PowerSettings {
+    int   updateRate;  // the frame-rate cap of the fixed-timestep loop.
+    int   workers;     // the active workers of the thread pool.
+    float renderScale; // the resolution scale of the renderer.
+};
+
+class PowerGovernor {
+public:
+    static const Uint32 SAMPLE_INTERVAL_MS = 1000;
+    static const Uint32 HOLD_MS = 5000;
+    static const int    DOWN_SAMPLES = 3;
+    static const int    UP_SAMPLES = 10;
+    static const int    LOW_BATTERY_PERCENT = 20;
+    static const int    RESTORE_BATTERY_PERCENT = 30;
+    static const int    THROTTLE_PERCENT = 90;
+    static const int    HEADROOM_PERCENT = 50;
+    static const char* const WORK_SECTION;
+
+    // govern a loop of the full rate and a pool of the full amount of workers.
+    PowerGovernor(PowerPolicy policy, int fullRate, int fullWorkers);
+
+    // the initial level is selected by the constructor without hysteresis.
+    bool update();
+
+    PowerPolicy           policy() const          { return mPolicy; }
+    QualityLevel          level() const           { return mLevel; }
+    const PowerSettings&  settings() const        { return mSettings; }
+    // the latest sampled power state and battery percentage (-1 = unknown).
+    SDL_PowerState        power_state() const     { return mPowerState; }
+    int                   battery_percent() const { return mBatteryPercent; }
+    const ShardedCounter& changes() const         { return mChanges; }
+
+    void add_counters();
+    void remove_counters();
+
+    // parse the policy from a text (i.e. "performance", "balanced" or "battery").
+    static bool parse_policy(const char* text, PowerPolicy* policy);
+    static const char* policy_name(PowerPolicy policy);
+    static const char* level_name(QualityLevel level);
+
+private:
+    PowerGovernor(const PowerGovernor&);
+    PowerGovernor& operator=(const PowerGovernor&);
+
+    void          sample_power();
+    // the level that the policy gives for the sampled power state.
+    QualityLevel  policy_level() const;
+    PowerSettings settings_of(QualityLevel level) const;
+    // the p99 frame time in percents of the frame budget of the level.
+    int           frame_load(Uint64 p99Ticks, QualityLevel level) const;
+    void          change_level(QualityLevel level, Uint32 now);
+
+    PowerPolicy    mPolicy;
+    int            mFullRate;
+    int            mFullWorkers;
+    int            mSection;
+    QualityLevel   mLevel;
+    PowerSettings  mSettings;
+    SDL_PowerState mPowerState;
+    int            mBatteryPercent;
+    bool           mLowBattery;
+    int            mDownSamples;
+    int            mUpSamples;
+    Uint32         mNextSample;
+    Uint32         mLastChange;
+    ShardedCounter mChanges;
+};
@@ -0,0 +1,160 @@
+#include "profiler.h"
+#include "counters.h"
+
+#include <algorithm>
+
+Profiler& Profiler::instance()
+{
+    static Profiler sProfiler;
+    return sProfiler;
+}
+
+Profiler::Profiler() : mNumSections(0), mLock(0)
+{
+    SDL_zeroa(mSections);
+}
+
+int Profiler::section(const char* name)
+{
+    SDL_AtomicLock(&mLock);
+    auto index = -1;
+    for (auto i = 0; i < mNumSections; i++) {
+        if (SDL_strcmp(mSections[i].name, name) == 0) {
+            index = i;
+            break;
+        }
+    }
+    if (index == -1 && mNumSections < MAX_SECTIONS) {
+        index = mNumSections++;
+        mSections[index].name = name;
+    }
+    SDL_AtomicUnlock(&mLock);
+    if (index == -1) {
+        SDL_Log("Profiler is out of sections, ignoring: %s\n", name);
+    }
+    return index;
+}
+
+void Profiler::add(int section, Uint64 ticks)
+{
+    if (section < 0) {
+        return;
+    }
+    SDL_AtomicLock(&mLock);
+    mSections[section].frameTicks += ticks;
+    mSections[section].touched = true;
+    SDL_AtomicUnlock(&mLock);
+}
+
+void Profiler::end_frame()
+{
+    SDL_AtomicLock(&mLock);
+    for (auto i = 0; i < mNumSections; i++) {
+        auto& section = mSections[i];
+        if (section.touched) {
+            section.samples[section.head] = section.frameTicks;
+            section.head = (section.head + 1) % MAX_SAMPLES;
+            section.count = SDL_min(section.count + 1, Uint32(MAX_SAMPLES));
+            section.frameTicks = 0;
+            section.touched = false;
+        }
+    }
+    SDL_AtomicUnlock(&mLock);
+}
+
+int Profiler::num_sections() const
+{
+    SDL_AtomicLock(&mLock);
+    auto count = mNumSections;
+    SDL_AtomicUnlock(&mLock);
+    return count;
+}
+
+bool Profiler::summary(int section, Summary* summary) const
+{
+    Uint64 samples[MAX_SAMPLES];
+    SDL_AtomicLock(&mLock);
+    if (section < 0 || section >= mNumSections) {
+        SDL_AtomicUnlock(&mLock);
+        return false;
+    }
+    summary->name = mSections[section].name;
+    summary->samples = mSections[section].count;
+    SDL_memcpy(samples, mSections[section].samples, sizeof(samples));
+    SDL_AtomicUnlock(&mLock);
+
+    // the ring buffer content is in use order only when it has wrapped, but
+    // the order does not matter for the statistics that are calculated here.
+    auto count = summary->samples;
+    if (count == 0) {
+        summary->min = summary->mean = summary->p99 = summary->max = 0;
+        return true;
+    }
+    std::sort(samples, samples + count);
+    Uint64 total = 0;
+    for (Uint32 i = 0; i < count; i++) {
+        total += samples[i];
+    }
+    summary->min = samples[0];
+    summary->mean = total / count;
+    summary->p99 = samples[(count * 99 + 99) / 100 - 1];
+    summary->max = samples[count - 1];
+    return true;
+}
+
+void Profiler::log_report() const
+{
+    auto micros = 1000000.0 / SDL_GetPerformanceFrequency();
+    SDL_Log("Profiler report (microseconds per frame):\n");
+    for (auto i = 0; i < num_sections(); i++) {
+        Summary s;
+        if (summary(i, &s)) {
+            SDL_Log("\t%-24s n=%3u min=%10.1f mean=%10.1f p99=%10.1f max=%10.1f\n",
+                    s.name,
+                    s.samples,
+                    s.min * micros,
+                    s.mean * micros,
+                    s.p99 * micros,
+                    s.max * micros);
+        }
+    }
+    CounterRegistry::instance().log_report();
+}
+
+bool Profiler::write_csv(const char* path) const
+{
+    auto file = SDL_RWFromFile(path, "w");
+    if (file == NULL) {
+        SDL_Log("Failed to open profiler CSV file: %s\n", SDL_GetError());
+        return false;
+    }
+
+    char line[256];
+    auto len = SDL_snprintf(line, sizeof(line),
+        "section,samples,min_ticks,mean_ticks,p99_ticks,max_ticks,frequency\n");
+    auto result = SDL_RWwrite(file, line, 1, len) == size_t(len);
+    for (auto i = 0; result && i < num_sections(); i++) {
+        Summary s;
+        if (summary(i, &s)) {
+            len = SDL_snprintf(line, sizeof(line),
+                "\"%s\",%u,%" SDL_PRIu64 ",%" SDL_PRIu64 ",%" SDL_PRIu64
+                ",%" SDL_PRIu64 ",%" SDL_PRIu64 "\n",
+                s.name,
+                s.samples,
+                s.min,
+                s.mean,
+                s.p99,
+                s.max,
+                SDL_GetPerformanceFrequency());
+            result = SDL_RWwrite(file, line, 1, len) == size_t(len);
+        }
+    }
+    if (!result) {
+        SDL_Log("Failed to write profiler CSV file: %s\n", SDL_GetError());
+    }
+    if (SDL_RWclose(file) != 0) {
+        SDL_Log("Failed to close profiler CSV file: %s\n", SDL_GetError());
+        result = false;
+    }
+    return result;
+}
@@ -0,0 +1,99 @@
+// ============================================================================
+// PROFILER
+// ============================================================================
+// A frame-time profiler built on top of the SDL performance counter.
+//
+// Time is measured with RAII scopes that are keyed by a name. Scopes with a
+// same name are summed together within a frame and each frame total is then
+// stored into a fixed-size ring buffer of the section when the frame ends.
+//
+// PROFILE_SCOPE(name)...Measure the time until the end of the current scope.
+// end_frame()...........Commit the frame totals into the ring buffers.
+// summary().............Get min/mean/p99/max ticks of the buffered frames.
+// log_report()..........Write the summaries of all sections and the named
+//                       counters of the CounterRegistry with SDL_Log.
+// write_csv()...........Write the summaries into a file with SDL_RWops.
+//
+// No heap allocations are done by the profiler. Both sections and samples
+// are stored in fixed-size arrays. Scopes can be used from any thread.
+// ============================================================================
+#pragma once
+
+#include <SDL.h>
+
+class Profiler {
+public:
+    static const int MAX_SECTIONS = 64;
+    static const int MAX_SAMPLES  = 256;
+
+    struct Summary {
+        const char* name;
+        Uint32      samples;
+        Uint64      min;
+        Uint64      mean;
+        Uint64      p99;
+        Uint64      max;
+    };
+
+    static Profiler& instance();
+
+    // get the index of the named section. Registers the section when needed.
+    // The name must remain valid as long as the profiler is used.
+    int section(const char* name);
+    // add the provided amount of ticks to the current frame of the section.
+    void add(int section, Uint64 ticks);
+    // commit the frame totals of all sections into their ring buffers.
+    void end_frame();
+
+    int  num_sections() const;
+    bool summary(int section, Summary* summary) const;
+
+    void log_report() const;
+    bool write_csv(const char* path) const;
+
+private:
+    struct Section {
+        const char* name;
+        Uint64      frameTicks;
+        bool        touched;
+        Uint32      head;
+        Uint32      count;
+        Uint64      samples[MAX_SAMPLES];
+    };
+
+    Profiler();
+    Profiler(const Profiler&);
+    Profiler& operator=(const Profiler&);
+
+    int                  mNumSections;
+    mutable SDL_SpinLock mLock;
+    Section              mSections[MAX_SECTIONS];
+};
+
+// ============================================================================
+// A RAII scope that adds its lifetime into the given profiler section.
+// ============================================================================
+class ProfileScope {
+public:
+    explicit ProfileScope(int section)
+        : mSection(section), mStart(SDL_GetPerformanceCounter()) {}
+    ~ProfileScope() {
+        Profiler::instance().add(mSection, SDL_GetPerformanceCounter() - mStart);
+    }
+
+private:
+    ProfileScope(const ProfileScope&);
+    ProfileScope& operator=(const ProfileScope&);
+
+    int    mSection;
+    Uint64 mStart;
+};
+
+// the section index is resolved only once per call site.
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+#define PROFILE_SCOPE(name)                                               \
+    static const int PROFILE_CONCAT(sProfileSection, __LINE__) =          \
+        Profiler::instance().section(name);                               \
+    ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(                  \
+        PROFILE_CONCAT(sProfileSection, __LINE__))
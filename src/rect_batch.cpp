@@ -0,0 +1,542 @@
+#include "rect_batch.h"
+#include "cpu_features.h"
+
+#ifdef SANDBOX_X86
+#include <immintrin.h>
+#endif
+
+struct RectArrays {
+    const int* x;
+    const int* y;
+    const int* w;
+    const int* h;
+    int        count;
+};
+
+// the enclosing bounds as inclusive minimum and exclusive maximum values.
+struct Bounds {
+    int minX;
+    int minY;
+    int maxX;
+    int maxY;
+};
+
+// append the indices of the set bits of the mask into the hits.
+static inline int emit_hits(int mask, int base, int* hits, int count)
+{
+    for (auto bit = 0; mask != 0; bit++, mask >>= 1) {
+        if (mask & 1) {
+            if (hits != NULL) {
+                hits[count] = base + bit;
+            }
+            count++;
+        }
+    }
+    return count;
+}
+
+// ============================================================================
+// SCALAR
+// ============================================================================
+// Range based so that the vector kernels are able to process their tails.
+// ============================================================================
+static int intersect_range(const RectArrays& a, int begin, const SDL_Rect& r, int* hits, int count)
+{
+    for (auto i = begin; i < a.count; i++) {
+        if (a.w[i] > 0 && a.h[i] > 0 &&
+            a.x[i] < r.x + r.w && r.x < a.x[i] + a.w[i] &&
+            a.y[i] < r.y + r.h && r.y < a.y[i] + a.h[i]) {
+            if (hits != NULL) {
+                hits[count] = i;
+            }
+            count++;
+        }
+    }
+    return count;
+}
+
+static int contains_range(const RectArrays& a, int begin, const SDL_Point& p, int* hits, int count)
+{
+    for (auto i = begin; i < a.count; i++) {
+        if (p.x >= a.x[i] && p.x < a.x[i] + a.w[i] &&
+            p.y >= a.y[i] && p.y < a.y[i] + a.h[i]) {
+            if (hits != NULL) {
+                hits[count] = i;
+            }
+            count++;
+        }
+    }
+    return count;
+}
+
+static void bounds_range(const RectArrays& a, int begin, Bounds* b)
+{
+    for (auto i = begin; i < a.count; i++) {
+        if (a.w[i] > 0 && a.h[i] > 0) {
+            b->minX = SDL_min(b->minX, a.x[i]);
+            b->minY = SDL_min(b->minY, a.y[i]);
+            b->maxX = SDL_max(b->maxX, a.x[i] + a.w[i]);
+            b->maxY = SDL_max(b->maxY, a.y[i] + a.h[i]);
+        }
+    }
+}
+
+static void enclose_range(const SDL_Point* points, int begin, int count, const SDL_Rect* clip, Bounds* b)
+{
+    for (auto i = begin; i < count; i++) {
+        const auto& p = points[i];
+        if (clip != NULL && (p.x < clip->x || p.x >= clip->x + clip->w ||
+                             p.y < clip->y || p.y >= clip->y + clip->h)) {
+            continue;
+        }
+        b->minX = SDL_min(b->minX, p.x);
+        b->minY = SDL_min(b->minY, p.y);
+        b->maxX = SDL_max(b->maxX, p.x + 1);
+        b->maxY = SDL_max(b->maxY, p.y + 1);
+    }
+}
+
+static int intersect_scalar(const RectArrays& a, const SDL_Rect& r, int* hits)
+{
+    if (r.w <= 0 || r.h <= 0) {
+        return 0;
+    }
+    return intersect_range(a, 0, r, hits, 0);
+}
+
+static int contains_scalar(const RectArrays& a, const SDL_Point& p, int* hits)
+{
+    return contains_range(a, 0, p, hits, 0);
+}
+
+static void bounds_scalar(const RectArrays& a, Bounds* b)
+{
+    bounds_range(a, 0, b);
+}
+
+static void enclose_scalar(const SDL_Point* points, int count, const SDL_Rect* clip, Bounds* b)
+{
+    enclose_range(points, 0, count, clip, b);
+}
+
+#ifdef SANDBOX_X86
+// ============================================================================
+// SSE2
+// ============================================================================
+// Four rects per iteration. SSE2 has no 32-bit min/max, so they are built by
+// selecting with the comparison masks.
+// ============================================================================
+SANDBOX_TARGET("sse2")
+static inline __m128i select_sse2(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+SANDBOX_TARGET("sse2")
+static inline __m128i min_sse2(__m128i a, __m128i b)
+{
+    return select_sse2(_mm_cmpgt_epi32(a, b), b, a);
+}
+
+SANDBOX_TARGET("sse2")
+static inline __m128i max_sse2(__m128i a, __m128i b)
+{
+    return select_sse2(_mm_cmpgt_epi32(a, b), a, b);
+}
+
+SANDBOX_TARGET("sse2")
+static inline __m128i load_sse2(const int* values)
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(values));
+}
+
+SANDBOX_TARGET("sse2")
+static int intersect_sse2(const RectArrays& a, const SDL_Rect& r, int* hits)
+{
+    if (r.w <= 0 || r.h <= 0) {
+        return 0;
+    }
+    const auto zero = _mm_setzero_si128();
+    const auto rx = _mm_set1_epi32(r.x);
+    const auto ry = _mm_set1_epi32(r.y);
+    const auto rx1 = _mm_set1_epi32(r.x + r.w);
+    const auto ry1 = _mm_set1_epi32(r.y + r.h);
+    auto count = 0;
+    auto i = 0;
+    for (; i + 4 <= a.count; i += 4) {
+        auto x = load_sse2(a.x + i);
+        auto y = load_sse2(a.y + i);
+        auto w = load_sse2(a.w + i);
+        auto h = load_sse2(a.h + i);
+        auto mask = _mm_and_si128(_mm_cmpgt_epi32(w, zero), _mm_cmpgt_epi32(h, zero));
+        mask = _mm_and_si128(mask, _mm_and_si128(_mm_cmplt_epi32(x, rx1), _mm_cmpgt_epi32(_mm_add_epi32(x, w), rx)));
+        mask = _mm_and_si128(mask, _mm_and_si128(_mm_cmplt_epi32(y, ry1), _mm_cmpgt_epi32(_mm_add_epi32(y, h), ry)));
+        count = emit_hits(_mm_movemask_ps(_mm_castsi128_ps(mask)), i, hits, count);
+    }
+    return intersect_range(a, i, r, hits, count);
+}
+
+SANDBOX_TARGET("sse2")
+static int contains_sse2(const RectArrays& a, const SDL_Point& p, int* hits)
+{
+    const auto px = _mm_set1_epi32(p.x);
+    const auto py = _mm_set1_epi32(p.y);
+    auto count = 0;
+    auto i = 0;
+    for (; i + 4 <= a.count; i += 4) {
+        auto x = load_sse2(a.x + i);
+        auto y = load_sse2(a.y + i);
+        auto w = load_sse2(a.w + i);
+        auto h = load_sse2(a.h + i);
+        auto mask = _mm_andnot_si128(_mm_cmpgt_epi32(x, px), _mm_cmpgt_epi32(_mm_add_epi32(x, w), px));
+        mask = _mm_and_si128(mask, _mm_andnot_si128(_mm_cmpgt_epi32(y, py), _mm_cmpgt_epi32(_mm_add_epi32(y, h), py)));
+        count = emit_hits(_mm_movemask_ps(_mm_castsi128_ps(mask)), i, hits, count);
+    }
+    return contains_range(a, i, p, hits, count);
+}
+
+// reduce the vectors of minimum and maximum values into the bounds.
+SANDBOX_TARGET("sse2")
+static void reduce_sse2(__m128i minX, __m128i minY, __m128i maxX, __m128i maxY, Bounds* b)
+{
+    int values[4][4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(values[0]), minX);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(values[1]), minY);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(values[2]), maxX);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(values[3]), maxY);
+    for (auto i = 0; i < 4; i++) {
+        b->minX = SDL_min(b->minX, values[0][i]);
+        b->minY = SDL_min(b->minY, values[1][i]);
+        b->maxX = SDL_max(b->maxX, values[2][i]);
+        b->maxY = SDL_max(b->maxY, values[3][i]);
+    }
+}
+
+SANDBOX_TARGET("sse2")
+static void bounds_sse2(const RectArrays& a, Bounds* b)
+{
+    const auto zero = _mm_setzero_si128();
+    const auto high = _mm_set1_epi32(SDL_MAX_SINT32);
+    const auto low = _mm_set1_epi32(SDL_MIN_SINT32);
+    auto minX = high, minY = high, maxX = low, maxY = low;
+    auto i = 0;
+    for (; i + 4 <= a.count; i += 4) {
+        auto x = load_sse2(a.x + i);
+        auto y = load_sse2(a.y + i);
+        auto w = load_sse2(a.w + i);
+        auto h = load_sse2(a.h + i);
+        auto valid = _mm_and_si128(_mm_cmpgt_epi32(w, zero), _mm_cmpgt_epi32(h, zero));
+        minX = min_sse2(minX, select_sse2(valid, x, high));
+        minY = min_sse2(minY, select_sse2(valid, y, high));
+        maxX = max_sse2(maxX, select_sse2(valid, _mm_add_epi32(x, w), low));
+        maxY = max_sse2(maxY, select_sse2(valid, _mm_add_epi32(y, h), low));
+    }
+    reduce_sse2(minX, minY, maxX, maxY, b);
+    bounds_range(a, i, b);
+}
+
+// two interleaved points per iteration, so the even lanes hold x values and
+// the odd lanes hold y values. A point is inside the clip only if both of
+// its lanes are inside, which is checked by swapping the lanes of a pair.
+SANDBOX_TARGET("sse2")
+static void enclose_sse2(const SDL_Point* points, int count, const SDL_Rect* clip, Bounds* b)
+{
+    const auto high = _mm_set1_epi32(SDL_MAX_SINT32);
+    const auto low = _mm_set1_epi32(SDL_MIN_SINT32);
+    const auto one = _mm_set1_epi32(1);
+    auto clipMin = _mm_setzero_si128();
+    auto clipMax = _mm_setzero_si128();
+    if (clip != NULL) {
+        clipMin = _mm_setr_epi32(clip->x, clip->y, clip->x, clip->y);
+        clipMax = _mm_setr_epi32(clip->x + clip->w, clip->y + clip->h, clip->x + clip->w, clip->y + clip->h);
+    }
+    auto minimum = high, maximum = low;
+    auto i = 0;
+    for (; i + 2 <= count; i += 2) {
+        auto p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(points + i));
+        if (clip != NULL) {
+            auto inside = _mm_andnot_si128(_mm_cmplt_epi32(p, clipMin), _mm_cmplt_epi32(p, clipMax));
+            inside = _mm_and_si128(inside, _mm_shuffle_epi32(inside, _MM_SHUFFLE(2, 3, 0, 1)));
+            minimum = min_sse2(minimum, select_sse2(inside, p, high));
+            maximum = max_sse2(maximum, select_sse2(inside, _mm_add_epi32(p, one), low));
+        } else {
+            minimum = min_sse2(minimum, p);
+            maximum = max_sse2(maximum, _mm_add_epi32(p, one));
+        }
+    }
+    int values[2][4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(values[0]), minimum);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(values[1]), maximum);
+    for (auto lane = 0; lane < 4; lane += 2) {
+        b->minX = SDL_min(b->minX, values[0][lane]);
+        b->minY = SDL_min(b->minY, values[0][lane + 1]);
+        b->maxX = SDL_max(b->maxX, values[1][lane]);
+        b->maxY = SDL_max(b->maxY, values[1][lane + 1]);
+    }
+    enclose_range(points, i, count, clip, b);
+}
+
+// ============================================================================
+// AVX2
+// ============================================================================
+// Eight rects (or four interleaved points) per iteration.
+// ============================================================================
+SANDBOX_TARGET("avx2")
+static inline __m256i load_avx2(const int* values)
+{
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values));
+}
+
+SANDBOX_TARGET("avx2")
+static int intersect_avx2(const RectArrays& a, const SDL_Rect& r, int* hits)
+{
+    if (r.w <= 0 || r.h <= 0) {
+        return 0;
+    }
+    const auto zero = _mm256_setzero_si256();
+    const auto rx = _mm256_set1_epi32(r.x);
+    const auto ry = _mm256_set1_epi32(r.y);
+    const auto rx1 = _mm256_set1_epi32(r.x + r.w);
+    const auto ry1 = _mm256_set1_epi32(r.y + r.h);
+    auto count = 0;
+    auto i = 0;
+    for (; i + 8 <= a.count; i += 8) {
+        auto x = load_avx2(a.x + i);
+        auto y = load_avx2(a.y + i);
+        auto w = load_avx2(a.w + i);
+        auto h = load_avx2(a.h + i);
+        auto mask = _mm256_and_si256(_mm256_cmpgt_epi32(w, zero), _mm256_cmpgt_epi32(h, zero));
+        mask = _mm256_and_si256(mask, _mm256_and_si256(_mm256_cmpgt_epi32(rx1, x), _mm256_cmpgt_epi32(_mm256_add_epi32(x, w), rx)));
+        mask = _mm256_and_si256(mask, _mm256_and_si256(_mm256_cmpgt_epi32(ry1, y), _mm256_cmpgt_epi32(_mm256_add_epi32(y, h), ry)));
+        count = emit_hits(_mm256_movemask_ps(_mm256_castsi256_ps(mask)), i, hits, count);
+    }
+    return intersect_range(a, i, r, hits, count);
+}
+
+SANDBOX_TARGET("avx2")
+static int contains_avx2(const RectArrays& a, const SDL_Point& p, int* hits)
+{
+    const auto px = _mm256_set1_epi32(p.x);
+    const auto py = _mm256_set1_epi32(p.y);
+    auto count = 0;
+    auto i = 0;
+    for (; i + 8 <= a.count; i += 8) {
+        auto x = load_avx2(a.x + i);
+        auto y = load_avx2(a.y + i);
+        auto w = load_avx2(a.w + i);
+        auto h = load_avx2(a.h + i);
+        auto mask = _mm256_andnot_si256(_mm256_cmpgt_epi32(x, px), _mm256_cmpgt_epi32(_mm256_add_epi32(x, w), px));
+        mask = _mm256_and_si256(mask, _mm256_andnot_si256(_mm256_cmpgt_epi32(y, py), _mm256_cmpgt_epi32(_mm256_add_epi32(y, h), py)));
+        count = emit_hits(_mm256_movemask_ps(_mm256_castsi256_ps(mask)), i, hits, count);
+    }
+    return contains_range(a, i, p, hits, count);
+}
+
+SANDBOX_TARGET("avx2")
+static void bounds_avx2(const RectArrays& a, Bounds* b)
+{
+    const auto zero = _mm256_setzero_si256();
+    const auto high = _mm256_set1_epi32(SDL_MAX_SINT32);
+    const auto low = _mm256_set1_epi32(SDL_MIN_SINT32);
+    auto minX = high, minY = high, maxX = low, maxY = low;
+    auto i = 0;
+    for (; i + 8 <= a.count; i += 8) {
+        auto x = load_avx2(a.x + i);
+        auto y = load_avx2(a.y + i);
+        auto w = load_avx2(a.w + i);
+        auto h = load_avx2(a.h + i);
+        auto valid = _mm256_and_si256(_mm256_cmpgt_epi32(w, zero), _mm256_cmpgt_epi32(h, zero));
+        minX = _mm256_min_epi32(minX, _mm256_blendv_epi8(high, x, valid));
+        minY = _mm256_min_epi32(minY, _mm256_blendv_epi8(high, y, valid));
+        maxX = _mm256_max_epi32(maxX, _mm256_blendv_epi8(low, _mm256_add_epi32(x, w), valid));
+        maxY = _mm256_max_epi32(maxY, _mm256_blendv_epi8(low, _mm256_add_epi32(y, h), valid));
+    }
+    int values[4][8];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(values[0]), minX);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(values[1]), minY);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(values[2]), maxX);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(values[3]), maxY);
+    for (auto lane = 0; lane < 8; lane++) {
+        b->minX = SDL_min(b->minX, values[0][lane]);
+        b->minY = SDL_min(b->minY, values[1][lane]);
+        b->maxX = SDL_max(b->maxX, values[2][lane]);
+        b->maxY = SDL_max(b->maxY, values[3][lane]);
+    }
+    bounds_range(a, i, b);
+}
+
+SANDBOX_TARGET("avx2")
+static void enclose_avx2(const SDL_Point* points, int count, const SDL_Rect* clip, Bounds* b)
+{
+    const auto high = _mm256_set1_epi32(SDL_MAX_SINT32);
+    const auto low = _mm256_set1_epi32(SDL_MIN_SINT32);
+    const auto one = _mm256_set1_epi32(1);
+    auto clipMin = _mm256_setzero_si256();
+    auto clipMax = _mm256_setzero_si256();
+    if (clip != NULL) {
+        auto right = clip->x + clip->w;
+        auto bottom = clip->y + clip->h;
+        clipMin = _mm256_setr_epi32(clip->x, clip->y, clip->x, clip->y, clip->x, clip->y, clip->x, clip->y);
+        clipMax = _mm256_setr_epi32(right, bottom, right, bottom, right, bottom, right, bottom);
+    }
+    auto minimum = high, maximum = low;
+    auto i = 0;
+    for (; i + 4 <= count; i += 4) {
+        auto p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(points + i));
+        if (clip != NULL) {
+            auto inside = _mm256_andnot_si256(_mm256_cmpgt_epi32(clipMin, p), _mm256_cmpgt_epi32(clipMax, p));
+            inside = _mm256_and_si256(inside, _mm256_shuffle_epi32(inside, _MM_SHUFFLE(2, 3, 0, 1)));
+            minimum = _mm256_min_epi32(minimum, _mm256_blendv_epi8(high, p, inside));
+            maximum = _mm256_max_epi32(maximum, _mm256_blendv_epi8(low, _mm256_add_epi32(p, one), inside));
+        } else {
+            minimum = _mm256_min_epi32(minimum, p);
+            maximum = _mm256_max_epi32(maximum, _mm256_add_epi32(p, one));
+        }
+    }
+    int values[2][8];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(values[0]), minimum);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(values[1]), maximum);
+    for (auto lane = 0; lane < 8; lane += 2) {
+        b->minX = SDL_min(b->minX, values[0][lane]);
+        b->minY = SDL_min(b->minY, values[0][lane + 1]);
+        b->maxX = SDL_max(b->maxX, values[1][lane]);
+        b->maxY = SDL_max(b->maxY, values[1][lane + 1]);
+    }
+    enclose_range(points, i, count, clip, b);
+}
+#endif
+
+// ============================================================================
+// DISPATCH
+// ============================================================================
+struct RectKernels {
+    const char* name;
+    int  (*intersect)(const RectArrays& a, const SDL_Rect& r, int* hits);
+    int  (*contains)(const RectArrays& a, const SDL_Point& p, int* hits);
+    void (*bounds)(const RectArrays& a, Bounds* b);
+    void (*enclose)(const SDL_Point* points, int count, const SDL_Rect* clip, Bounds* b);
+};
+
+static const RectKernels& rect_kernels()
+{
+    static const RectKernels sScalar = { "scalar", intersect_scalar, contains_scalar, bounds_scalar, enclose_scalar };
+#ifdef SANDBOX_X86
+    static const RectKernels sSse2 = { "sse2", intersect_sse2, contains_sse2, bounds_sse2, enclose_sse2 };
+    static const RectKernels sAvx2 = { "avx2", intersect_avx2, contains_avx2, bounds_avx2, enclose_avx2 };
+    static const RectKernels* sSelected = cpu_features().avx2 ? &sAvx2 :
+                                          cpu_features().sse2 ? &sSse2 : &sScalar;
+#else
+    static const RectKernels* sSelected = &sScalar;
+#endif
+    return *sSelected;
+}
+
+const char* rect_kernels_name()
+{
+    return rect_kernels().name;
+}
+
+static Bounds empty_bounds()
+{
+    Bounds bounds = { SDL_MAX_SINT32, SDL_MAX_SINT32, SDL_MIN_SINT32, SDL_MIN_SINT32 };
+    return bounds;
+}
+
+// ============================================================================
+// RECT BATCH
+// ============================================================================
+void RectBatch::clear()
+{
+    mX.clear();
+    mY.clear();
+    mW.clear();
+    mH.clear();
+}
+
+void RectBatch::reserve(int count)
+{
+    mX.reserve(count);
+    mY.reserve(count);
+    mW.reserve(count);
+    mH.reserve(count);
+}
+
+int RectBatch::add(const SDL_Rect& rect)
+{
+    mX.push_back(rect.x);
+    mY.push_back(rect.y);
+    mW.push_back(rect.w);
+    mH.push_back(rect.h);
+    return size() - 1;
+}
+
+void RectBatch::set(int index, const SDL_Rect& rect)
+{
+    mX[index] = rect.x;
+    mY[index] = rect.y;
+    mW[index] = rect.w;
+    mH[index] = rect.h;
+}
+
+SDL_Rect RectBatch::get(int index) const
+{
+    SDL_Rect rect = { mX[index], mY[index], mW[index], mH[index] };
+    return rect;
+}
+
+int RectBatch::intersect(const SDL_Rect& rect, int* hits) const
+{
+    if (mX.empty()) {
+        return 0;
+    }
+    RectArrays arrays = { &mX[0], &mY[0], &mW[0], &mH[0], size() };
+    return rect_kernels().intersect(arrays, rect, hits);
+}
+
+int RectBatch::contains_point(const SDL_Point& point, int* hits) const
+{
+    if (mX.empty()) {
+        return 0;
+    }
+    RectArrays arrays = { &mX[0], &mY[0], &mW[0], &mH[0], size() };
+    return rect_kernels().contains(arrays, point, hits);
+}
+
+bool RectBatch::bounds(SDL_Rect* result) const
+{
+    if (mX.empty()) {
+        return false;
+    }
+    RectArrays arrays = { &mX[0], &mY[0], &mW[0], &mH[0], size() };
+    auto bounds = empty_bounds();
+    rect_kernels().bounds(arrays, &bounds);
+    if (bounds.minX > bounds.maxX) {
+        return false;
+    }
+    if (result != NULL) {
+        result->x = bounds.minX;
+        result->y = bounds.minY;
+        result->w = bounds.maxX - bounds.minX;
+        result->h = bounds.maxY - bounds.minY;
+    }
+    return true;
+}
+
+bool enclose_points(const SDL_Point* points, int count, const SDL_Rect* clip, SDL_Rect* result)
+{
+    if (points == NULL || count < 1 || (clip != NULL && (clip->w <= 0 || clip->h <= 0))) {
+        return false;
+    }
+    auto bounds = empty_bounds();
+    rect_kernels().enclose(points, count, clip, &bounds);
+    if (bounds.minX > bounds.maxX) {
+        return false;
+    }
+    if (result != NULL) {
+        result->x = bounds.minX;
+        result->y = bounds.minY;
+        result->w = bounds.maxX - bounds.minX;
+        result->h = bounds.maxY - bounds.minY;
+    }
+    return true;
+}
@@ -0,0 +1,53 @@
+// ============================================================================
+// RECT BATCH
+// ============================================================================
+// Rectangle geometry over whole arrays of rects instead of a single pair.
+//
+// A RectBatch stores the rects as a structure of arrays (separate x, y, w
+// and h arrays), so that the vector kernels are able to test four (SSE2) or
+// eight (AVX2) rects with each instruction.
+//
+// intersect(rect, hits)........Indices of rects intersecting the rect with
+//                              the same semantics as SDL_HasIntersection.
+// contains_point(point, hits)..Indices of rects containing the point with
+//                              the same semantics as SDL_PointInRect.
+// bounds(result)...............Union of all non-empty rects (repeated calls
+//                              of SDL_UnionRect).
+// enclose_points(...)..........The minimal rect enclosing the points with
+//                              the same semantics as SDL_EnclosePoints.
+//
+// The kernels are selected once on the first use based on SDL_HasAVX2 and
+// SDL_HasSSE2. Hits are written in the ascending index order and the hits
+// array must have room for all rects. Pass NULL to only count the hits.
+// ============================================================================
+#pragma once
+
+#include <SDL.h>
+
+#include <vector>
+
+class RectBatch {
+public:
+    void clear();
+    void reserve(int count);
+    int  add(const SDL_Rect& rect);
+    void set(int index, const SDL_Rect& rect);
+
+    SDL_Rect get(int index) const;
+    int      size() const { return int(mX.size()); }
+
+    int  intersect(const SDL_Rect& rect, int* hits) const;
+    int  contains_point(const SDL_Point& point, int* hits) const;
+    bool bounds(SDL_Rect* result) const;
+
+private:
+    std::vector<int> mX;
+    std::vector<int> mY;
+    std::vector<int> mW;
+    std::vector<int> mH;
+};
+
+bool enclose_points(const SDL_Point* points, int count, const SDL_Rect* clip, SDL_Rect* result);
+
+// the name of the selected kernels.
+const char* rect_kernels_name();
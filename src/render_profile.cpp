@@ -0,0 +1,285 @@
+#include "render_profile.h"
+#include "profiler.h"
+#include "sprite_batch.h"
+
+#include <algorithm>
+
+static const char* PROFILE_HEADER = "# sdl2-sandbox render profile";
+static const int   PROBE_TEXTURES = 4;
+static const int   PROBE_TEXTURE_SIZE = 32;
+
+// FNV-1a hash of the string and its terminator, which is used to build the
+// signature of the profile.
+static void hash_string(Uint64* hash, const char* string)
+{
+    if (string == NULL) {
+        return;
+    }
+    auto bytes = reinterpret_cast<const Uint8*>(string);
+    for (size_t i = 0; i <= SDL_strlen(string); i++) {
+        *hash ^= bytes[i];
+        *hash *= 0x100000001b3ull;
+    }
+}
+
+RenderProfile::RenderProfile(const char* fileName)
+    : mProbed(false)
+{
+    mPath[0] = '\0';
+    auto prefPath = SDL_GetPrefPath("organization_name", "application_name");
+    if (prefPath != NULL) {
+        SDL_snprintf(mPath, sizeof(mPath), "%s%s", prefPath, fileName);
+        SDL_free(prefPath);
+    }
+}
+
+bool RenderProfile::select(bool forceProbe)
+{
+    auto currentSignature = signature();
+    mProbed = false;
+    if (!forceProbe && load(currentSignature)) {
+        SDL_Log("Loaded the render profile: %s\n", hint(SDL_HINT_RENDER_DRIVER));
+        return true;
+    }
+    if (!probe()) {
+        return false;
+    }
+    mProbed = true;
+    save(currentSignature);
+    return true;
+}
+
+void RenderProfile::apply() const
+{
+    for (const auto& hint : mHints) {
+        SDL_SetHintWithPriority(hint.name.c_str(), hint.value.c_str(), SDL_HINT_DEFAULT);
+    }
+}
+
+const char* RenderProfile::hint(const char* name) const
+{
+    for (const auto& hint : mHints) {
+        if (hint.name == name) {
+            return hint.value.c_str();
+        }
+    }
+    return NULL;
+}
+
+Uint64 RenderProfile::signature() const
+{
+    SDL_version version;
+    SDL_GetVersion(&version);
+    char versionText[32];
+    SDL_snprintf(versionText, sizeof(versionText), "%d.%d.%d", version.major, version.minor, version.patch);
+
+    Uint64 hash = 0xcbf29ce484222325ull;
+    hash_string(&hash, versionText);
+    hash_string(&hash, SDL_GetCurrentVideoDriver());
+    for (auto i = 0; i < SDL_GetNumRenderDrivers(); i++) {
+        SDL_RendererInfo info;
+        if (SDL_GetRenderDriverInfo(i, &info) == 0) {
+            hash_string(&hash, info.name);
+        }
+    }
+    return hash;
+}
+
+bool RenderProfile::probe()
+{
+    PROFILE_SCOPE("render probe");
+    SDL_Log("Probing the render drivers:\n");
+    // the batching must be enabled before the renderers are created.
+    SDL_SetHintWithPriority(SDL_HINT_RENDER_BATCHING, "1", SDL_HINT_DEFAULT);
+
+    auto best = -1;
+    auto bestMs = 0.0;
+    SDL_RendererInfo bestInfo;
+    for (auto i = 0; i < SDL_GetNumRenderDrivers(); i++) {
+        SDL_RendererInfo info;
+        if (SDL_GetRenderDriverInfo(i, &info) != 0) {
+            continue;
+        }
+        auto ms = benchmark(i);
+        if (ms < 0.0) {
+            SDL_Log("\t%-12s unavailable\n", info.name);
+            continue;
+        }
+        SDL_Log("\t%-12s %8.3f ms per frame\n", info.name, ms);
+        if (best < 0 || ms < bestMs) {
+            best = i;
+            bestMs = ms;
+            bestInfo = info;
+        }
+    }
+    if (best < 0) {
+        SDL_Log("Unable to find a working render driver.\n");
+        return false;
+    }
+
+    // 60 Hz is assumed when the display does not report its refresh rate.
+    SDL_DisplayMode mode;
+    auto refreshRate = 60;
+    if (SDL_GetCurrentDisplayMode(0, &mode) == 0 && mode.refresh_rate > 0) {
+        refreshRate = mode.refresh_rate;
+    }
+    auto refreshMs = 1000.0 / refreshRate;
+    auto accelerated = (bestInfo.flags & SDL_RENDERER_ACCELERATED) != 0;
+    mHints.clear();
+    set_hint(SDL_HINT_RENDER_DRIVER, bestInfo.name);
+    set_hint(SDL_HINT_RENDER_VSYNC, bestMs < refreshMs ? "1" : "0");
+    set_hint(SDL_HINT_RENDER_BATCHING, "1");
+    set_hint(SDL_HINT_RENDER_SCALE_QUALITY, accelerated ? "linear" : "nearest");
+    SDL_Log("Selected the %s render driver (%.3f ms per frame, vsync %s).\n",
+            bestInfo.name, bestMs, hint(SDL_HINT_RENDER_VSYNC));
+    return true;
+}
+
+double RenderProfile::benchmark(int driver) const
+{
+    auto window = SDL_CreateWindow("render probe",
+                                   SDL_WINDOWPOS_UNDEFINED,
+                                   SDL_WINDOWPOS_UNDEFINED,
+                                   PROBE_WIDTH,
+                                   PROBE_HEIGHT,
+                                   SDL_WINDOW_HIDDEN);
+    if (window == NULL) {
+        return -1.0;
+    }
+    auto renderer = SDL_CreateRenderer(window, driver, 0);
+    if (renderer == NULL) {
+        SDL_DestroyWindow(window);
+        return -1.0;
+    }
+
+    SDL_Texture* textures[PROBE_TEXTURES] = { NULL };
+    std::vector<Uint32> pixels(PROBE_TEXTURE_SIZE * PROBE_TEXTURE_SIZE);
+    auto result = 0.0;
+    for (auto i = 0; i < PROBE_TEXTURES; i++) {
+        textures[i] = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC,
+                                        PROBE_TEXTURE_SIZE, PROBE_TEXTURE_SIZE);
+        if (textures[i] == NULL) {
+            result = -1.0;
+            break;
+        }
+        std::fill(pixels.begin(), pixels.end(), 0x80000000u | (0x00ff00ffu >> i) | Uint32(i) << 10);
+        SDL_UpdateTexture(textures[i], NULL, pixels.data(), PROBE_TEXTURE_SIZE * 4);
+        SDL_SetTextureBlendMode(textures[i], SDL_BLENDMODE_BLEND);
+    }
+
+    std::vector<Uint64> frames;
+    frames.reserve(PROBE_FRAMES);
+    SpriteBatch batch(renderer);
+    for (auto frame = 0; frame < WARMUP_FRAMES + PROBE_FRAMES && result >= 0.0; frame++) {
+        auto start = SDL_GetPerformanceCounter();
+        SDL_SetRenderDrawColor(renderer, 32, 32, 48, 255);
+        SDL_RenderClear(renderer);
+        batch.begin();
+        for (auto i = 0; i < PROBE_SPRITES; i++) {
+            SDL_Rect dst = {
+                int((Uint32(i) * 7919u + Uint32(frame) * 3u) % Uint32(PROBE_WIDTH - PROBE_TEXTURE_SIZE)),
+                int((Uint32(i) * 104729u + Uint32(frame) * 5u) % Uint32(PROBE_HEIGHT - PROBE_TEXTURE_SIZE)),
+                PROBE_TEXTURE_SIZE,
+                PROBE_TEXTURE_SIZE
+            };
+            batch.draw(textures[i % PROBE_TEXTURES], NULL, dst, i % 4);
+        }
+        batch.end();
+        Uint32 pixel = 0;
+        SDL_Rect corner = { 0, 0, 1, 1 };
+        SDL_RenderReadPixels(renderer, &corner, SDL_PIXELFORMAT_ARGB8888, &pixel, 4);
+        SDL_RenderPresent(renderer);
+        if (frame >= WARMUP_FRAMES) {
+            frames.push_back(SDL_GetPerformanceCounter() - start);
+        }
+    }
+
+    for (auto texture : textures) {
+        if (texture != NULL) {
+            SDL_DestroyTexture(texture);
+        }
+    }
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
+    if (result < 0.0 || frames.empty()) {
+        return -1.0;
+    }
+    std::sort(frames.begin(), frames.end());
+    return frames[frames.size() / 2] * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+void RenderProfile::set_hint(const char* name, const char* value)
+{
+    Hint hint;
+    hint.name = name;
+    hint.value = value;
+    mHints.push_back(hint);
+}
+
+bool RenderProfile::load(Uint64 signature)
+{
+    if (mPath[0] == '\0') {
+        return false;
+    }
+    auto file = SDL_RWFromFile(mPath, "rb");
+    if (file == NULL) {
+        return false;
+    }
+    auto size = SDL_RWsize(file);
+    std::string text(size_t(SDL_max(size, Sint64(0))), '\0');
+    auto result = size > 0 && SDL_RWread(file, &text[0], 1, text.size()) == text.size();
+    SDL_RWclose(file);
+
+    std::vector<Hint> hints;
+    auto signatureFound = false;
+    size_t start = 0;
+    while (result && start < text.size()) {
+        auto end = text.find('\n', start);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        auto line = text.substr(start, end - start);
+        start = end + 1;
+        if (!line.empty() && line[line.size() - 1] == '\r') {
+            line.erase(line.size() - 1);
+        }
+        auto separator = line.find('=');
+        if (line.empty() || line[0] == '#' || separator == std::string::npos) {
+            continue;
+        }
+        Hint hint;
+        hint.name = line.substr(0, separator);
+        hint.value = line.substr(separator + 1);
+        if (hint.name == "signature") {
+            signatureFound = true;
+            result = SDL_strtoull(hint.value.c_str(), NULL, 16) == signature;
+        } else {
+            hints.push_back(hint);
+        }
+    }
+    if (!result || !signatureFound) {
+        return false;
+    }
+    mHints.swap(hints);
+    return hint(SDL_HINT_RENDER_DRIVER) != NULL;
+}
+
+void RenderProfile::save(Uint64 signature) const
+{
+    if (mPath[0] == '\0') {
+        return;
+    }
+    auto file = SDL_RWFromFile(mPath, "wb");
+    if (file == NULL) {
+        SDL_Log("Failed to write the render profile: %s\n", SDL_GetError());
+        return;
+    }
+    char line[256];
+    SDL_snprintf(line, sizeof(line), "%s\nsignature=%016llx\n", PROFILE_HEADER, (unsigned long long)signature);
+    SDL_RWwrite(file, line, 1, SDL_strlen(line));
+    for (const auto& hint : mHints) {
+        SDL_snprintf(line, sizeof(line), "%s=%s\n", hint.name.c_str(), hint.value.c_str());
+        SDL_RWwrite(file, line, 1, SDL_strlen(line));
+    }
+    SDL_RWclose(file);
+}
@@ -0,0 +1,77 @@
+// ============================================================================
+// RENDER PROFILE
+// ============================================================================
+// Selects the render driver and the related render hints for the machine
+// instead of hard-coding them. Which driver is the fastest depends on the GPU
+// and the video driver, so it is measured once and the result is stored.
+//
+// select()...Load the profile from the preferences path (SDL_GetPrefPath). If
+//            the file is missing or its signature (the SDL version, the video
+//            driver and the render drivers) has changed, probe the drivers:
+//            each driver of SDL_GetRenderDriverInfo draws a sprite workload
+//            in a hidden window and the driver with the lowest median frame
+//            time is selected. The profile is then written into the file.
+// apply()....Set the hints of the profile with SDL_HINT_DEFAULT priority, so
+//            that the hints given in the environment still take precedence.
+//            Must be called before the renderer is created.
+//
+// The profile stores the following hints.
+//
+// SDL_RENDER_DRIVER..........The name of the fastest driver.
+// SDL_RENDER_VSYNC...........Enabled when the driver can draw the workload
+//                            within the refresh period of the display.
+// SDL_RENDER_BATCHING........Enabled, as the sprite batch issues many copies.
+// SDL_RENDER_SCALE_QUALITY...Linear for the accelerated drivers and nearest
+//                            for the software renderer.
+//
+// The file is a text file of NAME=VALUE lines, so it can also be edited. The
+// frame ends with a 1x1 SDL_RenderReadPixels, which waits for the GPU to
+// finish the frame, so the probe measures the drawing and not the queuing.
+// ============================================================================
+#pragma once
+
+#include <SDL.h>
+
+#include <string>
+#include <vector>
+
+class RenderProfile {
+public:
+    static const int PROBE_WIDTH = 800;
+    static const int PROBE_HEIGHT = 600;
+    static const int PROBE_SPRITES = 2048;
+    static const int WARMUP_FRAMES = 10;
+    static const int PROBE_FRAMES = 60;
+
+    explicit RenderProfile(const char* fileName = "render.profile");
+
+    // load or probe the profile. Returns false if no driver could be used.
+    bool select(bool forceProbe = false);
+    void apply() const;
+
+    // whether the last select() probed the drivers instead of loading the file.
+    bool        probed() const { return mProbed; }
+    // the value of the hint in the profile or NULL when it is not set.
+    const char* hint(const char* name) const;
+
+private:
+    struct Hint {
+        std::string name;
+        std::string value;
+    };
+
+    RenderProfile(const RenderProfile&);
+    RenderProfile& operator=(const RenderProfile&);
+
+    Uint64 signature() const;
+    bool   probe();
+    // the median frame time of the driver in milliseconds or < 0 on failure.
+    double benchmark(int driver) const;
+    void   set_hint(const char* name, const char* value);
+    bool   load(Uint64 signature);
+    void   save(Uint64 signature) const;
+
+    char              mPath[1024];
+    bool              mProbed;
+    std::vector<Hint> mHints;
+};
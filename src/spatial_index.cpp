@@ -0,0 +1,378 @@
+#include "spatial_index.h"
+
+#include <algorithm>
+
+static bool is_empty(const SDL_Rect& rect)
+{
+    return rect.w <= 0 || rect.h <= 0;
+}
+
+static bool overlaps(const SDL_Rect& a, const SDL_Rect& b)
+{
+    return !is_empty(a) && !is_empty(b) &&
+           a.x < b.x + b.w && b.x < a.x + a.w &&
+           a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+// ============================================================================
+// SPATIAL GRID
+// ============================================================================
+// Cells are kept in a hash map so the grid is unbounded and only the cells
+// that contain rects use memory. A rect covering several cells is found from
+// each of them, so the queries mark the visited rects with a query stamp.
+//
+// Overlap pairs are reported only from the first (top-left) cell the rects
+// share, which makes each pair to be reported exactly once.
+// ============================================================================
+SpatialGrid::SpatialGrid(int cellSize)
+    : mCellSize(SDL_max(cellSize, 1)),
+      mSize(0),
+      mStamp(0)
+{
+}
+
+int SpatialGrid::cell_of(int value) const
+{
+    // round towards negative infinity also with the negative coordinates.
+    return value >= 0 ? value / mCellSize : -((-value - 1) / mCellSize) - 1;
+}
+
+void SpatialGrid::cells_of(Object* object) const
+{
+    const auto& rect = object->rect;
+    object->empty = is_empty(rect);
+    if (!object->empty) {
+        object->cellX0 = cell_of(rect.x);
+        object->cellY0 = cell_of(rect.y);
+        object->cellX1 = cell_of(rect.x + rect.w - 1);
+        object->cellY1 = cell_of(rect.y + rect.h - 1);
+    }
+}
+
+void SpatialGrid::link(int id)
+{
+    const auto& object = mObjects[id];
+    if (object.empty) {
+        return;
+    }
+    for (auto y = object.cellY0; y <= object.cellY1; y++) {
+        for (auto x = object.cellX0; x <= object.cellX1; x++) {
+            mCells[cell_key(x, y)].push_back(id);
+        }
+    }
+}
+
+void SpatialGrid::unlink(int id)
+{
+    const auto& object = mObjects[id];
+    if (object.empty) {
+        return;
+    }
+    for (auto y = object.cellY0; y <= object.cellY1; y++) {
+        for (auto x = object.cellX0; x <= object.cellX1; x++) {
+            auto cell = mCells.find(cell_key(x, y));
+            if (cell == mCells.end()) {
+                continue;
+            }
+            auto& ids = cell->second;
+            auto it = std::find(ids.begin(), ids.end(), id);
+            if (it != ids.end()) {
+                *it = ids.back();
+                ids.pop_back();
+            }
+            if (ids.empty()) {
+                mCells.erase(cell);
+            }
+        }
+    }
+}
+
+int SpatialGrid::insert(const SDL_Rect& rect)
+{
+    int id;
+    if (mFreeIds.empty()) {
+        id = int(mObjects.size());
+        mObjects.push_back(Object());
+        mStamps.push_back(0);
+    } else {
+        id = mFreeIds.back();
+        mFreeIds.pop_back();
+    }
+    auto& object = mObjects[id];
+    object.rect = rect;
+    object.alive = true;
+    cells_of(&object);
+    link(id);
+    mSize++;
+    return id;
+}
+
+void SpatialGrid::update(int id, const SDL_Rect& rect)
+{
+    auto& object = mObjects[id];
+    SDL_assert(object.alive);
+    auto moved = object;
+    moved.rect = rect;
+    cells_of(&moved);
+    if (moved.empty == object.empty && (moved.empty ||
+        (moved.cellX0 == object.cellX0 && moved.cellY0 == object.cellY0 &&
+         moved.cellX1 == object.cellX1 && moved.cellY1 == object.cellY1))) {
+        object.rect = rect;
+        return;
+    }
+    unlink(id);
+    object = moved;
+    link(id);
+}
+
+void SpatialGrid::remove(int id)
+{
+    auto& object = mObjects[id];
+    if (!object.alive) {
+        return;
+    }
+    unlink(id);
+    object.alive = false;
+    object.empty = true;
+    mFreeIds.push_back(id);
+    mSize--;
+}
+
+void SpatialGrid::clear()
+{
+    mObjects.clear();
+    mFreeIds.clear();
+    mCells.clear();
+    mStamps.clear();
+    mSize = 0;
+}
+
+void SpatialGrid::query_rect(const SDL_Rect& rect, std::vector<int>* results) const
+{
+    if (is_empty(rect)) {
+        return;
+    }
+    if (++mStamp == 0) {
+        std::fill(mStamps.begin(), mStamps.end(), 0);
+        mStamp = 1;
+    }
+    auto x0 = cell_of(rect.x);
+    auto y0 = cell_of(rect.y);
+    auto x1 = cell_of(rect.x + rect.w - 1);
+    auto y1 = cell_of(rect.y + rect.h - 1);
+    for (auto y = y0; y <= y1; y++) {
+        for (auto x = x0; x <= x1; x++) {
+            auto cell = mCells.find(cell_key(x, y));
+            if (cell == mCells.end()) {
+                continue;
+            }
+            for (auto id : cell->second) {
+                if (mStamps[id] != mStamp) {
+                    mStamps[id] = mStamp;
+                    if (overlaps(mObjects[id].rect, rect)) {
+                        results->push_back(id);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void SpatialGrid::query_point(const SDL_Point& point, std::vector<int>* results) const
+{
+    // a rect contains a point if the rect intersects the pixel of the point.
+    SDL_Rect pixel = { point.x, point.y, 1, 1 };
+    auto cell = mCells.find(cell_key(cell_of(point.x), cell_of(point.y)));
+    if (cell == mCells.end()) {
+        return;
+    }
+    for (auto id : cell->second) {
+        if (overlaps(mObjects[id].rect, pixel)) {
+            results->push_back(id);
+        }
+    }
+}
+
+void SpatialGrid::overlap_pairs(std::vector<OverlapPair>* results) const
+{
+    for (const auto& cell : mCells) {
+        auto cellX = Sint32(Uint32(Uint64(cell.first) >> 32));
+        auto cellY = Sint32(Uint32(Uint64(cell.first)));
+        const auto& ids = cell.second;
+        for (size_t i = 0; i < ids.size(); i++) {
+            const auto& a = mObjects[ids[i]];
+            for (auto j = i + 1; j < ids.size(); j++) {
+                const auto& b = mObjects[ids[j]];
+                if (SDL_max(a.cellX0, b.cellX0) != cellX || SDL_max(a.cellY0, b.cellY0) != cellY) {
+                    continue;
+                }
+                if (overlaps(a.rect, b.rect)) {
+                    results->push_back(OverlapPair(SDL_min(ids[i], ids[j]), SDL_max(ids[i], ids[j])));
+                }
+            }
+        }
+    }
+}
+
+// ============================================================================
+// BVH
+// ============================================================================
+// Nodes are stored in depth-first order, so the left child of an internal
+// node is the next node and the right child is stored into the node. Nodes
+// are split at the median of the rect centers along their longer axis.
+// ============================================================================
+void RectBvh::build(const SDL_Rect* rects, int count)
+{
+    mRects.assign(rects, rects + count);
+    mItems.resize(count);
+    for (auto i = 0; i < count; i++) {
+        mItems[i] = i;
+    }
+    mNodes.clear();
+    if (count <= 0) {
+        return;
+    }
+    mNodes.reserve(2 * count / LEAF_SIZE + 1);
+    build_node(0, count);
+}
+
+int RectBvh::build_node(int begin, int end)
+{
+    auto index = int(mNodes.size());
+    mNodes.push_back(Node());
+    auto node = &mNodes[index];
+    node->first = begin;
+    node->count = end - begin;
+    refit_node(index);
+    if (end - begin <= LEAF_SIZE) {
+        return index;
+    }
+
+    // split along the axis where the rect centers are spread the most.
+    int minX = SDL_MAX_SINT32, minY = SDL_MAX_SINT32, maxX = SDL_MIN_SINT32, maxY = SDL_MIN_SINT32;
+    for (auto i = begin; i < end; i++) {
+        const auto& rect = mRects[mItems[i]];
+        auto centerX = rect.x + rect.w / 2;
+        auto centerY = rect.y + rect.h / 2;
+        minX = SDL_min(minX, centerX);
+        minY = SDL_min(minY, centerY);
+        maxX = SDL_max(maxX, centerX);
+        maxY = SDL_max(maxY, centerY);
+    }
+    auto splitX = Sint64(maxX) - minX >= Sint64(maxY) - minY;
+    const auto& rects = mRects;
+    auto middle = begin + (end - begin) / 2;
+    std::nth_element(mItems.begin() + begin, mItems.begin() + middle, mItems.begin() + end,
+                     [&rects, splitX](int a, int b) {
+        const auto& ra = rects[a];
+        const auto& rb = rects[b];
+        return splitX ? ra.x + ra.w / 2 < rb.x + rb.w / 2
+                      : ra.y + ra.h / 2 < rb.y + rb.h / 2;
+    });
+
+    build_node(begin, middle);
+    auto right = build_node(middle, end);
+    node = &mNodes[index];
+    node->first = right;
+    node->count = -1;
+    return index;
+}
+
+void RectBvh::update(int id, const SDL_Rect& rect)
+{
+    mRects[id] = rect;
+}
+
+void RectBvh::refit()
+{
+    if (!mNodes.empty()) {
+        refit_node(0);
+    }
+}
+
+void RectBvh::refit_node(int index)
+{
+    auto& node = mNodes[index];
+    node.minX = SDL_MAX_SINT32;
+    node.minY = SDL_MAX_SINT32;
+    node.maxX = SDL_MIN_SINT32;
+    node.maxY = SDL_MIN_SINT32;
+    if (node.count >= 0) {
+        for (auto i = node.first; i < node.first + node.count; i++) {
+            const auto& rect = mRects[mItems[i]];
+            if (!is_empty(rect)) {
+                node.minX = SDL_min(node.minX, rect.x);
+                node.minY = SDL_min(node.minY, rect.y);
+                node.maxX = SDL_max(node.maxX, rect.x + rect.w);
+                node.maxY = SDL_max(node.maxY, rect.y + rect.h);
+            }
+        }
+        return;
+    }
+    // an internal node (only reached when refitting a built hierarchy).
+    auto right = node.first;
+    refit_node(index + 1);
+    refit_node(right);
+    const auto& l = mNodes[index + 1];
+    const auto& r = mNodes[right];
+    auto& parent = mNodes[index];
+    parent.minX = SDL_min(l.minX, r.minX);
+    parent.minY = SDL_min(l.minY, r.minY);
+    parent.maxX = SDL_max(l.maxX, r.maxX);
+    parent.maxY = SDL_max(l.maxY, r.maxY);
+}
+
+void RectBvh::query_node(int index, const Node& box, int minId, std::vector<int>* results) const
+{
+    const auto& node = mNodes[index];
+    if (!(box.minX < node.maxX && node.minX < box.maxX &&
+          box.minY < node.maxY && node.minY < box.maxY)) {
+        return;
+    }
+    if (node.count < 0) {
+        query_node(index + 1, box, minId, results);
+        query_node(node.first, box, minId, results);
+        return;
+    }
+    for (auto i = node.first; i < node.first + node.count; i++) {
+        auto id = mItems[i];
+        const auto& rect = mRects[id];
+        if (id > minId && !is_empty(rect) &&
+            box.minX < rect.x + rect.w && rect.x < box.maxX &&
+            box.minY < rect.y + rect.h && rect.y < box.maxY) {
+            results->push_back(id);
+        }
+    }
+}
+
+void RectBvh::query_rect(const SDL_Rect& rect, std::vector<int>* results) const
+{
+    if (mNodes.empty() || is_empty(rect)) {
+        return;
+    }
+    Node box = { rect.x, rect.y, rect.x + rect.w, rect.y + rect.h, 0, 0 };
+    query_node(0, box, -1, results);
+}
+
+void RectBvh::query_point(const SDL_Point& point, std::vector<int>* results) const
+{
+    SDL_Rect pixel = { point.x, point.y, 1, 1 };
+    query_rect(pixel, results);
+}
+
+void RectBvh::overlap_pairs(std::vector<OverlapPair>* results) const
+{
+    std::vector<int> overlapping;
+    for (auto id = 0; id < size(); id++) {
+        const auto& rect = mRects[id];
+        if (is_empty(rect)) {
+            continue;
+        }
+        Node box = { rect.x, rect.y, rect.x + rect.w, rect.y + rect.h, 0, 0 };
+        overlapping.clear();
+        query_node(0, box, id, &overlapping);
+        for (auto other : overlapping) {
+            results->push_back(OverlapPair(id, other));
+        }
+    }
+}
@@ -0,0 +1,104 @@
+// ============================================================================
+// SPATIAL INDEX
+// ============================================================================
+// Spatial indices for rects which avoid testing every pair of rects with the
+// SDL_HasIntersection (which would be O(n^2) for hit-testing and culling).
+//
+// SpatialGrid...A uniform grid of hashed cells for dynamic objects. Each rect
+//               is stored in all cells it covers. Moving a rect within the
+//               same cells only updates the rect.
+// RectBvh.......A bounding volume hierarchy for static level geometry. It is
+//               built once with median splits and can be refitted after the
+//               rects have been moved.
+//
+// Both support rect range queries, point queries and overlap pair queries
+// with the same semantics as SDL_HasIntersection and SDL_PointInRect (empty
+// rects never intersect anything). Results are appended to the vectors and
+// pairs are reported once with the smaller identifier first. Queries are not
+// thread-safe as they use internal scratch state.
+// ============================================================================
+#pragma once
+
+#include <SDL.h>
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+typedef std::pair<int, int> OverlapPair;
+
+class SpatialGrid {
+public:
+    explicit SpatialGrid(int cellSize = 128);
+
+    // add a rect and get its identifier. Identifiers of removed rects are reused.
+    int  insert(const SDL_Rect& rect);
+    void update(int id, const SDL_Rect& rect);
+    void remove(int id);
+    void clear();
+
+    const SDL_Rect& rect(int id) const { return mObjects[id].rect; }
+    int             size() const       { return mSize; }
+
+    void query_rect(const SDL_Rect& rect, std::vector<int>* results) const;
+    void query_point(const SDL_Point& point, std::vector<int>* results) const;
+    void overlap_pairs(std::vector<OverlapPair>* results) const;
+
+private:
+    struct Object {
+        SDL_Rect rect;
+        int      cellX0, cellY0, cellX1, cellY1;
+        bool     alive;
+        bool     empty;
+    };
+
+    static Sint64 cell_key(int x, int y) {
+        return Sint64((Uint64(Uint32(x)) << 32) | Uint32(y));
+    }
+
+    int  cell_of(int value) const;
+    void cells_of(Object* object) const;
+    void link(int id);
+    void unlink(int id);
+
+    int                                          mCellSize;
+    int                                          mSize;
+    std::vector<Object>                          mObjects;
+    std::vector<int>                             mFreeIds;
+    std::unordered_map<Sint64, std::vector<int>> mCells;
+    mutable std::vector<Uint32>                  mStamps;
+    mutable Uint32                               mStamp;
+};
+
+class RectBvh {
+public:
+    static const int LEAF_SIZE = 4;
+
+    // build the hierarchy of the rects. Identifiers are the rect indices.
+    void build(const SDL_Rect* rects, int count);
+    // move a rect. The hierarchy is correct again after the next refit.
+    void update(int id, const SDL_Rect& rect);
+    void refit();
+
+    int size() const { return int(mRects.size()); }
+
+    void query_rect(const SDL_Rect& rect, std::vector<int>* results) const;
+    void query_point(const SDL_Point& point, std::vector<int>* results) const;
+    void overlap_pairs(std::vector<OverlapPair>* results) const;
+
+private:
+    // bounds are stored as inclusive minimum and exclusive maximum values.
+    struct Node {
+        int minX, minY, maxX, maxY;
+        int first; // the first item of a leaf or the right child of a node.
+        int count; // the amount of items in a leaf or -1 for a node.
+    };
+
+    int  build_node(int begin, int end);
+    void refit_node(int index);
+    void query_node(int index, const Node& box, int minId, std::vector<int>* results) const;
+
+    std::vector<SDL_Rect> mRects;
+    std::vector<int>      mItems;
+    std::vector<Node>     mNodes;
+};
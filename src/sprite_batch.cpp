@@ -0,0 +1,99 @@
+#include "sprite_batch.h"
+
+#include <algorithm>
+
+SpriteBatch::SpriteBatch(SDL_Renderer* renderer)
+    : mRenderer(renderer),
+      mDrawing(false),
+      mFrameDrawCalls(0),
+      mFrameBinds(0)
+{
+}
+
+void SpriteBatch::begin()
+{
+    SDL_assert(!mDrawing);
+    mSprites.clear();
+    mDrawing = true;
+}
+
+void SpriteBatch::draw(const AtlasRegion& region, const SDL_Rect& dst, int layer, SDL_BlendMode blendMode)
+{
+    draw(region.texture, &region.rect, dst, layer, blendMode);
+}
+
+void SpriteBatch::draw(SDL_Texture* texture, const SDL_Rect* src, const SDL_Rect& dst, int layer, SDL_BlendMode blendMode)
+{
+    SDL_assert(mDrawing);
+    Sprite sprite;
+    sprite.texture = texture;
+    sprite.hasSrc = src != NULL;
+    if (src != NULL) {
+        sprite.src = *src;
+    }
+    sprite.dst = dst;
+    sprite.layer = layer;
+    sprite.blendMode = blendMode;
+    mSprites.push_back(sprite);
+}
+
+void SpriteBatch::end()
+{
+    SDL_assert(mDrawing);
+    mDrawing = false;
+    std::stable_sort(mSprites.begin(), mSprites.end(), [](const Sprite& a, const Sprite& b) {
+        if (a.layer != b.layer) {
+            return a.layer < b.layer;
+        }
+        if (a.blendMode != b.blendMode) {
+            return a.blendMode < b.blendMode;
+        }
+        return a.texture < b.texture;
+    });
+
+    // the blend mode is a texture state, so changing it is also counted as a bind.
+    SDL_Texture* boundTexture = NULL;
+    auto boundBlendMode = SDL_BLENDMODE_INVALID;
+    mFrameDrawCalls = 0;
+    mFrameBinds = 0;
+    for (const auto& sprite : mSprites) {
+        if (sprite.texture != boundTexture || sprite.blendMode != boundBlendMode) {
+            SDL_SetTextureBlendMode(sprite.texture, sprite.blendMode);
+            boundTexture = sprite.texture;
+            boundBlendMode = sprite.blendMode;
+            mFrameBinds++;
+        }
+        SDL_RenderCopy(mRenderer, sprite.texture, sprite.hasSrc ? &sprite.src : NULL, &sprite.dst);
+        mFrameDrawCalls++;
+    }
+    mDrawCalls.add(mFrameDrawCalls);
+    mBinds.add(mFrameBinds);
+}
+
+static Sint64 last_frame_draw_calls(void* data)
+{
+    return static_cast<SpriteBatch*>(data)->frame_draw_calls();
+}
+
+static Sint64 last_frame_texture_binds(void* data)
+{
+    return static_cast<SpriteBatch*>(data)->frame_texture_binds();
+}
+
+void SpriteBatch::add_counters()
+{
+    auto& registry = CounterRegistry::instance();
+    registry.add_counter("sprite draw calls", &mDrawCalls);
+    registry.add_counter("sprite texture binds", &mBinds);
+    registry.add_gauge("sprite frame draw calls", last_frame_draw_calls, this);
+    registry.add_gauge("sprite frame binds", last_frame_texture_binds, this);
+}
+
+void SpriteBatch::remove_counters()
+{
+    auto& registry = CounterRegistry::instance();
+    registry.remove("sprite draw calls");
+    registry.remove("sprite texture binds");
+    registry.remove("sprite frame draw calls");
+    registry.remove("sprite frame binds");
+}
@@ -0,0 +1,67 @@
+// ============================================================================
+// SPRITE BATCH
+// ============================================================================
+// Collects the sprite draws of a frame and submits them sorted by the layer,
+// the blend mode and the texture, so that each texture and blend mode is set
+// once per layer instead of once per sprite.
+//
+// begin()....Start collecting the sprites of a frame.
+// draw().....Add a sprite. Within a layer the draw order is not preserved,
+//            so the overlapping sprites that must be drawn in order should
+//            be put on different layers.
+// end()......Sort and submit the sprites with SDL_RenderCopy calls.
+//
+// The draw calls and the texture binds (texture or blend mode changes) are
+// counted in total and for the last frame, so they can be registered to the
+// CounterRegistry and thus reported by the profiler.
+// ============================================================================
+#pragma once
+
+#include <SDL.h>
+
+#include "counters.h"
+#include "texture_atlas.h"
+
+#include <vector>
+
+class SpriteBatch {
+public:
+    explicit SpriteBatch(SDL_Renderer* renderer);
+
+    void begin();
+    void draw(const AtlasRegion& region, const SDL_Rect& dst, int layer = 0,
+              SDL_BlendMode blendMode = SDL_BLENDMODE_BLEND);
+    void draw(SDL_Texture* texture, const SDL_Rect* src, const SDL_Rect& dst, int layer = 0,
+              SDL_BlendMode blendMode = SDL_BLENDMODE_BLEND);
+    void end();
+
+    int                   frame_draw_calls() const    { return mFrameDrawCalls; }
+    int                   frame_texture_binds() const { return mFrameBinds; }
+    const ShardedCounter& draw_calls() const          { return mDrawCalls; }
+    const ShardedCounter& texture_binds() const       { return mBinds; }
+
+    // register or remove the counters and the last frame gauges of the CounterRegistry.
+    void add_counters();
+    void remove_counters();
+
+private:
+    struct Sprite {
+        SDL_Texture*  texture;
+        SDL_Rect      src;
+        SDL_Rect      dst;
+        bool          hasSrc;
+        int           layer;
+        SDL_BlendMode blendMode;
+    };
+
+    SpriteBatch(const SpriteBatch&);
+    SpriteBatch& operator=(const SpriteBatch&);
+
+    SDL_Renderer*       mRenderer;
+    std::vector<Sprite> mSprites;
+    bool                mDrawing;
+    int                 mFrameDrawCalls;
+    int                 mFrameBinds;
+    ShardedCounter      mDrawCalls;
+    ShardedCounter      mBinds;
+};
@@ -0,0 +1,140 @@
+#include "startup.h"
+#include "thread_pool.h"
+
+StartupScheduler::StartupScheduler()
+    : mPool(NULL),
+      mMutex(SDL_CreateMutex()),
+      mCond(SDL_CreateCond()),
+      mNumCompleted(0),
+      mStart(0)
+{
+}
+
+StartupScheduler::~StartupScheduler()
+{
+    wait();
+    SDL_DestroyCond(mCond);
+    SDL_DestroyMutex(mMutex);
+}
+
+int StartupScheduler::add(const char* name,
+                          const Function& function,
+                          const std::vector<int>& dependencies,
+                          Affinity affinity)
+{
+    Task task;
+    task.name = name;
+    task.function = function;
+    task.affinity = affinity;
+    task.remaining = int(dependencies.size());
+    task.start = 0;
+    task.end = 0;
+    task.thread = 0;
+
+    auto id = int(mTasks.size());
+    mTasks.push_back(task);
+    for (auto dependency : dependencies) {
+        SDL_assert(dependency >= 0 && dependency < id);
+        mTasks[dependency].dependents.push_back(id);
+    }
+    return id;
+}
+
+void StartupScheduler::start(ThreadPool& pool)
+{
+    SDL_LockMutex(mMutex);
+    mPool = &pool;
+    mStart = SDL_GetPerformanceCounter();
+    for (auto i = 0; i < int(mTasks.size()); i++) {
+        if (mTasks[i].remaining == 0) {
+            enqueue(i);
+        }
+    }
+    SDL_UnlockMutex(mMutex);
+}
+
+bool StartupScheduler::run_main_task()
+{
+    SDL_LockMutex(mMutex);
+    auto result = !mMainQueue.empty();
+    if (result) {
+        auto task = mMainQueue.front();
+        mMainQueue.pop_front();
+        run(task);
+    }
+    SDL_UnlockMutex(mMutex);
+    return result;
+}
+
+bool StartupScheduler::finished() const
+{
+    SDL_LockMutex(mMutex);
+    auto result = mNumCompleted == int(mTasks.size());
+    SDL_UnlockMutex(mMutex);
+    return result;
+}
+
+void StartupScheduler::wait()
+{
+    SDL_LockMutex(mMutex);
+    while (mNumCompleted < int(mTasks.size())) {
+        if (!mMainQueue.empty()) {
+            auto task = mMainQueue.front();
+            mMainQueue.pop_front();
+            run(task);
+        } else {
+            SDL_CondWait(mCond, mMutex);
+        }
+    }
+    SDL_UnlockMutex(mMutex);
+}
+
+void StartupScheduler::log_timeline() const
+{
+    auto millis = 1000.0 / SDL_GetPerformanceFrequency();
+    SDL_LockMutex(mMutex);
+    SDL_Log("Startup timeline (milliseconds since the scheduler start):\n");
+    for (const auto& task : mTasks) {
+        SDL_Log("\t%-24s start=%8.2f end=%8.2f duration=%8.2f thread=%lu\n",
+                task.name,
+                (task.start - mStart) * millis,
+                (task.end - mStart) * millis,
+                (task.end - task.start) * millis,
+                task.thread);
+    }
+    SDL_UnlockMutex(mMutex);
+}
+
+void StartupScheduler::enqueue(int task)
+{
+    if (mTasks[task].affinity == AFFINITY_MAIN) {
+        mMainQueue.push_back(task);
+        SDL_CondBroadcast(mCond);
+    } else {
+        mPool->submit([this, task]() {
+            SDL_LockMutex(mMutex);
+            run(task);
+            SDL_UnlockMutex(mMutex);
+        });
+    }
+}
+
+void StartupScheduler::run(int task)
+{
+    // the task itself is run without holding the scheduler mutex.
+    mTasks[task].thread = SDL_ThreadID();
+    mTasks[task].start = SDL_GetPerformanceCounter();
+    SDL_UnlockMutex(mMutex);
+    mTasks[task].function();
+    auto end = SDL_GetPerformanceCounter();
+    SDL_LockMutex(mMutex);
+    mTasks[task].end = end;
+
+    mNumCompleted++;
+    for (auto dependent : mTasks[task].dependents) {
+        if (--mTasks[dependent].remaining == 0) {
+            enqueue(dependent);
+        }
+    }
+    SDL_CondBroadcast(mCond);
+}
@@ -0,0 +1,85 @@
+// ============================================================================
+// STARTUP SCHEDULER
+// ============================================================================
+// A scheduler that runs the application startup as a graph of named tasks.
+//
+// Each task can declare dependencies to other tasks and it will only become
+// ready after all of its dependencies have been completed. Independent tasks
+// are run at the same time so the startup does not wait on serial delays.
+//
+// AFFINITY_WORKER...The task is run as a job on the provided thread pool.
+// AFFINITY_MAIN.....The task is run on the main thread within the calls of
+//                   run_main_task(). Window creation, rendering and event
+//                   handling cannot be done in any other thread (see THREADS).
+//
+// The scheduler records the start and end ticks of each task so the startup
+// timeline can be reported after all tasks have been completed.
+// ============================================================================
+#pragma once
+
+#include <SDL.h>
+
+#include <deque>
+#include <functional>
+#include <vector>
+
+class ThreadPool;
+
+class StartupScheduler {
+public:
+    enum Affinity {
+        AFFINITY_WORKER,
+        AFFINITY_MAIN
+    };
+
+    typedef std::function<void()> Function;
+
+    StartupScheduler();
+    ~StartupScheduler();
+
+    // add a new task and get its identifier. Tasks must be added before start.
+    int add(const char* name,
+            const Function& function,
+            const std::vector<int>& dependencies = std::vector<int>(),
+            Affinity affinity = AFFINITY_WORKER);
+
+    // start running the tasks. Worker tasks are submitted to the pool.
+    void start(ThreadPool& pool);
+    // run a single ready main thread task. Returns false if none was ready.
+    bool run_main_task();
+    // check whether all tasks have been completed.
+    bool finished() const;
+    // run main thread tasks until all tasks have been completed.
+    void wait();
+
+    // log the start and end ticks of each task relative to the start.
+    void log_timeline() const;
+
+private:
+    struct Task {
+        const char*      name;
+        Function         function;
+        Affinity         affinity;
+        std::vector<int> dependents;
+        int              remaining;
+        Uint64           start;
+        Uint64           end;
+        SDL_threadID     thread;
+    };
+
+    StartupScheduler(const StartupScheduler&);
+    StartupScheduler& operator=(const StartupScheduler&);
+
+    // make the task ready to run. Requires the mutex to be locked.
+    void enqueue(int task);
+    // run the task and complete it. Requires the mutex to be locked.
+    void run(int task);
+
+    std::vector<Task>        mTasks;
+    std::deque<int>          mMainQueue;
+    ThreadPool*              mPool;
+    SDL_mutex*               mMutex;
+    SDL_cond*                mCond;
+    int                      mNumCompleted;
+    Uint64                   mStart;
+};
@@ -0,0 +1,156 @@
+#include "subsystems.h"
+
+// the subsystems in the order they are initialized by a single require().
+static const struct {
+    Uint32      flag;
+    const char* name;
+} SUBSYSTEMS[] = {
+    { SDL_INIT_TIMER,          "timer" },
+    { SDL_INIT_AUDIO,          "audio" },
+    { SDL_INIT_VIDEO,          "video" },
+    { SDL_INIT_JOYSTICK,       "joystick" },
+    { SDL_INIT_HAPTIC,         "haptic" },
+    { SDL_INIT_GAMECONTROLLER, "game controller" },
+    { SDL_INIT_EVENTS,         "events" },
+#if SDL_VERSION_ATLEAST(2, 0, 9)
+    { SDL_INIT_SENSOR,         "sensor" },
+#endif
+};
+
+Subsystems& Subsystems::instance()
+{
+    static Subsystems sSubsystems;
+    return sSubsystems;
+}
+
+Subsystems::Subsystems()
+    : mMutex(SDL_CreateMutex()),
+      mThread(NULL),
+      mPrewarmFlags(0),
+      mNumEntries(0)
+{
+    SDL_AtomicSet(&mPrewarming, 0);
+    for (const auto& subsystem : SUBSYSTEMS) {
+        auto& entry = mEntries[mNumEntries++];
+        entry.flag = subsystem.flag;
+        entry.name = subsystem.name;
+        entry.ticks = 0;
+        entry.attempted = false;
+        entry.initialized = false;
+    }
+}
+
+Subsystems::~Subsystems()
+{
+    wait();
+    SDL_DestroyMutex(mMutex);
+}
+
+bool Subsystems::require(Uint32 flags)
+{
+    auto result = true;
+    SDL_LockMutex(mMutex);
+    for (auto i = 0; i < mNumEntries; i++) {
+        auto& entry = mEntries[i];
+        if ((flags & entry.flag) != 0 && !initialize(&entry, "main")) {
+            result = false;
+        }
+    }
+    SDL_UnlockMutex(mMutex);
+    return result;
+}
+
+bool Subsystems::prewarm(Uint32 flags)
+{
+    if (mThread != NULL) {
+        return false;
+    }
+    mPrewarmFlags = flags;
+    SDL_AtomicSet(&mPrewarming, 1);
+    mThread = SDL_CreateThread(thread_function, "subsystem-prewarm", this);
+    if (mThread == NULL) {
+        SDL_Log("Unable to create the subsystem prewarm thread: %s\n", SDL_GetError());
+        SDL_AtomicSet(&mPrewarming, 0);
+        return false;
+    }
+    return true;
+}
+
+void Subsystems::wait()
+{
+    if (mThread != NULL) {
+        SDL_WaitThread(mThread, NULL);
+        mThread = NULL;
+    }
+}
+
+bool Subsystems::prewarming() const
+{
+    return SDL_AtomicGet(&mPrewarming) != 0;
+}
+
+double Subsystems::init_ms(Uint32 flag) const
+{
+    SDL_LockMutex(mMutex);
+    Uint64 ticks = 0;
+    for (auto i = 0; i < mNumEntries; i++) {
+        if (mEntries[i].flag == flag) {
+            ticks = mEntries[i].ticks;
+        }
+    }
+    SDL_UnlockMutex(mMutex);
+    return ticks * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+void Subsystems::log_report() const
+{
+    SDL_LockMutex(mMutex);
+    for (auto i = 0; i < mNumEntries; i++) {
+        const auto& entry = mEntries[i];
+        auto initialized = SDL_WasInit(entry.flag) != 0;
+        if (entry.attempted && entry.initialized) {
+            SDL_Log("[%d] %-16s %8.2f ms\n", initialized, entry.name,
+                    entry.ticks * 1000.0 / SDL_GetPerformanceFrequency());
+        } else if (entry.attempted) {
+            SDL_Log("[%d] %-16s   failed\n", initialized, entry.name);
+        } else {
+            SDL_Log("[%d] %-16s %s\n", initialized, entry.name, initialized ? "  implied" : "  not used");
+        }
+    }
+    SDL_UnlockMutex(mMutex);
+}
+
+int Subsystems::thread_function(void* data)
+{
+    auto subsystems = static_cast<Subsystems*>(data);
+    SDL_LockMutex(subsystems->mMutex);
+    for (auto i = 0; i < subsystems->mNumEntries; i++) {
+        auto& entry = subsystems->mEntries[i];
+        if ((subsystems->mPrewarmFlags & entry.flag) != 0) {
+            subsystems->initialize(&entry, "prewarm");
+        }
+    }
+    SDL_UnlockMutex(subsystems->mMutex);
+    SDL_AtomicSet(&subsystems->mPrewarming, 0);
+    return 0;
+}
+
+bool Subsystems::initialize(Entry* entry, const char* thread)
+{
+    if (entry->attempted) {
+        return entry->initialized;
+    }
+    entry->attempted = true;
+    auto start = SDL_GetPerformanceCounter();
+    entry->initialized = SDL_InitSubSystem(entry->flag) == 0;
+    entry->ticks = SDL_GetPerformanceCounter() - start;
+    if (!entry->initialized) {
+        SDL_Log("Unable to initialize the %s subsystem: %s\n", entry->name, SDL_GetError());
+        return false;
+    }
+    SDL_Log("Initialized the %s subsystem in %.2f ms on the %s thread.\n",
+            entry->name,
+            entry->ticks * 1000.0 / SDL_GetPerformanceFrequency(),
+            thread);
+    return true;
+}
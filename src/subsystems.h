@@ -0,0 +1,72 @@
+// ============================================================================
+// SUBSYSTEMS
+// ============================================================================
+// Initializes the SDL subsystems on their first use instead of all of them in
+// SDL_Init. Opening the joystick, haptic and audio backends enumerates their
+// devices (e.g. udev scans), which can take hundreds of milliseconds on some
+// platforms even when the application never uses them.
+//
+// require()....[any] Initialize the subsystems with SDL_InitSubSystem unless
+//              they have already been initialized. The time of each one is
+//              measured with the performance counter and logged.
+// prewarm()....[main] Initialize the subsystems on a background thread, e.g.
+//              after the first frame has been shown, so that the first use
+//              does not wait for them.
+// wait().......[main] Wait until the prewarm thread has finished.
+//
+// SDL does not guard its subsystem reference counts, so all of the calls are
+// serialized with a mutex. A require() during the prewarm waits for it. The
+// subsystems stay initialized until SDL_Quit.
+//
+// SDL documents the initialization as a main thread operation, and some of the
+// joystick and haptic backends bind their helper window or run loop to the
+// thread that initializes them. Therefore prewarm() is opt-in and should only
+// be used on the platforms where the backends are known to allow it.
+// ============================================================================
+#pragma once
+
+#include <SDL.h>
+
+class Subsystems {
+public:
+    static const int MAX_ENTRIES = 8;
+
+    static Subsystems& instance();
+
+    // returns false if any of the subsystems failed to initialize.
+    bool require(Uint32 flags);
+    bool prewarm(Uint32 flags);
+    void wait();
+
+    // true while the prewarm thread is still initializing the subsystems.
+    bool   prewarming() const;
+    // the initialization time of a single subsystem in milliseconds.
+    double init_ms(Uint32 flag) const;
+    // log the state and the initialization time of each subsystem.
+    void   log_report() const;
+
+private:
+    struct Entry {
+        Uint32      flag;
+        const char* name;
+        Uint64      ticks;
+        bool        attempted;
+        bool        initialized;
+    };
+
+    Subsystems();
+    ~Subsystems();
+    Subsystems(const Subsystems&);
+    Subsystems& operator=(const Subsystems&);
+
+    static int thread_function(void* data);
+
+    bool initialize(Entry* entry, const char* thread);
+
+    SDL_mutex*           mMutex;
+    SDL_Thread*          mThread;
+    Uint32               mPrewarmFlags;
+    mutable SDL_atomic_t mPrewarming;
+    Entry                mEntries[MAX_ENTRIES];
+    int                  mNumEntries;
+};
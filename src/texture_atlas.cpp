@@ -0,0 +1,182 @@
+#include "texture_atlas.h"
+
+// ============================================================================
+// SKYLINE PACKER
+// ============================================================================
+SkylinePacker::SkylinePacker(int width, int height)
+    : mWidth(width),
+      mHeight(height),
+      mUsedArea(0)
+{
+    reset();
+}
+
+void SkylinePacker::reset()
+{
+    Segment segment = { 0, 0, mWidth };
+    mSkyline.assign(1, segment);
+    mUsedArea = 0;
+}
+
+double SkylinePacker::occupancy() const
+{
+    return double(mUsedArea) / (double(mWidth) * mHeight);
+}
+
+int SkylinePacker::fit(size_t index, int width, int height) const
+{
+    auto x = mSkyline[index].x;
+    if (x + width > mWidth) {
+        return -1;
+    }
+    // the rect rests on the highest segment below it.
+    auto y = 0;
+    auto remaining = width;
+    for (auto i = index; remaining > 0; i++) {
+        y = SDL_max(y, mSkyline[i].y);
+        if (y + height > mHeight) {
+            return -1;
+        }
+        remaining -= mSkyline[i].width;
+    }
+    return y;
+}
+
+bool SkylinePacker::pack(int width, int height, SDL_Rect* result)
+{
+    if (width <= 0 || height <= 0) {
+        return false;
+    }
+    auto bestIndex = size_t(-1);
+    auto bestTop = SDL_MAX_SINT32;
+    auto bestX = SDL_MAX_SINT32;
+    for (size_t i = 0; i < mSkyline.size(); i++) {
+        auto y = fit(i, width, height);
+        if (y < 0) {
+            continue;
+        }
+        auto top = y + height;
+        if (top < bestTop || (top == bestTop && mSkyline[i].x < bestX)) {
+            bestIndex = i;
+            bestTop = top;
+            bestX = mSkyline[i].x;
+        }
+    }
+    if (bestIndex == size_t(-1)) {
+        return false;
+    }
+    SDL_Rect rect = { bestX, bestTop - height, width, height };
+    place(bestIndex, rect);
+    mUsedArea += Sint64(width) * height;
+    *result = rect;
+    return true;
+}
+
+void SkylinePacker::place(size_t index, const SDL_Rect& rect)
+{
+    Segment segment = { rect.x, rect.y + rect.h, rect.w };
+    mSkyline.insert(mSkyline.begin() + index, segment);
+
+    // shrink or remove the segments that are now under the new segment.
+    auto right = rect.x + rect.w;
+    auto i = index + 1;
+    while (i < mSkyline.size() && mSkyline[i].x < right) {
+        auto overlap = right - mSkyline[i].x;
+        if (overlap >= mSkyline[i].width) {
+            mSkyline.erase(mSkyline.begin() + i);
+        } else {
+            mSkyline[i].x += overlap;
+            mSkyline[i].width -= overlap;
+            break;
+        }
+    }
+
+    // merge neighbouring segments of the same height.
+    for (i = 0; i + 1 < mSkyline.size();) {
+        if (mSkyline[i].y == mSkyline[i + 1].y) {
+            mSkyline[i].width += mSkyline[i + 1].width;
+            mSkyline.erase(mSkyline.begin() + i + 1);
+        } else {
+            i++;
+        }
+    }
+}
+
+// ============================================================================
+// TEXTURE ATLAS
+// ============================================================================
+TextureAtlas::TextureAtlas(SDL_Renderer* renderer, int pageSize, int padding)
+    : mRenderer(renderer),
+      mPageSize(pageSize),
+      mPadding(padding)
+{
+}
+
+TextureAtlas::~TextureAtlas()
+{
+    for (auto& page : mPages) {
+        SDL_DestroyTexture(page.texture);
+    }
+}
+
+bool TextureAtlas::add_page()
+{
+    auto texture = SDL_CreateTexture(mRenderer,
+                                     SDL_PIXELFORMAT_ARGB8888,
+                                     SDL_TEXTUREACCESS_STATIC,
+                                     mPageSize,
+                                     mPageSize);
+    if (texture == NULL) {
+        return false;
+    }
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+    Page page = { texture, SkylinePacker(mPageSize, mPageSize) };
+    mPages.push_back(page);
+    return true;
+}
+
+bool TextureAtlas::add(SDL_Surface* surface, AtlasRegion* region)
+{
+    // the padding keeps a gap between the regions for the scaled sprites.
+    auto width = surface->w + mPadding * 2;
+    auto height = surface->h + mPadding * 2;
+    if (width > mPageSize || height > mPageSize) {
+        SDL_SetError("Surface of %dx%d does not fit into an atlas page", surface->w, surface->h);
+        return false;
+    }
+
+    SDL_Rect packed;
+    auto page = -1;
+    for (auto i = 0; i < num_pages() && page < 0; i++) {
+        if (mPages[i].packer.pack(width, height, &packed)) {
+            page = i;
+        }
+    }
+    if (page < 0) {
+        if (!add_page() || !mPages.back().packer.pack(width, height, &packed)) {
+            return false;
+        }
+        page = num_pages() - 1;
+    }
+
+    SDL_Surface* converted = NULL;
+    if (surface->format->format != SDL_PIXELFORMAT_ARGB8888) {
+        converted = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+        if (converted == NULL) {
+            return false;
+        }
+        surface = converted;
+    }
+    SDL_Rect rect = { packed.x + mPadding, packed.y + mPadding, surface->w, surface->h };
+    auto result = SDL_LockSurface(surface) == 0;
+    if (result) {
+        result = SDL_UpdateTexture(mPages[page].texture, &rect, surface->pixels, surface->pitch) == 0;
+        SDL_UnlockSurface(surface);
+    }
+    SDL_FreeSurface(converted);
+    if (result) {
+        region->texture = mPages[page].texture;
+        region->rect = rect;
+    }
+    return result;
+}
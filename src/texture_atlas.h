@@ -0,0 +1,78 @@
+// ============================================================================
+// TEXTURE ATLAS
+// ============================================================================
+// Packs many small surfaces into a few large textures, so that sprites which
+// share an atlas page can be drawn without switching the bound texture.
+//
+// SkylinePacker...Packs rects into a fixed size area with the skyline bottom
+//                 left heuristic. The skyline is the top edge of the packed
+//                 rects, and each rect is placed where its top edge will be
+//                 the lowest (the leftmost of equally low positions).
+// TextureAtlas....Uploads the surfaces into SDL_TEXTUREACCESS_STATIC pages.
+//                 A new page is created when a surface does not fit into the
+//                 existing pages. Surfaces are converted into ARGB8888.
+// ============================================================================
+#pragma once
+
+#include <SDL.h>
+
+#include <vector>
+
+class SkylinePacker {
+public:
+    SkylinePacker(int width, int height);
+
+    bool   pack(int width, int height, SDL_Rect* result);
+    void   reset();
+    double occupancy() const;
+
+private:
+    struct Segment {
+        int x;
+        int y;
+        int width;
+    };
+
+    // get the y where a rect would be placed at the segment or -1 if no fit.
+    int  fit(size_t index, int width, int height) const;
+    void place(size_t index, const SDL_Rect& rect);
+
+    int                  mWidth;
+    int                  mHeight;
+    Sint64               mUsedArea;
+    std::vector<Segment> mSkyline;
+};
+
+struct AtlasRegion {
+    SDL_Texture* texture;
+    SDL_Rect     rect;
+};
+
+class TextureAtlas {
+public:
+    TextureAtlas(SDL_Renderer* renderer, int pageSize = 1024, int padding = 1);
+    ~TextureAtlas();
+
+    // pack and upload the surface. Returns false and sets the SDL error on failure.
+    bool add(SDL_Surface* surface, AtlasRegion* region);
+
+    int          num_pages() const      { return int(mPages.size()); }
+    SDL_Texture* page(int index) const  { return mPages[index].texture; }
+    double       occupancy(int index) const { return mPages[index].packer.occupancy(); }
+
+private:
+    struct Page {
+        SDL_Texture*  texture;
+        SkylinePacker packer;
+    };
+
+    TextureAtlas(const TextureAtlas&);
+    TextureAtlas& operator=(const TextureAtlas&);
+
+    bool add_page();
+
+    SDL_Renderer*     mRenderer;
+    int               mPageSize;
+    int               mPadding;
+    std::vector<Page> mPages;
+};
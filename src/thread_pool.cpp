@@ -0,0 +1,261 @@
+#include "thread_pool.h"
+
+// the pool and the worker index of the calling thread (if it is a worker).
+static thread_local const ThreadPool* tPool = NULL;
+static thread_local int tWorker = -1;
+
+WaitGroup::WaitGroup() : mMutex(SDL_CreateMutex()), mCond(SDL_CreateCond())
+{
+    SDL_AtomicSet(&mCount, 0);
+}
+
+WaitGroup::~WaitGroup()
+{
+    SDL_DestroyCond(mCond);
+    SDL_DestroyMutex(mMutex);
+}
+
+void WaitGroup::add(int count)
+{
+    SDL_AtomicAdd(&mCount, count);
+}
+
+void WaitGroup::done()
+{
+    // decrement within the mutex so a waiter that has seen the zero count is
+    // able to destroy the group as soon as it has acquired the mutex.
+    SDL_LockMutex(mMutex);
+    if (SDL_AtomicAdd(&mCount, -1) == 1) {
+        SDL_CondBroadcast(mCond);
+    }
+    SDL_UnlockMutex(mMutex);
+}
+
+bool WaitGroup::is_done()
+{
+    return SDL_AtomicGet(&mCount) <= 0;
+}
+
+bool WaitGroup::wait(Uint32 timeout)
+{
+    SDL_LockMutex(mMutex);
+    while (SDL_AtomicGet(&mCount) > 0) {
+        if (timeout == SDL_MUTEX_MAXWAIT) {
+            SDL_CondWait(mCond, mMutex);
+        } else if (SDL_CondWaitTimeout(mCond, mMutex, timeout) == SDL_MUTEX_TIMEDOUT) {
+            break;
+        }
+    }
+    auto result = SDL_AtomicGet(&mCount) <= 0;
+    SDL_UnlockMutex(mMutex);
+    return result;
+}
+
+ThreadPool::ThreadPool(int numWorkers)
+    : mSignal(SDL_CreateSemaphore(0)),
+      mParkMutex(SDL_CreateMutex()),
+      mParkCond(SDL_CreateCond())
+{
+    SDL_AtomicSet(&mStopping, 0);
+    SDL_AtomicSet(&mNextWorker, 0);
+    if (numWorkers <= 0) {
+        numWorkers = SDL_GetCPUCount();
+    }
+    SDL_AtomicSet(&mActiveWorkers, numWorkers);
+
+    // create all workers before starting any of them as they steal from each other.
+    for (auto i = 0; i < numWorkers; i++) {
+        auto worker = new Worker();
+        worker->pool = this;
+        worker->index = i;
+        worker->thread = NULL;
+        worker->lock = 0;
+        mWorkers.push_back(worker);
+    }
+    for (auto worker : mWorkers) {
+        char name[32];
+        SDL_snprintf(name, sizeof(name), "pool-%d", worker->index + 1);
+        worker->thread = SDL_CreateThread(worker_function, name, worker);
+        if (worker->thread == NULL) {
+            SDL_Log("Failed to create a pool worker: %s\n", SDL_GetError());
+        }
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    // workers run all remaining jobs before exiting.
+    SDL_AtomicSet(&mStopping, 1);
+    SDL_LockMutex(mParkMutex);
+    SDL_CondBroadcast(mParkCond);
+    SDL_UnlockMutex(mParkMutex);
+    for (size_t i = 0; i < mWorkers.size(); i++) {
+        SDL_SemPost(mSignal);
+    }
+    for (auto worker : mWorkers) {
+        if (worker->thread != NULL) {
+            SDL_WaitThread(worker->thread, NULL);
+        }
+    }
+    // run what was left behind by the workers that failed to start.
+    while (run_one(-1)) {
+    }
+    for (auto worker : mWorkers) {
+        delete worker;
+    }
+    SDL_DestroyCond(mParkCond);
+    SDL_DestroyMutex(mParkMutex);
+    SDL_DestroySemaphore(mSignal);
+}
+
+int ThreadPool::active_workers() const
+{
+    return SDL_AtomicGet(&mActiveWorkers);
+}
+
+void ThreadPool::set_active_workers(int count)
+{
+    count = SDL_max(1, SDL_min(count, num_workers()));
+    SDL_LockMutex(mParkMutex);
+    SDL_AtomicSet(&mActiveWorkers, count);
+    SDL_CondBroadcast(mParkCond);
+    SDL_UnlockMutex(mParkMutex);
+}
+
+void ThreadPool::submit(const Job& job, WaitGroup* group)
+{
+    if (group != NULL) {
+        group->add(1);
+    }
+
+    Task task;
+    task.job = job;
+    task.group = group;
+
+    auto index = current_worker();
+    if (index < 0) {
+        index = (SDL_AtomicAdd(&mNextWorker, 1) & 0x7fffffff) % active_workers();
+    }
+    auto worker = mWorkers[index];
+    SDL_AtomicLock(&worker->lock);
+    worker->tasks.push_back(task);
+    SDL_AtomicUnlock(&worker->lock);
+    SDL_SemPost(mSignal);
+}
+
+void ThreadPool::parallel_for(int begin, int end, int grain, const RangeJob& body)
+{
+    if (begin >= end) {
+        return;
+    }
+    if (grain <= 0) {
+        grain = SDL_max(1, (end - begin) / (active_workers() * 4));
+    }
+
+    WaitGroup group;
+    for (auto chunk = begin; chunk < end; chunk += grain) {
+        auto chunkEnd = SDL_min(end, chunk + grain);
+        submit([&body, chunk, chunkEnd]() { body(chunk, chunkEnd); }, &group);
+    }
+    wait(group);
+}
+
+void ThreadPool::wait(WaitGroup& group)
+{
+    auto worker = current_worker();
+    while (!group.is_done()) {
+        if (!run_one(worker)) {
+            group.wait(1);
+        }
+    }
+    // synchronize with the last done() before the group gets destroyed.
+    group.wait();
+}
+
+int ThreadPool::worker_function(void* data)
+{
+    auto worker = static_cast<Worker*>(data);
+    auto pool = worker->pool;
+    tPool = pool;
+    tWorker = worker->index;
+    for (;;) {
+        pool->park(worker->index);
+        SDL_SemWait(pool->mSignal);
+        if (worker->index >= pool->active_workers() && SDL_AtomicGet(&pool->mStopping) == 0) {
+            // pass the signal on to an active worker before parking.
+            SDL_SemPost(pool->mSignal);
+            continue;
+        }
+        while (pool->run_one(worker->index)) {
+        }
+        if (SDL_AtomicGet(&pool->mStopping) != 0) {
+            break;
+        }
+    }
+    return 0;
+}
+
+void ThreadPool::park(int worker)
+{
+    SDL_LockMutex(mParkMutex);
+    while (worker >= SDL_AtomicGet(&mActiveWorkers) && SDL_AtomicGet(&mStopping) == 0) {
+        SDL_CondWait(mParkCond, mParkMutex);
+    }
+    SDL_UnlockMutex(mParkMutex);
+}
+
+int ThreadPool::current_worker() const
+{
+    return tPool == this ? tWorker : -1;
+}
+
+bool ThreadPool::take(int worker, Task* task)
+{
+    auto numWorkers = int(mWorkers.size());
+    if (worker >= 0) {
+        auto own = mWorkers[worker];
+        SDL_AtomicLock(&own->lock);
+        auto found = !own->tasks.empty();
+        if (found) {
+            *task = own->tasks.back();
+            own->tasks.pop_back();
+        }
+        SDL_AtomicUnlock(&own->lock);
+        if (found) {
+            return true;
+        }
+    }
+
+    // steal from the oldest end of the other workers' deques.
+    auto first = worker >= 0 ? worker + 1 : (SDL_AtomicGet(&mNextWorker) & 0x7fffffff);
+    for (auto i = 0; i < numWorkers; i++) {
+        auto victim = mWorkers[(first + i) % numWorkers];
+        if (victim->index == worker) {
+            continue;
+        }
+        SDL_AtomicLock(&victim->lock);
+        auto found = !victim->tasks.empty();
+        if (found) {
+            *task = victim->tasks.front();
+            victim->tasks.pop_front();
+        }
+        SDL_AtomicUnlock(&victim->lock);
+        if (found) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::run_one(int worker)
+{
+    Task task;
+    if (!take(worker, &task)) {
+        return false;
+    }
+    task.job();
+    if (task.group != NULL) {
+        task.group->done();
+    }
+    return true;
+}
@@ -0,0 +1,108 @@
+// ============================================================================
+// THREAD POOL
+// ============================================================================
+// A persistent pool of SDL threads that runs short jobs without creating and
+// destroying a thread per job. The pool is built with SDL_Thread, SDL_sem and
+// SDL_atomic_t primitives.
+//
+// Each worker has a deque of its own. Jobs submitted from a worker are pushed
+// into the back of its deque and the worker pops from the back (LIFO) to keep
+// the caches warm. Jobs submitted from other threads are distributed between
+// the workers in a round-robin fashion. An idle worker steals jobs from the
+// front (FIFO) of the other workers' deques.
+//
+// submit().........Run a job on the pool and optionally track it in a group.
+// parallel_for()...Split a range into chunks and run them on the pool.
+// wait()...........Wait for a group to complete while running pending jobs,
+//                  which makes it safe to wait within a job of the same pool.
+//
+// The amount of active workers can be limited with set_active_workers(), e.g.
+// to save power. The workers above the limit are parked on a condition and
+// their queued jobs are stolen by the active workers.
+// ============================================================================
+#pragma once
+
+#include <SDL.h>
+
+#include <deque>
+#include <functional>
+#include <vector>
+
+// ============================================================================
+// A counter of outstanding jobs that can be waited to reach zero.
+// ============================================================================
+class WaitGroup {
+public:
+    WaitGroup();
+    ~WaitGroup();
+
+    void add(int count);
+    void done();
+    bool is_done();
+    // block until the count reaches zero or the timeout (ms) expires.
+    bool wait(Uint32 timeout = SDL_MUTEX_MAXWAIT);
+
+private:
+    WaitGroup(const WaitGroup&);
+    WaitGroup& operator=(const WaitGroup&);
+
+    SDL_atomic_t mCount;
+    SDL_mutex*   mMutex;
+    SDL_cond*    mCond;
+};
+
+class ThreadPool {
+public:
+    typedef std::function<void()>         Job;
+    typedef std::function<void(int, int)> RangeJob;
+
+    // build a pool with the given amount of workers (0 = SDL_GetCPUCount()).
+    explicit ThreadPool(int numWorkers = 0);
+    ~ThreadPool();
+
+    void submit(const Job& job, WaitGroup* group = NULL);
+    // run the body for [begin, end) in chunks of grain items and wait for it.
+    void parallel_for(int begin, int end, int grain, const RangeJob& body);
+    // wait for the group to complete and help running jobs in the meanwhile.
+    void wait(WaitGroup& group);
+
+    int num_workers() const { return int(mWorkers.size()); }
+    int active_workers() const;
+    // limit the jobs to the first count workers (clamped to [1, num_workers]).
+    void set_active_workers(int count);
+
+private:
+    struct Task {
+        Job        job;
+        WaitGroup* group;
+    };
+
+    struct Worker {
+        ThreadPool*      pool;
+        int              index;
+        SDL_Thread*      thread;
+        SDL_SpinLock     lock;
+        std::deque<Task> tasks;
+    };
+
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+
+    static int worker_function(void* data);
+    // the index of the calling worker of this pool or -1 for other threads.
+    int current_worker() const;
+    // pop a task from the own deque or steal one from the other workers.
+    bool take(int worker, Task* task);
+    // take and run a single task. Returns false when no tasks were found.
+    bool run_one(int worker);
+    // wait on the park condition while the worker is above the active limit.
+    void park(int worker);
+
+    std::vector<Worker*> mWorkers;
+    SDL_sem*             mSignal;
+    SDL_mutex*           mParkMutex;
+    SDL_cond*            mParkCond;
+    SDL_atomic_t         mStopping;
+    SDL_atomic_t         mNextWorker;
+    mutable SDL_atomic_t mActiveWorkers;
+};
@@ -0,0 +1,386 @@
+#include "timer_wheel.h"
+
+#include <cmath>
+
+static const int    SLOT_MASK = TimerWheel::NUM_SLOTS - 1;
+static const Uint64 MAX_DELTA = (Uint64(1) << (TimerWheel::SLOT_BITS * TimerWheel::NUM_LEVELS)) - 1;
+
+static int lowest_bit(Uint64 mask)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(mask);
+#else
+    auto index = 0;
+    while ((mask & 1) == 0) {
+        mask >>= 1;
+        index++;
+    }
+    return index;
+#endif
+}
+
+TimerWheel::TimerWheel(ThreadPool* pool, double resolutionMs)
+    : mPool(pool),
+      mResolutionMs(resolutionMs > 0.0 ? resolutionMs : 0.25),
+      mStart(SDL_GetPerformanceCounter()),
+      mFrequency(SDL_GetPerformanceFrequency()),
+      mNow(0),
+      mWakeTick(0),
+      mActive(0),
+      mQuit(false),
+      mMutex(SDL_CreateMutex()),
+      mCond(SDL_CreateCond()),
+      mThread(NULL),
+      mEventType(SDL_RegisterEvents(1)),
+      mEventPending(false)
+{
+    for (auto level = 0; level < NUM_LEVELS; level++) {
+        for (auto slot = 0; slot < NUM_SLOTS; slot++) {
+            mHeads[level][slot] = -1;
+        }
+        for (auto& word : mOccupied[level]) {
+            word = 0;
+        }
+    }
+    if (mEventType == Uint32(-1)) {
+        SDL_Log("Unable to register the timer wheel event type: %s\n", SDL_GetError());
+    }
+    mThread = SDL_CreateThread(thread_function, "timer-wheel", this);
+    if (mThread == NULL) {
+        SDL_Log("Unable to create the timer wheel thread: %s\n", SDL_GetError());
+    }
+}
+
+TimerWheel::~TimerWheel()
+{
+    SDL_LockMutex(mMutex);
+    mQuit = true;
+    SDL_CondSignal(mCond);
+    SDL_UnlockMutex(mMutex);
+    if (mThread != NULL) {
+        SDL_WaitThread(mThread, NULL);
+    }
+    if (mEventType != Uint32(-1)) {
+        SDL_FlushEvent(mEventType);
+    }
+    SDL_DestroyCond(mCond);
+    SDL_DestroyMutex(mMutex);
+}
+
+Uint64 TimerWheel::now_ticks() const
+{
+    auto elapsed = double(SDL_GetPerformanceCounter() - mStart);
+    return Uint64(elapsed * 1000.0 / (double(mFrequency) * mResolutionMs));
+}
+
+TimerWheel::TimerId TimerWheel::schedule(double delayMs, const Callback& callback, Executor executor, double intervalMs)
+{
+    if (mThread == NULL || !callback) {
+        return 0;
+    }
+    auto interval = intervalMs > 0.0 ? Uint64(SDL_max(std::ceil(intervalMs / mResolutionMs), 1.0)) : 0;
+
+    SDL_LockMutex(mMutex);
+    // read the time under the lock, so that the wheel cannot advance past the
+    // deadline before it is linked. Round the deadline up, so that a timer is
+    // never called before it.
+    auto elapsed = double(SDL_GetPerformanceCounter() - mStart);
+    auto exactNow = elapsed * 1000.0 / (double(mFrequency) * mResolutionMs);
+    auto now = Uint64(exactNow);
+    auto deadline = Uint64(std::ceil(exactNow + SDL_max(delayMs, 0.0) / mResolutionMs));
+    deadline = SDL_max(deadline, now + 1);
+    // an empty wheel can jump to the current time without stepping the slots.
+    if (mActive == 0 && now > mNow) {
+        mNow = now;
+    }
+    int index;
+    if (mFree.empty()) {
+        index = int(mTimers.size());
+        mTimers.push_back(Timer());
+        mTimers.back().generation = 1;
+    } else {
+        index = mFree.back();
+        mFree.pop_back();
+    }
+    auto& timer = mTimers[index];
+    timer.deadline = deadline;
+    timer.interval = interval;
+    timer.callback = callback;
+    timer.executor = executor;
+    link(index);
+    mActive++;
+    auto id = (TimerId(timer.generation) << 32) | TimerId(index + 1);
+    if (timer.deadline < mWakeTick || mActive == 1) {
+        SDL_CondSignal(mCond);
+    }
+    SDL_UnlockMutex(mMutex);
+    mScheduled.increment();
+    return id;
+}
+
+bool TimerWheel::cancel(TimerId id)
+{
+    auto index = int(id & 0xffffffff) - 1;
+    auto generation = Uint32(id >> 32);
+    auto result = false;
+    SDL_LockMutex(mMutex);
+    if (index >= 0 && index < int(mTimers.size())
+        && mTimers[index].generation == generation
+        && mTimers[index].level >= 0) {
+        unlink(index);
+        release(index);
+        result = true;
+    }
+    SDL_UnlockMutex(mMutex);
+    return result;
+}
+
+bool TimerWheel::handle_event(const SDL_Event& event)
+{
+    if (event.type != mEventType || event.user.data2 != this) {
+        return false;
+    }
+    std::vector<Expired> batch;
+    SDL_LockMutex(mMutex);
+    batch.swap(mMainQueue);
+    mEventPending = false;
+    SDL_UnlockMutex(mMutex);
+    for (auto& expired : batch) {
+        expired.callback();
+    }
+    return true;
+}
+
+int TimerWheel::num_active() const
+{
+    SDL_LockMutex(mMutex);
+    auto active = mActive;
+    SDL_UnlockMutex(mMutex);
+    return active;
+}
+
+void TimerWheel::link(int index)
+{
+    auto& timer = mTimers[index];
+    // the current slot of level 0 has already expired, so the next is the
+    // earliest slot that is still ahead of the wheel.
+    auto position = SDL_max(timer.deadline, mNow + 1);
+    auto delta = position - mNow;
+    auto level = 0;
+    while (level < NUM_LEVELS - 1 && delta >> (SLOT_BITS * (level + 1)) != 0) {
+        level++;
+    }
+    // a deadline beyond the wheel waits in the last slot and is linked again.
+    if (delta > MAX_DELTA) {
+        position = mNow + MAX_DELTA;
+    }
+    link_slot(index, level, int(position >> (SLOT_BITS * level)) & SLOT_MASK);
+}
+
+void TimerWheel::link_slot(int index, int level, int slot)
+{
+    auto& timer = mTimers[index];
+    timer.level = level;
+    timer.slot = slot;
+    timer.prev = -1;
+    timer.next = mHeads[level][slot];
+    if (timer.next >= 0) {
+        mTimers[timer.next].prev = index;
+    }
+    mHeads[level][slot] = index;
+    mOccupied[level][slot / 64] |= Uint64(1) << (slot % 64);
+}
+
+void TimerWheel::unlink(int index)
+{
+    auto& timer = mTimers[index];
+    if (timer.prev >= 0) {
+        mTimers[timer.prev].next = timer.next;
+    } else {
+        mHeads[timer.level][timer.slot] = timer.next;
+        if (timer.next < 0) {
+            mOccupied[timer.level][timer.slot / 64] &= ~(Uint64(1) << (timer.slot % 64));
+        }
+    }
+    if (timer.next >= 0) {
+        mTimers[timer.next].prev = timer.prev;
+    }
+}
+
+void TimerWheel::release(int index)
+{
+    auto& timer = mTimers[index];
+    timer.callback = Callback();
+    timer.level = -1;
+    timer.generation++;
+    mFree.push_back(index);
+    mActive--;
+}
+
+void TimerWheel::advance(Uint64 target, std::vector<Expired>& batch)
+{
+    while (mNow < target) {
+        // step to the next occupied slot of level 0 or to the end of the level.
+        auto next = (mNow | SLOT_MASK) + 1;
+        auto from = int(mNow & SLOT_MASK) + 1;
+        for (auto word = from / 64; word < NUM_SLOTS / 64; word++) {
+            auto mask = mOccupied[0][word];
+            if (word == from / 64) {
+                mask &= ~Uint64(0) << (from % 64);
+            }
+            if (mask != 0) {
+                next = (mNow & ~Uint64(SLOT_MASK)) + Uint64(word * 64 + lowest_bit(mask));
+                break;
+            }
+        }
+        if (next > target) {
+            mNow = target;
+            return;
+        }
+        mNow = next;
+        if ((mNow & SLOT_MASK) == 0) {
+            for (auto level = 1; level < NUM_LEVELS; level++) {
+                auto slot = int(mNow >> (SLOT_BITS * level)) & SLOT_MASK;
+                cascade(level, slot);
+                if (slot != 0) {
+                    break;
+                }
+            }
+        }
+        expire_slot(int(mNow & SLOT_MASK), batch);
+    }
+}
+
+void TimerWheel::cascade(int level, int slot)
+{
+    auto index = mHeads[level][slot];
+    mHeads[level][slot] = -1;
+    mOccupied[level][slot / 64] &= ~(Uint64(1) << (slot % 64));
+    while (index >= 0) {
+        auto next = mTimers[index].next;
+        // a timer that is due now goes into the slot that is expired next.
+        if (mTimers[index].deadline <= mNow) {
+            link_slot(index, 0, int(mNow & SLOT_MASK));
+        } else {
+            link(index);
+        }
+        index = next;
+    }
+}
+
+void TimerWheel::expire_slot(int slot, std::vector<Expired>& batch)
+{
+    auto index = mHeads[0][slot];
+    mHeads[0][slot] = -1;
+    mOccupied[0][slot / 64] &= ~(Uint64(1) << (slot % 64));
+    while (index >= 0) {
+        auto& timer = mTimers[index];
+        auto next = timer.next;
+        if (timer.deadline > mNow) {
+            link(index);
+        } else if (timer.interval > 0) {
+            Expired expired = { timer.callback, timer.executor };
+            batch.push_back(expired);
+            // skip the missed periods instead of firing them all at once.
+            timer.deadline += ((mNow - timer.deadline) / timer.interval + 1) * timer.interval;
+            link(index);
+        } else {
+            Expired expired = { Callback(), timer.executor };
+            expired.callback.swap(timer.callback);
+            batch.push_back(expired);
+            release(index);
+        }
+        index = next;
+    }
+}
+
+Uint64 TimerWheel::next_event_tick() const
+{
+    auto from = int(mNow & SLOT_MASK) + 1;
+    for (auto word = from / 64; word < NUM_SLOTS / 64; word++) {
+        auto mask = mOccupied[0][word];
+        if (word == from / 64) {
+            mask &= ~Uint64(0) << (from % 64);
+        }
+        if (mask != 0) {
+            return (mNow & ~Uint64(SLOT_MASK)) + Uint64(word * 64 + lowest_bit(mask));
+        }
+    }
+    return (mNow | SLOT_MASK) + 1;
+}
+
+int TimerWheel::thread_function(void* data)
+{
+    auto wheel = static_cast<TimerWheel*>(data);
+    std::vector<Expired> batch;
+    SDL_LockMutex(wheel->mMutex);
+    while (!wheel->mQuit) {
+        auto now = wheel->now_ticks();
+        wheel->advance(now, batch);
+        if (!batch.empty()) {
+            SDL_UnlockMutex(wheel->mMutex);
+            wheel->mExpired.add(Sint64(batch.size()));
+            wheel->dispatch(batch);
+            batch.clear();
+            SDL_LockMutex(wheel->mMutex);
+            continue;
+        }
+        if (wheel->mActive == 0) {
+            wheel->mWakeTick = SDL_MAX_UINT64;
+            SDL_CondWait(wheel->mCond, wheel->mMutex);
+            continue;
+        }
+        wheel->mWakeTick = wheel->next_event_tick();
+        auto waitMs = wheel->ticks_to_ms(wheel->mWakeTick - now);
+        if (waitMs >= 2.0) {
+            SDL_CondWaitTimeout(wheel->mCond, wheel->mMutex, Uint32(waitMs) - 1);
+        } else {
+            SDL_UnlockMutex(wheel->mMutex);
+            SDL_Delay(0);
+            SDL_LockMutex(wheel->mMutex);
+        }
+    }
+    SDL_UnlockMutex(wheel->mMutex);
+    return 0;
+}
+
+void TimerWheel::dispatch(std::vector<Expired>& batch)
+{
+    auto hasMain = false;
+    for (auto& expired : batch) {
+        switch (expired.executor) {
+            case EXECUTOR_POOL:
+                if (mPool != NULL) {
+                    mPool->submit(expired.callback);
+                    break;
+                }
+                expired.callback();
+                break;
+            case EXECUTOR_MAIN:
+                hasMain = true;
+                break;
+            default:
+                expired.callback();
+                break;
+        }
+    }
+    if (!hasMain) {
+        return;
+    }
+    SDL_LockMutex(mMutex);
+    for (auto& expired : batch) {
+        if (expired.executor == EXECUTOR_MAIN) {
+            mMainQueue.push_back(Expired());
+            mMainQueue.back().callback.swap(expired.callback);
+            mMainQueue.back().executor = EXECUTOR_MAIN;
+        }
+    }
+    if (!mEventPending && mEventType != Uint32(-1)) {
+        SDL_Event event;
+        SDL_zero(event);
+        event.type = mEventType;
+        event.user.data2 = this;
+        mEventPending = SDL_PushEvent(&event) == 1;
+    }
+    SDL_UnlockMutex(mMutex);
+}
@@ -0,0 +1,130 @@
+// ============================================================================
+// TIMER WHEEL
+// ============================================================================
+// A hierarchical timer wheel for many short-lived timeouts. SDL_AddTimer runs
+// every callback on the single SDL timer thread with millisecond granularity
+// and keeps the timers in a sorted list, so a heavy callback delays all the
+// other timers and adding a timer gets slower with the amount of timers.
+//
+// The wheel has NUM_LEVELS levels of NUM_SLOTS slots. A slot of level 0 is a
+// single tick (the resolution) and a slot of level N spans all the slots of
+// level N-1. A timer is linked into the slot of its deadline at the lowest
+// level that reaches it, which makes schedule() and cancel() O(1). When the
+// wheel advances to the next slot of a level, the timers of that slot are
+// cascaded down to the lower levels. The slots have occupancy bitmaps, so the
+// wheel can skip the empty slots instead of stepping through every tick.
+//
+// The "timer-wheel" thread advances the wheel with SDL_GetPerformanceCounter
+// and collects the expired timers as a batch, which is dispatched outside of
+// the lock to the executor of each timer.
+//
+// EXECUTOR_TIMER...Run on the timer thread. Only for short callbacks.
+// EXECUTOR_POOL....Submit as a job of the ThreadPool.
+// EXECUTOR_MAIN....Run on the event thread through handle_event(). A single
+//                  SDL event of a type from SDL_RegisterEvents carries all the
+//                  callbacks that have expired since the previous event.
+//
+// The thread sleeps until the next occupied slot with SDL_CondWaitTimeout and
+// yields the last millisecond with SDL_Delay(0), because the condition wait
+// has only a millisecond granularity.
+// ============================================================================
+#pragma once
+
+#include <SDL.h>
+
+#include "counters.h"
+#include "thread_pool.h"
+
+#include <functional>
+#include <vector>
+
+class TimerWheel {
+public:
+    static const int SLOT_BITS = 8;
+    static const int NUM_SLOTS = 1 << SLOT_BITS;
+    static const int NUM_LEVELS = 4;
+
+    enum Executor {
+        EXECUTOR_TIMER,
+        EXECUTOR_POOL,
+        EXECUTOR_MAIN
+    };
+
+    typedef std::function<void()> Callback;
+    typedef Uint64                TimerId;
+
+    // the pool is used for EXECUTOR_POOL (or the timer thread when NULL).
+    explicit TimerWheel(ThreadPool* pool = NULL, double resolutionMs = 0.25);
+    ~TimerWheel();
+
+    // schedule a callback after the delay and then on the interval (if > 0).
+    // Returns 0 on failure. Can be called from any thread.
+    TimerId schedule(double delayMs, const Callback& callback,
+                     Executor executor = EXECUTOR_TIMER, double intervalMs = 0.0);
+    // returns false if the timer has already expired or been cancelled.
+    bool    cancel(TimerId id);
+    bool    handle_event(const SDL_Event& event);
+    Uint32  event_type() const { return mEventType; }
+
+    // convert between the wheel ticks and the milliseconds.
+    Uint64 now_ticks() const;
+    double ticks_to_ms(Uint64 ticks) const { return double(ticks) * mResolutionMs; }
+
+    int                   num_active() const;
+    const ShardedCounter& scheduled() const { return mScheduled; }
+    const ShardedCounter& expired() const   { return mExpired; }
+
+private:
+    struct Timer {
+        Uint64   deadline;
+        Uint64   interval;
+        Callback callback;
+        Executor executor;
+        Uint32   generation;
+        int      prev;
+        int      next;
+        int      level;
+        int      slot;
+    };
+
+    struct Expired {
+        Callback callback;
+        Executor executor;
+    };
+
+    TimerWheel(const TimerWheel&);
+    TimerWheel& operator=(const TimerWheel&);
+
+    static int thread_function(void* data);
+
+    void   link(int index);
+    void   link_slot(int index, int level, int slot);
+    void   unlink(int index);
+    void   release(int index);
+    void   advance(Uint64 target, std::vector<Expired>& batch);
+    void   expire_slot(int slot, std::vector<Expired>& batch);
+    void   cascade(int level, int slot);
+    Uint64 next_event_tick() const;
+    void   dispatch(std::vector<Expired>& batch);
+
+    ThreadPool*          mPool;
+    double               mResolutionMs;
+    Uint64               mStart;
+    Uint64               mFrequency;
+    Uint64               mNow;
+    Uint64               mWakeTick;
+    int                  mActive;
+    bool                 mQuit;
+    SDL_mutex*           mMutex;
+    SDL_cond*            mCond;
+    SDL_Thread*          mThread;
+    Uint32               mEventType;
+    bool                 mEventPending;
+    std::vector<Timer>   mTimers;
+    std::vector<int>     mFree;
+    int                  mHeads[NUM_LEVELS][NUM_SLOTS];
+    Uint64               mOccupied[NUM_LEVELS][NUM_SLOTS / 64];
+    std::vector<Expired> mMainQueue;
+    ShardedCounter       mScheduled;
+    ShardedCounter       mExpired;
+};